@@ -99,35 +99,107 @@ struct blit_op_table {
 
 extern struct blit_op_table optbl[];
 
+class FimgApi;
+
+/*
+ * Completion of an asynchronous blit. The G2D runs blits in order, so the
+ * fence is signaled once every blit up to its sequence number is done.
+ * GetFd() may be polled for POLLOUT to chain on it from an event loop.
+ */
+class FimgFence
+{
+private :
+    FimgApi        *m_fimgApi;
+    unsigned int    m_seqNo;
+
+public:
+    FimgFence();
+
+    bool            Wait(int timeoutMs);
+    bool            IsSignaled(void);
+    int             GetFd(void);
+    inline bool     IsValid(void) { return m_fimgApi != NULL; }
+    inline unsigned SeqNo(void)   { return m_seqNo; }
+
+    friend class FimgApi;
+};
+
 class FimgApi
 {
-    public:
+public:
 #endif
 
 #ifdef __cplusplus
-    private :
-        bool    m_flagCreate;
-
-    protected :
-        FimgApi();
-        FimgApi(const FimgApi& rhs) {}
-        virtual ~FimgApi();
-
-    public:
-        bool        Create(void);
-        bool        Destroy(void);
-        inline bool FlagCreate(void) { return m_flagCreate; }
-        bool        Stretch(struct fimg2d_blit *cmd);
-        bool        Sync(void);
-
-    protected:
-        virtual bool t_Create(void);
-        virtual bool t_Destroy(void);
-        virtual bool t_Stretch(struct fimg2d_blit *cmd);
-        virtual bool t_Sync(void);
-        virtual bool t_Lock(void);
-        virtual bool t_UnLock(void);
+private :
+    bool    m_flagCreate;
+
+    volatile unsigned int m_submitSeqNo;
+    volatile unsigned int m_doneSeqNo;
+
+protected :
+    FimgApi();
+    FimgApi(const FimgApi& rhs) {}
+    virtual ~FimgApi();
+
+public:
+    bool        Create(void);
+    bool        Destroy(void);
+    inline bool FlagCreate(void) { return m_flagCreate; }
+    bool        Stretch(struct fimg2d_blit *cmd);
+    bool        StretchBatch(struct fimg2d_blit **cmd, int numOfCmd);
+    bool        StretchAsync(struct fimg2d_blit *cmd, FimgFence *fence);
+    bool        WaitSeqNo(unsigned int seqNo, int timeoutMs);
+    int         GetFd(void);
+    bool        Sync(void);
+
+protected:
+    virtual bool t_Create(void);
+    virtual bool t_Destroy(void);
+    virtual bool t_Stretch(struct fimg2d_blit *cmd);
+    virtual bool t_StretchBatch(struct fimg2d_blit **cmd, int numOfCmd);
+    virtual bool t_StretchAsync(struct fimg2d_blit *cmd);
+    virtual bool t_Wait(int timeoutMs);
+    virtual int  t_GetFd(void);
+    virtual bool t_Sync(void);
+    virtual bool t_Lock(void);
+    virtual bool t_UnLock(void);
+
+};
 
+#define FIMG_BATCH_MAX_BLIT        (16)
+
+/*
+ * Command list of blits submitted to one G2D context under a single lock.
+ * Every blit is copied and validated on Append(), so Submit() only issues
+ * the ioctls back to back and Fence() waits once for all of them.
+ */
+class FimgBatch
+{
+private :
+    FimgApi            *m_fimgApi;
+    int                 m_numOfBlit;
+    bool                m_flagSubmit;
+
+    struct fimg2d_blit  m_blit[FIMG_BATCH_MAX_BLIT];
+    struct fimg2d_blit *m_ptrBlit[FIMG_BATCH_MAX_BLIT];
+    struct fimg2d_image m_src[FIMG_BATCH_MAX_BLIT];
+    struct fimg2d_image m_msk[FIMG_BATCH_MAX_BLIT];
+    struct fimg2d_image m_tmp[FIMG_BATCH_MAX_BLIT];
+    struct fimg2d_image m_dst[FIMG_BATCH_MAX_BLIT];
+
+public:
+    FimgBatch();
+    virtual ~FimgBatch();
+
+    bool        Begin(void);
+    bool        Append(struct fimg2d_blit *cmd);
+    bool        Submit(void);
+    bool        Fence(void);
+    inline int  NumOfBlit(void) { return m_numOfBlit; }
+
+private:
+    bool        m_CheckBlit(struct fimg2d_blit *cmd);
+    bool        m_CheckImage(struct fimg2d_image *image, bool isDst);
 };
 #endif
 
@@ -150,6 +222,68 @@ extern "C"
 #endif
 int SyncFimgApi(void);
 
+#ifdef __cplusplus
+extern "C"
+#endif
+int stretchFimgApiBatch(struct fimg2d_blit **cmd, int numOfCmd);
+
+/*
+ * Fence of stretchFimgApiAsync(). Every G2D context counts its own sequence
+ * numbers, so the fence keeps the context which queued the blit and
+ * waitFimgApi() waits on that one, whichever context the caller gets next.
+ */
+struct fimg_fence {
+    void           *fimgApi;
+    unsigned int    seqNo;
+};
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int stretchFimgApiAsync(struct fimg2d_blit *cmd, struct fimg_fence *fence);
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int waitFimgApi(struct fimg_fence *fence, int timeoutMs);
+
+/*
+ * G2D contexts are kept open in a pool. Contexts unused for idleTimeMs are
+ * closed while other blits are released, except the first numOfKeep ones.
+ * trimFimgApi() applies the policy right away, ex. when the UI goes idle.
+ */
+#ifdef __cplusplus
+extern "C"
+#endif
+void setFimgApiPoolPolicy(int idleTimeMs, int numOfKeep);
+
+#ifdef __cplusplus
+extern "C"
+#endif
+void trimFimgApi(void);
+
+/*
+ * FIMGAPI_BACKEND_AUTO uses G2D and falls back to the CPU (FimgSw) when
+ * /dev/fimg2d can not be opened or a blit fails. HW and SW force one of them.
+ * The CPU only reaches images mapped to the process (ADDR_USER), blits of
+ * other address types fail instead of falling back.
+ */
+enum {
+    FIMGAPI_BACKEND_AUTO = 0,
+    FIMGAPI_BACKEND_HW,
+    FIMGAPI_BACKEND_SW,
+};
+
+#ifdef __cplusplus
+extern "C"
+#endif
+void setFimgApiBackend(int backend);
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int getFimgApiBackend(void);
+
 void printDataBlit(char *title, struct fimg2d_blit *cmd);
 void printDataBlitRotate(int rotate);
 void printDataBlitImage(char *title, struct fimg2d_image *image);
@@ -60,6 +60,7 @@ extern "C" {
 #include "sec_utils.h"
 #endif
 #include "sec_format.h"
+#include "sec_fimc_format.h"
 
 #include "SecBuffer.h"
 #include "SecRect.h"
@@ -67,10 +68,11 @@ extern "C" {
 #define PFX_NODE_FIMC        "/dev/video"
 #ifdef BOARD_USE_V4L2
 #define MAX_DST_BUFFERS     (4)	//yulu
+#define MAX_SRC_BUFFERS     (1)
 #else
 #define MAX_DST_BUFFERS     (3)
+#define MAX_SRC_BUFFERS     (4)     // deepest src queue of the streaming mode
 #endif
-#define MAX_SRC_BUFFERS     (1)
 #define MAX_PLANES          (3)
 
 #ifdef __cplusplus
@@ -114,6 +116,9 @@ private:
     bool                        mFlagSetSrcParam;
     bool                        mFlagSetDstParam;
     bool                        mFlagStreamOn;
+    int                         mQueueDepth;
+    int                         mNumOfQueued;
+    int                         mQueueHead;
 
     s5p_fimc_t                  mS5pFimc;
     struct v4l2_capability      mFimcCap;
@@ -172,8 +177,21 @@ public:
 
     virtual bool draw(int src_index, int dst_index);
 
+    /*
+     * The stream stays on between frames and is only stopped when a
+     * parameter or the dst address changes, or on destroy().
+     * enqueue() returns once the src is queued and only waits when
+     * queueDepth frames are already in flight, dequeue() waits for the
+     * oldest one. draw() is enqueue() followed by dequeue() of every frame.
+     */
+    virtual bool setQueueDepth(int queueDepth);
+    int  getQueueDepth(void);
+    virtual bool enqueue(int src_index, int dst_index);
+    virtual bool dequeue(int *src_index = NULL);
+
 private:
     bool m_streamOn(void);
+    bool m_streamOff(void);
     bool m_checkSrcSize(unsigned int width, unsigned int height,
                         unsigned int cropX, unsigned int cropY,
                         unsigned int *cropWidth, unsigned int *cropHeight,
@@ -0,0 +1,173 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      SecFimcScheduler.h
+ * \brief     header file for the FIMC job scheduler
+ *
+ * The scheduler runs each conversion job on the FIMC node of its device
+ * mask which would finish it first. A node is opened when the first job is
+ * put on it and closed again after SEC_FIMC_SCHED_IDLE_TIME without jobs,
+ * so only as many nodes are held as the load needs. Jobs of a higher
+ * priority are taken first by a node, so a display job only waits for the
+ * job already running and for other display jobs, and the node thread runs
+ * at the scheduling priority of the job it is working on.
+ */
+
+#ifndef __SEC_FIMC_SCHEDULER_H__
+#define __SEC_FIMC_SCHEDULER_H__
+
+#include <utils/threads.h>
+#include <utils/String8.h>
+
+#include "SecFimc.h"
+
+#define SEC_FIMC_SCHED_MAX_JOB      (32)
+#define SEC_FIMC_SCHED_DEV_MASK_ALL ((1 << SecFimc::DEV_MAX) - 1)
+#define SEC_FIMC_SCHED_IDLE_TIME    (1000)  // ms a node stays open without jobs
+
+// nodes getInstance() may open, the others are kept for the HWC, HDMI and
+// camera. A board sets it with BOARD_FIMC_SCHED_DEV_MASK.
+#ifndef SEC_FIMC_SCHED_DEV_MASK_DEFAULT
+#define SEC_FIMC_SCHED_DEV_MASK_DEFAULT (1 << SecFimc::DEV_0)
+#endif
+
+class SecFimcScheduler
+{
+public:
+    enum PRIORITY {
+        PRIORITY_DISPLAY = 0,
+        PRIORITY_ENCODER,
+        PRIORITY_BACKGROUND,
+        PRIORITY_MAX,
+    };
+
+    //! one conversion : rect.fullW/fullH is the image size, rect.colorFormat is HAL_PIXEL_FORMAT_XXX
+    struct Job {
+        SecBuffer   srcBuf;
+        SecRect     srcRect;
+        SecBuffer   dstBuf;
+        SecRect     dstRect;
+        int         rotVal;
+        int         priority;
+    };
+
+    struct NodeStats {
+        int          dev;
+        bool         enable;
+        unsigned int numOfDone;
+        unsigned int numOfFail;
+        int          numOfQueued;
+        nsecs_t      busyTime;      //!< since create(), also while closed
+        int          utilization;   //!< busy time per mille since resetStats()
+    };
+
+private:
+    enum JOB_STATE {
+        JOB_FREE = 0,
+        JOB_QUEUED,
+        JOB_RUNNING,
+        JOB_DONE,
+        JOB_FAILED,
+    };
+
+    struct JobSlot {
+        Job          job;
+        int          id;
+        int          state;
+        int          node;
+        unsigned int cost;          //!< estimated work, in 1K pixels
+        unsigned int triedMask;     //!< nodes which failed this job
+        unsigned int seq;           //!< FIFO order inside a priority
+        bool         detached;      //!< cancelled while running, freed when done
+    };
+
+    class NodeThread;
+
+    struct Node {
+        SecFimc             fimc;
+        bool                enable;         //!< open and its thread is running
+        bool                opening;        //!< being opened without mLock, see m_openNode()
+        nsecs_t             openFailTime;   //!< held by another user, skipped for SEC_FIMC_SCHED_IDLE_TIME
+        android::sp<android::Thread> thread;
+        android::Condition  workCond;
+
+        unsigned int        runningCost;
+        unsigned int        numOfDone;
+        unsigned int        numOfFail;
+        nsecs_t             busyTime;
+        nsecs_t             busyTimeAtReset;
+        nsecs_t             runStart;
+        int                 threadPriority;
+    };
+
+    bool                    mFlagCreate;
+    bool                    mFlagExit;
+    unsigned int            mDevMask;
+    android::Mutex          mLock;
+    android::Condition      mDoneCond;
+    android::Condition      mOpenCond;
+
+    Node                    mNode[SecFimc::DEV_MAX];
+    JobSlot                 mJob[SEC_FIMC_SCHED_MAX_JOB];
+    int                     mNextJobId;
+    unsigned int            mNextSeq;
+    nsecs_t                 mResetTime;
+
+    static android::Mutex       mInstanceLock;
+    static SecFimcScheduler    *mInstance;
+
+public:
+    SecFimcScheduler();
+    virtual ~SecFimcScheduler();
+
+    //! process wide scheduler on the nodes of SEC_FIMC_SCHED_DEV_MASK_DEFAULT
+    static SecFimcScheduler *getInstance(void);
+
+    //! no node is opened here, only when a job needs it
+    virtual bool create(unsigned int devMask = SEC_FIMC_SCHED_DEV_MASK_DEFAULT);
+    virtual bool destroy(void);
+    bool flagCreate(void);
+
+    //! returns the job id, or -1
+    int  submit(const Job *job);
+    //! waits the job and frees its id. timeoutMs < 0 waits forever,
+    //! on timeout the job is kept : wait() again or cancel() it
+    bool wait(int jobId, int timeoutMs = -1);
+    //! frees the job : a queued job is dropped, a running one is freed when done
+    bool cancel(int jobId);
+    //! submit() + wait()
+    bool run(const Job *job);
+
+    //! nodes of the mask which are open or may be opened
+    int  getNumOfNode(void);
+    bool getNodeStats(int node, NodeStats *stats);
+    void resetStats(void);
+    void dump(android::String8& result);
+
+private:
+    JobSlot *m_findJob(int jobId);
+    int  m_selectNode(JobSlot *slot);
+    bool m_openNode(int node);
+    void m_closeNode(int node);
+    void m_setThreadPriority(Node *n, int priority);
+    unsigned int m_loadOfNode(int node, int priority);
+    JobSlot *m_takeJob(int node);
+    bool m_runJob(int node, Job *job);
+    bool m_threadLoop(int node);
+};
+
+#endif //__SEC_FIMC_SCHEDULER_H__
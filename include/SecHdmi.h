@@ -49,7 +49,9 @@
 #include "../libhdmi/libsForhdmi/libcec/libcec.h"
 
 #include "../libhdmi/SecHdmi/SecHdmiCommon.h"
+#include "../libhdmi/SecHdmi/SecHdmiCEC.h"
 #include "../libhdmi/SecHdmi/SecHdmiV4L2Utils.h"
+#include "../libhdmi/SecHdmi/SecHdmiTrace.h"
 
 #if defined(BOARD_USES_FIMGAPI)
 #include "FimgApi.h"
@@ -60,6 +62,7 @@
 #include <hardware/hardware.h>
 
 #include <utils/threads.h>
+#include <utils/Timers.h>
 
 
 namespace android {
@@ -76,39 +79,9 @@ public :
     };
 
 private :
-    class CECThread: public Thread
-    {
-        public:
-            bool                mFlagRunning;
-
-        private:
-            sp<SecHdmi>         mSecHdmi;
-            Mutex               mThreadLoopLock;
-            Mutex               mThreadControlLock;
-            virtual bool        threadLoop();
-            enum CECDeviceType  mDevtype;
-            int                 mLaddr;
-            int                 mPaddr;
-
-        public:
-            CECThread(sp<SecHdmi> secHdmi)
-                :Thread(false),
-                mFlagRunning(false),
-                mSecHdmi(secHdmi),
-                mDevtype(CEC_DEVICE_PLAYER),
-                mLaddr(0),
-                mPaddr(0){
-            };
-            virtual ~CECThread();
-
-            bool start();
-            bool stop();
-
-    };
-
     Mutex        mLock;
 
-    sp<CECThread>               mCECThread;
+    sp<SecHdmiCEC>              mCECThread;
 
     bool         mFlagCreate;
     bool         mFlagConnected;
@@ -160,6 +133,7 @@ private :
     void         *mFBaddr;
     unsigned int mFBsize;
     int          mFBionfd;
+    unsigned long mFBphys;
     unsigned int mFBIndex;
     int          mHdmiFd[HDMI_LAYER_MAX];
 
@@ -192,7 +166,9 @@ public :
                         unsigned int srcYAddr, unsigned int srcCbAddr, unsigned int srcCrAddr,
                         int dstX, int dstY,
                         int hdmiLayer,
-                        int num_of_hwc_layer);
+                        int num_of_hwc_layer,
+                        struct v4l2_rect *damage = NULL,
+                        int fbYOffset = -1);
 
 	bool        clear(int hdmiLayer);
 
@@ -206,6 +182,11 @@ public :
 private:
 
     bool        m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer);
+#if defined(BOARD_USE_V4L2_ION)
+    bool        m_mapFramebuffer(unsigned int fbSize, unsigned long fbPhys);
+    void        m_unmapFramebuffer(void);
+    bool        m_getFramebufferPhys(unsigned long *fbPhys);
+#endif
     bool        m_startHdmi(int hdmiLayer, unsigned int num_of_plane);
     bool        m_startHdmi(int hdmiLayer);
     bool        m_stopHdmi(int hdmiLayer);
@@ -109,6 +109,71 @@ struct jpeg_config {
     int                         reserved[8];
 };
 
+/*
+ * A session keeps the device open, the queues configured and streaming and
+ * the buffers allocated (and mmap'ed) across images. It is only set up again
+ * when the format changes or, for decoding, the JPEG does not fit the input
+ * buffer. With V4L2_MEMORY_USERPTR the caller fills start/length of in_buf
+ * and out_buf before each jpeghal_session_exe(), with V4L2_MEMORY_MMAP it
+ * uses the buffers they point to.
+ */
+#define JPEG_SESSION_SIZE_ALIGN     (64 * 1024)   /* decoding input is allocated in this unit */
+
+struct jpeg_session {
+    int                 fd;
+    enum jpeg_mode      mode;
+    int                 flag_config;
+    int                 flag_stream_on;
+    struct jpeg_config  config;
+    struct jpeg_buf     in_buf;
+    struct jpeg_buf     out_buf;
+    int                 in_size_jpeg;   /* JPEG size the decoding input is allocated for */
+};
+
+/*
+ * A queue keeps up to JPEG_QUEUE_MAX_DEPTH input/output buffer pairs in
+ * flight, so the caller prepares the next image while the codec works on the
+ * previous ones. jpeghal_queue_get_buf() gives a free pair, which is filled
+ * and handed over by jpeghal_queue_submit(). Completions are taken in submit
+ * order by jpeghal_queue_reap(), either blocking or once the fd of
+ * jpeghal_queue_get_fd() polls readable. The callback, when set, is called
+ * from reap and flush for every finished pair. As for a session, the decoding
+ * input is allocated in JPEG_SESSION_SIZE_ALIGN units, so a JPEG of another
+ * size which still fits keeps the queue streaming.
+ */
+#define JPEG_QUEUE_MAX_DEPTH        4
+
+/* jpeghal_queue_reap() results besides the index of the finished pair */
+#define JPEG_QUEUE_ERROR            (-1)    /* the codec failed, every pair in flight is dropped */
+#define JPEG_QUEUE_TIMEOUT          (-2)    /* nothing finished yet, reap again later */
+#define JPEG_QUEUE_EMPTY            (-3)    /* nothing in flight */
+
+typedef void (*jpeg_queue_done_cb)(int index, int result, int size, void *priv);
+
+struct jpeg_queue {
+    int                 fd;
+    enum jpeg_mode      mode;
+    int                 flag_config;
+    int                 flag_stream_on;
+    int                 depth;
+    struct jpeg_config  config;
+    struct jpeg_buf_info in_info;
+    struct jpeg_buf_info out_info;
+    struct jpeg_buf     in_buf[JPEG_QUEUE_MAX_DEPTH];
+    struct jpeg_buf     out_buf[JPEG_QUEUE_MAX_DEPTH];
+    int                 busy[JPEG_QUEUE_MAX_DEPTH];
+    int                 order[JPEG_QUEUE_MAX_DEPTH];   /* submitted indexes, oldest first */
+    int                 num_queued;
+    int                 in_size_jpeg;   /* JPEG size the decoding input is allocated for */
+
+    jpeg_queue_done_cb  done_cb;
+    void                *done_priv;
+
+    unsigned int        num_done;
+    long long           time_first_us;
+    long long           time_last_us;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -128,6 +193,24 @@ int jpeghal_enc_exe(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf);
 
 int jpeghal_deinit(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf);
 
+int jpeghal_session_open(struct jpeg_session *session, enum jpeg_mode mode);
+int jpeghal_session_setconfig(struct jpeg_session *session, struct jpeg_config *config,
+                              struct jpeg_buf_info *in_info, struct jpeg_buf_info *out_info);
+int jpeghal_session_exe(struct jpeg_session *session);
+int jpeghal_session_close(struct jpeg_session *session);
+
+int jpeghal_queue_open(struct jpeg_queue *queue, enum jpeg_mode mode, int depth);
+int jpeghal_queue_setconfig(struct jpeg_queue *queue, struct jpeg_config *config,
+                            struct jpeg_buf_info *in_info, struct jpeg_buf_info *out_info);
+void jpeghal_queue_set_callback(struct jpeg_queue *queue, jpeg_queue_done_cb cb, void *priv);
+int jpeghal_queue_get_fd(struct jpeg_queue *queue);
+int jpeghal_queue_get_buf(struct jpeg_queue *queue);
+int jpeghal_queue_submit(struct jpeg_queue *queue, int index);
+int jpeghal_queue_reap(struct jpeg_queue *queue, int timeout_ms, int *size);
+int jpeghal_queue_flush(struct jpeg_queue *queue);
+float jpeghal_queue_get_rate(struct jpeg_queue *queue);
+int jpeghal_queue_close(struct jpeg_queue *queue);
+
 int jpeghal_s_ctrl(int fd, int cid, int value);
 int jpeghal_g_ctrl(int fd, int id);
 
@@ -0,0 +1,142 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/*
+ * file sec_fimc_format.h
+ * brief what FIMC needs to know about a V4L2 pixel format, shared by
+ *       libfimc and the hwcomposer. Include it after s5p_fimc.h and
+ *       sec_utils.h (or their _v4l2 versions), which bring the V4L2 formats.
+ */
+
+#ifndef __SAMSUNG_SYSLSI_SEC_FIMC_FORMAT_H__
+#define __SAMSUNG_SYSLSI_SEC_FIMC_FORMAT_H__
+
+/*
+ * One line per format:
+ *   F(v4l2 format, bpp, planes, yuv,
+ *     width alignment before FIMC 0x50, from FIMC 0x50 on, height alignment)
+ * FIMC rounds the destination size down to the alignment. With a rotation
+ * of 90/270 both sides of the destination take the width alignment.
+ * The table and the lookup below are generated from this list, so they
+ * cannot disagree.
+ */
+#define SEC_FIMC_FORMAT_LIST(F)                         \
+    F(V4L2_PIX_FMT_RGB565,   16, 1, 0,  8, 1, 1)        \
+    F(V4L2_PIX_FMT_RGB32,    32, 1, 0,  4, 1, 1)        \
+    F(V4L2_PIX_FMT_NV12,     12, 2, 1,  8, 2, 2)        \
+    F(V4L2_PIX_FMT_NV12T,    12, 2, 1,  8, 2, 2)        \
+    F(V4L2_PIX_FMT_NV21,     12, 2, 1,  8, 2, 2)        \
+    F(V4L2_PIX_FMT_NV21X,    12, 2, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_NV12X,    12, 2, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_YUV420,   12, 3, 1, 16, 2, 2)        \
+    F(V4L2_PIX_FMT_YUYV,     16, 1, 1,  4, 2, 1)        \
+    F(V4L2_PIX_FMT_YVYU,     16, 1, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_UYVY,     16, 1, 1,  4, 2, 1)        \
+    F(V4L2_PIX_FMT_VYUY,     16, 1, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_NV16,     16, 2, 1,  8, 2, 1)        \
+    F(V4L2_PIX_FMT_NV61,     16, 2, 1,  8, 2, 1)        \
+    F(V4L2_PIX_FMT_NV16X,    16, 2, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_NV61X,    16, 2, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_YUV422P,  16, 3, 1, 16, 2, 1)        \
+    SEC_FIMC_FORMAT_LIST_MPLANE(F)
+
+#ifdef BOARD_USE_V4L2
+#define SEC_FIMC_FORMAT_LIST_MPLANE(F)                  \
+    F(V4L2_PIX_FMT_NV12M,    12, 2, 1,  1, 1, 1)        \
+    F(V4L2_PIX_FMT_NV12MT,   12, 2, 1,  8, 2, 2)        \
+    F(V4L2_PIX_FMT_YUV420M,  12, 3, 1, 16, 2, 2)
+#else
+#define SEC_FIMC_FORMAT_LIST_MPLANE(F)
+#endif
+
+struct sec_fimc_format {
+    unsigned int    v4l2_fmt;
+    int             bpp;
+    int             planes;
+    int             yuv;
+    int             width_align;        /* FIMC before 0x50 */
+    int             width_align_v50;    /* FIMC 0x50 and later */
+    int             height_align;
+};
+
+#define SEC_FIMC_FORMAT_ENTRY(fmt, bpp, planes, yuv, w_align, w_align_v50, h_align) \
+    { fmt, bpp, planes, yuv, w_align, w_align_v50, h_align },
+
+static const struct sec_fimc_format sec_fimc_format_table[] = {
+    SEC_FIMC_FORMAT_LIST(SEC_FIMC_FORMAT_ENTRY)
+};
+
+#undef SEC_FIMC_FORMAT_ENTRY
+
+/* unknown formats get this one: no alignment, not YUV */
+static const struct sec_fimc_format sec_fimc_format_default = { 0, 0, 1, 0, 1, 1, 1 };
+
+/*
+ * The lookup is a switch over the formats, which the compiler turns into a
+ * binary search, instead of a scan of the table.
+ */
+#define SEC_FIMC_FORMAT_INDEX(fmt, bpp, planes, yuv, w_align, w_align_v50, h_align) \
+    SEC_FIMC_FORMAT_INDEX_##fmt,
+
+enum {
+    SEC_FIMC_FORMAT_LIST(SEC_FIMC_FORMAT_INDEX)
+    SEC_FIMC_FORMAT_NUM
+};
+
+#define SEC_FIMC_FORMAT_CASE(fmt, bpp, planes, yuv, w_align, w_align_v50, h_align) \
+    case fmt: return &sec_fimc_format_table[SEC_FIMC_FORMAT_INDEX_##fmt];
+
+static inline const struct sec_fimc_format *sec_fimc_get_format(unsigned int v4l2_fmt)
+{
+    switch (v4l2_fmt) {
+    SEC_FIMC_FORMAT_LIST(SEC_FIMC_FORMAT_CASE)
+    default:
+        return &sec_fimc_format_default;
+    }
+}
+
+#undef SEC_FIMC_FORMAT_INDEX
+#undef SEC_FIMC_FORMAT_CASE
+
+/* bpp and planes of YUV formats, -1 for the others */
+static inline int sec_fimc_yuv_bpp(unsigned int v4l2_fmt)
+{
+    const struct sec_fimc_format *format = sec_fimc_get_format(v4l2_fmt);
+
+    return format->yuv ? format->bpp : -1;
+}
+
+static inline int sec_fimc_yuv_planes(unsigned int v4l2_fmt)
+{
+    const struct sec_fimc_format *format = sec_fimc_get_format(v4l2_fmt);
+
+    return format->yuv ? format->planes : -1;
+}
+
+static inline int sec_fimc_align_width(unsigned int v4l2_fmt, bool v50, int width)
+{
+    const struct sec_fimc_format *format = sec_fimc_get_format(v4l2_fmt);
+    int align = v50 ? format->width_align_v50 : format->width_align;
+
+    return width - (width % align);
+}
+
+static inline int sec_fimc_align_height(unsigned int v4l2_fmt, int height)
+{
+    return height - (height % sec_fimc_get_format(v4l2_fmt)->height_align);
+}
+
+#endif /* __SAMSUNG_SYSLSI_SEC_FIMC_FORMAT_H__ */
@@ -466,4 +466,62 @@ void csc_ARGB8888_to_YUV420SP_NEON(
     unsigned int width,
     unsigned int height);
 
+/*
+ * Converts ARGB8888 to NV12T in one pass
+ * Same result as csc_ARGB8888_to_YUV420SP() followed by
+ * csc_linear_to_tiled_y() of Y and UV, without the linear buffer
+ *
+ * @param y_dst
+ *   Y plane address of NV12T[out]
+ *
+ * @param uv_dst
+ *   UV plane address of NV12T[out]
+ *
+ * @param rgb_src
+ *   Address of ARGB8888[in]
+ *
+ * @param width
+ *   Width of ARGB8888[in]
+ *   it should be even
+ *
+ * @param height
+ *   Height of ARGB8888[in]
+ *   it should be even
+ */
+void csc_ARGB8888_to_NV12T(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width,
+    unsigned int height);
+
+/*
+ * Converts RGB565 to NV12T in one pass
+ * Same result as csc_RGB565_to_YUV420SP() followed by
+ * csc_linear_to_tiled_y() of Y and UV, without the linear buffer
+ *
+ * @param y_dst
+ *   Y plane address of NV12T[out]
+ *
+ * @param uv_dst
+ *   UV plane address of NV12T[out]
+ *
+ * @param rgb_src
+ *   Address of RGB565[in]
+ *
+ * @param width
+ *   Width of RGB565[in]
+ *   it should be even
+ *
+ * @param height
+ *   Height of RGB565[in]
+ *   it should be even
+ */
+void csc_RGB565_to_NV12T(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width,
+    unsigned int height);
+
 #endif /*COLOR_SPACE_CONVERTOR_H_*/
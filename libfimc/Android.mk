@@ -39,6 +39,10 @@ ifeq ($(BOARD_USE_V4L2),true)
 LOCAL_CFLAGS += -DBOARD_USE_V4L2
 endif
 
+ifneq ($(BOARD_FIMC_SCHED_DEV_MASK),)
+LOCAL_CFLAGS += -DSEC_FIMC_SCHED_DEV_MASK_DEFAULT=$(BOARD_FIMC_SCHED_DEV_MASK)
+endif
+
 LOCAL_CFLAGS  += \
 	-DDEFAULT_FB_NUM=$(DEFAULT_FB_NUM)
 
@@ -46,7 +50,8 @@ LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/../include \
 	framework/base/include
 
-LOCAL_SRC_FILES := SecFimc.cpp
+LOCAL_SRC_FILES := SecFimc.cpp \
+	SecFimcScheduler.cpp
 
 LOCAL_MODULE_TAGS := eng
 LOCAL_MODULE := libfimc
@@ -62,31 +62,6 @@
 #define V4L2_MEMORY_TYPE_DST V4L2_MEMORY_USERPTR
 #endif
 
-struct yuv_fmt_list yuv_list[] = {
-    { "V4L2_PIX_FMT_NV12",      "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12,      12, 2 },
-#ifdef BOARD_USE_V4L2
-    { "V4L2_PIX_FMT_NV12M",     "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12M,     12, 2 },
-    { "V4L2_PIX_FMT_NV12MT",    "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12MT,    12, 2 },
-#endif
-    { "V4L2_PIX_FMT_NV12T",     "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12T,     12, 2 },
-    { "V4L2_PIX_FMT_NV21",      "YUV420/2P/LSB_CRCB",   V4L2_PIX_FMT_NV21,      12, 2 },
-    { "V4L2_PIX_FMT_NV21X",     "YUV420/2P/MSB_CBCR",   V4L2_PIX_FMT_NV21X,     12, 2 },
-    { "V4L2_PIX_FMT_NV12X",     "YUV420/2P/MSB_CRCB",   V4L2_PIX_FMT_NV12X,     12, 2 },
-#ifdef BOARD_USE_V4L2
-    { "V4L2_PIX_FMT_YUV420M",   "YUV420/3P",            V4L2_PIX_FMT_YUV420M,   12, 3 },
-#endif
-    { "V4L2_PIX_FMT_YUV420",    "YUV420/3P",            V4L2_PIX_FMT_YUV420,    12, 3 },
-    { "V4L2_PIX_FMT_YUYV",      "YUV422/1P/YCBYCR",     V4L2_PIX_FMT_YUYV,      16, 1 },
-    { "V4L2_PIX_FMT_YVYU",      "YUV422/1P/YCRYCB",     V4L2_PIX_FMT_YVYU,      16, 1 },
-    { "V4L2_PIX_FMT_UYVY",      "YUV422/1P/CBYCRY",     V4L2_PIX_FMT_UYVY,      16, 1 },
-    { "V4L2_PIX_FMT_VYUY",      "YUV422/1P/CRYCBY",     V4L2_PIX_FMT_VYUY,      16, 1 },
-    { "V4L2_PIX_FMT_UV12",      "YUV422/2P/LSB_CBCR",   V4L2_PIX_FMT_NV16,      16, 2 },
-    { "V4L2_PIX_FMT_UV21",      "YUV422/2P/LSB_CRCB",   V4L2_PIX_FMT_NV61,      16, 2 },
-    { "V4L2_PIX_FMT_UV12X",     "YUV422/2P/MSB_CBCR",   V4L2_PIX_FMT_NV16X,     16, 2 },
-    { "V4L2_PIX_FMT_UV21X",     "YUV422/2P/MSB_CRCB",   V4L2_PIX_FMT_NV61X,     16, 2 },
-    { "V4L2_PIX_FMT_YUV422P",   "YUV422/3P",            V4L2_PIX_FMT_YUV422P,   16, 3 },
-};
-
 #ifdef BOARD_USE_V4L2
 void dump_pixfmt_mp(struct v4l2_pix_format_mplane *pix_mp)
 {
@@ -534,6 +509,9 @@ SecFimc::SecFimc()
     mHwVersion = 0;
     mGlobalAlpha = 0x0;
     mFlagStreamOn = false;
+    mQueueDepth = 1;
+    mNumOfQueued = 0;
+    mQueueHead = 0;
     mFlagSetSrcParam = false;
     mFlagSetDstParam = false;
     mFlagGlobalAlpha = false;
@@ -703,18 +681,9 @@ bool SecFimc::destroy()
         return false;
     }
 
-    if (mFlagStreamOn == true) {
-        if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_SRC) < 0) {
-            ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
-            return false;
-        }
-#ifdef BOARD_USE_V4L2
-        if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_DST) < 0) {
-            ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
-            return false;
-        }
-#endif
-        mFlagStreamOn = false;
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
     }
 
     if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
@@ -835,6 +804,13 @@ bool SecFimc::setSrcParams(unsigned int width, unsigned int height,
     params->src.color_space = v4l2ColorFormat;
     src_planes = (src_planes == -1) ? 1 : src_planes;
 
+#ifndef BOARD_USE_V4L2
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+#endif
+
     if (mFlagSetSrcParam == true) {
         if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
             ALOGE("%s::fimc_v4l2_clr_buf_src() failed", __func__);
@@ -847,7 +823,7 @@ bool SecFimc::setSrcParams(unsigned int width, unsigned int height,
         return false;
     }
 
-    if (fimc_v4l2_req_buf(mFd, 1, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
+    if (fimc_v4l2_req_buf(mFd, mQueueDepth, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
         ALOGE("%s::fimc_v4l2_req_buf()[src] failed", __func__);
         return false;
     }
@@ -982,6 +958,9 @@ bool SecFimc::setDstParams(unsigned int width, unsigned int height,
     }
 
     s5p_fimc_params_t *params = &(mS5pFimc.params);
+#ifndef BOARD_USE_V4L2
+    s5p_fimc_img_info  prevDst = params->dst;
+#endif
 
     unsigned int fimcWidth  = *cropWidth;
     unsigned int fimcHeight = *cropHeight;
@@ -1042,6 +1021,21 @@ bool SecFimc::setDstParams(unsigned int width, unsigned int height,
     params->dst.color_space = v4l2ColorFormat;
     dst_planes = (dst_planes == -1) ? 1 : dst_planes;
 
+#ifndef BOARD_USE_V4L2
+    // same params : keep the stream running
+    if (   mFlagSetDstParam == true
+        && memcmp(&prevDst, &(params->dst), sizeof(prevDst)) == 0) {
+        *cropWidth  = fimcWidth;
+        *cropHeight = fimcHeight;
+        return true;
+    }
+
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+#endif
+
 #ifdef BOARD_USE_V4L2
     if (mFlagSetDstParam == true) {
         if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_DST, V4L2_MEMORY_TYPE_DST) < 0) {
@@ -1172,6 +1166,18 @@ bool SecFimc::setDstAddr(unsigned int physYAddr, unsigned int physCbAddr, unsign
     if (physYAddr != 0)
         mS5pFimc.use_ext_out_mem = 1;
 #else
+    // the dst address is part of the format, it can not change while streaming
+    if (   mFlagStreamOn == true
+        && params->dst.buf_addr_phy_rgb_y == physYAddr
+        && params->dst.buf_addr_phy_cb    == physCbAddr
+        && params->dst.buf_addr_phy_cr    == physCrAddr)
+        return true;
+
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+
     params->dst.buf_addr_phy_rgb_y = physYAddr;
     params->dst.buf_addr_phy_cb    = physCbAddr;
     params->dst.buf_addr_phy_cr    = physCrAddr;
@@ -1204,6 +1210,18 @@ bool SecFimc::setFlipVal(unsigned int flipVal)
         return false;
     }
 
+#ifndef BOARD_USE_V4L2
+    if (mFlagStreamOn == true) {
+        if (mFlipVal == (int)flipVal)
+            return true;
+
+        if (m_streamOff() == false) {
+            ALOGE("%s::m_streamOff() failed", __func__);
+            return false;
+        }
+    }
+#endif
+
 if(flipVal==1){
     	if (fimc_v4l2_s_ctrl(mFd, V4L2_HFLIP, 1) < 0) {
         	ALOGE("%s::fimc_v4l2_s_ctrl(V4L2_ROTATE) failed", __func__);
@@ -1239,6 +1257,18 @@ bool SecFimc::setRotVal(unsigned int rotVal)
         return false;
     }
 
+#ifndef BOARD_USE_V4L2
+    if (mFlagStreamOn == true) {
+        if (mRotVal == (int)rotVal)
+            return true;
+
+        if (m_streamOff() == false) {
+            ALOGE("%s::m_streamOff() failed", __func__);
+            return false;
+        }
+    }
+#endif
+
     if (fimc_v4l2_s_ctrl(mFd, V4L2_ROTATE, rotVal) < 0) {
         ALOGE("%s::fimc_v4l2_s_ctrl(V4L2_ROTATE) failed", __func__);
         return false;
@@ -1258,14 +1288,23 @@ bool SecFimc::setGlobalAlpha(bool enable, int alpha)
         return false;
     }
 
+#ifdef BOARD_USE_V4L2
     if (mFlagStreamOn == true) {
         ALOGE("%s::mFlagStreamOn == true", __func__);
         return false;
     }
+#endif
 
     if (mFlagGlobalAlpha == enable && mGlobalAlpha == alpha)
         return true;
 
+#ifndef BOARD_USE_V4L2
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+#endif
+
     memset(&fbuf, 0, sizeof(fbuf));
 
     if (ioctl(mFd, VIDIOC_G_FBUF, &fbuf) < 0) {
@@ -1313,14 +1352,23 @@ bool SecFimc::setLocalAlpha(bool enable)
         return false;
     }
 
+#ifdef BOARD_USE_V4L2
     if (mFlagStreamOn == true) {
         ALOGE("%s::mFlagStreamOn == true", __func__);
         return false;
     }
+#endif
 
     if (mFlagLocalAlpha == enable)
         return true;
 
+#ifndef BOARD_USE_V4L2
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+#endif
+
     return true;
 }
 
@@ -1334,14 +1382,23 @@ bool SecFimc::setColorKey(bool enable, int colorKey)
         return false;
     }
 
+#ifdef BOARD_USE_V4L2
     if (mFlagStreamOn == true) {
         ALOGE("%s::mFlagStreamOn == true", __func__);
         return false;
     }
+#endif
 
     if (mFlagColorKey == enable && mColorKey == colorKey)
         return true;
 
+#ifndef BOARD_USE_V4L2
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+#endif
+
     memset(&fbuf, 0, sizeof(fbuf));
 
     if (ioctl(mFd, VIDIOC_G_FBUF, &fbuf) < 0) {
@@ -1399,14 +1456,13 @@ bool SecFimc::draw(int src_index, int dst_index)
         return false;
     }
 
+#ifdef BOARD_USE_V4L2
     s5p_fimc_params_t *params = &(mS5pFimc.params);
-    bool flagStreamOn = false;
     int src_planes = m_getYuvPlanes(params->src.color_space);
     int dst_planes = m_getYuvPlanes(params->dst.color_space);
     src_planes  = (src_planes == -1) ? 1 : src_planes;
     dst_planes  = (dst_planes == -1) ? 1 : dst_planes;
 
-#ifdef BOARD_USE_V4L2
     if (mFlagStreamOn == false) {
         if (m_streamOn() == false) {
             ALOGE("%s::m_streamOn failed", __func__);
@@ -1434,35 +1490,140 @@ bool SecFimc::draw(int src_index, int dst_index)
         return false;
     }
 #else
-    if (fimc_v4l2_stream_on(mFd, V4L2_BUF_TYPE_SRC) < 0) {
-        ALOGE("%s::fimc_v4l2_stream_on() failed", __func__);
-        goto err;
+    if (enqueue(src_index, dst_index) == false) {
+        ALOGE("%s::enqueue() failed", __func__);
+        return false;
     }
 
-    flagStreamOn = true;
+    // callers of draw() use the dst right away
+    while (0 < mNumOfQueued) {
+        if (dequeue() == false) {
+            ALOGE("%s::dequeue() failed", __func__);
+            return false;
+        }
+    }
+#endif
 
-    if (fimc_v4l2_queue(mFd, &(mSrcBuffer), V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, src_index, src_planes) < 0) {
-        ALOGE("%s::fimc_v4l2_queue(index : %d) (mNumOfBuf : %d) failed", __func__, 0, mNumOfBuf);
-        goto err;
+    return true;
+}
+
+bool SecFimc::setQueueDepth(int queueDepth)
+{
+    if (mFlagCreate == false) {
+        ALOGE("%s::Not yet created", __func__);
+        return false;
     }
 
-    if (fimc_v4l2_dequeue(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, &src_index, src_planes) < 0) {
-        ALOGE("%s::fimc_v4l2_dequeue (mNumOfBuf : %d) failed", __func__, mNumOfBuf);
-        goto err;
+    if (queueDepth < 1 || MAX_SRC_BUFFERS < queueDepth) {
+        ALOGE("%s::invalid queueDepth(%d), max is %d", __func__, queueDepth, MAX_SRC_BUFFERS);
+        return false;
     }
-#endif
 
-err :
-#ifndef BOARD_USE_V4L2
-    if (flagStreamOn == true) {
-        if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_SRC) < 0) {
-            ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
+    if (mQueueDepth == queueDepth)
+        return true;
+
+    if (m_streamOff() == false) {
+        ALOGE("%s::m_streamOff() failed", __func__);
+        return false;
+    }
+
+    if (mFlagSetSrcParam == true) {
+        if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
+            ALOGE("%s::fimc_v4l2_clr_buf_src() failed", __func__);
+            return false;
+        }
+
+        if (fimc_v4l2_req_buf(mFd, queueDepth, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
+            ALOGE("%s::fimc_v4l2_req_buf()[src] failed", __func__);
+            return false;
+        }
+    }
+
+    mQueueDepth = queueDepth;
+
+    return true;
+}
+
+int SecFimc::getQueueDepth(void)
+{
+    return mQueueDepth;
+}
+
+bool SecFimc::enqueue(int src_index, int dst_index)
+{
+#ifdef BOARD_USE_V4L2
+    // the v4l2 path queues and dequeues in draw()
+    return draw(src_index, dst_index);
+#else
+    if (mFlagCreate == false) {
+        ALOGE("%s::Not yet created", __func__);
+        return false;
+    }
+
+    if (mFlagSetSrcParam == false || mFlagSetDstParam == false) {
+        ALOGE("%s::params are not set", __func__);
+        return false;
+    }
+
+    s5p_fimc_params_t *params = &(mS5pFimc.params);
+    int src_planes = m_getYuvPlanes(params->src.color_space);
+    src_planes = (src_planes == -1) ? 1 : src_planes;
+
+    if (mQueueDepth <= mNumOfQueued) {
+        if (dequeue() == false) {
+            ALOGE("%s::dequeue() failed", __func__);
+            return false;
+        }
+    }
+
+    if (mFlagStreamOn == false) {
+        if (m_streamOn() == false) {
+            ALOGE("%s::m_streamOn failed", __func__);
             return false;
         }
+        mFlagStreamOn = true;
     }
+
+    // the driver takes the src address at QBUF, so one mSrcBuffer serves every slot
+    if (fimc_v4l2_queue(mFd, &(mSrcBuffer), V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, mQueueHead, src_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_queue(index : %d) (mQueueDepth : %d) failed", __func__, mQueueHead, mQueueDepth);
+        return false;
+    }
+
+    mQueueHead = (mQueueHead + 1) % mQueueDepth;
+    mNumOfQueued++;
+
+    return true;
 #endif
+}
+
+bool SecFimc::dequeue(int *src_index)
+{
+#ifdef BOARD_USE_V4L2
+    return true;
+#else
+    s5p_fimc_params_t *params = &(mS5pFimc.params);
+    int src_planes = m_getYuvPlanes(params->src.color_space);
+    int index = 0;
+    src_planes = (src_planes == -1) ? 1 : src_planes;
+
+    if (mNumOfQueued <= 0) {
+        ALOGE("%s::nothing is queued", __func__);
+        return false;
+    }
+
+    if (fimc_v4l2_dequeue(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, &index, src_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_dequeue (mNumOfQueued : %d) failed", __func__, mNumOfQueued);
+        return false;
+    }
+
+    mNumOfQueued--;
+
+    if (src_index != NULL)
+        *src_index = index;
 
     return true;
+#endif
 }
 
 bool SecFimc::m_streamOn()
@@ -1521,6 +1682,42 @@ bool SecFimc::m_streamOn()
     return true;
 }
 
+bool SecFimc::m_streamOff(void)
+{
+#ifdef DEBUG_LIB_FIMC
+    ALOGD("%s", __func__);
+#endif
+
+    if (mFlagStreamOn == false)
+        return true;
+
+#ifndef BOARD_USE_V4L2
+    // let the frames in flight finish, their dst may still be on screen
+    while (0 < mNumOfQueued) {
+        if (dequeue() == false)
+            break;
+    }
+    mNumOfQueued = 0;
+    mQueueHead   = 0;
+#endif
+
+    if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_SRC) < 0) {
+        ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
+        return false;
+    }
+
+#ifdef BOARD_USE_V4L2
+    if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_DST) < 0) {
+        ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
+        return false;
+    }
+#endif
+
+    mFlagStreamOn = false;
+
+    return true;
+}
+
 bool SecFimc::m_checkSrcSize(unsigned int width, unsigned int height,
                              unsigned int cropX, unsigned int cropY,
                              unsigned int *cropWidth, unsigned int *cropHeight,
@@ -1621,122 +1818,20 @@ bool SecFimc::m_checkDstSize(unsigned int width, unsigned int height,
 
 int SecFimc::m_widthOfFimc(int v4l2ColorFormat, int width)
 {
-    int newWidth = width;
-
-    if (0x50 == mHwVersion) {
-        switch (v4l2ColorFormat) {
-        /* 422 1/2/3 plane */
-        case V4L2_PIX_FMT_YUYV:
-        case V4L2_PIX_FMT_UYVY:
-        case V4L2_PIX_FMT_NV61:
-        case V4L2_PIX_FMT_NV16:
-        case V4L2_PIX_FMT_YUV422P:
-        /* 420 2/3 plane */
-        case V4L2_PIX_FMT_NV21:
-        case V4L2_PIX_FMT_NV12:
-        case V4L2_PIX_FMT_NV12T:
-#ifdef BOARD_USE_V4L2
-        case V4L2_PIX_FMT_NV12MT:
-        case V4L2_PIX_FMT_YUV420M:
-#endif
-        case V4L2_PIX_FMT_YUV420:
-
-            newWidth = multipleOfN(width, 2);
-            break;
-        default :
-            break;
-        }
-    } else {
-        switch (v4l2ColorFormat) {
-        case V4L2_PIX_FMT_RGB565:
-            newWidth = multipleOfN(width, 8);
-            break;
-        case V4L2_PIX_FMT_RGB32:
-            newWidth = multipleOfN(width, 4);
-            break;
-        case V4L2_PIX_FMT_YUYV:
-        case V4L2_PIX_FMT_UYVY:
-            newWidth = multipleOfN(width, 4);
-            break;
-        case V4L2_PIX_FMT_NV61:
-        case V4L2_PIX_FMT_NV16:
-            newWidth = multipleOfN(width, 8);
-            break;
-        case V4L2_PIX_FMT_YUV422P:
-            newWidth = multipleOfN(width, 16);
-            break;
-        case V4L2_PIX_FMT_NV21:
-        case V4L2_PIX_FMT_NV12:
-        case V4L2_PIX_FMT_NV12T:
-#ifdef BOARD_USE_V4L2
-        case V4L2_PIX_FMT_NV12MT:
-#endif
-            newWidth = multipleOfN(width, 8);
-            break;
-#ifdef BOARD_USE_V4L2
-        case V4L2_PIX_FMT_YUV420M:
-#endif
-        case V4L2_PIX_FMT_YUV420:
-            newWidth = multipleOfN(width, 16);
-            break;
-        default :
-            break;
-        }
-    }
-    return newWidth;
+    return sec_fimc_align_width(v4l2ColorFormat, 0x50 == mHwVersion, width);
 }
 
 int SecFimc::m_heightOfFimc(int v4l2ColorFormat, int height)
 {
-    int newHeight = height;
-
-    switch (v4l2ColorFormat) {
-    case V4L2_PIX_FMT_NV21:
-    case V4L2_PIX_FMT_NV12:
-    case V4L2_PIX_FMT_NV12T:
-#ifdef BOARD_USE_V4L2
-    case V4L2_PIX_FMT_NV12MT:
-    case V4L2_PIX_FMT_YUV420M:
-#endif
-    case V4L2_PIX_FMT_YUV420:
-        newHeight = multipleOfN(height, 2);
-        break;
-    default :
-        break;
-    }
-    return newHeight;
+    return sec_fimc_align_height(v4l2ColorFormat, height);
 }
 
 int SecFimc::m_getYuvBpp(unsigned int fmt)
 {
-    int i, sel = -1;
-
-    for (i = 0; i < (int)(sizeof(yuv_list) / sizeof(struct yuv_fmt_list)); i++) {
-        if (yuv_list[i].fmt == fmt) {
-            sel = i;
-            break;
-        }
-    }
-
-    if (sel == -1)
-        return sel;
-    else
-        return yuv_list[sel].bpp;
+    return sec_fimc_yuv_bpp(fmt);
 }
 
 int SecFimc::m_getYuvPlanes(unsigned int fmt)
 {
-    int i, sel = -1;
-
-    for (i = 0; i < (int)(sizeof(yuv_list) / sizeof(struct yuv_fmt_list)); i++) {
-        if (yuv_list[i].fmt == fmt) {
-            sel = i;
-            break;
-        }
-    }
-
-    if (sel == -1)
-        return sel;
-    else
-        return yuv_list[sel].planes;
+    return sec_fimc_yuv_planes(fmt);
 }
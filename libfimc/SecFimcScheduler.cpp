@@ -0,0 +1,720 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*!
+ * \file      SecFimcScheduler.cpp
+ * \brief     source file for the FIMC job scheduler
+ */
+
+#define LOG_TAG "libfimc"
+#include <cutils/log.h>
+#include <sys/resource.h>
+
+#include "SecFimcScheduler.h"
+
+using namespace android;
+
+//#define DEBUG_LIB_FIMC_SCHED
+
+Mutex              SecFimcScheduler::mInstanceLock;
+SecFimcScheduler * SecFimcScheduler::mInstance = NULL;
+
+class SecFimcScheduler::NodeThread : public Thread
+{
+private:
+    SecFimcScheduler *mScheduler;
+    int               mNode;
+
+public:
+    NodeThread(SecFimcScheduler *scheduler, int node)
+        : Thread(false),
+          mScheduler(scheduler),
+          mNode(node)
+    { }
+
+    virtual bool threadLoop()
+    {
+        return mScheduler->m_threadLoop(mNode);
+    }
+};
+
+SecFimcScheduler::SecFimcScheduler()
+:   mFlagCreate(false),
+    mFlagExit(false),
+    mDevMask(0),
+    mNextJobId(1),
+    mNextSeq(0),
+    mResetTime(0)
+{
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        mNode[i].enable          = false;
+        mNode[i].opening         = false;
+        mNode[i].openFailTime    = 0;
+        mNode[i].runningCost     = 0;
+        mNode[i].numOfDone       = 0;
+        mNode[i].numOfFail       = 0;
+        mNode[i].busyTime        = 0;
+        mNode[i].busyTimeAtReset = 0;
+        mNode[i].runStart        = 0;
+        mNode[i].threadPriority  = android::PRIORITY_NORMAL;
+    }
+
+    memset(mJob, 0, sizeof(mJob));
+}
+
+SecFimcScheduler::~SecFimcScheduler()
+{
+    if (mFlagCreate == true) {
+        if (destroy() == false)
+            ALOGE("%s::destroy failed", __func__);
+    }
+}
+
+SecFimcScheduler *SecFimcScheduler::getInstance(void)
+{
+    Mutex::Autolock lock(mInstanceLock);
+
+    if (mInstance == NULL)
+        mInstance = new SecFimcScheduler;
+
+    if (   mInstance->flagCreate() == false
+        && mInstance->create(SEC_FIMC_SCHED_DEV_MASK_DEFAULT) == false) {
+        ALOGE("%s::create() fail", __func__);
+        return NULL;
+    }
+
+    return mInstance;
+}
+
+bool SecFimcScheduler::create(unsigned int devMask)
+{
+    if (mFlagCreate == true) {
+        ALOGE("%s::Already Created fail", __func__);
+        return false;
+    }
+
+    if ((devMask & SEC_FIMC_SCHED_DEV_MASK_ALL) == 0) {
+        ALOGE("%s::invalid devMask(0x%x)", __func__, devMask);
+        return false;
+    }
+
+    mFlagExit = false;
+    mDevMask  = devMask & SEC_FIMC_SCHED_DEV_MASK_ALL;
+
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        mNode[i].enable       = false;
+        mNode[i].opening      = false;
+        mNode[i].openFailTime = 0;
+    }
+
+    mResetTime  = systemTime();
+    mFlagCreate = true;
+
+    return true;
+}
+
+bool SecFimcScheduler::destroy(void)
+{
+    if (mFlagCreate == false) {
+        ALOGE("%s::Already Destroyed fail", __func__);
+        return false;
+    }
+
+    {
+        Mutex::Autolock lock(mLock);
+        mFlagExit = true;
+
+        for (int i = 0; i < SecFimc::DEV_MAX; i++)
+            mNode[i].workCond.broadcast();
+
+        // nothing will run the queued jobs any more
+        for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+            if (mJob[i].state == JOB_QUEUED)
+                mJob[i].state = JOB_FAILED;
+        }
+        mDoneCond.broadcast();
+
+        // a node being opened gives up once it sees mFlagExit
+        for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+            while (mNode[i].opening == true)
+                mOpenCond.wait(mLock);
+        }
+    }
+
+    // threads of nodes closed on idle have exited already, this only joins them
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        if (mNode[i].thread == NULL)
+            continue;
+
+        mNode[i].thread->requestExitAndWait();
+        mNode[i].thread.clear();
+    }
+
+    {
+        Mutex::Autolock lock(mLock);
+
+        for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+            if (mNode[i].enable == true)
+                m_closeNode(i);
+        }
+    }
+
+    mFlagCreate = false;
+
+    return true;
+}
+
+bool SecFimcScheduler::flagCreate(void)
+{
+    return mFlagCreate;
+}
+
+int SecFimcScheduler::submit(const Job *job)
+{
+    JobSlot *slot = NULL;
+    int node;
+
+    if (mFlagCreate == false) {
+        ALOGE("%s::Not yet created", __func__);
+        return -1;
+    }
+
+    if (job->priority < PRIORITY_DISPLAY || PRIORITY_MAX <= job->priority) {
+        ALOGE("%s::invalid priority(%d)", __func__, job->priority);
+        return -1;
+    }
+
+    Mutex::Autolock lock(mLock);
+
+    if (mFlagExit == true) {
+        ALOGE("%s::being destroyed", __func__);
+        return -1;
+    }
+
+    for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+        if (mJob[i].state == JOB_FREE) {
+            slot = &mJob[i];
+            break;
+        }
+    }
+
+    if (slot == NULL) {
+        ALOGE("%s::too many jobs in flight (%d)", __func__, SEC_FIMC_SCHED_MAX_JOB);
+        return -1;
+    }
+
+    slot->job       = *job;
+    slot->id        = mNextJobId;
+    slot->triedMask = 0;
+    slot->seq       = mNextSeq++;
+    slot->detached  = false;
+    slot->cost      = ((job->srcRect.w * job->srcRect.h) + (job->dstRect.w * job->dstRect.h)) >> 10;
+    if (slot->cost == 0)
+        slot->cost = 1;
+
+    mNextJobId = (mNextJobId == 0x7fffffff) ? 1 : mNextJobId + 1;
+
+    // reserved, no node takes it while m_selectNode() opens one
+    slot->node  = -1;
+    slot->state = JOB_QUEUED;
+
+    node = m_selectNode(slot);
+    if (node < 0 || mFlagExit == true) {
+        ALOGE("%s::no FIMC node for the job", __func__);
+        slot->state = JOB_FREE;
+        return -1;
+    }
+
+    slot->node  = node;
+    slot->state = JOB_QUEUED;
+    mNode[node].workCond.signal();
+
+#ifdef DEBUG_LIB_FIMC_SCHED
+    ALOGD("%s::job %d (priority %d, cost %d) -> FIMC%d",
+            __func__, slot->id, job->priority, slot->cost, node);
+#endif
+
+    return slot->id;
+}
+
+bool SecFimcScheduler::wait(int jobId, int timeoutMs)
+{
+    JobSlot *slot = NULL;
+    nsecs_t  timeout = (nsecs_t)timeoutMs * 1000000LL;
+    nsecs_t  start   = systemTime();
+    bool     ret;
+
+    Mutex::Autolock lock(mLock);
+
+    slot = m_findJob(jobId);
+    if (slot == NULL) {
+        ALOGE("%s::invalid job id(%d)", __func__, jobId);
+        return false;
+    }
+
+    while (slot->state == JOB_QUEUED || slot->state == JOB_RUNNING) {
+        if (timeoutMs < 0) {
+            mDoneCond.wait(mLock);
+        } else {
+            nsecs_t remain = timeout - (systemTime() - start);
+            if (remain <= 0) {
+                ALOGE("%s::job %d timeout(%d ms)", __func__, jobId, timeoutMs);
+                return false;
+            }
+            mDoneCond.waitRelative(mLock, remain);
+        }
+
+        // cancelled by another thread meanwhile, the slot may be reused
+        if (slot->id != jobId || slot->detached == true) {
+            ALOGE("%s::job %d is cancelled", __func__, jobId);
+            return false;
+        }
+    }
+
+    ret = (slot->state == JOB_DONE);
+    slot->state = JOB_FREE;
+
+    return ret;
+}
+
+bool SecFimcScheduler::cancel(int jobId)
+{
+    Mutex::Autolock lock(mLock);
+
+    JobSlot *slot = m_findJob(jobId);
+    if (slot == NULL) {
+        ALOGE("%s::invalid job id(%d)", __func__, jobId);
+        return false;
+    }
+
+    // the node is writing the dst already, its thread frees the slot when done
+    if (slot->state == JOB_RUNNING)
+        slot->detached = true;
+    else
+        slot->state = JOB_FREE;
+
+    return true;
+}
+
+bool SecFimcScheduler::run(const Job *job)
+{
+    int jobId = submit(job);
+
+    if (jobId < 0)
+        return false;
+
+    return wait(jobId);
+}
+
+int SecFimcScheduler::getNumOfNode(void)
+{
+    Mutex::Autolock lock(mLock);
+    nsecs_t now = systemTime();
+    int numOfNode = 0;
+
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        if (!(mDevMask & (1 << i)))
+            continue;
+
+        if (   mNode[i].enable == true
+            || mNode[i].openFailTime == 0
+            || ms2ns(SEC_FIMC_SCHED_IDLE_TIME) <= now - mNode[i].openFailTime)
+            numOfNode++;
+    }
+
+    return numOfNode;
+}
+
+bool SecFimcScheduler::getNodeStats(int node, NodeStats *stats)
+{
+    if (node < 0 || SecFimc::DEV_MAX <= node) {
+        ALOGE("%s::invalid node(%d)", __func__, node);
+        return false;
+    }
+
+    Mutex::Autolock lock(mLock);
+
+    Node   *n       = &mNode[node];
+    nsecs_t now     = systemTime();
+    nsecs_t busy    = n->busyTime;
+    nsecs_t elapsed = now - mResetTime;
+
+    // count the job which is running now as well
+    if (n->runStart != 0)
+        busy += now - n->runStart;
+
+    stats->dev         = node;
+    stats->enable      = n->enable;
+    stats->numOfDone   = n->numOfDone;
+    stats->numOfFail   = n->numOfFail;
+    stats->numOfQueued = 0;
+    stats->busyTime    = busy;
+    stats->utilization = 0;
+
+    for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+        if (mJob[i].state == JOB_QUEUED && mJob[i].node == node)
+            stats->numOfQueued++;
+    }
+
+    if (0 < elapsed)
+        stats->utilization = (int)(((busy - n->busyTimeAtReset) * 1000) / elapsed);
+
+    return true;
+}
+
+void SecFimcScheduler::resetStats(void)
+{
+    Mutex::Autolock lock(mLock);
+    nsecs_t now = systemTime();
+
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        mNode[i].busyTimeAtReset = mNode[i].busyTime;
+        if (mNode[i].runStart != 0)
+            mNode[i].busyTimeAtReset += now - mNode[i].runStart;
+    }
+
+    mResetTime = now;
+}
+
+void SecFimcScheduler::dump(String8& result)
+{
+    NodeStats stats;
+
+    result.append("FIMC scheduler\n");
+    result.append("  node enable  done  fail queued  busy(ms) util(%)\n");
+
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        if (getNodeStats(i, &stats) == false)
+            continue;
+
+        result.appendFormat("  %4d %6d %5u %5u %6d %9lld %3d.%d\n",
+                stats.dev, stats.enable, stats.numOfDone, stats.numOfFail,
+                stats.numOfQueued, ns2ms(stats.busyTime),
+                stats.utilization / 10, stats.utilization % 10);
+    }
+}
+
+SecFimcScheduler::JobSlot *SecFimcScheduler::m_findJob(int jobId)
+{
+    for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+        if (mJob[i].state != JOB_FREE && mJob[i].detached == false && mJob[i].id == jobId)
+            return &mJob[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * The node which finishes the job first : the job waits for the one running
+ * on the node and for the queued jobs of the same or a higher priority. For
+ * the same load a node which is open already is taken, a closed one is only
+ * opened when every open node is busy. mLock is dropped while a node opens.
+ */
+int SecFimcScheduler::m_selectNode(JobSlot *slot)
+{
+    nsecs_t now = systemTime();
+
+    while (true) {
+        unsigned long long minKey = ~0ULL;
+        int node = -1;
+
+        for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+            Node *n = &mNode[i];
+
+            if (!(mDevMask & (1 << i)) || (slot->triedMask & (1 << i)))
+                continue;
+
+            if (   n->enable == false
+                && n->openFailTime != 0
+                && now - n->openFailTime < ms2ns(SEC_FIMC_SCHED_IDLE_TIME))
+                continue;
+
+            unsigned long long key = ((unsigned long long)m_loadOfNode(i, slot->job.priority) << 1)
+                                   | (n->enable == true ? 0 : 1);
+            if (key < minKey) {
+                minKey = key;
+                node   = i;
+            }
+        }
+
+        if (node < 0 || mNode[node].enable == true)
+            return node;
+
+        // another job opens it, take the loads again once it is done
+        if (mNode[node].opening == true) {
+            mOpenCond.wait(mLock);
+            now = systemTime();
+            continue;
+        }
+
+        if (m_openNode(node) == true)
+            return node;
+
+        mNode[node].openFailTime = now;
+    }
+}
+
+/*
+ * Called and returns with mLock held. Joining the old thread and opening the
+ * device take milliseconds, so they run unlocked : jobs of the open nodes
+ * keep being submitted and finished meanwhile. n->opening keeps a second
+ * open and destroy() off the node.
+ */
+bool SecFimcScheduler::m_openNode(int node)
+{
+    Node *n = &mNode[node];
+    bool  ret;
+
+    if (mFlagExit == true)
+        return false;
+
+    n->opening = true;
+    mLock.unlock();
+
+    // the thread of the last open has left its loop when the node was closed
+    if (n->thread != NULL) {
+        n->thread->requestExitAndWait();
+        n->thread.clear();
+    }
+
+    // a node which is kept by another user just fails to open
+    ret = n->fimc.create((enum SecFimc::DEV)node, SecFimc::MODE_MULTI_BUF, 1);
+
+    mLock.lock();
+    n->opening = false;
+    mOpenCond.broadcast();
+
+    if (ret == false) {
+        ALOGW("%s::FIMC%d is not available", __func__, node);
+        return false;
+    }
+
+    if (mFlagExit == true) {
+        n->fimc.destroy();
+        return false;
+    }
+
+    n->threadPriority = android::PRIORITY_NORMAL;
+    n->thread = new NodeThread(this, node);
+    if (n->thread->run("SecFimcScheduler", android::PRIORITY_NORMAL) != NO_ERROR) {
+        ALOGE("%s::FIMC%d thread run fail", __func__, node);
+        n->thread.clear();
+        n->fimc.destroy();
+        return false;
+    }
+
+    n->enable       = true;
+    n->openFailTime = 0;
+
+#ifdef DEBUG_LIB_FIMC_SCHED
+    ALOGD("%s::FIMC%d opened", __func__, node);
+#endif
+
+    return true;
+}
+
+void SecFimcScheduler::m_closeNode(int node)
+{
+    if (mNode[node].fimc.destroy() == false)
+        ALOGE("%s::FIMC%d destroy fail", __func__, node);
+
+    mNode[node].enable = false;
+
+#ifdef DEBUG_LIB_FIMC_SCHED
+    ALOGD("%s::FIMC%d closed", __func__, node);
+#endif
+}
+
+void SecFimcScheduler::m_setThreadPriority(Node *n, int priority)
+{
+    static const int threadPriority[PRIORITY_MAX] = {
+        android::PRIORITY_DISPLAY,      // PRIORITY_DISPLAY
+        android::PRIORITY_FOREGROUND,   // PRIORITY_ENCODER
+        android::PRIORITY_BACKGROUND,   // PRIORITY_BACKGROUND
+    };
+
+    if (n->threadPriority == threadPriority[priority])
+        return;
+
+    // 0 : the calling thread, which is the node thread
+    if (setpriority(PRIO_PROCESS, 0, threadPriority[priority]) < 0)
+        ALOGW("%s::setpriority(%d) fail", __func__, threadPriority[priority]);
+
+    n->threadPriority = threadPriority[priority];
+}
+
+unsigned int SecFimcScheduler::m_loadOfNode(int node, int priority)
+{
+    unsigned int load = mNode[node].runningCost;
+
+    for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+        if (   mJob[i].state == JOB_QUEUED
+            && mJob[i].node == node
+            && mJob[i].job.priority <= priority)
+            load += mJob[i].cost;
+    }
+
+    return load;
+}
+
+SecFimcScheduler::JobSlot *SecFimcScheduler::m_takeJob(int node)
+{
+    JobSlot *slot = NULL;
+
+    for (int i = 0; i < SEC_FIMC_SCHED_MAX_JOB; i++) {
+        JobSlot *cur = &mJob[i];
+
+        if (cur->state != JOB_QUEUED || cur->node != node)
+            continue;
+
+        if (   slot == NULL
+            || cur->job.priority < slot->job.priority
+            || (cur->job.priority == slot->job.priority && (int)(cur->seq - slot->seq) < 0))
+            slot = cur;
+    }
+
+    return slot;
+}
+
+bool SecFimcScheduler::m_runJob(int node, Job *job)
+{
+    SecFimc *fimc = &mNode[node].fimc;
+    unsigned int srcW = job->srcRect.w;
+    unsigned int srcH = job->srcRect.h;
+    unsigned int dstW = job->dstRect.w;
+    unsigned int dstH = job->dstRect.h;
+
+    if (fimc->setSrcParams(job->srcRect.fullW, job->srcRect.fullH,
+                           job->srcRect.x, job->srcRect.y,
+                           &srcW, &srcH,
+                           job->srcRect.colorFormat) == false) {
+        ALOGE("%s::FIMC%d setSrcParams() fail", __func__, node);
+        return false;
+    }
+
+    if (fimc->setSrcAddr(job->srcBuf.phys.extP[0],
+                         job->srcBuf.phys.extP[1],
+                         job->srcBuf.phys.extP[2],
+                         job->srcRect.colorFormat) == false) {
+        ALOGE("%s::FIMC%d setSrcAddr() fail", __func__, node);
+        return false;
+    }
+
+    if (fimc->setRotVal(job->rotVal) == false) {
+        ALOGE("%s::FIMC%d setRotVal(%d) fail", __func__, node, job->rotVal);
+        return false;
+    }
+
+    if (fimc->setDstParams(job->dstRect.fullW, job->dstRect.fullH,
+                           job->dstRect.x, job->dstRect.y,
+                           &dstW, &dstH,
+                           job->dstRect.colorFormat) == false) {
+        ALOGE("%s::FIMC%d setDstParams() fail", __func__, node);
+        return false;
+    }
+
+    if (fimc->setDstAddr(job->dstBuf.phys.extP[0],
+                         job->dstBuf.phys.extP[1],
+                         job->dstBuf.phys.extP[2]) == false) {
+        ALOGE("%s::FIMC%d setDstAddr() fail", __func__, node);
+        return false;
+    }
+
+    if (fimc->draw(0, 0) == false) {
+        ALOGE("%s::FIMC%d draw() fail", __func__, node);
+        return false;
+    }
+
+    return true;
+}
+
+bool SecFimcScheduler::m_threadLoop(int node)
+{
+    Node    *n = &mNode[node];
+    JobSlot *slot;
+    Job      job;
+    bool     ret;
+
+    {
+        Mutex::Autolock lock(mLock);
+        nsecs_t idleStart = systemTime();
+
+        while ((slot = m_takeJob(node)) == NULL) {
+            if (mFlagExit == true)
+                return false;
+
+            nsecs_t idle = systemTime() - idleStart;
+            if (ms2ns(SEC_FIMC_SCHED_IDLE_TIME) <= idle) {
+                // nothing to do for a while, give the node back
+                m_closeNode(node);
+                return false;
+            }
+            n->workCond.waitRelative(mLock, ms2ns(SEC_FIMC_SCHED_IDLE_TIME) - idle);
+        }
+
+        if (mFlagExit == true)
+            return false;
+
+        slot->state    = JOB_RUNNING;
+        n->runningCost = slot->cost;
+        n->runStart    = systemTime();
+        job            = slot->job;
+    }
+
+    m_setThreadPriority(n, job.priority);
+
+    ret = m_runJob(node, &job);
+
+    Mutex::Autolock lock(mLock);
+
+    n->busyTime   += systemTime() - n->runStart;
+    n->runStart    = 0;
+    n->runningCost = 0;
+
+    if (ret == true) {
+        n->numOfDone++;
+        slot->state = JOB_DONE;
+    } else {
+        n->numOfFail++;
+        slot->triedMask |= (1 << node);
+
+        // the node may not support the format or size, try the others
+        int next = (mFlagExit == true || slot->detached == true) ? -1 : m_selectNode(slot);
+
+        // cancelled or being destroyed while m_selectNode() opened a node
+        if (mFlagExit == true || slot->detached == true)
+            next = -1;
+
+        if (0 <= next) {
+            slot->node  = next;
+            slot->state = JOB_QUEUED;
+            mNode[next].workCond.signal();
+            return true;
+        }
+
+        slot->state = JOB_FAILED;
+    }
+
+    // nobody waits for a cancelled job
+    if (slot->detached == true) {
+        slot->state    = JOB_FREE;
+        slot->detached = false;
+    }
+
+    mDoneCond.broadcast();
+
+    return true;
+}
@@ -9,7 +9,8 @@ LOCAL_MODULE_TAGS := optional
 
 LOCAL_SRC_FILES:= \
 	FimgApi.cpp   \
-	FimgExynos4.cpp
+	FimgExynos4.cpp \
+	FimgSw.cpp
 
 LOCAL_SHARED_LIBRARIES:= liblog libutils libbinder
 
@@ -19,4 +20,6 @@ LOCAL_PRELINK_MODULE := false
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(LOCAL_PATH)/test/Android.mk
+
 endif
@@ -20,8 +20,10 @@
 #define LOG_NDEBUG 0
 #define LOG_TAG "SKIA"
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 #include "FimgApi.h"
+#include "FimgSw.h"
 
 struct blit_op_table optbl[] = {
     { (int)BLIT_OP_SOLID_FILL, "FILL" },
@@ -69,9 +71,38 @@ struct blit_op_table optbl[] = {
     {}
 #endif
 
+FimgFence::FimgFence()
+{
+    m_fimgApi = NULL;
+    m_seqNo   = 0;
+}
+
+bool FimgFence::Wait(int timeoutMs)
+{
+    if (m_fimgApi == NULL)
+        return true;
+
+    return m_fimgApi->WaitSeqNo(m_seqNo, timeoutMs);
+}
+
+bool FimgFence::IsSignaled(void)
+{
+    return Wait(0);
+}
+
+int FimgFence::GetFd(void)
+{
+    if (m_fimgApi == NULL)
+        return -1;
+
+    return m_fimgApi->GetFd();
+}
+
 FimgApi::FimgApi()
 {
-    m_flagCreate = false;
+    m_flagCreate  = false;
+    m_submitSeqNo = 0;
+    m_doneSeqNo   = 0;
 }
 
 FimgApi::~FimgApi()
@@ -167,9 +198,117 @@ STRETCH_DONE :
     return ret;
 }
 
+bool FimgApi::StretchBatch(struct fimg2d_blit **cmd, int numOfCmd)
+{
+    bool ret = false;
+
+    if (t_Lock() == false) {
+        PRINT("%s::t_Lock() fail\n", __func__);
+        goto STRETCH_BATCH_DONE;
+    }
+
+    if (m_flagCreate == false) {
+        PRINT("%s::This is not Created fail\n", __func__);
+        goto STRETCH_BATCH_DONE;
+    }
+
+    if (t_StretchBatch(cmd, numOfCmd) == false) {
+        goto STRETCH_BATCH_DONE;
+    }
+
+    ret = true;
+
+STRETCH_BATCH_DONE :
+
+    t_UnLock();
+
+    return ret;
+}
+
+bool FimgApi::StretchAsync(struct fimg2d_blit *cmd, FimgFence *fence)
+{
+    bool ret = false;
+    unsigned int seqNo;
+
+    if (t_Lock() == false) {
+        PRINT("%s::t_Lock() fail\n", __func__);
+        goto STRETCH_ASYNC_DONE;
+    }
+
+    if (m_flagCreate == false) {
+        PRINT("%s::This is not Created fail\n", __func__);
+        goto STRETCH_ASYNC_DONE;
+    }
+
+    seqNo = m_submitSeqNo + 1;
+    cmd->seq_no = seqNo;
+
+    if (t_StretchAsync(cmd) == false) {
+        goto STRETCH_ASYNC_DONE;
+    }
+
+    m_submitSeqNo = seqNo;
+
+    if (fence != NULL) {
+        fence->m_fimgApi = this;
+        fence->m_seqNo   = seqNo;
+    }
+
+    ret = true;
+
+STRETCH_ASYNC_DONE :
+
+    t_UnLock();
+
+    return ret;
+}
+
+bool FimgApi::WaitSeqNo(unsigned int seqNo, int timeoutMs)
+{
+    unsigned int target;
+    bool ret = true;
+
+    // sequence numbers wrap, compare the distance
+    if ((int)(seqNo - m_doneSeqNo) <= 0)
+        return true;
+
+    // a fence may be waited from any thread, the lock keeps the pool from
+    // closing this context under the poll
+    t_Lock();
+
+    // everything queued before the wait is done once the G2D is idle
+    target = m_submitSeqNo;
+
+    if ((int)(seqNo - m_doneSeqNo) <= 0)
+        goto WAIT_DONE;
+
+    if (t_Wait(timeoutMs) == false) {
+        ret = false;
+        goto WAIT_DONE;
+    }
+
+    if (0 < (int)(target - m_doneSeqNo))
+        m_doneSeqNo = target;
+
+WAIT_DONE :
+
+    t_UnLock();
+
+    return ret;
+}
+
+int FimgApi::GetFd(void)
+{
+    if (m_flagCreate == false)
+        return -1;
+
+    return t_GetFd();
+}
+
 bool FimgApi::Sync(void)
 {
     bool ret = false;
+    unsigned int target = m_submitSeqNo;
 
     if (m_flagCreate == false) {
         PRINT("%s::This is not Created fail\n", __func__);
@@ -179,6 +318,11 @@ bool FimgApi::Sync(void)
     if (t_Sync() == false)
         goto SYNC_DONE;
 
+    t_Lock();
+    if (0 < (int)(target - m_doneSeqNo))
+        m_doneSeqNo = target;
+    t_UnLock();
+
     ret = true;
 
 SYNC_DONE :
@@ -204,6 +348,35 @@ bool FimgApi::t_Stretch(struct fimg2d_blit *cmd)
     return false;
 }
 
+bool FimgApi::t_StretchBatch(struct fimg2d_blit **cmd, int numOfCmd)
+{
+    // backends without a queue just run the blits one by one
+    for (int i = 0; i < numOfCmd; i++) {
+        if (t_Stretch(cmd[i]) == false) {
+            PRINT("%s::t_Stretch(%d) fail\n", __func__, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FimgApi::t_StretchAsync(struct fimg2d_blit *cmd)
+{
+    // backends without a queue finish the blit before returning
+    return t_Stretch(cmd);
+}
+
+bool FimgApi::t_Wait(int timeoutMs)
+{
+    return true;
+}
+
+int FimgApi::t_GetFd(void)
+{
+    return -1;
+}
+
 bool FimgApi::t_Sync(void)
 {
     PRINT("%s::This is empty virtual function fail\n", __func__);
@@ -222,15 +395,209 @@ bool FimgApi::t_UnLock(void)
     return false;
 }
 
+//---------------------------------------------------------------------------//
+// FimgBatch
+//---------------------------------------------------------------------------//
+FimgBatch::FimgBatch()
+{
+    m_fimgApi    = NULL;
+    m_numOfBlit  = 0;
+    m_flagSubmit = false;
+
+    for (int i = 0; i < FIMG_BATCH_MAX_BLIT; i++)
+        m_ptrBlit[i] = &m_blit[i];
+}
+
+FimgBatch::~FimgBatch()
+{
+    if (m_flagSubmit == true && Fence() == false)
+        PRINT("%s::Fence() fail\n", __func__);
+
+    if (m_fimgApi != NULL)
+        destroyFimgApi(m_fimgApi);
+}
+
+bool FimgBatch::Begin(void)
+{
+    if (m_flagSubmit == true && Fence() == false) {
+        PRINT("%s::Fence() fail\n", __func__);
+        return false;
+    }
+
+    if (m_fimgApi == NULL) {
+        m_fimgApi = createFimgApi();
+        if (m_fimgApi == NULL) {
+            PRINT("%s::createFimgApi() fail\n", __func__);
+            return false;
+        }
+    }
+
+    m_numOfBlit = 0;
+
+    return true;
+}
+
+bool FimgBatch::Append(struct fimg2d_blit *cmd)
+{
+    if (m_fimgApi == NULL || m_flagSubmit == true) {
+        PRINT("%s::Begin() is not called fail\n", __func__);
+        return false;
+    }
+
+    if (FIMG_BATCH_MAX_BLIT <= m_numOfBlit) {
+        PRINT("%s::too many blits(%d) fail\n", __func__, m_numOfBlit);
+        return false;
+    }
+
+    if (m_CheckBlit(cmd) == false) {
+        PRINT("%s::m_CheckBlit(%d) fail\n", __func__, m_numOfBlit);
+        return false;
+    }
+
+    // keep our own copy, the caller's images are usually on its stack
+    struct fimg2d_blit *blit = &m_blit[m_numOfBlit];
+
+    *blit = *cmd;
+    if (cmd->src != NULL) {
+        m_src[m_numOfBlit] = *cmd->src;
+        blit->src = &m_src[m_numOfBlit];
+    }
+    if (cmd->msk != NULL) {
+        m_msk[m_numOfBlit] = *cmd->msk;
+        blit->msk = &m_msk[m_numOfBlit];
+    }
+    if (cmd->tmp != NULL) {
+        m_tmp[m_numOfBlit] = *cmd->tmp;
+        blit->tmp = &m_tmp[m_numOfBlit];
+    }
+    m_dst[m_numOfBlit] = *cmd->dst;
+    blit->dst = &m_dst[m_numOfBlit];
+
+    m_numOfBlit++;
+
+    return true;
+}
+
+bool FimgBatch::Submit(void)
+{
+    if (m_fimgApi == NULL || m_flagSubmit == true) {
+        PRINT("%s::Begin() is not called fail\n", __func__);
+        return false;
+    }
+
+    if (m_numOfBlit == 0)
+        return true;
+
+    if (m_fimgApi->StretchBatch(m_ptrBlit, m_numOfBlit) == false) {
+        PRINT("%s::StretchBatch(%d) fail\n", __func__, m_numOfBlit);
+        return false;
+    }
+
+    m_flagSubmit = true;
+
+    return true;
+}
+
+bool FimgBatch::Fence(void)
+{
+    if (m_flagSubmit == false)
+        return true;
+
+    m_flagSubmit = false;
+    m_numOfBlit  = 0;
+
+    if (m_fimgApi->Sync() == false) {
+        PRINT("%s::Sync() fail\n", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+bool FimgBatch::m_CheckBlit(struct fimg2d_blit *cmd)
+{
+    if (cmd == NULL || cmd->dst == NULL)
+        return false;
+
+    if (cmd->op < BLIT_OP_SOLID_FILL || BLIT_OP_END <= cmd->op)
+        return false;
+
+    if (YFLIP < cmd->param.rotate)
+        return false;
+
+    if (cmd->op != BLIT_OP_SOLID_FILL && cmd->op != BLIT_OP_CLR && cmd->src == NULL)
+        return false;
+
+    if (cmd->param.scaling.mode != NO_SCALING
+        && (cmd->param.scaling.src_w <= 0 || cmd->param.scaling.src_h <= 0
+            || cmd->param.scaling.dst_w <= 0 || cmd->param.scaling.dst_h <= 0))
+        return false;
+
+    if (android::FimgSw::IsInstance(m_fimgApi) == true
+        && android::FimgSw::IsAccessible(cmd) == false)
+        return false;
+
+    if (m_CheckImage(cmd->src, false) == false
+        || m_CheckImage(cmd->msk, false) == false
+        || m_CheckImage(cmd->tmp, true) == false
+        || m_CheckImage(cmd->dst, true) == false)
+        return false;
+
+    return true;
+}
+
+bool FimgBatch::m_CheckImage(struct fimg2d_image *image, bool isDst)
+{
+    if (image == NULL)
+        return true;
+
+    if (image->addr.type == ADDR_NONE)
+        return false;
+
+    if (isDst == true && SRC_DST_FORMAT_END <= image->fmt)
+        return false;
+
+    if (image->width <= 0 || image->height <= 0 || image->stride <= 0)
+        return false;
+
+    if (image->rect.x2 <= image->rect.x1 || image->rect.y2 <= image->rect.y1
+        || image->rect.x1 < 0 || image->rect.y1 < 0
+        || image->width < image->rect.x2 || image->height < image->rect.y2)
+        return false;
+
+    return true;
+}
+
 //---------------------------------------------------------------------------//
 // extern function
 //---------------------------------------------------------------------------//
-extern "C" int stretchFimgApi(struct fimg2d_blit *cmd)
+// the CPU can not reach physical or kernel addresses, such blits need G2D
+static FimgApi *createFimgApiForBlit(struct fimg2d_blit *cmd)
 {
     FimgApi * fimgApi = createFimgApi();
 
+    if (fimgApi != NULL
+        && android::FimgSw::IsInstance(fimgApi) == true
+        && android::FimgSw::IsAccessible(cmd) == false) {
+        PRINT("%s::addr type is not accessible by FimgSw fail\n", __func__);
+        return NULL;
+    }
+
+    return fimgApi;
+}
+
+extern "C" int stretchFimgApi(struct fimg2d_blit *cmd)
+{
+#ifdef CHECK_FIMGAPI_SUBMIT_TIME
+#define FIMGAPI_SUBMIT_TIME_CNT (100)
+    static nsecs_t submitTime = 0;
+    static int     submitCnt  = 0;
+    nsecs_t        start      = systemTime();
+#endif
+    FimgApi * fimgApi = createFimgApiForBlit(cmd);
+
     if (fimgApi == NULL) {
-        PRINT("%s::createFimgApi() fail\n", __func__);
+        PRINT("%s::createFimgApiForBlit() fail\n", __func__);
         return -1;
     }
 
@@ -238,12 +605,33 @@ extern "C" int stretchFimgApi(struct fimg2d_blit *cmd)
         if (fimgApi != NULL)
             destroyFimgApi(fimgApi);
 
-        return -1;
+        // retry on the CPU, ex. the format is not supported by this G2D
+        if (getFimgApiBackend() != FIMGAPI_BACKEND_AUTO
+            || android::FimgSw::IsInstance(fimgApi) == true
+            || android::FimgSw::IsAccessible(cmd) == false)
+            return -1;
+
+        fimgApi = android::FimgSw::CreateInstance();
+        if (fimgApi == NULL || fimgApi->Stretch(cmd) == false) {
+            PRINT("%s::FimgSw Stretch() fail\n", __func__);
+            return -1;
+        }
     }
 
     if (fimgApi != NULL)
         destroyFimgApi(fimgApi);
 
+#ifdef CHECK_FIMGAPI_SUBMIT_TIME
+    // pool lookup + submit + release, the blit itself is included unless async
+    submitTime += systemTime() - start;
+    if (++submitCnt == FIMGAPI_SUBMIT_TIME_CNT) {
+        ALOGD("%s::average submit time = %lld us", __func__,
+              (long long)ns2us(submitTime / FIMGAPI_SUBMIT_TIME_CNT));
+        submitTime = 0;
+        submitCnt  = 0;
+    }
+#endif
+
     return 0;
 }
 
@@ -268,6 +656,65 @@ extern "C" int SyncFimgApi(void)
     return 0;
 }
 
+extern "C" int stretchFimgApiBatch(struct fimg2d_blit **cmd, int numOfCmd)
+{
+    FimgBatch batch;
+
+    if (batch.Begin() == false)
+        return -1;
+
+    for (int i = 0; i < numOfCmd; i++) {
+        if (batch.NumOfBlit() == FIMG_BATCH_MAX_BLIT
+            && (batch.Submit() == false || batch.Begin() == false))
+            return -1;
+
+        if (batch.Append(cmd[i]) == false)
+            return -1;
+    }
+
+    if (batch.Submit() == false || batch.Fence() == false)
+        return -1;
+
+    return 0;
+}
+
+extern "C" int stretchFimgApiAsync(struct fimg2d_blit *cmd, struct fimg_fence *fence)
+{
+    FimgApi * fimgApi = createFimgApiForBlit(cmd);
+    FimgFence fimgFence;
+
+    if (fimgApi == NULL) {
+        PRINT("%s::createFimgApiForBlit() fail\n", __func__);
+        return -1;
+    }
+
+    if (fimgApi->StretchAsync(cmd, &fimgFence) == false) {
+        destroyFimgApi(fimgApi);
+        return -1;
+    }
+
+    // pooled contexts are never freed, only closed, so the pointer stays valid
+    if (fence != NULL) {
+        fence->fimgApi = fimgApi;
+        fence->seqNo   = fimgFence.SeqNo();
+    }
+
+    destroyFimgApi(fimgApi);
+
+    return 0;
+}
+
+extern "C" int waitFimgApi(struct fimg_fence *fence, int timeoutMs)
+{
+    if (fence == NULL || fence->fimgApi == NULL)
+        return 0;
+
+    if (((FimgApi *)fence->fimgApi)->WaitSeqNo(fence->seqNo, timeoutMs) == false)
+        return -1;
+
+    return 0;
+}
+
 void printDataBlit(char *title, struct fimg2d_blit *cmd)
 {
     ALOGI("%s\n", title);
@@ -22,6 +22,9 @@
 #include <utils/Log.h>
 
 #include "FimgExynos4.h"
+#include "FimgSw.h"
+
+#define G2D_POLL_TIME (1000)
 
 namespace android
 {
@@ -30,6 +33,13 @@ unsigned   FimgV4x::m_curFimgV4xIndex = 0;
 int        FimgV4x::m_numOfInstance    = 0;
 FimgApi *  FimgV4x::m_ptrFimgApiList[NUMBER_FIMG_LIST] = {NULL, };
 
+pthread_key_t  FimgV4x::m_shardKey;
+pthread_once_t FimgV4x::m_shardOnce = PTHREAD_ONCE_INIT;
+
+int        FimgV4x::m_idleTimeMs   = FIMG_POOL_IDLE_TIME;
+int        FimgV4x::m_numOfKeep    = FIMG_POOL_NUM_OF_KEEP;
+nsecs_t    FimgV4x::m_lastTrimTime = 0;
+
 //---------------------------------------------------------------------------//
 
 FimgV4x::FimgV4x()
@@ -39,7 +49,9 @@ FimgV4x::FimgV4x()
            m_g2dSrcVirtAddr(NULL),
            m_g2dSrcSize(0),
            m_g2dDstVirtAddr(NULL),
-           m_g2dDstSize(0)
+           m_g2dDstSize(0),
+           m_ref(0),
+           m_lastUseTime(0)
 {
     memset(&(m_g2dPoll), 0, sizeof(struct pollfd));
     m_lock = new Mutex(Mutex::SHARED, "FimgV4x");
@@ -50,37 +62,57 @@ FimgV4x::~FimgV4x()
     delete m_lock;
 }
 
+/*
+ * The contexts are a process wide pool which is never freed, only their
+ * /dev/fimg2d fds are closed by TrimInstance(). Each thread sticks to the
+ * context it got first, so the common case takes no lock at all.
+ */
 FimgApi *FimgV4x::CreateInstance()
 {
-    Mutex::Autolock autolock(m_instanceLock);
+    unsigned int index;
+    FimgV4x *ptrFimg;
 
-    FimgApi *ptrFimg = NULL;
+    pthread_once(&m_shardOnce, m_InitShardKey);
 
-    for(unsigned int i = m_curFimgV4xIndex; i < NUMBER_FIMG_LIST; i++) {
-        if (m_ptrFimgApiList[i] == NULL)
-            m_ptrFimgApiList[i] = new FimgV4x;
+    index = (unsigned int)(uintptr_t)pthread_getspecific(m_shardKey);
+    if (index != 0) {
+        ptrFimg = (FimgV4x *)m_ptrFimgApiList[index - 1];
 
-        if (m_ptrFimgApiList[i]->FlagCreate() == false) {
-            if (m_ptrFimgApiList[i]->Create() == false) {
-                PRINT("%s::Create(%d) fail\n", __func__, i);
-                goto CreateInstance_End;
-            }
-            else
-                m_numOfInstance++;
+        if (ptrFimg != NULL && ptrFimg->m_TryGet() == true) {
+            if (ptrFimg->FlagCreate() == true)
+                return ptrFimg;
+
+            android_atomic_dec(&ptrFimg->m_ref);
         }
+    }
+
+    Mutex::Autolock autolock(m_instanceLock);
+
+    if (index == 0) {
+        index = m_curFimgV4xIndex + 1;
 
-        if (i < NUMBER_FIMG_LIST - 1)
-            m_curFimgV4xIndex = i + 1;
+        if (m_curFimgV4xIndex < NUMBER_FIMG_LIST - 1)
+            m_curFimgV4xIndex++;
         else
             m_curFimgV4xIndex = 0;
 
-        ptrFimg = m_ptrFimgApiList[i];
-        goto CreateInstance_End;
+        pthread_setspecific(m_shardKey, (void *)(uintptr_t)index);
     }
 
-CreateInstance_End :
+    return m_CreateInstanceLocked(index - 1);
+}
 
-    return ptrFimg;
+void FimgV4x::ReleaseInstance(FimgApi *ptrFimgApi)
+{
+    FimgV4x *ptrFimg = (FimgV4x *)ptrFimgApi;
+    nsecs_t now = systemTime();
+
+    ptrFimg->m_lastUseTime = now;
+    android_atomic_dec(&ptrFimg->m_ref);
+
+    // idle contexts are trimmed while releasing, no timer thread is needed
+    if (ms2ns(m_idleTimeMs) <= now - m_lastTrimTime)
+        TrimInstance(false);
 }
 
 void FimgV4x::DestroyInstance(FimgApi * ptrFimgApi)
@@ -89,37 +121,119 @@ void FimgV4x::DestroyInstance(FimgApi * ptrFimgApi)
 
     for(int i = 0; i < NUMBER_FIMG_LIST; i++) {
         if (m_ptrFimgApiList[i] != NULL && m_ptrFimgApiList[i] == ptrFimgApi) {
-            if (m_ptrFimgApiList[i]->FlagCreate() == true && m_ptrFimgApiList[i]->Destroy() == false) {
-                PRINT("%s::Destroy() fail\n", __func__);
-            } else {
-                FimgV4x * tempFimgV4x = (FimgV4x *)m_ptrFimgApiList[i];
-                delete tempFimgV4x;
-                m_ptrFimgApiList[i] = NULL;
+            FimgV4x * tempFimgV4x = (FimgV4x *)m_ptrFimgApiList[i];
 
-                m_numOfInstance--;
+            if (tempFimgV4x->FlagCreate() == false)
+                break;
+
+            if (android_atomic_cmpxchg(0, -1, &tempFimgV4x->m_ref) != 0) {
+                PRINT("%s::instance(%d) is in use fail\n", __func__, i);
+                break;
             }
 
+            if (tempFimgV4x->Destroy() == false)
+                PRINT("%s::Destroy() fail\n", __func__);
+            else
+                m_numOfInstance--;
+
+            android_atomic_release_store(0, &tempFimgV4x->m_ref);
             break;
         }
     }
 }
 
 void FimgV4x::DestroyAllInstance(void)
+{
+    TrimInstance(true);
+}
+
+void FimgV4x::TrimInstance(bool force)
+{
+    nsecs_t now;
+    int numOfKeep;
+
+    if (force == true)
+        m_instanceLock.lock();
+    else if (m_instanceLock.tryLock() != 0)
+        return;
+
+    now = systemTime();
+    numOfKeep = (force == true) ? 0 : m_numOfKeep;
+    m_lastTrimTime = now;
+
+    for (int i = NUMBER_FIMG_LIST - 1; 0 <= i && numOfKeep < m_numOfInstance; i--) {
+        FimgV4x * tempFimgV4x = (FimgV4x *)m_ptrFimgApiList[i];
+
+        if (tempFimgV4x == NULL || tempFimgV4x->FlagCreate() == false)
+            continue;
+
+        if (force == false && now - tempFimgV4x->m_lastUseTime < ms2ns(m_idleTimeMs))
+            continue;
+
+        // skip contexts somebody holds, they are not idle
+        if (android_atomic_cmpxchg(0, -1, &tempFimgV4x->m_ref) != 0)
+            continue;
+
+        if (tempFimgV4x->Destroy() == false)
+            PRINT("%s::Destroy(%d) fail\n", __func__, i);
+        else
+            m_numOfInstance--;
+
+        android_atomic_release_store(0, &tempFimgV4x->m_ref);
+    }
+
+    m_instanceLock.unlock();
+}
+
+void FimgV4x::SetPoolPolicy(int idleTimeMs, int numOfKeep)
 {
     Mutex::Autolock autolock(m_instanceLock);
 
-    for(int i = 0; i < NUMBER_FIMG_LIST; i++) {
-        if (m_ptrFimgApiList[i] != NULL) {
-            if (m_ptrFimgApiList[i]->FlagCreate() == true
-               && m_ptrFimgApiList[i]->Destroy() == false) {
-                    PRINT("%s::Destroy() fail\n", __func__);
-            } else {
-                FimgV4x * tempFimgV4x = (FimgV4x *)m_ptrFimgApiList[i];
-                delete tempFimgV4x;
-                m_ptrFimgApiList[i] = NULL;
-            }
+    m_idleTimeMs = idleTimeMs;
+    m_numOfKeep  = numOfKeep;
+}
+
+void FimgV4x::m_InitShardKey(void)
+{
+    if (pthread_key_create(&m_shardKey, NULL) != 0)
+        PRINT("%s::pthread_key_create() fail\n", __func__);
+}
+
+FimgApi *FimgV4x::m_CreateInstanceLocked(unsigned int index)
+{
+    FimgV4x *ptrFimg;
+
+    if (m_ptrFimgApiList[index] == NULL)
+        m_ptrFimgApiList[index] = new FimgV4x;
+
+    ptrFimg = (FimgV4x *)m_ptrFimgApiList[index];
+
+    // trimming holds m_instanceLock as well, so m_ref is not -1 here
+    android_atomic_inc(&ptrFimg->m_ref);
+
+    if (ptrFimg->FlagCreate() == false) {
+        if (ptrFimg->Create() == false) {
+            PRINT("%s::Create(%d) fail\n", __func__, index);
+            android_atomic_dec(&ptrFimg->m_ref);
+            return NULL;
         }
+        m_numOfInstance++;
     }
+
+    return ptrFimg;
+}
+
+inline bool FimgV4x::m_TryGet(void)
+{
+    int32_t ref;
+
+    do {
+        ref = m_ref;
+        if (ref < 0)
+            return false;
+    } while (android_atomic_cmpxchg(ref, ref + 1, &m_ref) != 0);
+
+    return true;
 }
 
 bool FimgV4x::t_Create(void)
@@ -165,7 +279,7 @@ bool FimgV4x::t_Stretch(struct fimg2d_blit *cmd)
     }
 
 #ifdef G2D_NONE_BLOCKING_MODE
-    if (m_PollG2D(&m_g2dPoll) == false)
+    if (m_PollG2D(&m_g2dPoll, G2D_POLL_TIME) == false)
     {
         PRINT("%s::m_PollG2D() fail\n", __func__);
         goto STRETCH_FAIL;
@@ -183,9 +297,55 @@ STRETCH_FAIL:
 
 }
 
+bool FimgV4x::t_StretchBatch(struct fimg2d_blit **cmd, int numOfCmd)
+{
+    // queue everything, the caller waits once with t_Sync()
+    for (int i = 0; i < numOfCmd; i++) {
+        cmd[i]->sync = BLIT_ASYNC;
+
+        if (m_DoG2D(cmd[i]) == false) {
+            PRINT("%s::m_DoG2D(%d) fail\n", __func__, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FimgV4x::t_StretchAsync(struct fimg2d_blit *cmd)
+{
+    cmd->sync = BLIT_ASYNC;
+
+    if (m_DoG2D(cmd) == false) {
+        PRINT("%s::m_DoG2D() fail\n", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+bool FimgV4x::t_Wait(int timeoutMs)
+{
+    struct pollfd g2dPoll = m_g2dPoll;
+
+    // a trimmed context has nothing queued any more
+    if (m_g2dFd <= 0)
+        return true;
+
+    return m_PollG2D(&g2dPoll, timeoutMs);
+}
+
+int FimgV4x::t_GetFd(void)
+{
+    if (m_g2dFd <= 0)
+        return -1;
+
+    return m_g2dFd;
+}
+
 bool FimgV4x::t_Sync(void)
 {
-    if (m_PollG2D(&m_g2dPoll) == false)
+    if (m_PollG2D(&m_g2dPoll, G2D_POLL_TIME) == false)
     {
         PRINT("%s::m_PollG2D() fail\n", __func__);
         goto SYNC_FAIL;
@@ -261,20 +421,19 @@ bool FimgV4x::m_DoG2D(struct fimg2d_blit *cmd)
     return true;
 }
 
-inline bool FimgV4x::m_PollG2D(struct pollfd * events)
+inline bool FimgV4x::m_PollG2D(struct pollfd * events, int timeoutMs)
 {
-#define G2D_POLL_TIME (1000)
-
     int ret;
 
-    ret = poll(events, 1, G2D_POLL_TIME);
+    ret = poll(events, 1, timeoutMs);
 
     if (ret < 0) {
         PRINT("%s::poll fail \n", __func__);
         return false;
     }
     else if (ret == 0) {
-        PRINT("%s::No data in %d milli secs..\n", __func__, G2D_POLL_TIME);
+        if (timeoutMs != 0)
+            PRINT("%s::No data in %d milli secs..\n", __func__, timeoutMs);
         return false;
     }
 
@@ -286,17 +445,36 @@ inline bool FimgV4x::m_PollG2D(struct pollfd * events)
 //---------------------------------------------------------------------------//
 extern "C" struct FimgApi * createFimgApi()
 {
-    if (fimgApiAutoFreeThread == 0)
-        fimgApiAutoFreeThread = new FimgApiAutoFreeThread();
-    else
-        fimgApiAutoFreeThread->SetOneMoreSleep();
+    int       backend = getFimgApiBackend();
+    FimgApi * fimgApi = NULL;
 
-    return FimgV4x::CreateInstance();
+    if (backend != FIMGAPI_BACKEND_SW)
+        fimgApi = FimgV4x::CreateInstance();
+
+    if (fimgApi == NULL && backend != FIMGAPI_BACKEND_HW)
+        fimgApi = FimgSw::CreateInstance();
+
+    return fimgApi;
 }
 
 extern "C" void destroyFimgApi(FimgApi * ptrFimgApi)
 {
-    // Dont' call DestroyInstance.
+    // FimgSw is a singleton which lives until the process exits
+    if (ptrFimgApi == NULL || FimgSw::IsInstance(ptrFimgApi) == true)
+        return;
+
+    // the context stays open in the pool, this only drops our reference
+    FimgV4x::ReleaseInstance(ptrFimgApi);
+}
+
+extern "C" void setFimgApiPoolPolicy(int idleTimeMs, int numOfKeep)
+{
+    FimgV4x::SetPoolPolicy(idleTimeMs, numOfKeep);
+}
+
+extern "C" void trimFimgApi(void)
+{
+    FimgV4x::TrimInstance(false);
 }
 
 }; // namespace android
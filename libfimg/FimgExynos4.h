@@ -22,6 +22,7 @@
 #define FIMG_EXYNOS4_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -35,8 +36,12 @@
 #include <sys/poll.h>
 #include <sys/stat.h>
 
+#include <pthread.h>
+
 #include <linux/android_pmem.h>
+#include <cutils/atomic.h>
 #include <utils/threads.h>
+#include <utils/Timers.h>
 #include <utils/StopWatch.h>
 
 #include "FimgApi.h"
@@ -46,11 +51,15 @@
 namespace android
 {
 
-#define NUMBER_FIMG_LIST           (1)  // kcoolsw : because of pmem
+// a context is only an open /dev/fimg2d, idle ones are closed by TrimInstance()
+#ifndef NUMBER_FIMG_LIST
+#define NUMBER_FIMG_LIST           (4)
+#endif
 #define GET_RECT_SIZE(rect)        ((rect->full_w) * (rect->h) * (rect->bytes_per_pixel))
 #define GET_REAL_SIZE(rect)        ((rect->full_w) * (rect->h) * (rect->bytes_per_pixel))
 #define GET_START_ADDR(rect)       (rect->virt_addr + ((rect->y * rect->full_w) * rect->bytes_per_pixel))
-#define SLEEP_TIME                 (3000000) // 3 sec
+#define FIMG_POOL_IDLE_TIME        (3000) // ms a context may stay unused before it is trimmed
+#define FIMG_POOL_NUM_OF_KEEP      (0)    // contexts which are never trimmed
 
 //---------------------------------------------------------------------------//
 // class FimgV4x : public FimgBase
@@ -70,25 +79,43 @@ private :
 
     Mutex          *m_lock;
 
+    // > 0 : number of users, -1 : being trimmed
+    volatile int32_t m_ref;
+    nsecs_t         m_lastUseTime;
+
     static Mutex    m_instanceLock;
     static unsigned m_curFimgV4xIndex;
     static int      m_numOfInstance;
 
     static FimgApi *m_ptrFimgApiList[NUMBER_FIMG_LIST];
 
+    static pthread_key_t  m_shardKey;
+    static pthread_once_t m_shardOnce;
+
+    static int      m_idleTimeMs;
+    static int      m_numOfKeep;
+    static nsecs_t  m_lastTrimTime;
+
 protected :
     FimgV4x();
     virtual ~FimgV4x();
 
 public:
     static FimgApi *CreateInstance();
+    static void     ReleaseInstance(FimgApi *ptrFimgApi);
     static void     DestroyInstance(FimgApi *ptrFimgApi);
     static void     DestroyAllInstance(void);
+    static void     TrimInstance(bool force);
+    static void     SetPoolPolicy(int idleTimeMs, int numOfKeep);
 
 protected:
     virtual bool    t_Create(void);
     virtual bool    t_Destroy(void);
     virtual bool    t_Stretch(struct fimg2d_blit *cmd);
+    virtual bool    t_StretchBatch(struct fimg2d_blit **cmd, int numOfCmd);
+    virtual bool    t_StretchAsync(struct fimg2d_blit *cmd);
+    virtual bool    t_Wait(int timeoutMs);
+    virtual int     t_GetFd(void);
     virtual bool    t_Sync(void);
     virtual bool    t_Lock(void);
     virtual bool    t_UnLock(void);
@@ -99,69 +126,13 @@ private:
 
     bool            m_DoG2D(struct fimg2d_blit *cmd);
 
-    inline bool     m_PollG2D(struct pollfd *events);
+    inline bool     m_PollG2D(struct pollfd *events, int timeoutMs);
 
     inline int      m_ColorFormatFimgApi2FimgHw(int colorFormat);
-};
-
-class FimgApiAutoFreeThread;
 
-static sp<FimgApiAutoFreeThread> fimgApiAutoFreeThread = 0;
-
-class FimgApiAutoFreeThread : public Thread
-{
-private:
-    bool mOneMoreSleep;
-    bool mDestroyed;
-
-public:
-    FimgApiAutoFreeThread(void):
-                Thread(false),
-                mOneMoreSleep(true),
-                mDestroyed(false)
-                { }
-    ~FimgApiAutoFreeThread(void)
-    {
-        if (mDestroyed == false)
-        {
-            FimgV4x::DestroyAllInstance();
-            mDestroyed = true;
-        }
-    }
-
-    virtual void onFirstRef()
-    {
-        run("FimgApiAutoFreeThread", PRIORITY_BACKGROUND);
-    }
-
-    virtual bool threadLoop()
-    {
-
-        if (mOneMoreSleep == true)
-        {
-            mOneMoreSleep = false;
-            usleep(SLEEP_TIME);
-
-            return true;
-        }
-        else
-        {
-            if (mDestroyed == false)
-            {
-                FimgV4x::DestroyAllInstance();
-                mDestroyed = true;
-            }
-
-            fimgApiAutoFreeThread = 0;
-
-            return false;
-        }
-    }
-
-    void SetOneMoreSleep(void)
-    {
-        mOneMoreSleep = true;
-    }
+    static void     m_InitShardKey(void);
+    static FimgApi *m_CreateInstanceLocked(unsigned int index);
+    inline bool     m_TryGet(void);
 };
 
 }; // namespace android
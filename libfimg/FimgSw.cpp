@@ -0,0 +1,784 @@
+/*
+**
+** Copyright 2009 Samsung Electronics Co, Ltd.
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+**
+**
+*/
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "FimgSw"
+#include <utils/Log.h>
+
+#include "FimgSw.h"
+
+namespace android
+{
+Mutex      FimgSw::m_instanceLock;
+FimgSw *   FimgSw::m_instance = NULL;
+
+static volatile int32_t fimgApiBackend = FIMGAPI_BACKEND_AUTO;
+
+//---------------------------------------------------------------------------//
+// pixel helpers, every step rounds the same way so the output is bit exact
+// between runs, threads and tile sizes
+//---------------------------------------------------------------------------//
+#define SW_A(c)         (((c) >> 24) & 0xff)
+#define SW_R(c)         (((c) >> 16) & 0xff)
+#define SW_G(c)         (((c) >>  8) & 0xff)
+#define SW_B(c)         ((c) & 0xff)
+#define SW_ARGB(a, r, g, b) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b))
+
+static inline uint32_t sw_div255(uint32_t x)
+{
+    // round(x / 255) for x <= 255 * 255
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#ifdef __ARM_NEON__
+static inline uint8x8_t sw_div255_u8(uint16x8_t x)
+{
+    // sw_div255() on 8 lanes
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+#endif
+
+static inline int sw_clamp(int v, int min, int max)
+{
+    if (v < min)
+        return min;
+    if (max < v)
+        return max;
+    return v;
+}
+
+static inline uint32_t sw_premultiply(uint32_t c)
+{
+    uint32_t a = SW_A(c);
+
+    if (a == 0xff)
+        return c;
+    if (a == 0)
+        return 0;
+
+    return SW_ARGB(a, sw_div255(SW_R(c) * a), sw_div255(SW_G(c) * a), sw_div255(SW_B(c) * a));
+}
+
+static inline uint32_t sw_unpremultiply(uint32_t c)
+{
+    uint32_t a = SW_A(c);
+
+    if (a == 0xff)
+        return c;
+    if (a == 0)
+        return 0;
+
+#define SW_UNPREMUL(x) (((x) * 255 + (a >> 1)) / a < 255 ? ((x) * 255 + (a >> 1)) / a : 255)
+    return SW_ARGB(a, SW_UNPREMUL(SW_R(c)), SW_UNPREMUL(SW_G(c)), SW_UNPREMUL(SW_B(c)));
+#undef SW_UNPREMUL
+}
+
+static inline uint32_t sw_read(const FimgSwImage *image, int x, int y)
+{
+    const unsigned char *p = image->addr + y * image->stride + x * image->format.bpp;
+
+    if (image->format.bpp == 4)
+        return *(const uint32_t *)p;
+    else
+        return *(const uint16_t *)p;
+}
+
+static inline void sw_write(FimgSwImage *image, int x, int y, uint32_t v)
+{
+    unsigned char *p = image->addr + y * image->stride + x * image->format.bpp;
+
+    if (image->format.bpp == 4)
+        *(uint32_t *)p = v;
+    else
+        *(uint16_t *)p = (uint16_t)v;
+}
+
+static inline uint32_t sw_unpack(const FimgSwFormat *format, uint32_t v)
+{
+    uint32_t c[4];
+
+    for (int i = 0; i < 4; i++) {
+        int bits = format->bits[i];
+
+        if (bits == 0) {
+            c[i] = (i == 0) ? 0xff : 0;
+        } else {
+            uint32_t mask = (1 << bits) - 1;
+
+            c[i] = (v >> format->shift[i]) & mask;
+            if (bits != 8)
+                c[i] = (c[i] * 255 + (mask >> 1)) / mask;
+        }
+    }
+
+    return SW_ARGB(c[0], c[1], c[2], c[3]);
+}
+
+static inline uint32_t sw_pack(const FimgSwFormat *format, uint32_t argb)
+{
+    uint32_t v = format->fill;
+
+    for (int i = 0; i < 4; i++) {
+        int bits = format->bits[i];
+
+        if (bits != 0) {
+            uint32_t mask = (1 << bits) - 1;
+            uint32_t c = (argb >> (24 - 8 * i)) & 0xff;
+
+            if (bits != 8)
+                c = (c * mask + 127) / 255;
+            v |= c << format->shift[i];
+        }
+    }
+
+    return v;
+}
+
+//---------------------------------------------------------------------------//
+// class FimgSw
+//---------------------------------------------------------------------------//
+class FimgSw::FimgSwWorker : public Thread
+{
+private:
+    FimgSw         *m_fimgSw;
+    unsigned int    m_gen;
+
+public:
+    FimgSwWorker(FimgSw *fimgSw)
+        : Thread(false),
+          m_fimgSw(fimgSw),
+          m_gen(0)
+    { }
+
+    virtual bool threadLoop()
+    {
+        if (m_fimgSw->m_WaitJob(&m_gen) == false)
+            return false;
+
+        FimgSw::m_RunRows(m_fimgSw->m_job);
+        m_fimgSw->m_DoneJob();
+
+        return true;
+    }
+};
+
+FimgSw::FimgSw()
+         : m_jobGen(0),
+           m_jobBusy(0),
+           m_jobExit(false),
+           m_job(NULL),
+           m_numOfWorker(0)
+{
+    m_lock = new Mutex(Mutex::SHARED, "FimgSw");
+}
+
+FimgSw::~FimgSw()
+{
+    delete m_lock;
+}
+
+FimgApi *FimgSw::CreateInstance()
+{
+    Mutex::Autolock autolock(m_instanceLock);
+
+    if (m_instance == NULL)
+        m_instance = new FimgSw;
+
+    if (m_instance->FlagCreate() == false && m_instance->Create() == false) {
+        PRINT("%s::Create() fail\n", __func__);
+        return NULL;
+    }
+
+    return m_instance;
+}
+
+bool FimgSw::IsInstance(FimgApi *ptrFimgApi)
+{
+    return (ptrFimgApi != NULL && ptrFimgApi == m_instance);
+}
+
+bool FimgSw::IsAccessible(struct fimg2d_blit *cmd)
+{
+    struct fimg2d_image *image[] = {cmd->src, cmd->msk, cmd->tmp, cmd->dst};
+
+    for (unsigned int i = 0; i < sizeof(image) / sizeof(image[0]); i++) {
+        if (image[i] != NULL
+            && image[i]->addr.type != ADDR_USER && image[i]->addr.type != ADDR_USER_RSVD)
+            return false;
+    }
+
+    return true;
+}
+
+bool FimgSw::t_Create(void)
+{
+    long numOfCpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (numOfCpu < 1)
+        numOfCpu = 1;
+    if (FIMG_SW_MAX_THREAD < numOfCpu)
+        numOfCpu = FIMG_SW_MAX_THREAD;
+
+    m_jobExit = false;
+    m_numOfWorker = 0;
+
+    // the caller's thread works on the blit as well
+    for (int i = 0; i < numOfCpu - 1; i++) {
+        m_worker[i] = new FimgSwWorker(this);
+        if (m_worker[i]->run("FimgSwWorker", PRIORITY_DISPLAY) != NO_ERROR) {
+            PRINT("%s::run(FimgSwWorker %d) fail\n", __func__, i);
+            m_worker[i].clear();
+            break;
+        }
+        m_numOfWorker++;
+    }
+
+    return true;
+}
+
+bool FimgSw::t_Destroy(void)
+{
+    {
+        Mutex::Autolock autolock(m_jobLock);
+        m_jobExit = true;
+        m_jobCond.broadcast();
+    }
+
+    for (int i = 0; i < m_numOfWorker; i++) {
+        m_worker[i]->requestExitAndWait();
+        m_worker[i].clear();
+    }
+    m_numOfWorker = 0;
+
+    return true;
+}
+
+bool FimgSw::t_Stretch(struct fimg2d_blit *cmd)
+{
+    FimgSwBlit blit;
+
+    if (m_SetBlit(cmd, &blit) == false) {
+        PRINT("%s::m_SetBlit() fail\n", __func__);
+        return false;
+    }
+
+    if (blit.x1 <= blit.x0 || blit.y1 <= blit.y0)
+        return true;
+
+    if (m_numOfWorker == 0
+        || (blit.x1 - blit.x0) * (blit.y1 - blit.y0) < FIMG_SW_MT_MIN_PIXELS) {
+        m_RunRows(&blit);
+        return true;
+    }
+
+    {
+        Mutex::Autolock autolock(m_jobLock);
+        m_job     = &blit;
+        m_jobBusy = m_numOfWorker;
+        m_jobGen++;
+        m_jobCond.broadcast();
+    }
+
+    m_RunRows(&blit);
+
+    {
+        Mutex::Autolock autolock(m_jobLock);
+        while (0 < m_jobBusy)
+            m_doneCond.wait(m_jobLock);
+        m_job = NULL;
+    }
+
+    return true;
+}
+
+bool FimgSw::t_Sync(void)
+{
+    // t_Stretch() returns when the blit is done
+    return true;
+}
+
+bool FimgSw::t_Lock(void)
+{
+    m_lock->lock();
+    return true;
+}
+
+bool FimgSw::t_UnLock(void)
+{
+    m_lock->unlock();
+    return true;
+}
+
+bool FimgSw::m_SetBlit(struct fimg2d_blit *cmd, FimgSwBlit *blit)
+{
+    struct fimg2d_param *param = &cmd->param;
+    int dstW, dstH, srcW, srcH;
+
+    memset(blit, 0, sizeof(FimgSwBlit));
+
+    switch (cmd->op) {
+    case BLIT_OP_SOLID_FILL:
+    case BLIT_OP_CLR:
+        break;
+    case BLIT_OP_SRC:
+    case BLIT_OP_SRC_OVER:
+        if (m_SetImage(cmd->src, &blit->src) == false) {
+            PRINT("%s::m_SetImage(src) fail\n", __func__);
+            return false;
+        }
+        break;
+    default:
+        PRINT("%s::blit_op(%d) is not supported\n", __func__, cmd->op);
+        return false;
+    }
+
+    if (cmd->msk != NULL) {
+        PRINT("%s::mask image is not supported\n", __func__);
+        return false;
+    }
+
+    if (m_SetImage(cmd->dst, &blit->dst) == false) {
+        PRINT("%s::m_SetImage(dst) fail\n", __func__);
+        return false;
+    }
+
+    if (param->rotate < ORIGIN || YFLIP < param->rotate) {
+        PRINT("%s::rotate(%d) is not supported\n", __func__, param->rotate);
+        return false;
+    }
+
+    blit->op         = cmd->op;
+    blit->premult    = (param->premult == PREMULTIPLIED);
+    blit->gAlpha     = param->g_alpha;
+    blit->solidColor = (uint32_t)param->solid_color;
+    blit->rotate     = param->rotate;
+    blit->scaling    = param->scaling.mode;
+    blit->raw        = (cmd->op == BLIT_OP_SRC && blit->gAlpha == 0xff
+                        && blit->scaling != SCALING_BILINEAR);
+
+    // dst area : dst rect, inside the dst image and the clip rect
+    blit->x0 = sw_clamp(blit->dst.rect.x1, 0, blit->dst.width);
+    blit->y0 = sw_clamp(blit->dst.rect.y1, 0, blit->dst.height);
+    blit->x1 = sw_clamp(blit->dst.rect.x2, 0, blit->dst.width);
+    blit->y1 = sw_clamp(blit->dst.rect.y2, 0, blit->dst.height);
+
+    if (param->clipping.enable == true) {
+        blit->x0 = sw_clamp(blit->x0, param->clipping.x1, param->clipping.x2);
+        blit->y0 = sw_clamp(blit->y0, param->clipping.y1, param->clipping.y2);
+        blit->x1 = sw_clamp(blit->x1, param->clipping.x1, param->clipping.x2);
+        blit->y1 = sw_clamp(blit->y1, param->clipping.y1, param->clipping.y2);
+    }
+
+    if (cmd->op != BLIT_OP_SRC && cmd->op != BLIT_OP_SRC_OVER)
+        return true;
+
+    dstW = blit->dst.rect.x2 - blit->dst.rect.x1;
+    dstH = blit->dst.rect.y2 - blit->dst.rect.y1;
+    srcW = blit->src.rect.x2 - blit->src.rect.x1;
+    srcH = blit->src.rect.y2 - blit->src.rect.y1;
+
+    if (dstW <= 0 || dstH <= 0 || srcW <= 0 || srcH <= 0) {
+        blit->x1 = blit->x0;
+        return true;
+    }
+
+    if (blit->rotate == ROT_90 || blit->rotate == ROT_270) {
+        blit->scaledW = dstH;
+        blit->scaledH = dstW;
+    } else {
+        blit->scaledW = dstW;
+        blit->scaledH = dstH;
+    }
+
+    // the scaling ratio may describe a bigger image than the rects (partial update)
+    if (blit->scaling != NO_SCALING
+        && 0 < param->scaling.src_w && 0 < param->scaling.src_h
+        && 0 < param->scaling.dst_w && 0 < param->scaling.dst_h) {
+        blit->ratioX = ((int64_t)param->scaling.src_w << 16) / param->scaling.dst_w;
+        blit->ratioY = ((int64_t)param->scaling.src_h << 16) / param->scaling.dst_h;
+    } else {
+        blit->ratioX = ((int64_t)srcW << 16) / blit->scaledW;
+        blit->ratioY = ((int64_t)srcH << 16) / blit->scaledH;
+    }
+
+    return true;
+}
+
+bool FimgSw::m_SetImage(struct fimg2d_image *image, FimgSwImage *swImage)
+{
+    if (image == NULL)
+        return false;
+
+    if (image->addr.type != ADDR_USER && image->addr.type != ADDR_USER_RSVD) {
+        PRINT("%s::addr type(%d) is not accessible\n", __func__, image->addr.type);
+        return false;
+    }
+
+    if (image->addr.start == 0 || image->width <= 0 || image->height <= 0 || image->stride <= 0)
+        return false;
+
+    if (m_SetFormat(image->fmt, image->order, &swImage->format) == false) {
+        PRINT("%s::color format(%d, %d) is not supported\n", __func__, image->fmt, image->order);
+        return false;
+    }
+
+    swImage->addr   = (unsigned char *)image->addr.start;
+    swImage->width  = image->width;
+    swImage->height = image->height;
+    swImage->stride = image->stride;
+    swImage->rect   = image->rect;
+
+    return true;
+}
+
+bool FimgSw::m_SetFormat(int colorFormat, int order, FimgSwFormat *format)
+{
+    // channels from MSB to LSB : index of A, R, G, B
+    static const int channelOrder[ARGB_ORDER_END][4] = {
+        {0, 1, 2, 3},   // AX_RGB
+        {1, 2, 3, 0},   // RGB_AX
+        {0, 3, 2, 1},   // AX_BGR
+        {3, 2, 1, 0},   // BGR_AX
+    };
+    int bits[4];
+    bool noAlpha = false;
+    int pos;
+
+    if (order < AX_RGB || ARGB_ORDER_END <= order)
+        return false;
+
+    switch (colorFormat) {
+    case CF_XRGB_8888:
+        noAlpha = true;
+    case CF_ARGB_8888:
+        format->bpp = 4;
+        bits[0] = 8; bits[1] = 8; bits[2] = 8; bits[3] = 8;
+        break;
+    case CF_RGB_565:
+        format->bpp = 2;
+        bits[0] = 0; bits[1] = 5; bits[2] = 6; bits[3] = 5;
+        break;
+    case CF_XRGB_1555:
+        noAlpha = true;
+    case CF_ARGB_1555:
+        format->bpp = 2;
+        bits[0] = 1; bits[1] = 5; bits[2] = 5; bits[3] = 5;
+        break;
+    case CF_XRGB_4444:
+        noAlpha = true;
+    case CF_ARGB_4444:
+        format->bpp = 2;
+        bits[0] = 4; bits[1] = 4; bits[2] = 4; bits[3] = 4;
+        break;
+    default:
+        return false;
+    }
+
+    pos = format->bpp * 8;
+    for (int i = 0; i < 4; i++) {
+        int ch = channelOrder[order][i];
+
+        pos -= bits[ch];
+        format->shift[ch] = pos;
+        format->bits[ch]  = bits[ch];
+    }
+
+    format->fill = 0;
+    if (noAlpha == true) {
+        format->fill    = ((1 << bits[0]) - 1) << format->shift[0];
+        format->bits[0] = 0;
+    }
+
+    return true;
+}
+
+bool FimgSw::m_WaitJob(unsigned int *gen)
+{
+    Mutex::Autolock autolock(m_jobLock);
+
+    while (*gen == m_jobGen && m_jobExit == false)
+        m_jobCond.wait(m_jobLock);
+
+    if (m_jobExit == true)
+        return false;
+
+    *gen = m_jobGen;
+
+    return true;
+}
+
+void FimgSw::m_DoneJob(void)
+{
+    Mutex::Autolock autolock(m_jobLock);
+
+    m_jobBusy--;
+    if (m_jobBusy == 0)
+        m_doneCond.signal();
+}
+
+void FimgSw::m_RunRows(FimgSwBlit *blit)
+{
+    uint32_t src[FIMG_SW_SPAN];
+    uint32_t dst[FIMG_SW_SPAN];
+    int numOfRow = blit->y1 - blit->y0;
+
+    // workers take FIMG_SW_TILE_ROWS rows at a time until the dst area is done
+    while (true) {
+        int row = android_atomic_add(FIMG_SW_TILE_ROWS, &blit->nextRow);
+        if (numOfRow <= row)
+            break;
+
+        int rowEnd = row + FIMG_SW_TILE_ROWS;
+        if (numOfRow < rowEnd)
+            rowEnd = numOfRow;
+
+        for (int y = blit->y0 + row; y < blit->y0 + rowEnd; y++) {
+            for (int x = blit->x0; x < blit->x1; x += FIMG_SW_SPAN) {
+                int num = blit->x1 - x;
+                if (FIMG_SW_SPAN < num)
+                    num = FIMG_SW_SPAN;
+
+                switch (blit->op) {
+                case BLIT_OP_CLR:
+                    memset(src, 0, num * sizeof(uint32_t));
+                    m_StoreSpan(&blit->dst, blit->premult, x, y, num, src);
+                    break;
+                case BLIT_OP_SOLID_FILL:
+                {
+                    uint32_t color = blit->solidColor;
+
+                    if (blit->premult == false)
+                        color = sw_premultiply(color);
+                    for (int i = 0; i < num; i++)
+                        src[i] = color;
+                    m_GlobalAlphaSpan(src, blit->gAlpha, num);
+                    m_StoreSpan(&blit->dst, blit->premult, x, y, num, src);
+                    break;
+                }
+                case BLIT_OP_SRC:
+                    m_SampleSpan(blit, x, y, num, src);
+                    m_GlobalAlphaSpan(src, blit->gAlpha, num);
+                    m_StoreSpan(&blit->dst, blit->premult || blit->raw, x, y, num, src);
+                    break;
+                case BLIT_OP_SRC_OVER:
+                    m_SampleSpan(blit, x, y, num, src);
+                    m_GlobalAlphaSpan(src, blit->gAlpha, num);
+                    m_LoadSpan(&blit->dst, blit->premult, x, y, num, dst);
+                    m_SrcOverSpan(dst, src, num);
+                    m_StoreSpan(&blit->dst, blit->premult, x, y, num, dst);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void FimgSw::m_SampleSpan(FimgSwBlit *blit, int x, int y, int num, uint32_t *out)
+{
+    FimgSwImage *src = &blit->src;
+    int srcMaxX = src->width  - 1;
+    int srcMaxY = src->height - 1;
+    bool toPremult = (blit->premult == false && blit->raw == false);
+
+    for (int i = 0; i < num; i++) {
+        int u = x + i - blit->dst.rect.x1;
+        int v = y - blit->dst.rect.y1;
+        int xs, ys;
+
+        // dst pixel -> pixel of the unrotated scaled src rect
+        switch (blit->rotate) {
+        case ROT_90:
+            xs = v;
+            ys = blit->scaledH - 1 - u;
+            break;
+        case ROT_180:
+            xs = blit->scaledW - 1 - u;
+            ys = blit->scaledH - 1 - v;
+            break;
+        case ROT_270:
+            xs = blit->scaledW - 1 - v;
+            ys = u;
+            break;
+        case XFLIP:
+            xs = u;
+            ys = blit->scaledH - 1 - v;
+            break;
+        case YFLIP:
+            xs = blit->scaledW - 1 - u;
+            ys = v;
+            break;
+        case ORIGIN:
+        default:
+            xs = u;
+            ys = v;
+            break;
+        }
+
+        // pixel centre in src coordinates, 16.16
+        int64_t sx = ((int64_t)src->rect.x1 << 16) + (((2 * xs + 1) * blit->ratioX) >> 1) - 0x8000;
+        int64_t sy = ((int64_t)src->rect.y1 << 16) + (((2 * ys + 1) * blit->ratioY) >> 1) - 0x8000;
+
+        if (blit->scaling != SCALING_BILINEAR) {
+            int px = sw_clamp((int)((sx + 0x8000) >> 16), 0, srcMaxX);
+            int py = sw_clamp((int)((sy + 0x8000) >> 16), 0, srcMaxY);
+            uint32_t c = sw_unpack(&src->format, sw_read(src, px, py));
+
+            out[i] = (toPremult == true) ? sw_premultiply(c) : c;
+        } else {
+            int px  = (int)(sx >> 16);
+            int py  = (int)(sy >> 16);
+            uint32_t wx = (uint32_t)(sx >> 8) & 0xff;
+            uint32_t wy = (uint32_t)(sy >> 8) & 0xff;
+            int px0 = sw_clamp(px,     0, srcMaxX);
+            int px1 = sw_clamp(px + 1, 0, srcMaxX);
+            int py0 = sw_clamp(py,     0, srcMaxY);
+            int py1 = sw_clamp(py + 1, 0, srcMaxY);
+            uint32_t c00 = sw_unpack(&src->format, sw_read(src, px0, py0));
+            uint32_t c01 = sw_unpack(&src->format, sw_read(src, px1, py0));
+            uint32_t c10 = sw_unpack(&src->format, sw_read(src, px0, py1));
+            uint32_t c11 = sw_unpack(&src->format, sw_read(src, px1, py1));
+            uint32_t c = 0;
+
+            // filter premultiplied colors, otherwise transparent texels bleed
+            if (blit->premult == false) {
+                c00 = sw_premultiply(c00);
+                c01 = sw_premultiply(c01);
+                c10 = sw_premultiply(c10);
+                c11 = sw_premultiply(c11);
+            }
+
+            for (int s = 0; s < 32; s += 8) {
+                uint32_t top    = ((c00 >> s) & 0xff) * (256 - wx) + ((c01 >> s) & 0xff) * wx;
+                uint32_t bottom = ((c10 >> s) & 0xff) * (256 - wx) + ((c11 >> s) & 0xff) * wx;
+
+                c |= ((top * (256 - wy) + bottom * wy + 32768) >> 16) << s;
+            }
+
+            out[i] = c;
+        }
+    }
+}
+
+void FimgSw::m_LoadSpan(FimgSwImage *image, bool premult, int x, int y, int num, uint32_t *out)
+{
+    for (int i = 0; i < num; i++) {
+        uint32_t c = sw_unpack(&image->format, sw_read(image, x + i, y));
+
+        out[i] = (premult == true) ? c : sw_premultiply(c);
+    }
+}
+
+void FimgSw::m_StoreSpan(FimgSwImage *image, bool premult, int x, int y, int num, const uint32_t *in)
+{
+    // 32bpp ARGB in memory order is a plain copy
+    if (image->format.bpp == 4 && image->format.shift[0] == 24 && image->format.shift[3] == 0
+        && image->format.bits[0] == 8 && premult == true) {
+        memcpy(image->addr + y * image->stride + x * 4, in, num * sizeof(uint32_t));
+        return;
+    }
+
+    for (int i = 0; i < num; i++) {
+        uint32_t c = (premult == true) ? in[i] : sw_unpremultiply(in[i]);
+
+        sw_write(image, x + i, y, sw_pack(&image->format, c));
+    }
+}
+
+void FimgSw::m_SrcOverSpan(uint32_t *dst, const uint32_t *src, int num)
+{
+    int i = 0;
+
+#ifdef __ARM_NEON__
+    // 8 pixels deinterleaved to B, G, R, A lanes, the tail is left to C
+    for (; i + 8 <= num; i += 8) {
+        uint8x8x4_t s  = vld4_u8((const uint8_t *)(src + i));
+        uint8x8x4_t d  = vld4_u8((const uint8_t *)(dst + i));
+        uint8x8_t   ia = vmvn_u8(s.val[3]);
+
+        d.val[0] = vadd_u8(s.val[0], sw_div255_u8(vmull_u8(d.val[0], ia)));
+        d.val[1] = vadd_u8(s.val[1], sw_div255_u8(vmull_u8(d.val[1], ia)));
+        d.val[2] = vadd_u8(s.val[2], sw_div255_u8(vmull_u8(d.val[2], ia)));
+        d.val[3] = vadd_u8(s.val[3], sw_div255_u8(vmull_u8(d.val[3], ia)));
+        vst4_u8((uint8_t *)(dst + i), d);
+    }
+#endif
+
+    // premultiplied : d = s + d * (1 - sa), per channel without branches
+    for (; i < num; i++) {
+        uint32_t s  = src[i];
+        uint32_t d  = dst[i];
+        uint32_t ia = 255 - SW_A(s);
+
+        dst[i] = SW_ARGB(SW_A(s) + sw_div255(SW_A(d) * ia),
+                         SW_R(s) + sw_div255(SW_R(d) * ia),
+                         SW_G(s) + sw_div255(SW_G(d) * ia),
+                         SW_B(s) + sw_div255(SW_B(d) * ia));
+    }
+}
+
+void FimgSw::m_GlobalAlphaSpan(uint32_t *src, unsigned int gAlpha, int num)
+{
+    int i = 0;
+
+    if (gAlpha == 0xff)
+        return;
+
+#ifdef __ARM_NEON__
+    uint8x8_t ga = vdup_n_u8((uint8_t)gAlpha);
+
+    for (; i + 8 <= num; i += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+
+        s.val[0] = sw_div255_u8(vmull_u8(s.val[0], ga));
+        s.val[1] = sw_div255_u8(vmull_u8(s.val[1], ga));
+        s.val[2] = sw_div255_u8(vmull_u8(s.val[2], ga));
+        s.val[3] = sw_div255_u8(vmull_u8(s.val[3], ga));
+        vst4_u8((uint8_t *)(src + i), s);
+    }
+#endif
+
+    for (; i < num; i++) {
+        uint32_t s = src[i];
+
+        src[i] = SW_ARGB(sw_div255(SW_A(s) * gAlpha),
+                         sw_div255(SW_R(s) * gAlpha),
+                         sw_div255(SW_G(s) * gAlpha),
+                         sw_div255(SW_B(s) * gAlpha));
+    }
+}
+
+//---------------------------------------------------------------------------//
+// extern function
+//---------------------------------------------------------------------------//
+extern "C" void setFimgApiBackend(int backend)
+{
+    android_atomic_release_store(backend, &fimgApiBackend);
+}
+
+extern "C" int getFimgApiBackend(void)
+{
+    return android_atomic_acquire_load(&fimgApiBackend);
+}
+
+}; // namespace android
@@ -0,0 +1,154 @@
+/*
+**
+** Copyright 2009 Samsung Electronics Co, Ltd.
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+**
+**
+*/
+
+#ifndef FIMG_SW_H
+#define FIMG_SW_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include <cutils/atomic.h>
+#include <utils/threads.h>
+
+#include "FimgApi.h"
+
+#include "sec_g2d_4x.h"
+
+namespace android
+{
+
+#define FIMG_SW_MAX_THREAD          (4)
+#define FIMG_SW_TILE_ROWS           (16)        // rows one worker takes at a time
+#define FIMG_SW_SPAN                (256)       // pixels processed per kernel call
+#define FIMG_SW_MT_MIN_PIXELS       (64 * 1024) // smaller blits stay on the caller's thread
+
+struct FimgSwFormat {
+    int             bpp;
+    int             shift[4];   // A, R, G, B
+    int             bits[4];    // 0 : channel is not stored
+    unsigned int    fill;       // bits written as 1 (X of XRGB)
+};
+
+struct FimgSwImage {
+    unsigned char  *addr;
+    int             width;
+    int             height;
+    int             stride;
+    FimgSwFormat    format;
+    fimg2d_rect     rect;
+};
+
+struct FimgSwBlit {
+    int             op;
+    bool            premult;
+    unsigned int    gAlpha;
+    unsigned int    solidColor;
+    int             rotate;
+    int             scaling;
+    bool            raw;        // plain copy, src is stored without converting alpha
+
+    FimgSwImage     src;
+    FimgSwImage     dst;
+
+    // unrotated size of the scaled src rect and the src step per dst pixel (16.16)
+    int             scaledW;
+    int             scaledH;
+    int64_t         ratioX;
+    int64_t         ratioY;
+
+    // dst area which is written, dst rect clipped
+    int             x0;
+    int             y0;
+    int             x1;
+    int             y1;
+
+    volatile int32_t nextRow;
+};
+
+//---------------------------------------------------------------------------//
+// class FimgSw : public FimgApi
+//---------------------------------------------------------------------------//
+/*
+ * CPU implementation of the common blits, used when /dev/fimg2d is missing
+ * or fails, and as a reference to compare the G2D output with. Only images
+ * with a user virtual address can be accessed, see IsAccessible().
+ */
+class FimgSw : public FimgApi
+{
+private :
+    Mutex          *m_lock;
+
+    Mutex           m_jobLock;
+    Condition       m_jobCond;
+    Condition       m_doneCond;
+    unsigned int    m_jobGen;
+    int             m_jobBusy;
+    bool            m_jobExit;
+    FimgSwBlit     *m_job;
+
+    int             m_numOfWorker;
+    sp<Thread>      m_worker[FIMG_SW_MAX_THREAD - 1];
+
+    static Mutex    m_instanceLock;
+    static FimgSw  *m_instance;
+
+    class FimgSwWorker;
+
+protected :
+    FimgSw();
+    virtual ~FimgSw();
+
+public:
+    static FimgApi *CreateInstance();
+    static bool     IsInstance(FimgApi *ptrFimgApi);
+    static bool     IsAccessible(struct fimg2d_blit *cmd);
+
+protected:
+    virtual bool    t_Create(void);
+    virtual bool    t_Destroy(void);
+    virtual bool    t_Stretch(struct fimg2d_blit *cmd);
+    virtual bool    t_Sync(void);
+    virtual bool    t_Lock(void);
+    virtual bool    t_UnLock(void);
+
+private:
+    bool            m_SetBlit(struct fimg2d_blit *cmd, FimgSwBlit *blit);
+    bool            m_SetImage(struct fimg2d_image *image, FimgSwImage *swImage);
+    bool            m_SetFormat(int colorFormat, int order, FimgSwFormat *format);
+
+    bool            m_WaitJob(unsigned int *gen);
+    void            m_DoneJob(void);
+
+    static void     m_RunRows(FimgSwBlit *blit);
+    static void     m_SampleSpan(FimgSwBlit *blit, int x, int y, int num, uint32_t *out);
+    static void     m_LoadSpan(FimgSwImage *image, bool premult, int x, int y, int num, uint32_t *out);
+    static void     m_StoreSpan(FimgSwImage *image, bool premult, int x, int y, int num, const uint32_t *in);
+    static void     m_SrcOverSpan(uint32_t *dst, const uint32_t *src, int num);
+    static void     m_GlobalAlphaSpan(uint32_t *src, unsigned int gAlpha, int num);
+};
+
+}; // namespace android
+
+#endif // FIMG_SW_H
@@ -0,0 +1,295 @@
+/*
+**
+** Copyright 2009 Samsung Electronics Co, Ltd.
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+**
+**
+*/
+
+/*
+ * Measures what the G2D context pool costs per blit.
+ *
+ *   fimg_pool_bench [threads] [iterations]
+ *
+ * "acquire" is createFimgApi() + destroyFimgApi() from 1 up to the given
+ * number of threads at once, "blit" is stretchFimgApi() of a small ARGB8888
+ * copy, once on a warm pool and once with the pool trimmed before every
+ * blit, which is what every blit paid when contexts were closed on idle.
+ * "trim" holds a context on every thread at once, lets the pool go idle and
+ * trims it, printing the /dev/fimg2d fds open before and after.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <utils/Timers.h>
+
+#include "FimgApi.h"
+
+#define BENCH_MAX_THREADS   (8)
+#define BENCH_BLIT_W        (64)
+#define BENCH_BLIT_H        (64)
+#define BENCH_IDLE_TIME     (100)   // ms
+#define BENCH_NUM_OF_KEEP   (1)
+
+struct bench_thread {
+    pthread_t   thread;
+    int         iterations;
+    int         fail;
+    nsecs_t     time;
+};
+
+static void *acquire_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    nsecs_t start = systemTime();
+
+    for (int i = 0; i < t->iterations; i++) {
+        FimgApi *fimgApi = createFimgApi();
+        if (fimgApi == NULL) {
+            t->fail++;
+            continue;
+        }
+        destroyFimgApi(fimgApi);
+    }
+
+    t->time = systemTime() - start;
+    return NULL;
+}
+
+static int bench_acquire(int numOfThread, int iterations)
+{
+    struct bench_thread t[BENCH_MAX_THREADS];
+    nsecs_t total = 0;
+    int fail = 0;
+
+    memset(t, 0, sizeof(t));
+
+    for (int i = 0; i < numOfThread; i++) {
+        t[i].iterations = iterations;
+        if (pthread_create(&t[i].thread, NULL, acquire_thread, &t[i]) != 0) {
+            printf("pthread_create fail\n");
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < numOfThread; i++) {
+        pthread_join(t[i].thread, NULL);
+        total += t[i].time;
+        fail  += t[i].fail;
+    }
+
+    printf("acquire  %d thread(s) : %6lld ns/op%s\n", numOfThread,
+           (long long)(total / ((nsecs_t)numOfThread * iterations)),
+           fail ? "  (no context)" : "");
+    return fail ? -1 : 0;
+}
+
+static int count_g2d_fd(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *entry;
+    char path[64];
+    char link[64];
+    int count = 0;
+
+    if (dir == NULL)
+        return -1;
+
+    while ((entry = readdir(dir)) != NULL) {
+        ssize_t len;
+
+        snprintf(path, sizeof(path), "/proc/self/fd/%s", entry->d_name);
+        len = readlink(path, link, sizeof(link) - 1);
+        if (len < 0)
+            continue;
+        link[len] = '\0';
+
+        if (strcmp(link, "/dev/fimg2d") == 0)
+            count++;
+    }
+
+    closedir(dir);
+    return count;
+}
+
+struct trim_state {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             numOfHeld;
+    bool            release;
+};
+
+static void *hold_thread(void *arg)
+{
+    struct trim_state *s = (struct trim_state *)arg;
+    FimgApi *fimgApi = createFimgApi();
+
+    pthread_mutex_lock(&s->lock);
+    s->numOfHeld++;
+    pthread_cond_broadcast(&s->cond);
+    while (s->release == false)
+        pthread_cond_wait(&s->cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+
+    if (fimgApi != NULL)
+        destroyFimgApi(fimgApi);
+    return NULL;
+}
+
+static int bench_trim(int numOfThread)
+{
+    struct trim_state s;
+    pthread_t thread[BENCH_MAX_THREADS];
+    int numOfOpen, numOfTrimmed;
+
+    memset(&s, 0, sizeof(s));
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+
+    setFimgApiPoolPolicy(BENCH_IDLE_TIME, BENCH_NUM_OF_KEEP);
+
+    for (int i = 0; i < numOfThread; i++) {
+        if (pthread_create(&thread[i], NULL, hold_thread, &s) != 0) {
+            printf("pthread_create fail\n");
+            return -1;
+        }
+    }
+
+    // every thread holds its context now, each shard has one open
+    pthread_mutex_lock(&s.lock);
+    while (s.numOfHeld < numOfThread)
+        pthread_cond_wait(&s.cond, &s.lock);
+    numOfOpen = count_g2d_fd();
+    s.release = true;
+    pthread_cond_broadcast(&s.cond);
+    pthread_mutex_unlock(&s.lock);
+
+    for (int i = 0; i < numOfThread; i++)
+        pthread_join(thread[i], NULL);
+
+    usleep((BENCH_IDLE_TIME * 2) * 1000);
+    trimFimgApi();
+    numOfTrimmed = count_g2d_fd();
+
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+
+    printf("trim     %d thread(s) : %d -> %d fimg2d fd(s) open, keep %d\n",
+           numOfThread, numOfOpen, numOfTrimmed, BENCH_NUM_OF_KEEP);
+
+    // without a /dev/fimg2d (FimgSw) nothing is opened, nothing to trim
+    if (BENCH_NUM_OF_KEEP < numOfTrimmed)
+        return -1;
+    return 0;
+}
+
+static void init_image(struct fimg2d_image *image, unsigned int *buf)
+{
+    memset(image, 0, sizeof(*image));
+    image->width      = BENCH_BLIT_W;
+    image->height     = BENCH_BLIT_H;
+    image->stride     = BENCH_BLIT_W * 4;
+    image->order      = AX_RGB;
+    image->fmt        = CF_ARGB_8888;
+    image->addr.type  = ADDR_USER;
+    image->addr.start = (unsigned long)buf;
+    image->rect.x2    = BENCH_BLIT_W;
+    image->rect.y2    = BENCH_BLIT_H;
+}
+
+static int bench_blit(const char *name, int iterations, bool cold)
+{
+    static unsigned int src[BENCH_BLIT_W * BENCH_BLIT_H];
+    static unsigned int dst[BENCH_BLIT_W * BENCH_BLIT_H];
+    struct fimg2d_image srcImage, dstImage;
+    struct fimg2d_blit  cmd;
+    nsecs_t total = 0;
+
+    for (int i = 0; i < BENCH_BLIT_W * BENCH_BLIT_H; i++)
+        src[i] = 0xff000000 | i;
+
+    init_image(&srcImage, src);
+    init_image(&dstImage, dst);
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.op            = BLIT_OP_SRC;
+    cmd.param.g_alpha = 0xff;
+    cmd.param.rotate  = ORIGIN;
+    cmd.src           = &srcImage;
+    cmd.dst           = &dstImage;
+    cmd.sync          = BLIT_SYNC;
+
+    for (int i = 0; i < iterations; i++) {
+        nsecs_t start;
+
+        if (cold == true)
+            trimFimgApi();
+
+        start = systemTime();
+        if (stretchFimgApi(&cmd) < 0) {
+            printf("blit     %-4s       : stretchFimgApi fail\n", name);
+            return -1;
+        }
+        total += systemTime() - start;
+    }
+
+    if (memcmp(src, dst, sizeof(dst)) != 0) {
+        printf("blit     %-4s       : dst does not match src\n", name);
+        return -1;
+    }
+
+    printf("blit     %-4s       : %6lld us/blit\n", name,
+           (long long)ns2us(total / iterations));
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int numOfThread = 4;
+    int iterations  = 1000;
+    int ret = 0;
+
+    if (argc > 1)
+        numOfThread = atoi(argv[1]);
+    if (argc > 2)
+        iterations = atoi(argv[2]);
+
+    if (numOfThread < 1 || BENCH_MAX_THREADS < numOfThread || iterations < 1) {
+        printf("usage: %s [threads(1~%d)] [iterations]\n", argv[0], BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    for (int i = 1; i <= numOfThread; i++) {
+        if (bench_acquire(i, iterations) < 0)
+            ret = 1;
+    }
+
+    if (bench_blit("warm", iterations, false) < 0)
+        ret = 1;
+
+    if (bench_trim(numOfThread) < 0)
+        ret = 1;
+
+    // every context may be closed, the next blit opens /dev/fimg2d again
+    setFimgApiPoolPolicy(0, 0);
+    if (bench_blit("cold", iterations, true) < 0)
+        ret = 1;
+
+    return ret;
+}
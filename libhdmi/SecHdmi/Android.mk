@@ -21,11 +21,13 @@ LOCAL_MODULE_TAGS := eng
 
 LOCAL_PRELINK_MODULE := false
 #LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
-LOCAL_SHARED_LIBRARIES := libutils liblog libedid libcec
+LOCAL_SHARED_LIBRARIES := libutils libcutils liblog libedid libcec
 
 LOCAL_SRC_FILES := \
 	SecHdmiV4L2Utils.cpp \
 	SecHdmi.cpp \
+	SecHdmiCEC.cpp \
+	SecHdmiTrace.cpp \
 	fimd_api.c
 
 LOCAL_C_INCLUDES += $(LOCAL_PATH)
@@ -85,4 +87,6 @@ endif
 LOCAL_MODULE := libhdmi
 include $(BUILD_SHARED_LIBRARY)
 
+include $(LOCAL_PATH)/test/Android.mk
+
 endif
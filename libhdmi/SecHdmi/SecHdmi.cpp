@@ -24,6 +24,7 @@
 
 #include "SecHdmi.h"
 #include "SecHdmiV4L2Utils.h"
+#include "SecHdmiTrace.h"
 
 #define CHECK_GRAPHIC_LAYER_TIME (0)
 
@@ -51,188 +52,6 @@ extern unsigned int cur_g2d_address;
 extern unsigned int g2d_buf_index;
 #endif
 
-#if defined(BOARD_USES_CEC)
-SecHdmi::CECThread::~CECThread()
-{
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("%s", __func__);
-#endif
-    mFlagRunning = false;
-}
-
-bool SecHdmi::CECThread::threadLoop()
-{
-    unsigned char buffer[CEC_MAX_FRAME_SIZE];
-    int size;
-    unsigned char lsrc, ldst, opcode;
-
-    {
-        Mutex::Autolock lock(mThreadLoopLock);
-        mFlagRunning = true;
-
-        size = CECReceiveMessage(buffer, CEC_MAX_FRAME_SIZE, 100000);
-
-        if (!size) // no data available or ctrl-c
-            return true;
-
-        if (size == 1)
-            return true; // "Polling Message"
-
-        lsrc = buffer[0] >> 4;
-
-        /* ignore messages with src address == mLaddr*/
-        if (lsrc == mLaddr)
-            return true;
-
-        opcode = buffer[1];
-
-        if (CECIgnoreMessage(opcode, lsrc)) {
-            ALOGE("### ignore message coming from address 15 (unregistered)\n");
-            return true;
-        }
-
-        if (!CECCheckMessageSize(opcode, size)) {
-            ALOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
-            return true;
-        }
-
-        /* check if message broadcasted/directly addressed */
-        if (!CECCheckMessageMode(opcode, (buffer[0] & 0x0F) == CEC_MSG_BROADCAST ? 1 : 0)) {
-            ALOGE("### invalid message mode (directly addressed/broadcast) ###\n");
-            return true;
-        }
-
-        ldst = lsrc;
-
-        //TODO: macroses to extract src and dst logical addresses
-        //TODO: macros to extract opcode
-
-        switch (opcode) {
-        case CEC_OPCODE_GIVE_PHYSICAL_ADDRESS:
-            /* responce with "Report Physical Address" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            buffer[4] = mDevtype;
-            size = 5;
-            break;
-
-        case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-            ALOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
-            /* responce with "Active Source" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_ACTIVE_SOURCE;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            size = 4;
-            ALOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
-            break;
-
-        case CEC_OPCODE_ABORT:
-        case CEC_OPCODE_FEATURE_ABORT:
-        default:
-            /* send "Feature Abort" */
-            buffer[0] = (mLaddr << 4) | ldst;
-            buffer[1] = CEC_OPCODE_FEATURE_ABORT;
-            buffer[2] = CEC_OPCODE_ABORT;
-            buffer[3] = 0x04; // "refused"
-            size = 4;
-            break;
-        }
-
-        if (CECSendMessage(buffer, size) != size)
-            ALOGE("CECSendMessage() failed!!!\n");
-
-    }
-    return true;
-}
-
-bool SecHdmi::CECThread::start()
-{
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("%s", __func__);
-#endif
-
-    Mutex::Autolock lock(mThreadControlLock);
-    if (exitPending()) {
-        if (requestExitAndWait() == WOULD_BLOCK) {
-            ALOGE("mCECThread.requestExitAndWait() == WOULD_BLOCK");
-            return false;
-        }
-    }
-
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("EDIDGetCECPhysicalAddress");
-#endif
-    /* set to not valid physical address */
-    mPaddr = CEC_NOT_VALID_PHYSICAL_ADDRESS;
-
-    if (!EDIDGetCECPhysicalAddress(&mPaddr)) {
-        ALOGE("Error: EDIDGetCECPhysicalAddress() failed.\n");
-        return false;
-    }
-
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("CECOpen");
-#endif
-    if (!CECOpen()) {
-        ALOGE("CECOpen() failed!!!\n");
-        return false;
-    }
-
-    /* a logical address should only be allocated when a device \
-       has a valid physical address, at all other times a device \
-       should take the 'Unregistered' logical address (15)
-       */
-
-    /* if physical address is not valid device should take \
-       the 'Unregistered' logical address (15)
-       */
-
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("CECAllocLogicalAddress");
-#endif
-    mLaddr = CECAllocLogicalAddress(mPaddr, mDevtype);
-
-    if (!mLaddr) {
-        ALOGE("CECAllocLogicalAddress() failed!!!\n");
-        if (!CECClose())
-            ALOGE("CECClose() failed!\n");
-        return false;
-    }
-
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("request to run CECThread");
-#endif
-
-    status_t ret = run("SecHdmi::CECThread", PRIORITY_DISPLAY);
-    if (ret != NO_ERROR) {
-        ALOGE("%s fail to run thread", __func__);
-        return false;
-    }
-    return true;
-}
-
-bool SecHdmi::CECThread::stop()
-{
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("%s request Exit", __func__);
-#endif
-    Mutex::Autolock lock(mThreadControlLock);
-    if (requestExitAndWait() == WOULD_BLOCK) {
-        ALOGE("mCECThread.requestExitAndWait() == WOULD_BLOCK");
-        return false;
-    }
-
-    if (!CECClose())
-        ALOGE("CECClose() failed!\n");
-
-    mFlagRunning = false;
-    return true;
-}
-#endif
-
 SecHdmi::SecHdmi():
 #if defined(BOARD_USES_CEC)
     mCECThread(NULL),
@@ -260,6 +79,7 @@ SecHdmi::SecHdmi():
     mFBaddr(NULL),
     mFBsize(0),
     mFBionfd(-1),
+    mFBphys(0),
     mFBIndex(0),
     mDefaultFBFd(-1),
     mDisplayWidth(DEFALULT_DISPLAY_WIDTH),
@@ -310,7 +130,7 @@ SecHdmi::SecHdmi():
     mHdmiResolutionValueList[13] = 4809602;
 
 #if defined(BOARD_USES_CEC)
-    mCECThread = new CECThread(this);
+    mCECThread = new SecHdmiCEC();
 #endif
 
     SecBuffer zeroBuf;
@@ -523,15 +343,7 @@ bool SecHdmi::destroy(void)
 #endif //USE_LCD_ADDR_IN_HERE
 
 #if defined(BOARD_USE_V4L2_ION)
-    if (mFBaddr != NULL)
-        ion_unmap((void *)mFBaddr, ALIGN(mFBsize * 4 * 2, PAGE_SIZE));
-
-    if (mFBionfd > 0)
-        ion_free(mFBionfd);
-
-    mFBaddr = NULL;
-    mFBionfd = -1;
-    mFBsize = 0;
+    m_unmapFramebuffer();
 #endif
 
 #if defined(BOARD_USE_V4L2_ION) && defined(BOARD_USES_FIMGAPI)
@@ -585,7 +397,7 @@ bool SecHdmi::connect(void)
 #endif
 
 #if defined(BOARD_USES_CEC)
-            if (!(mCECThread->mFlagRunning))
+            if (!(mCECThread->isActive()))
                 mCECThread->start();
 #endif
         }
@@ -635,7 +447,7 @@ bool SecHdmi::disconnect(void)
     if (mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
         mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI) {
 #if defined(BOARD_USES_CEC)
-        if (mCECThread->mFlagRunning)
+        if (mCECThread->isActive())
             mCECThread->stop();
 #endif
 
@@ -702,7 +514,9 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
         unsigned int srcYAddr, unsigned int srcCbAddr, unsigned int srcCrAddr,
         int dstX, int dstY,
         int hdmiLayer,
-        int num_of_hwc_layer)
+        int num_of_hwc_layer,
+        struct v4l2_rect *damage,
+        int fbYOffset)
 {
 #ifdef DEBUG_MSG_ENABLE
     ALOGD("%s [srcW=%d, srcH=%d, srcColorFormat=0x%x, srcYAddr=0x%x, srcCbAddr=0x%x, srcCrAddr=0x%x, dstX=%d, dstY=%d, hdmiLayer=%d]",
@@ -775,41 +589,45 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
     }
 
     if (srcYAddr == 0) {
+        /* fb_mapped is the lookup and map, g2d_start..g2d_end the scaling of the mirror */
+        hdmi_trace_stamp(HDMI_TRACE_FB_LOOKUP);
 #if defined(BOARD_USE_V4L2_ION)
         unsigned int FB_size = ALIGN(srcW, 16) * ALIGN(srcH, 16) * HDMI_FB_BPP_SIZE;
-        void *virFBAddr = 0;
-        struct s3c_fb_user_ion_client ion_handle;
+        unsigned long FB_phys = 0;
 
-        if (mFBaddr != NULL) {
-            ion_unmap((void *)mFBaddr, ALIGN(mFBsize * 2, PAGE_SIZE));
-            ion_free(mFBionfd);
-        }
-
-        // get framebuffer virtual address for LCD
-        if (ioctl(mDefaultFBFd, S3CFB_GET_ION_USER_HANDLE, &ion_handle) < 0) {
-            ALOGE("%s:ioctl(S3CFB_GET_ION_USER_HANDLE) fail", __func__);
+        /*
+         * the ion handle of the framebuffer is a new fd on every query, so the
+         * mapping is keyed on the memory behind it: stays mapped until the
+         * framebuffer is reallocated or its geometry changes
+         */
+        if (m_getFramebufferPhys(&FB_phys) == false)
             return false;
-        }
 
-        virFBAddr = ion_map(ion_handle.fd, ALIGN(FB_size * 2, PAGE_SIZE), 0);
-        if (virFBAddr == MAP_FAILED) {
-            ALOGE("%s::ion_map fail", __func__);
-            ion_free(ion_handle.fd);
-            mFBaddr = NULL;
-            return false;
+        if (mFBaddr == NULL || mFBsize != FB_size || mFBphys != FB_phys) {
+            if (m_mapFramebuffer(FB_size, FB_phys) == false) {
+                ALOGE("%s::m_mapFramebuffer(%d) fail", __func__, FB_size);
+                return false;
+            }
         }
 
+        /*
+         * The damage is only valid against the buffer that was posted. When
+         * the caller does not say which one that is, take the other half than
+         * last time and re-scale all of it, so a wrong guess lasts one frame.
+         */
+        if (0 <= fbYOffset)
+            mFBIndex = (fbYOffset < srcH) ? 0 : 1;
+        else
+            damage = NULL;
+
         if ((mFBIndex % 2) == 0)
-            srcYAddr = (unsigned int)virFBAddr;
+            srcYAddr = (unsigned int)mFBaddr;
         else
-            srcYAddr = (unsigned int)virFBAddr + FB_size;
+            srcYAddr = (unsigned int)mFBaddr + FB_size;
 
         srcCbAddr = srcYAddr;
 
         mFBIndex++;
-        mFBaddr = virFBAddr;
-        mFBsize = FB_size;
-        mFBionfd = ion_handle.fd;
 #else
         unsigned int phyFBAddr = 0;
 
@@ -831,6 +649,7 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
         srcYAddr = phyFBAddr;
         srcCbAddr = srcYAddr;
 #endif
+        hdmi_trace_stamp(HDMI_TRACE_FB_MAPPED);
     }
 
     if (hdmiLayer == HDMI_LAYER_VIDEO) {
@@ -891,10 +710,12 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                 return false;
             }
 
+            hdmi_trace_stamp(HDMI_TRACE_FIMC_START);
             if (mSecFimc.draw(0, mFimcCurrentOutBufIndex) == false) {
                 ALOGE("%s::mSecFimc.draw() fail \n", __func__);
                 return false;
             }
+            hdmi_trace_stamp(HDMI_TRACE_FIMC_END);
 #if defined(BOARD_USE_V4L2)
             mMixerBuffer[hdmiLayer][0].virt.extP[0] = (char *)mHdmiSrcYAddr;
             mMixerBuffer[hdmiLayer][0].virt.extP[1] = (char *)mHdmiSrcCbCrAddr;
@@ -925,10 +746,12 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                 return false;
             }
 
+            hdmi_trace_stamp(HDMI_TRACE_FIMC_START);
             if (mSecFimc.draw(0, mFimcCurrentOutBufIndex) == false) {
                 ALOGE("%s::mSecFimc.draw() failed", __func__);
                 return false;
             }
+            hdmi_trace_stamp(HDMI_TRACE_FIMC_END);
 #if defined(BOARD_USE_V4L2)
             if (hdmi_set_g_scaling(hdmiLayer,
                             HAL_PIXEL_FORMAT_BGRA_8888,
@@ -937,7 +760,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                             mDstRect.left , mDstRect.top,
                             mHdmiDstWidth, mHdmiDstHeight,
                             mG2DUIRotVal,
-                            num_of_hwc_layer) < 0)
+                            num_of_hwc_layer,
+                            NULL) < 0)
                 return false;
 #else
             if (hdmi_gl_set_param(hdmiLayer,
@@ -946,7 +770,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                             mHdmiSrcYAddr, mHdmiSrcCbCrAddr,
                             mDstRect.left , mDstRect.top,
                             mHdmiDstWidth, mHdmiDstHeight,
-                            mG2DUIRotVal) < 0)
+                            mG2DUIRotVal,
+                            NULL) < 0)
 #endif
                 return false;
         } else {
@@ -972,7 +797,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                                 rect.left, rect.top,
                                 rect.width, rect.height,
                                 mG2DUIRotVal,
-                                num_of_hwc_layer) < 0)
+                                num_of_hwc_layer,
+                                damage) < 0)
                     return false;
 #else
                 if (hdmi_gl_set_param(hdmiLayer,
@@ -981,7 +807,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                                 srcYAddr, srcCbAddr,
                                 rect.left, rect.top,
                                 rect.width, rect.height,
-                                mG2DUIRotVal) < 0)
+                                mG2DUIRotVal,
+                                damage) < 0)
                     return false;
 #endif
             } else { /* Video Playback Mode */
@@ -993,7 +820,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                                 dstX, dstY,
                                 mHdmiDstWidth, mHdmiDstHeight,
                                 mG2DUIRotVal,
-                                num_of_hwc_layer) < 0)
+                                num_of_hwc_layer,
+                                damage) < 0)
                     return false;
 #else
                 if (hdmi_gl_set_param(hdmiLayer,
@@ -1002,7 +830,8 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                                 srcYAddr, srcCbAddr,
                                 dstX, dstY,
                                 mHdmiDstWidth, mHdmiDstHeight,
-                                mG2DUIRotVal) < 0)
+                                mG2DUIRotVal,
+                                damage) < 0)
                     return false;
 #endif
             }
@@ -1013,6 +842,13 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
         }
     }
 
+#if defined(BOARD_USE_V4L2)
+    if (hdmi_g2d_wait() < 0) {
+        ALOGE("%s::hdmi_g2d_wait() fail", __func__);
+        return false;
+    }
+#endif
+
     if (mFlagConnected) {
 #if defined(BOARD_USE_V4L2)
         unsigned int num_of_plane;
@@ -1273,6 +1109,64 @@ bool SecHdmi::setDisplaySize(int width, int height)
     return true;
 }
 
+#if defined(BOARD_USE_V4L2_ION)
+bool SecHdmi::m_getFramebufferPhys(unsigned long *fbPhys)
+{
+    struct fb_fix_screeninfo fix;
+
+    if (ioctl(mDefaultFBFd, FBIOGET_FSCREENINFO, &fix) < 0) {
+        ALOGE("%s:ioctl(FBIOGET_FSCREENINFO) fail", __func__);
+        return false;
+    }
+
+    *fbPhys = fix.smem_start;
+    return true;
+}
+
+bool SecHdmi::m_mapFramebuffer(unsigned int fbSize, unsigned long fbPhys)
+{
+    struct s3c_fb_user_ion_client ion_handle;
+    void *virFBAddr = NULL;
+
+    m_unmapFramebuffer();
+
+    // get framebuffer ion handle for LCD
+    if (ioctl(mDefaultFBFd, S3CFB_GET_ION_USER_HANDLE, &ion_handle) < 0) {
+        ALOGE("%s:ioctl(S3CFB_GET_ION_USER_HANDLE) fail", __func__);
+        return false;
+    }
+
+    // the framebuffer is double buffered, so map both halves at once
+    virFBAddr = ion_map(ion_handle.fd, ALIGN(fbSize * 2, PAGE_SIZE), 0);
+    if (virFBAddr == MAP_FAILED) {
+        ALOGE("%s::ion_map fail", __func__);
+        ion_free(ion_handle.fd);
+        return false;
+    }
+
+    mFBaddr = virFBAddr;
+    mFBsize = fbSize;
+    mFBionfd = ion_handle.fd;
+    mFBphys = fbPhys;
+
+    return true;
+}
+
+void SecHdmi::m_unmapFramebuffer(void)
+{
+    if (mFBaddr != NULL)
+        ion_unmap((void *)mFBaddr, ALIGN(mFBsize * 2, PAGE_SIZE));
+
+    if (mFBionfd > 0)
+        ion_free(mFBionfd);
+
+    mFBaddr = NULL;
+    mFBionfd = -1;
+    mFBsize = 0;
+    mFBphys = 0;
+}
+#endif
+
 bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer)
 {
 #ifdef DEBUG_MSG_ENABLE
@@ -1461,7 +1355,7 @@ bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer
 #if defined(BOARD_USES_CEC)
         if (mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
             mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI) {
-            if (mCECThread->mFlagRunning)
+            if (mCECThread->isActive())
                 mCECThread->stop();
         }
 #endif
@@ -1513,7 +1407,7 @@ bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer
         if (mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
             mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI) {
 #if defined(BOARD_USES_CEC)
-            if (!(mCECThread->mFlagRunning))
+            if (!(mCECThread->isActive()))
                 mCECThread->start();
 #endif
 
@@ -1550,6 +1444,7 @@ bool SecHdmi::m_startHdmi(int hdmiLayer, unsigned int num_of_plane)
 
         if (mFlagHdmiStart[hdmiLayer] == false) {
             index = 0;
+            hdmi_trace_stamp(HDMI_TRACE_QBUF);
             if (tvout_std_v4l2_qbuf(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR,
                                     index, num_of_plane, &mMixerBuffer[hdmiLayer][0]) < 0) {
                 ALOGE("%s::tvout_std_v4l2_qbuf(index : %d) (mSrcBufNum : %d) failed", __func__, index, HDMI_NUM_MIXER_BUF);
@@ -1564,6 +1459,7 @@ bool SecHdmi::m_startHdmi(int hdmiLayer, unsigned int num_of_plane)
 
             mFlagHdmiStart[hdmiLayer] = true;
         } else {
+            hdmi_trace_stamp(HDMI_TRACE_QBUF);
             if (tvout_std_v4l2_qbuf(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR,
                                     index, num_of_plane, &mMixerBuffer[hdmiLayer][0]) < 0) {
                 ALOGE("%s::tvout_std_v4l2_qbuf() failed", __func__);
@@ -1574,6 +1470,7 @@ bool SecHdmi::m_startHdmi(int hdmiLayer, unsigned int num_of_plane)
                 ALOGE("%s::tvout_std_v4l2_dqbuf() failed", __func__);
                 return false;
             }
+            hdmi_trace_stamp(HDMI_TRACE_DQBUF);
             index = buf_index;
         }
     }
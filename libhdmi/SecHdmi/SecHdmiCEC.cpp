@@ -0,0 +1,482 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+//#define LOG_TAG "libhdmi"
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../libsForhdmi/libedid/libedid.h"
+#include "SecHdmiCEC.h"
+
+//#define DEBUG_HDMI_HW_LEVEL
+
+namespace android {
+
+SecHdmiCEC::SecHdmiCEC()
+    :Thread(false),
+    mFlagRunning(false),
+    mDevtype(CEC_DEVICE_PLAYER),
+    mLaddr(0),
+    mPaddr(0),
+    mEpollFd(-1),
+    mEventFd(-1),
+    mRecord(NULL),
+    mTxHead(0),
+    mTxCount(0)
+{
+    for (int i = 0; i < CEC_OPCODE_MAX; i++)
+        mHandler[i] = NULL;
+    mHandler[CEC_OPCODE_GIVE_PHYSICAL_ADDRESS] = m_handleGivePhysicalAddress;
+    mHandler[CEC_OPCODE_REQUEST_ACTIVE_SOURCE] = m_handleRequestActiveSource;
+}
+
+SecHdmiCEC::~SecHdmiCEC()
+{
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("%s", __func__);
+#endif
+    m_closeEvent();
+    mFlagRunning = false;
+}
+
+bool SecHdmiCEC::threadLoop()
+{
+    struct epoll_event events[2];
+    bool hangup = false;
+    int num;
+
+    /* block until the CEC device or the eventfd is readable, or a NACKed frame is due */
+    num = epoll_wait(mEpollFd, events, 2, m_txTimeout());
+    if (num < 0) {
+        if (errno == EINTR)
+            return true;
+        ALOGE("%s::epoll_wait() fail(%d)", __func__, errno);
+        mFlagRunning = false;
+        return false;
+    }
+
+    {
+        Mutex::Autolock lock(mThreadLoopLock);
+
+        for (int i = 0; i < num; i++) {
+            if (events[i].data.fd == mEventFd) {
+                uint64_t count;
+                read(mEventFd, &count, sizeof(count));
+                continue;
+            }
+
+            /* drain what arrived before the error, then give up the device */
+            if (events[i].events & EPOLLIN)
+                m_receive();
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                hangup = true;
+        }
+
+        if (hangup) {
+            ALOGE("%s::CEC device error/hangup, stop CEC thread", __func__);
+            mFlagRunning = false;
+            return false;
+        }
+
+        if (exitPending())
+            return false;
+
+        m_flushTxQueue();
+    }
+    return true;
+}
+
+void SecHdmiCEC::m_receive(void)
+{
+    unsigned char buffer[CEC_MAX_FRAME_SIZE];
+    int size;
+    unsigned char lsrc, opcode;
+
+    size = read(CECGetFd(), buffer, CEC_MAX_FRAME_SIZE);
+
+    if (size <= 0) // no data available
+        return;
+
+    m_record("rx", buffer, size);
+
+    if (size == 1)
+        return; // "Polling Message"
+
+    lsrc = buffer[0] >> 4;
+
+    /* ignore messages with src address == mLaddr*/
+    if (lsrc == mLaddr)
+        return;
+
+    opcode = buffer[1];
+
+    if (CECIgnoreMessage(opcode, lsrc)) {
+        ALOGE("### ignore message coming from address 15 (unregistered)\n");
+        return;
+    }
+
+    if (!CECCheckMessageSize(opcode, size)) {
+        ALOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
+        return;
+    }
+
+    /* check if message broadcasted/directly addressed */
+    if (!CECCheckMessageMode(opcode, (buffer[0] & 0x0F) == CEC_MSG_BROADCAST ? 1 : 0)) {
+        ALOGE("### invalid message mode (directly addressed/broadcast) ###\n");
+        return;
+    }
+
+    if (mHandler[opcode] != NULL && mHandler[opcode](this, lsrc, buffer, size) == true)
+        return;
+
+    /* send "Feature Abort" */
+    buffer[0] = (mLaddr << 4) | lsrc;
+    buffer[1] = CEC_OPCODE_FEATURE_ABORT;
+    buffer[2] = CEC_OPCODE_ABORT;
+    buffer[3] = 0x04; // "refused"
+    if (queueMessage(buffer, 4) == false)
+        ALOGE("%s::queueMessage(Feature Abort) fail", __func__);
+}
+
+void SecHdmiCEC::m_flushTxQueue(void)
+{
+    Mutex::Autolock lock(mTxLock);
+
+    while (mTxCount > 0) {
+        CECTxFrame *frame = &mTxQueue[mTxHead];
+
+        if (systemTime() < frame->when)
+            break;
+
+        if (CECSendMessage(frame->buffer, frame->size) != frame->size) {
+            if (frame->retry < CEC_TX_MAX_RETRY) {
+                /* NACKed or bus busy, back off and keep the frame at the head */
+                frame->when = systemTime() + ms2ns(CEC_TX_RETRY_DELAY_MS << frame->retry);
+                frame->retry++;
+                break;
+            }
+            ALOGE("CECSendMessage(opcode: 0x%x) failed after %d retries!!!\n",
+                    frame->size > 1 ? frame->buffer[1] : 0, frame->retry);
+        } else {
+            m_record("tx", frame->buffer, frame->size);
+        }
+
+        mTxHead = (mTxHead + 1) % CEC_TX_QUEUE_SIZE;
+        mTxCount--;
+    }
+}
+
+int SecHdmiCEC::m_txTimeout(void)
+{
+    Mutex::Autolock lock(mTxLock);
+
+    /* nothing to send: sleep until the device or the eventfd wakes us up */
+    if (mTxCount == 0)
+        return -1;
+
+    nsecs_t delay = mTxQueue[mTxHead].when - systemTime();
+    if (delay <= 0)
+        return 0;
+
+    return (int)ns2ms(delay) + 1;
+}
+
+bool SecHdmiCEC::m_wakeUp(void)
+{
+    uint64_t count = 1;
+
+    if (mEventFd < 0)
+        return false;
+
+    if (write(mEventFd, &count, sizeof(count)) != sizeof(count)) {
+        ALOGE("%s::write(eventfd) fail(%d)", __func__, errno);
+        return false;
+    }
+    return true;
+}
+
+bool SecHdmiCEC::m_join(void)
+{
+    /* also reaps a thread that already left threadLoop() on a device hangup */
+    requestExit();
+    m_wakeUp();
+    if (requestExitAndWait() == WOULD_BLOCK) {
+        ALOGE("%s::requestExitAndWait() == WOULD_BLOCK", __func__);
+        return false;
+    }
+    return true;
+}
+
+void SecHdmiCEC::setHandler(unsigned char opcode, CECOpcodeHandler handler)
+{
+    Mutex::Autolock lock(mThreadLoopLock);
+    mHandler[opcode] = handler;
+}
+
+bool SecHdmiCEC::queueMessage(unsigned char *buffer, int size)
+{
+    if (size <= 0 || size > CEC_MAX_FRAME_SIZE) {
+        ALOGE("%s::invalid message size(%d)", __func__, size);
+        return false;
+    }
+
+    {
+        Mutex::Autolock lock(mTxLock);
+
+        if (mTxCount >= CEC_TX_QUEUE_SIZE) {
+            ALOGE("%s::tx queue full, drop message(opcode: 0x%x)", __func__,
+                    size > 1 ? buffer[1] : 0);
+            return false;
+        }
+
+        CECTxFrame *frame = &mTxQueue[(mTxHead + mTxCount) % CEC_TX_QUEUE_SIZE];
+        memcpy(frame->buffer, buffer, size);
+        frame->size = size;
+        frame->retry = 0;
+        frame->when = 0;
+        mTxCount++;
+    }
+
+    /* the CEC thread itself flushes the queue at the end of threadLoop() */
+    if (getTid() != gettid())
+        m_wakeUp();
+
+    return true;
+}
+
+bool SecHdmiCEC::m_handleGivePhysicalAddress(SecHdmiCEC *cec, unsigned char lsrc,
+                                             unsigned char *buffer, int size)
+{
+    /* responce with "Report Physical Address" */
+    buffer[0] = (cec->mLaddr << 4) | CEC_MSG_BROADCAST;
+    buffer[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
+    buffer[2] = (cec->mPaddr >> 8) & 0xFF;
+    buffer[3] = cec->mPaddr & 0xFF;
+    buffer[4] = cec->mDevtype;
+
+    return cec->queueMessage(buffer, 5);
+}
+
+bool SecHdmiCEC::m_handleRequestActiveSource(SecHdmiCEC *cec, unsigned char lsrc,
+                                             unsigned char *buffer, int size)
+{
+    ALOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
+    /* responce with "Active Source" */
+    buffer[0] = (cec->mLaddr << 4) | CEC_MSG_BROADCAST;
+    buffer[1] = CEC_OPCODE_ACTIVE_SOURCE;
+    buffer[2] = (cec->mPaddr >> 8) & 0xFF;
+    buffer[3] = cec->mPaddr & 0xFF;
+    ALOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
+
+    return cec->queueMessage(buffer, 4);
+}
+
+void SecHdmiCEC::m_closeEvent(void)
+{
+    if (0 <= mEpollFd) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
+    if (0 <= mEventFd) {
+        close(mEventFd);
+        mEventFd = -1;
+    }
+
+    if (mRecord != NULL) {
+        fclose(mRecord);
+        mRecord = NULL;
+    }
+}
+
+void SecHdmiCEC::m_openRecord(void)
+{
+    char path[PROPERTY_VALUE_MAX];
+
+    if (property_get(CEC_RECORD_PROPERTY, path, NULL) <= 0)
+        return;
+
+    mRecord = fopen(path, "w");
+    if (mRecord == NULL) {
+        ALOGE("%s::fopen(%s) fail(%d)", __func__, path, errno);
+        return;
+    }
+
+    fprintf(mRecord, "laddr %d paddr %04x devtype %d\n", mLaddr, mPaddr, mDevtype);
+}
+
+void SecHdmiCEC::m_record(const char *dir, unsigned char *buffer, int size)
+{
+    if (mRecord == NULL)
+        return;
+
+    fputs(dir, mRecord);
+    for (int i = 0; i < size; i++)
+        fprintf(mRecord, " %02x", buffer[i]);
+    fputc('\n', mRecord);
+    fflush(mRecord);
+}
+
+bool SecHdmiCEC::m_run(void)
+{
+    mEventFd = eventfd(0, 0);
+    mEpollFd = epoll_create(2);
+    if (mEventFd < 0 || mEpollFd < 0) {
+        ALOGE("%s::eventfd/epoll_create fail(%d)", __func__, errno);
+        goto RUN_FAIL;
+    }
+
+    {
+        struct epoll_event event;
+
+        /* EPOLLERR and EPOLLHUP are always reported, threadLoop() exits on them */
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = CECGetFd();
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, event.data.fd, &event) < 0) {
+            ALOGE("%s::epoll_ctl(CEC) fail(%d)", __func__, errno);
+            goto RUN_FAIL;
+        }
+
+        event.data.fd = mEventFd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, event.data.fd, &event) < 0) {
+            ALOGE("%s::epoll_ctl(eventfd) fail(%d)", __func__, errno);
+            goto RUN_FAIL;
+        }
+    }
+
+    mTxHead = 0;
+    mTxCount = 0;
+    m_openRecord();
+
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("request to run SecHdmiCEC");
+#endif
+
+    mFlagRunning = true;
+    if (run("SecHdmiCEC", PRIORITY_DISPLAY) != NO_ERROR) {
+        ALOGE("%s fail to run thread", __func__);
+        mFlagRunning = false;
+        goto RUN_FAIL;
+    }
+    return true;
+
+RUN_FAIL :
+    m_closeEvent();
+    return false;
+}
+
+bool SecHdmiCEC::start()
+{
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("%s", __func__);
+#endif
+
+    Mutex::Autolock lock(mThreadControlLock);
+    if (m_join() == false)
+        return false;
+    m_closeEvent();
+
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("EDIDGetCECPhysicalAddress");
+#endif
+    /* set to not valid physical address */
+    mPaddr = CEC_NOT_VALID_PHYSICAL_ADDRESS;
+
+    if (!EDIDGetCECPhysicalAddress(&mPaddr)) {
+        ALOGE("Error: EDIDGetCECPhysicalAddress() failed.\n");
+        return false;
+    }
+
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("CECOpen");
+#endif
+    if (!CECOpen()) {
+        ALOGE("CECOpen() failed!!!\n");
+        return false;
+    }
+
+    /* a logical address should only be allocated when a device \
+       has a valid physical address, at all other times a device \
+       should take the 'Unregistered' logical address (15)
+       */
+
+    /* if physical address is not valid device should take \
+       the 'Unregistered' logical address (15)
+       */
+
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("CECAllocLogicalAddress");
+#endif
+    mLaddr = CECAllocLogicalAddress(mPaddr, mDevtype);
+
+    if (!mLaddr) {
+        ALOGE("CECAllocLogicalAddress() failed!!!\n");
+        if (!CECClose())
+            ALOGE("CECClose() failed!\n");
+        return false;
+    }
+
+    if (m_run() == false) {
+        if (!CECClose())
+            ALOGE("CECClose() failed!\n");
+        return false;
+    }
+    return true;
+}
+
+bool SecHdmiCEC::start(int laddr, int paddr)
+{
+    Mutex::Autolock lock(mThreadControlLock);
+    if (m_join() == false)
+        return false;
+    m_closeEvent();
+
+    if (CECGetFd() < 0) {
+        ALOGE("%s::CEC device is not opened", __func__);
+        return false;
+    }
+
+    mLaddr = laddr;
+    mPaddr = paddr;
+    return m_run();
+}
+
+bool SecHdmiCEC::stop()
+{
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("%s request Exit", __func__);
+#endif
+    Mutex::Autolock lock(mThreadControlLock);
+    if (m_join() == false)
+        return false;
+
+    m_closeEvent();
+
+    if (!CECClose())
+        ALOGE("CECClose() failed!\n");
+
+    mFlagRunning = false;
+    return true;
+}
+
+}; // namespace android
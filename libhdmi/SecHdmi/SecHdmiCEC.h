@@ -0,0 +1,119 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SEC_HDMI_CEC_H__
+#define __SEC_HDMI_CEC_H__
+
+#include <stdio.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+#include "../libsForhdmi/libcec/libcec.h"
+
+namespace android {
+
+#define CEC_OPCODE_MAX              (256)
+#define CEC_TX_QUEUE_SIZE           (8)
+#define CEC_TX_MAX_RETRY            (3)
+#define CEC_TX_RETRY_DELAY_MS       (10)    //doubled on every retry of a NACKed frame
+
+/*
+ * Path of the rx/tx frame log written while the property is set, one
+ * "laddr L paddr PPPP devtype D" header and then one "rx xx xx ..." or
+ * "tx xx xx ..." line per frame, the format read by test/cec_replay.
+ */
+#define CEC_RECORD_PROPERTY         "debug.hdmi.cec.record"
+
+/*
+ * CEC message loop of the HDMI output.
+ *
+ * The thread blocks in epoll_wait on the libcec fd and an eventfd, incoming
+ * frames are dispatched through a per-opcode handler table and replies go
+ * through a bounded tx queue that retries NACKed frames. When the device
+ * reports an error or hangup the thread exits and isActive() turns false,
+ * the next start() opens the device again.
+ */
+class SecHdmiCEC: public Thread
+{
+public:
+    /*
+     * Opcode handler. Returns false when the message is not handled,
+     * in which case "Feature Abort" is sent back to the initiator.
+     */
+    typedef bool (*CECOpcodeHandler)(SecHdmiCEC *cec, unsigned char lsrc,
+                                     unsigned char *buffer, int size);
+
+private:
+    struct CECTxFrame {
+        unsigned char   buffer[CEC_MAX_FRAME_SIZE];
+        int             size;
+        int             retry;
+        nsecs_t         when;
+    };
+
+    volatile bool       mFlagRunning;
+    Mutex               mThreadLoopLock;
+    Mutex               mThreadControlLock;
+    Mutex               mTxLock;
+    virtual bool        threadLoop();
+    enum CECDeviceType  mDevtype;
+    int                 mLaddr;
+    int                 mPaddr;
+    int                 mEpollFd;
+    int                 mEventFd;
+    FILE               *mRecord;
+    CECOpcodeHandler    mHandler[CEC_OPCODE_MAX];
+    CECTxFrame          mTxQueue[CEC_TX_QUEUE_SIZE];
+    int                 mTxHead;
+    int                 mTxCount;
+
+    void                m_receive(void);
+    void                m_flushTxQueue(void);
+    int                 m_txTimeout(void);
+    bool                m_wakeUp(void);
+    bool                m_join(void);
+    bool                m_run(void);
+    void                m_closeEvent(void);
+    void                m_openRecord(void);
+    void                m_record(const char *dir, unsigned char *buffer, int size);
+
+    static bool         m_handleGivePhysicalAddress(SecHdmiCEC *cec, unsigned char lsrc,
+                                                    unsigned char *buffer, int size);
+    static bool         m_handleRequestActiveSource(SecHdmiCEC *cec, unsigned char lsrc,
+                                                    unsigned char *buffer, int size);
+
+public:
+    SecHdmiCEC();
+    virtual ~SecHdmiCEC();
+
+    /* read the physical address from EDID, open /dev/CEC and allocate a logical address */
+    bool start();
+    /* run on the device already given to libcec (CECOpen/CECOpenFd) with fixed addresses */
+    bool start(int laddr, int paddr);
+    bool stop();
+
+    void setHandler(unsigned char opcode, CECOpcodeHandler handler);
+    bool queueMessage(unsigned char *buffer, int size);
+
+    inline bool isActive(void) { return mFlagRunning; }
+    inline int logicalAddress(void) { return mLaddr; }
+    inline int physicalAddress(void) { return mPaddr; }
+    inline enum CECDeviceType deviceType(void) { return mDevtype; }
+};
+
+}; // namespace android
+
+#endif /* __SEC_HDMI_CEC_H__ */
@@ -52,6 +52,9 @@
 #define HDMI_G2D_OUTPUT_BUF_NUM     (2)
 #define HDMI_FIMC_BUFFER_BPP_SIZE   (1.5)   //NV12 Tiled is 1.5 bytes, RGB565 is 2, RGB888 is 4, Default is NV12 Tiled
 #define HDMI_G2D_BUFFER_BPP_SIZE    (4)     //NV12 Tiled is 1.5 bytes, RGB565 is 2, RGB888 is 4
+#define HDMI_G2D_FILTER_MARGIN      (1)     //source pixels read around a damaged area by bilinear scaling
+#define HDMI_G2D_DAMAGE_MAX_STEP    (64)    //coarser src/dst pixel grid than this re-scales the whole line
+#define HDMI_G2D_FENCE_TIMEOUT      (1000)  //ms to wait for a queued G2D blit before the mixer takes its buffer
 #define HDMI_FB_BPP_SIZE            (4)     //ARGB888 is 4
 #define SUPPORT_1080P_FIMC_OUT
 #define HDMI_MAX_WIDTH              (1920)
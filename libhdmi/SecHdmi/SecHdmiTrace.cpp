@@ -0,0 +1,212 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+//#define LOG_TAG "libhdmi"
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "SecHdmiTrace.h"
+
+namespace android {
+
+struct hdmi_trace_frame {
+    volatile int32_t seq;
+    nsecs_t          stamp[HDMI_TRACE_STAGE_MAX];
+};
+
+static struct hdmi_trace_frame trace_ring[HDMI_TRACE_RING_SIZE];
+static volatile int32_t        trace_next_frame = 0;
+
+/* the frame being stamped is per thread, video and UI are flushed from different threads */
+static pthread_key_t           trace_cur_frame;
+static pthread_once_t          trace_once = PTHREAD_ONCE_INIT;
+
+static const char *trace_stage_name[HDMI_TRACE_STAGE_MAX] = {
+    "hwc_set",
+    "blit2Hdmi",
+    "dequeue",
+    "fb_lookup",
+    "fb_mapped",
+    "fimc_start",
+    "fimc_end",
+    "g2d_start",
+    "g2d_end",
+    "qbuf",
+    "dqbuf",
+};
+
+/* upper bounds of the histogram buckets in us, the last bucket is open */
+static const nsecs_t trace_bucket_us[] = {
+    500, 1000, 2000, 4000, 8000, 16000, 33000,
+};
+#define HDMI_TRACE_BUCKET_NUM   (sizeof(trace_bucket_us) / sizeof(trace_bucket_us[0]) + 1)
+
+static void trace_init(void)
+{
+    if (pthread_key_create(&trace_cur_frame, NULL) != 0)
+        ALOGE("%s::pthread_key_create() fail", __func__);
+}
+
+uint32_t hdmi_trace_begin(nsecs_t hwcSetTime)
+{
+    int32_t frame = android_atomic_inc(&trace_next_frame) + 1;
+    struct hdmi_trace_frame *slot;
+
+    /* 0 means "no frame", skip it when the counter wraps */
+    if (frame == 0)
+        frame = android_atomic_inc(&trace_next_frame) + 1;
+
+    slot = &trace_ring[(uint32_t)frame % HDMI_TRACE_RING_SIZE];
+
+    android_atomic_release_store(0, &slot->seq);
+    memset(slot->stamp, 0, sizeof(slot->stamp));
+    slot->stamp[HDMI_TRACE_HWC_SET]     = hwcSetTime;
+    slot->stamp[HDMI_TRACE_BLIT_2_HDMI] = systemTime();
+    android_atomic_release_store(frame, &slot->seq);
+
+    hdmi_trace_set_frame((uint32_t)frame);
+
+    return (uint32_t)frame;
+}
+
+void hdmi_trace_set_frame(uint32_t frame)
+{
+    pthread_once(&trace_once, trace_init);
+    pthread_setspecific(trace_cur_frame, (void *)(uintptr_t)frame);
+}
+
+void hdmi_trace_stamp(int stage)
+{
+    int32_t frame;
+    struct hdmi_trace_frame *slot;
+
+    pthread_once(&trace_once, trace_init);
+    frame = (int32_t)(uintptr_t)pthread_getspecific(trace_cur_frame);
+
+    if (frame == 0 || stage < 0 || HDMI_TRACE_STAGE_MAX <= stage)
+        return;
+
+    slot = &trace_ring[(uint32_t)frame % HDMI_TRACE_RING_SIZE];
+
+    /* the slot was recycled by a newer frame */
+    if (android_atomic_acquire_load(&slot->seq) != frame)
+        return;
+
+    slot->stamp[stage] = systemTime();
+}
+
+static int trace_compare(const void *a, const void *b)
+{
+    nsecs_t l = *(const nsecs_t *)a;
+    nsecs_t r = *(const nsecs_t *)b;
+
+    if (l < r)
+        return -1;
+    if (l > r)
+        return 1;
+    return 0;
+}
+
+static void trace_dump_stage(String8& result, const char *name, nsecs_t *delta, int count)
+{
+    unsigned int hist[HDMI_TRACE_BUCKET_NUM];
+    unsigned int i, j;
+
+    if (count == 0) {
+        result.appendFormat("  %-10s      0\n", name);
+        return;
+    }
+
+    qsort(delta, count, sizeof(nsecs_t), trace_compare);
+
+    memset(hist, 0, sizeof(hist));
+    for (i = 0; i < (unsigned int)count; i++) {
+        nsecs_t us = ns2us(delta[i]);
+
+        for (j = 0; j < HDMI_TRACE_BUCKET_NUM - 1; j++) {
+            if (us < trace_bucket_us[j])
+                break;
+        }
+        hist[j]++;
+    }
+
+    result.appendFormat("  %-10s %6d %8lld %8lld %8lld %8lld  ", name, count,
+            ns2us(delta[(count * 50) / 100]),
+            ns2us(delta[(count * 90) / 100]),
+            ns2us(delta[(count * 99) / 100]),
+            ns2us(delta[count - 1]));
+
+    for (j = 0; j < HDMI_TRACE_BUCKET_NUM; j++)
+        result.appendFormat("%s%u", (j == 0) ? "" : "/", hist[j]);
+    result.append("\n");
+}
+
+void hdmi_trace_dump(String8& result)
+{
+    nsecs_t delta[HDMI_TRACE_STAGE_MAX + 1][HDMI_TRACE_RING_SIZE];
+    int count[HDMI_TRACE_STAGE_MAX + 1];
+    struct hdmi_trace_frame frame;
+    int total = HDMI_TRACE_STAGE_MAX;
+
+    memset(count, 0, sizeof(count));
+
+    for (int i = 0; i < HDMI_TRACE_RING_SIZE; i++) {
+        int32_t seq = android_atomic_acquire_load(&trace_ring[i].seq);
+        if (seq == 0)
+            continue;
+
+        memcpy(frame.stamp, trace_ring[i].stamp, sizeof(frame.stamp));
+
+        /* overwritten while copying */
+        if (android_atomic_acquire_load(&trace_ring[i].seq) != seq)
+            continue;
+
+        /* each stage is measured from the closest earlier stage that was hit */
+        int prev = -1;
+        for (int s = 0; s < HDMI_TRACE_STAGE_MAX; s++) {
+            if (frame.stamp[s] == 0)
+                continue;
+
+            if (prev >= 0 && frame.stamp[s] >= frame.stamp[prev])
+                delta[s][count[s]++] = frame.stamp[s] - frame.stamp[prev];
+            prev = s;
+        }
+
+        int first = 0;
+        while (first < HDMI_TRACE_STAGE_MAX && frame.stamp[first] == 0)
+            first++;
+
+        if (prev > first && frame.stamp[prev] >= frame.stamp[first])
+            delta[total][count[total]++] = frame.stamp[prev] - frame.stamp[first];
+    }
+
+    result.appendFormat("HDMI latency trace (last %d frames, us from previous stage)\n",
+            HDMI_TRACE_RING_SIZE);
+    result.append("  stage       count      p50      p90      p99      max  "
+            "<0.5/<1/<2/<4/<8/<16/<33/>=33 ms\n");
+
+    for (int s = 1; s < HDMI_TRACE_STAGE_MAX; s++)
+        trace_dump_stage(result, trace_stage_name[s], delta[s], count[s]);
+    trace_dump_stage(result, "total", delta[total], count[total]);
+}
+
+}; // namespace android
@@ -0,0 +1,61 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SEC_HDMI_TRACE_H__
+#define __SEC_HDMI_TRACE_H__
+
+#include <stdint.h>
+#include <utils/Timers.h>
+#include <utils/String8.h>
+
+namespace android {
+
+/*
+ * Per-frame latency trace of the HDMI path.
+ *
+ * A frame is opened with hdmi_trace_begin() when the TV-out service receives
+ * it, every later stage is stamped with hdmi_trace_stamp() into the frame the
+ * calling thread last passed to hdmi_trace_begin() or hdmi_trace_set_frame(),
+ * so a frame handed over to the flush thread keeps its id. Frames live in a
+ * fixed ring that is written without locks, a frame recycled while it is
+ * dumped is dropped by the sequence check in hdmi_trace_dump().
+ */
+
+#define HDMI_TRACE_RING_SIZE    (256)
+
+enum hdmi_trace_stage {
+    HDMI_TRACE_HWC_SET = 0,
+    HDMI_TRACE_BLIT_2_HDMI,
+    HDMI_TRACE_DEQUEUE,
+    HDMI_TRACE_FB_LOOKUP,       /* UI mirror: framebuffer lookup starts */
+    HDMI_TRACE_FB_MAPPED,       /* UI mirror: framebuffer found and mapped */
+    HDMI_TRACE_FIMC_START,
+    HDMI_TRACE_FIMC_END,
+    HDMI_TRACE_G2D_START,
+    HDMI_TRACE_G2D_END,
+    HDMI_TRACE_QBUF,
+    HDMI_TRACE_DQBUF,
+    HDMI_TRACE_STAGE_MAX,
+};
+
+uint32_t hdmi_trace_begin(nsecs_t hwcSetTime);
+void     hdmi_trace_set_frame(uint32_t frame);
+void     hdmi_trace_stamp(int stage);
+void     hdmi_trace_dump(String8& result);
+
+}; // namespace android
+
+#endif /* __SEC_HDMI_TRACE_H__ */
@@ -50,6 +50,7 @@
 
 #include "SecHdmiCommon.h"
 #include "SecHdmiV4L2Utils.h"
+#include "SecHdmiTrace.h"
 
 namespace android {
 
@@ -1243,6 +1244,9 @@ int hdmi_deinit_layer(int layer)
                                   (((uint32_t) boundary)-1)) & \
                                   (~(((uint32_t) boundary)-1)))
 
+#define HDMI_MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define HDMI_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
 void hdmi_cal_rect(int src_w, int src_h, int dst_w, int dst_h, struct v4l2_rect *dst_rect)
 {
     if (dst_w * src_h <= dst_h * src_w) {
@@ -1258,6 +1262,204 @@ void hdmi_cal_rect(int src_w, int src_h, int dst_w, int dst_h, struct v4l2_rect
     }
 }
 
+#if defined(BOARD_USES_FIMGAPI)
+/*
+ * Every G2D output buffer remembers the source region that changed since it
+ * was last written, so that only this region is re-scaled into it.
+ */
+static struct v4l2_rect g2d_dirty_rect[HDMI_G2D_OUTPUT_BUF_NUM];
+static int g2d_dirty_geometry[6] = {0, 0, 0, 0, 0, 0};
+
+/* fence of the last blit queued to the G2D and not waited for yet */
+static struct fimg_fence g2d_fence = {NULL, 0};
+static int g2d_fence_pending = 0;
+
+static void hdmi_union_rect(struct v4l2_rect *dst, const struct v4l2_rect *src)
+{
+    int right, bottom;
+
+    if (src->width <= 0 || src->height <= 0)
+        return;
+
+    if (dst->width <= 0 || dst->height <= 0) {
+        *dst = *src;
+        return;
+    }
+
+    right  = HDMI_MAX(dst->left + (int)dst->width, src->left + (int)src->width);
+    bottom = HDMI_MAX(dst->top + (int)dst->height, src->top + (int)src->height);
+
+    dst->left   = HDMI_MIN(dst->left, src->left);
+    dst->top    = HDMI_MIN(dst->top, src->top);
+    dst->width  = right - dst->left;
+    dst->height = bottom - dst->top;
+}
+
+static int hdmi_gcd(int a, int b)
+{
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Snap [*start, *end) of the source to a grid where source and scaled pixel
+ * edges coincide and return the matching range of the scaled image.
+ * Falls back to the whole line when the grid is too coarse.
+ */
+static void hdmi_g2d_snap_range(int src_size, int scaled_size, int *start, int *end,
+        int *scaled_start, int *scaled_end)
+{
+    int g = hdmi_gcd(src_size, scaled_size);
+    int src_step = src_size / g;
+    int scaled_step = scaled_size / g;
+
+    if (HDMI_G2D_DAMAGE_MAX_STEP < src_step) {
+        *start = 0;
+        *end = src_size;
+    } else {
+        *start = (*start / src_step) * src_step;
+        *end = HDMI_MIN(((*end + src_step - 1) / src_step) * src_step, src_size);
+    }
+
+    *scaled_start = (*start / src_step) * scaled_step;
+    *scaled_end = (*end == src_size) ? scaled_size : (*end / src_step) * scaled_step;
+}
+
+/*
+ * Compute the source and destination rectangle which has to be re-scaled into
+ * the G2D output buffer buf_index. damage is the source region which changed
+ * since the previous frame, NULL means unknown and forces a full frame.
+ *
+ * return 0 when the buffer is already up to date, 1 otherwise.
+ */
+static int hdmi_g2d_get_dirty_rect(unsigned int buf_index,
+        int src_w, int src_h, int dst_w, int dst_h,
+        int rotVal, int dst_color_format,
+        struct v4l2_rect *damage,
+        struct v4l2_rect *src_rect, struct v4l2_rect *dst_rect)
+{
+    struct v4l2_rect full_rect;
+    int geometry[6] = {src_w, src_h, dst_w, dst_h, rotVal, dst_color_format};
+    int scaled_w, scaled_h;
+    int x0, x1, y0, y1;
+    int sx0, sx1, sy0, sy1;
+
+    full_rect.left   = 0;
+    full_rect.top    = 0;
+    full_rect.width  = src_w;
+    full_rect.height = src_h;
+
+    if (damage == NULL ||
+        memcmp(geometry, g2d_dirty_geometry, sizeof(geometry)) != 0) {
+        for (int i = 0; i < HDMI_G2D_OUTPUT_BUF_NUM; i++)
+            g2d_dirty_rect[i] = full_rect;
+        memcpy(g2d_dirty_geometry, geometry, sizeof(geometry));
+    } else if (0 < damage->width && 0 < damage->height) {
+        struct v4l2_rect expand_rect;
+
+        /* bilinear filtering reads the neighbouring source pixels too */
+        x0 = HDMI_MAX(damage->left - HDMI_G2D_FILTER_MARGIN, 0);
+        y0 = HDMI_MAX(damage->top - HDMI_G2D_FILTER_MARGIN, 0);
+        x1 = HDMI_MIN(damage->left + (int)damage->width + HDMI_G2D_FILTER_MARGIN, src_w);
+        y1 = HDMI_MIN(damage->top + (int)damage->height + HDMI_G2D_FILTER_MARGIN, src_h);
+
+        if (x0 < x1 && y0 < y1) {
+            expand_rect.left   = x0;
+            expand_rect.top    = y0;
+            expand_rect.width  = x1 - x0;
+            expand_rect.height = y1 - y0;
+
+            for (int i = 0; i < HDMI_G2D_OUTPUT_BUF_NUM; i++)
+                hdmi_union_rect(&g2d_dirty_rect[i], &expand_rect);
+        }
+    }
+
+    *src_rect = g2d_dirty_rect[buf_index];
+    memset(&g2d_dirty_rect[buf_index], 0, sizeof(struct v4l2_rect));
+
+    if (src_rect->width <= 0 || src_rect->height <= 0)
+        return 0;
+
+    if (rotVal == 0 || rotVal == 180) {
+        scaled_w = dst_w;
+        scaled_h = dst_h;
+    } else {
+        scaled_w = dst_h;
+        scaled_h = dst_w;
+    }
+
+    x0 = src_rect->left;
+    x1 = src_rect->left + src_rect->width;
+    y0 = src_rect->top;
+    y1 = src_rect->top + src_rect->height;
+
+    hdmi_g2d_snap_range(src_w, scaled_w, &x0, &x1, &sx0, &sx1);
+    hdmi_g2d_snap_range(src_h, scaled_h, &y0, &y1, &sy0, &sy1);
+
+    src_rect->left   = x0;
+    src_rect->top    = y0;
+    src_rect->width  = x1 - x0;
+    src_rect->height = y1 - y0;
+
+    /* rotate the scaled rectangle (clockwise) into the destination */
+    switch (rotVal) {
+    case 90:
+        dst_rect->left = dst_w - sy1;
+        dst_rect->top  = sx0;
+        break;
+    case 180:
+        dst_rect->left = dst_w - sx1;
+        dst_rect->top  = dst_h - sy1;
+        break;
+    case 270:
+        dst_rect->left = sy0;
+        dst_rect->top  = dst_h - sx1;
+        break;
+    case 0:
+    default:
+        dst_rect->left = sx0;
+        dst_rect->top  = sy0;
+        break;
+    }
+
+    if (rotVal == 0 || rotVal == 180) {
+        dst_rect->width  = sx1 - sx0;
+        dst_rect->height = sy1 - sy0;
+    } else {
+        dst_rect->width  = sy1 - sy0;
+        dst_rect->height = sx1 - sx0;
+    }
+
+    return 1;
+}
+#endif
+
+/*
+ * G2D blits are queued asynchronously, the mixer must not read a G2D output
+ * buffer before the blit writing it is done.
+ */
+int hdmi_g2d_wait(void)
+{
+#if defined(BOARD_USES_FIMGAPI)
+    if (g2d_fence_pending == 0)
+        return 0;
+
+    g2d_fence_pending = 0;
+
+    if (waitFimgApi(&g2d_fence, HDMI_G2D_FENCE_TIMEOUT) < 0) {
+        ALOGE("%s::waitFimgApi(%d) fail", __func__, g2d_fence.seqNo);
+        return -1;
+    }
+    hdmi_trace_stamp(HDMI_TRACE_G2D_END);
+#endif
+
+    return 0;
+}
+
 #if defined(BOARD_USE_V4L2)
 int hdmi_get_src_plane(int srcColorFormat, unsigned int *num_of_plane)
 {
@@ -1441,7 +1643,8 @@ int hdmi_set_g_scaling(int layer,
         int src_w, int src_h,
         unsigned int src_address, SecBuffer * dstBuffer,
         int dst_x, int dst_y, int dst_w, int dst_h,
-        int rotVal, unsigned int hwc_layer)
+        int rotVal, unsigned int hwc_layer,
+        struct v4l2_rect *damage)
 {
 #if defined(BOARD_USES_FIMGAPI)
     int             dst_color_format;
@@ -1461,6 +1664,9 @@ int hdmi_set_g_scaling(int layer,
     fimg2d_clip dstClip;
     fimg2d_scale Scaling;
 
+    struct v4l2_rect src_dirty;
+    struct v4l2_rect dst_dirty;
+
     switch (g_preset_id) {
     case V4L2_DV_1080P60:
     case V4L2_DV_1080P30:
@@ -1484,9 +1690,17 @@ int hdmi_set_g_scaling(int layer,
 
     static unsigned int prev_src_addr = 0;
 
-    if ((cur_g2d_address == 0) || (src_address != prev_src_addr)) {
+    /*
+     * known damage says what changed even when the UI is single buffered,
+     * only without it a new source address is the sign of a new frame
+     */
+    if ((cur_g2d_address == 0) || (damage != NULL) || (src_address != prev_src_addr)) {
         dst_addr = (unsigned char *)g2d_reserved_memory[g2d_buf_index];
 
+        int need_blit = hdmi_g2d_get_dirty_rect(g2d_buf_index,
+                src_w, src_h, dst_w, dst_h, rotVal, dst_color_format,
+                damage, &src_dirty, &dst_dirty);
+
         g2d_buf_index++;
         if (g2d_buf_index >= HDMI_G2D_OUTPUT_BUF_NUM)
             g2d_buf_index = 0;
@@ -1496,11 +1710,13 @@ int hdmi_set_g_scaling(int layer,
 
         srcAddr = {(addr_space)ADDR_USER, (unsigned long)src_address, src_w * src_h * 4, 1, 0};
         srcImage = {srcAddr, srcAddr, src_w, src_h, src_w*4, AX_RGB, CF_ARGB_8888};
-        srcRect = {0, 0, src_w, src_h};
+        srcRect = {src_dirty.left, src_dirty.top,
+                   src_dirty.left + src_dirty.width, src_dirty.top + src_dirty.height};
 
         dstAddr = {(addr_space)ADDR_USER, (unsigned long)dst_addr, dst_w * dst_h * dst_bpp, 1, 0};
         dstImage = {dstAddr, dstAddr, dst_w, dst_h, dst_w*dst_bpp, AX_RGB, (color_format)dst_color_format};
-        dstRect = {0, 0, dst_w, dst_h};
+        dstRect = {dst_dirty.left, dst_dirty.top,
+                   dst_dirty.left + dst_dirty.width, dst_dirty.top + dst_dirty.height};
         dstClip = {0, 0, 0, dst_w, dst_h};
 
         if (rotVal == 0 || rotVal == 180)
@@ -1529,9 +1745,13 @@ int hdmi_set_g_scaling(int layer,
 
         BlitParam = {BLIT_OP_SRC, NON_PREMULTIPLIED, 0xff, 0, g2d_rotation, &Scaling, 0, 0, &dstClip, 0, &srcImage, &dstImage, NULL, &srcRect, &dstRect, NULL, 0};
 
-        if (stretchFimgApi(&BlitParam) < 0) {
-            ALOGE("%s::stretchFimgApi() fail", __func__);
-            return -1;
+        if (need_blit) {
+            hdmi_trace_stamp(HDMI_TRACE_G2D_START);
+            if (stretchFimgApiAsync(&BlitParam, &g2d_fence) < 0) {
+                ALOGE("%s::stretchFimgApiAsync() fail", __func__);
+                return -1;
+            }
+            g2d_fence_pending = 1;
         }
 
 #ifdef DEBUG_MSG_ENABLE
@@ -1619,7 +1839,8 @@ int hdmi_gl_set_param(int layer,
         int src_w, int src_h,
         unsigned int src_y_address, unsigned int src_c_address,
         int dst_x, int dst_y, int dst_w, int dst_h,
-        int rotVal)
+        int rotVal,
+        struct v4l2_rect *damage)
 {
 #if defined(BOARD_USES_FIMGAPI)
     int             dst_color_format;
@@ -1639,6 +1860,9 @@ int hdmi_gl_set_param(int layer,
     fimg2d_clip dstClip;
     fimg2d_scale Scaling;
 
+    struct v4l2_rect src_dirty;
+    struct v4l2_rect dst_dirty;
+
     struct fb_var_screeninfo var;
     struct s5ptvfb_user_window window;
 
@@ -1676,9 +1900,17 @@ int hdmi_gl_set_param(int layer,
 
     static unsigned int prev_src_addr = 0;
 
-    if ((cur_g2d_address == 0) || (src_y_address != prev_src_addr)) {
+    /*
+     * known damage says what changed even when the UI is single buffered,
+     * only without it a new source address is the sign of a new frame
+     */
+    if ((cur_g2d_address == 0) || (damage != NULL) || (src_y_address != prev_src_addr)) {
         dst_addr = (unsigned char *)g2d_reserved_memory[g2d_buf_index];
 
+        int need_blit = hdmi_g2d_get_dirty_rect(g2d_buf_index,
+                src_w, src_h, dst_w, dst_h, rotVal, dst_color_format,
+                damage, &src_dirty, &dst_dirty);
+
         g2d_buf_index++;
         if (g2d_buf_index >= HDMI_G2D_OUTPUT_BUF_NUM)
             g2d_buf_index = 0;
@@ -1688,11 +1920,13 @@ int hdmi_gl_set_param(int layer,
 
         srcAddr = {(addr_space)ADDR_PHYS, (unsigned long)src_y_address, src_w*src_h*4, 1, 0};
         srcImage = {srcAddr, srcAddr, src_w, src_h, src_w*4, AX_RGB, CF_ARGB_8888};
-        srcRect = {0, 0, src_w, src_h};
+        srcRect = {src_dirty.left, src_dirty.top,
+                   src_dirty.left + src_dirty.width, src_dirty.top + src_dirty.height};
 
         dstAddr = {(addr_space)ADDR_PHYS, (unsigned long)dst_addr, dst_w*dst_h*dst_bpp, 1, 0};
         dstImage = {dstAddr, dstAddr, dst_w, dst_h, dst_w*dst_bpp, AX_RGB, (color_format)dst_color_format};
-        dstRect = {0, 0, dst_w, dst_h};
+        dstRect = {dst_dirty.left, dst_dirty.top,
+                   dst_dirty.left + dst_dirty.width, dst_dirty.top + dst_dirty.height};
         dstClip = {0, 0, 0, dst_w, dst_h};
 
         if (rotVal == 0 || rotVal == 180)
@@ -1721,9 +1955,13 @@ int hdmi_gl_set_param(int layer,
 
         BlitParam = {BLIT_OP_SRC, NON_PREMULTIPLIED, 0xff, 0, g2d_rotation, &Scaling, 0, 0, &dstClip, 0, &srcImage, &dstImage, NULL, &srcRect, &dstRect, NULL, 0};
 
-        if (stretchFimgApi(&BlitParam) < 0) {
-            ALOGE("%s::stretchFimgApi() fail", __func__);
-            return -1;
+        if (need_blit) {
+            hdmi_trace_stamp(HDMI_TRACE_G2D_START);
+            if (stretchFimgApiAsync(&BlitParam, &g2d_fence) < 0) {
+                ALOGE("%s::stretchFimgApiAsync() fail", __func__);
+                return -1;
+            }
+            g2d_fence_pending = 1;
         }
 
         var.xres = dst_w;
@@ -1740,6 +1978,9 @@ int hdmi_gl_set_param(int layer,
         window.x = dst_x;
         window.y = dst_y;
 
+        if (hdmi_g2d_wait() < 0)
+            return -1;
+
         tvout_v4l2_s_baseaddr(fp_tvout_g, (void *)dst_addr);
         put_vscreeninfo(fp_tvout_g, &var);
 
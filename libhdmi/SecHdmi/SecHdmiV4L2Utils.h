@@ -90,7 +90,8 @@ int hdmi_set_g_scaling(int layer,
         int src_w, int src_h,
         unsigned int src_address, SecBuffer * dstBuffer,
         int dst_x, int dst_y, int dst_w, int dst_h,
-        int rotVal, unsigned int hwc_layer);
+        int rotVal, unsigned int hwc_layer,
+        struct v4l2_rect *damage);
 #else
 int hdmi_set_v_param(int layer,
         int src_w, int src_h, int colorFormat,
@@ -101,9 +102,11 @@ int hdmi_gl_set_param(int layer,
         int src_w, int src_h,
         unsigned int src_y_address, unsigned int src_c_address,
         int dst_x, int dst_y, int dst_w, int dst_h,
-        int rotVal);
+        int rotVal,
+        struct v4l2_rect *damage);
 #endif
 void hdmi_cal_rect(int src_w, int src_h, int dst_w, int dst_h, struct v4l2_rect *dst_rect);
+int hdmi_g2d_wait(void);
 #if defined(BOARD_USE_V4L2)
 int hdmi_get_src_plane(int srcColorFormat, unsigned int *num_of_plane);
 #endif
@@ -0,0 +1,245 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a CEC session against SecHdmiCEC over a socketpair standing in
+ * for /dev/CEC.
+ *
+ *   cec_replay [file]
+ *
+ * The file is a log recorded with "setprop debug.hdmi.cec.record <path>",
+ * without one a built-in session is replayed. "rx" frames are written to
+ * the thread, every "tx" frame must be sent back by it byte for byte within
+ * CEC_REPLAY_TIMEOUT_MS. Afterwards the thread must stay asleep while the
+ * bus is idle and must exit when the device hangs up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "SecHdmiCEC.h"
+
+using namespace android;
+
+#define CEC_REPLAY_TIMEOUT_MS   (1000)
+#define CEC_REPLAY_IDLE_MS      (500)
+
+static const char *default_session[] = {
+    "laddr 4 paddr 1000 devtype 3",
+    /* TV asks for our physical address */
+    "rx 04 83",
+    "tx 4f 84 10 00 03",
+    /* TV asks for the active source */
+    "rx 0f 85",
+    "tx 4f 82 10 00",
+    /* "Give OSD Name" is not handled: Feature Abort, refused */
+    "rx 04 46",
+    "tx 40 00 ff 04",
+    /* own frames and polling messages are ignored */
+    "rx 44",
+    "rx 4f 85",
+    "rx 04 83",
+    "tx 4f 84 10 00 03",
+    NULL,
+};
+
+static int parse_frame(const char *line, unsigned char *buffer)
+{
+    int size = 0;
+    char *end;
+
+    while (size < CEC_MAX_FRAME_SIZE) {
+        long byte = strtol(line, &end, 16);
+        if (end == line)
+            break;
+        buffer[size++] = (unsigned char)byte;
+        line = end;
+    }
+    return size;
+}
+
+static void print_frame(const char *prefix, unsigned char *buffer, int size)
+{
+    printf("%s", prefix);
+    for (int i = 0; i < size; i++)
+        printf(" %02x", buffer[i]);
+    printf("\n");
+}
+
+static long thread_switches(pid_t tid)
+{
+    char path[64];
+    char line[128];
+    long switches = -1;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "voluntary_ctxt_switches: %ld", &switches) == 1)
+            break;
+    }
+    fclose(fp);
+    return switches;
+}
+
+static int replay_line(int fd, const char *line, int lineno)
+{
+    unsigned char buffer[CEC_MAX_FRAME_SIZE];
+    unsigned char expect[CEC_MAX_FRAME_SIZE];
+    struct pollfd pfd;
+    int size, expect_size;
+
+    if (strncmp(line, "rx", 2) == 0) {
+        size = parse_frame(line + 2, buffer);
+        if (write(fd, buffer, size) != size) {
+            printf("line %d: write fail(%d)\n", lineno, errno);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strncmp(line, "tx", 2) != 0)
+        return 0;
+
+    expect_size = parse_frame(line + 2, expect);
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, CEC_REPLAY_TIMEOUT_MS) <= 0) {
+        print_frame("timeout, expected tx", expect, expect_size);
+        printf("line %d: FAIL\n", lineno);
+        return -1;
+    }
+
+    size = read(fd, buffer, sizeof(buffer));
+    if (size != expect_size || memcmp(buffer, expect, size) != 0) {
+        print_frame("expected tx", expect, expect_size);
+        print_frame("got      tx", buffer, size > 0 ? size : 0);
+        printf("line %d: FAIL\n", lineno);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char line[256];
+    const char **script = default_session;
+    const char *header;
+    FILE *fp = NULL;
+    int laddr = 4, paddr = 0x1000, devtype = CEC_DEVICE_PLAYER;
+    int lineno = 0;
+    int sv[2];
+    int ret = 0;
+    long before, after;
+
+    if (argc > 1) {
+        fp = fopen(argv[1], "r");
+        if (fp == NULL) {
+            printf("can't open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    /* SOCK_SEQPACKET keeps frame boundaries like the CEC driver does */
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        printf("socketpair fail(%d)\n", errno);
+        return 1;
+    }
+
+    header = script[0];
+    if (fp) {
+        if (fgets(line, sizeof(line), fp) == NULL) {
+            printf("empty session\n");
+            return 1;
+        }
+        header = line;
+    }
+    if (sscanf(header, "laddr %d paddr %x devtype %d", &laddr, &paddr, &devtype) != 3) {
+        printf("missing \"laddr L paddr PPPP devtype D\" header\n");
+        return 1;
+    }
+    lineno++;
+
+    if (devtype != CEC_DEVICE_PLAYER)
+        printf("warning: recorded devtype %d, replaying as player\n", devtype);
+
+    CECOpenFd(sv[0]);
+
+    sp<SecHdmiCEC> cec = new SecHdmiCEC();
+    if (cec->start(laddr, paddr) == false) {
+        printf("start fail\n");
+        return 1;
+    }
+
+    for (;;) {
+        const char *cur;
+
+        if (fp) {
+            if (fgets(line, sizeof(line), fp) == NULL)
+                break;
+            cur = line;
+        } else {
+            cur = script[lineno];
+            if (cur == NULL)
+                break;
+        }
+        lineno++;
+
+        if (replay_line(sv[1], cur, lineno) < 0) {
+            ret = 1;
+            break;
+        }
+    }
+    if (fp)
+        fclose(fp);
+    printf("replay: %d lines, %s\n", lineno, ret ? "FAIL" : "ok");
+
+    /* nothing to send and nothing received: the thread must not wake up */
+    usleep(10 * 1000);
+    before = thread_switches(cec->getTid());
+    usleep(CEC_REPLAY_IDLE_MS * 1000);
+    after = thread_switches(cec->getTid());
+    if (before < 0 || after != before) {
+        printf("idle: %ld wakeups in %d ms, FAIL\n", after - before, CEC_REPLAY_IDLE_MS);
+        ret = 1;
+    } else {
+        printf("idle: no wakeups, ok\n");
+    }
+
+    /* the device going away must stop the thread instead of spinning on EPOLLHUP */
+    close(sv[1]);
+    for (int i = 0; i < CEC_REPLAY_TIMEOUT_MS / 10 && cec->isActive(); i++)
+        usleep(10 * 1000);
+    if (cec->isActive()) {
+        printf("hangup: thread still running, FAIL\n");
+        ret = 1;
+    } else {
+        printf("hangup: thread stopped, ok\n");
+    }
+
+    cec->stop();
+    return ret;
+}
@@ -91,7 +91,12 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer)
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t damageX,
+                                        uint32_t damageY,
+                                        uint32_t damageW,
+                                        uint32_t damageH,
+                                        int64_t hwcSetTime)
     {
         Parcel data, reply;
         data.writeInt32(w);
@@ -104,6 +109,11 @@ namespace android {
         data.writeInt32(dstY);
         data.writeInt32(hdmiLayer);
         data.writeInt32(num_of_hwc_layer);
+        data.writeInt32(damageX);
+        data.writeInt32(damageY);
+        data.writeInt32(damageW);
+        data.writeInt32(damageH);
+        data.writeInt64(hwcSetTime);
         remote()->transact(BLIT_2_HDMI, data, &reply);
     }
 
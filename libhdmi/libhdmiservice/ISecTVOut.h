@@ -28,6 +28,13 @@
 #include <binder/IInterface.h>
 #include <binder/Parcel.h>
 
+/*
+ * A blit2Hdmi() of the UI with a Y address of 0 mirrors the panel
+ * framebuffer. The Cb address then tells which buffer of it was posted:
+ * HDMI_FB_YOFFSET_VALID | its yoffset, or 0 when the caller does not know.
+ */
+#define HDMI_FB_YOFFSET_VALID   (0x80000000)
+
 namespace android {
     class ISecTVOut: public IInterface
     {
@@ -47,7 +54,12 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer) = 0;
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t damageX,
+                                        uint32_t damageY,
+                                        uint32_t damageW,
+                                        uint32_t damageH,
+                                        int64_t hwcSetTime) = 0;
     };
     //--------------------------------------------------------------
     class BpSecTVOut: public BpInterface<ISecTVOut>
@@ -68,7 +80,12 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer);
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t damageX,
+                                        uint32_t damageY,
+                                        uint32_t damageW,
+                                        uint32_t damageH,
+                                        int64_t hwcSetTime);
     };
 };
 #endif
@@ -34,6 +34,7 @@ SecHdmiClient::SecHdmiClient()
 {
     g_SecTVOutService = m_getSecTVOutService();
     mEnable = 0;
+    mHwcSetTime = 0;
 }
 
 SecHdmiClient::~SecHdmiClient()
@@ -102,6 +103,11 @@ void SecHdmiClient::setHdmiEnable(uint32_t enable)
         mEnable = enable;
 }
 
+void SecHdmiClient::setHwcSetTime(nsecs_t time)
+{
+    mHwcSetTime = time;
+}
+
 void SecHdmiClient::blit2Hdmi(uint32_t w, uint32_t h,
                                 uint32_t colorFormat,
                                 uint32_t physYAddr,
@@ -112,8 +118,30 @@ void SecHdmiClient::blit2Hdmi(uint32_t w, uint32_t h,
                                 uint32_t hdmiLayer,
                                 uint32_t num_of_hwc_layer)
 {
+    blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer,
+              0, 0, 0, 0);
+}
+
+void SecHdmiClient::blit2Hdmi(uint32_t w, uint32_t h,
+                                uint32_t colorFormat,
+                                uint32_t physYAddr,
+                                uint32_t physCbAddr,
+                                uint32_t physCrAddr,
+                                uint32_t dstX,
+                                uint32_t dstY,
+                                uint32_t hdmiLayer,
+                                uint32_t num_of_hwc_layer,
+                                uint32_t damageX,
+                                uint32_t damageY,
+                                uint32_t damageW,
+                                uint32_t damageH)
+{
+    nsecs_t hwcSetTime = mHwcSetTime;
+
+    mHwcSetTime = 0;
     if (g_SecTVOutService != 0 && mEnable == 1)
-        g_SecTVOutService->blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer);
+        g_SecTVOutService->blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer,
+                                     damageX, damageY, damageW, damageH, hwcSetTime);
 }
 
 sp<ISecTVOut> SecHdmiClient::m_getSecTVOutService(void)
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <utils/RefBase.h>
+#include <utils/Timers.h>
 #include <cutils/log.h>
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -56,6 +57,7 @@ private:
     SecHdmiClient();
     virtual ~SecHdmiClient();
     uint32_t    mEnable;
+    nsecs_t     mHwcSetTime;
 
 public:
         static SecHdmiClient * getInstance(void);
@@ -66,6 +68,8 @@ public:
         void setHdmiRotate(int rotVal, uint32_t hwcLayer);
         void setHdmiHwcLayer(uint32_t hwcLayer);
         void setHdmiEnable(uint32_t enable);
+        /* start time of the composition the next blit2Hdmi() belongs to */
+        void setHwcSetTime(nsecs_t time);
         virtual void blit2Hdmi(uint32_t w, uint32_t h,
                                         uint32_t colorFormat,
                                         uint32_t physYAddr,
@@ -75,6 +79,23 @@ public:
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
                                         uint32_t num_of_hwc_layer);
+        /*
+         * damageX/Y/W/H is the region of the UI which changed since the
+         * previous blit, an empty region means unknown (full frame).
+         */
+        virtual void blit2Hdmi(uint32_t w, uint32_t h,
+                                        uint32_t colorFormat,
+                                        uint32_t physYAddr,
+                                        uint32_t physCbAddr,
+                                        uint32_t physCrAddr,
+                                        uint32_t dstX,
+                                        uint32_t dstY,
+                                        uint32_t hdmiLayer,
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t damageX,
+                                        uint32_t damageY,
+                                        uint32_t damageW,
+                                        uint32_t damageH);
 
 private:
         sp<ISecTVOut> m_getSecTVOutService(void);
@@ -29,6 +29,8 @@
 #include <binder/IInterface.h>
 #include <binder/Parcel.h>
 #include <utils/Log.h>
+#include <utils/String8.h>
+#include <unistd.h>
 #include "SecTVOutService.h"
 #include <linux/fb.h>
 
@@ -173,8 +175,14 @@ namespace android {
             uint32_t dstY   = data.readInt32();
             uint32_t hdmiLayer   = data.readInt32();
             uint32_t num_of_hwc_layer = data.readInt32();
-
-            blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer);
+            uint32_t damageX = data.readInt32();
+            uint32_t damageY = data.readInt32();
+            uint32_t damageW = data.readInt32();
+            uint32_t damageH = data.readInt32();
+            int64_t hwcSetTime = data.readInt64();
+
+            blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer,
+                      damageX, damageY, damageW, damageH, hwcSetTime);
         } break;
 
         default :
@@ -185,6 +193,18 @@ namespace android {
         return NO_ERROR;
     }
 
+    status_t SecTVOutService::dump(int fd, const Vector<String16>& args)
+    {
+        String8 result;
+
+        result.appendFormat("SecTVOutService: cable %s, ui layer %d, hwc layer %d\n",
+                hdmiCableInserted() ? "inserted" : "removed", mUILayerMode, mHwcLayer);
+        hdmi_trace_dump(result);
+
+        write(fd, result.string(), result.size());
+        return NO_ERROR;
+    }
+
     void SecTVOutService::setHdmiStatus(uint32_t status)
     {
 
@@ -211,7 +231,8 @@ namespace android {
         }
 
         if (hdmiCableInserted() == true)
-            this->blit2Hdmi(mLCD_width, mLCD_height, HAL_PIXEL_FORMAT_BGRA_8888, 0, 0, 0, 0, 0, HDMI_MODE_UI, 0);
+            this->blit2Hdmi(mLCD_width, mLCD_height, HAL_PIXEL_FORMAT_BGRA_8888, 0, 0, 0, 0, 0, HDMI_MODE_UI, 0,
+                            0, 0, 0, 0, 0);
     }
 
     void SecTVOutService::setHdmiMode(uint32_t mode)
@@ -271,13 +292,33 @@ namespace android {
                                  uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
                                  uint32_t dstX, uint32_t dstY,
                                  uint32_t hdmiMode,
-                                 uint32_t num_of_hwc_layer)
+                                 uint32_t num_of_hwc_layer,
+                                 uint32_t damageX, uint32_t damageY,
+                                 uint32_t damageW, uint32_t damageH,
+                                 int64_t hwcSetTime)
     {
         Mutex::Autolock _l(mLock);
 
         if (hdmiCableInserted() == false)
             return;
 
+        uint32_t traceFrame = hdmi_trace_begin(hwcSetTime);
+
+        struct v4l2_rect damage;
+        struct v4l2_rect *pDamage = NULL;
+        int fbYOffset = -1;
+
+        if (pPhyYAddr == 0 && (pPhyCbAddr & HDMI_FB_YOFFSET_VALID))
+            fbYOffset = pPhyCbAddr & ~HDMI_FB_YOFFSET_VALID;
+
+        if (damageW != 0 && damageH != 0) {
+            damage.left   = damageX;
+            damage.top    = damageY;
+            damage.width  = damageW;
+            damage.height = damageH;
+            pDamage = &damage;
+        }
+
         int hdmiLayer = SecHdmi::HDMI_LAYER_VIDEO;
 #if defined(CHECK_UI_TIME) || defined(CHECK_VIDEO_TIME)
         nsecs_t start, end;
@@ -323,7 +364,7 @@ namespace android {
                 start = systemTime();
 #endif
                 if (mSecHdmi.flush(w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr, dstX, dstY,
-                                    mUILayerMode, mHwcLayer) == false)
+                                    mUILayerMode, mHwcLayer, pDamage, fbYOffset) == false)
                     ALOGE("%s::mSecHdmi.flush() on HDMI_MODE_UI fail", __func__);
 #ifdef CHECK_UI_TIME
                 end = systemTime();
@@ -333,7 +374,8 @@ namespace android {
 #else
             {
                 msg = new SecHdmiEventMsg(&mSecHdmi, w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr,
-                                            dstX, dstY, mUILayerMode, mHwcLayer, HDMI_MODE_UI);
+                                            dstX, dstY, mUILayerMode, mHwcLayer, HDMI_MODE_UI, pDamage,
+                                            fbYOffset, traceFrame);
 
                 /* post to HdmiEventQueue */
                 mHdmiEventQueue.postMessage(msg, 0, 0);
@@ -364,7 +406,8 @@ namespace android {
 #endif
 #else
             msg = new SecHdmiEventMsg(&mSecHdmi, w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr,
-                                        dstX, dstY, SecHdmi::HDMI_LAYER_VIDEO, mHwcLayer, HDMI_MODE_VIDEO);
+                                        dstX, dstY, SecHdmi::HDMI_LAYER_VIDEO, mHwcLayer, HDMI_MODE_VIDEO, NULL,
+                                        -1, traceFrame);
 
             /* post to HdmiEventQueue */
             mHdmiEventQueue.postMessage(msg, 0, 0);
@@ -75,6 +75,7 @@ namespace android {
             SecTVOutService();
             static int instantiate ();
             virtual status_t onTransact(uint32_t, const Parcel &, Parcel *, uint32_t);
+            virtual status_t dump(int fd, const Vector<String16>& args);
             virtual ~SecTVOutService ();
 
             virtual void                        setHdmiStatus(uint32_t status);
@@ -87,7 +88,10 @@ namespace android {
                                                 uint32_t colorFormat,
                                                 uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
                                                 uint32_t dstX, uint32_t dstY,
-                                                uint32_t hdmiMode, uint32_t num_of_hwc_layer);
+                                                uint32_t hdmiMode, uint32_t num_of_hwc_layer,
+                                                uint32_t damageX, uint32_t damageY,
+                                                uint32_t damageW, uint32_t damageH,
+                                                int64_t hwcSetTime);
             bool                                hdmiCableInserted(void);
             void                                setLCDsize(void);
 
@@ -116,13 +120,21 @@ namespace android {
             uint32_t    mDstX, mDstY;
             uint32_t    mHdmiMode;
             uint32_t    mHdmiLayer, mHwcLayer;
+            struct v4l2_rect mDamage;
+            bool        mHasDamage;
+            int         mFBYOffset;
+            uint32_t    mTraceFrame;
 
             SecHdmiEventMsg(SecHdmi *SecHdmi, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcColorFormat,
                     uint32_t srcYAddr, uint32_t srcCbAddr, uint32_t srcCrAddr,
-                    uint32_t dstX, uint32_t dstY, uint32_t hdmiLayer, uint32_t hwcLayer, uint32_t hdmiMode)
+                    uint32_t dstX, uint32_t dstY, uint32_t hdmiLayer, uint32_t hwcLayer, uint32_t hdmiMode,
+                    struct v4l2_rect *damage, int fbYOffset, uint32_t traceFrame)
                 : pSecHdmi(SecHdmi), mSrcWidth(srcWidth), mSrcHeight(srcHeight), mSrcColorFormat(srcColorFormat),
                 mSrcYAddr(srcYAddr), mSrcCbAddr(srcCbAddr), mSrcCrAddr(srcCrAddr),
-                mDstX(dstX), mDstY(dstY), mHdmiLayer(hdmiLayer), mHwcLayer(hwcLayer), mHdmiMode(hdmiMode) {
+                mDstX(dstX), mDstY(dstY), mHdmiLayer(hdmiLayer), mHwcLayer(hwcLayer), mHdmiMode(hdmiMode),
+                mHasDamage(damage != NULL), mFBYOffset(fbYOffset), mTraceFrame(traceFrame) {
+                if (damage != NULL)
+                    mDamage = *damage;
             }
 
             virtual bool handler() {
@@ -132,13 +144,17 @@ namespace android {
                 nsecs_t start, end;
 #endif
 
+                hdmi_trace_set_frame(mTraceFrame);
+                hdmi_trace_stamp(HDMI_TRACE_DEQUEUE);
+
                 switch (mHdmiMode) {
                 case HDMI_MODE_UI:
 #ifdef CHECK_UI_TIME
                     start = systemTime();
 #endif
                     if (pSecHdmi->flush(mSrcWidth, mSrcHeight, mSrcColorFormat, mSrcYAddr, mSrcCbAddr, mSrcCrAddr,
-                                mDstX, mDstY, mHdmiLayer, mHwcLayer) == false) {
+                                mDstX, mDstY, mHdmiLayer, mHwcLayer, mHasDamage ? &mDamage : NULL,
+                                mFBYOffset) == false) {
                         ALOGE("%s::pSecHdmi->flush() fail on HDMI_MODE_UI", __func__);
                         ret = false;
                     }
@@ -81,6 +81,27 @@ int CECOpen()
     return res;
 }
 
+/**
+ * Adopt an already opened descriptor as the CEC device, e.g. one end of a
+ * socketpair standing in for /dev/CEC when replaying a recorded session.
+ * The descriptor is owned by libcec afterwards and closed by CECClose().
+ *
+ * @param newfd [in] descriptor to use for CEC frames.
+ *
+ * @return  If newfd is valid, return 1; otherwise, return 0.
+ */
+int CECOpenFd(int newfd)
+{
+    if (newfd < 0)
+        return 0;
+
+    if (fd != -1)
+        CECClose();
+
+    fd = newfd;
+    return 1;
+}
+
 /**
  * Close CEC file descriptor.
  *
@@ -101,6 +122,16 @@ int CECClose()
     return res;
 }
 
+/**
+ * Get CEC file descriptor, e.g. to wait for incoming messages with poll/epoll.
+ *
+ * @return  CEC file descriptor, or -1 if the device is not opened.
+ */
+int CECGetFd()
+{
+    return fd;
+}
+
 /**
  * Allocate logical address.
  *
@@ -312,7 +343,7 @@ int CECCheckMessageSize(unsigned char opcode, int size)
 
     switch (opcode) {
     case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-        if (size != 1)
+        if (size != 2)
             retval = 0;
         break;
     case CEC_OPCODE_SET_SYSTEM_AUDIO_MODE:
@@ -193,7 +193,9 @@ enum CECDeviceType {
 };
 
 int CECOpen();
+int CECOpenFd(int fd);
 int CECClose();
+int CECGetFd();
 int CECAllocLogicalAddress(int paddr, enum CECDeviceType devtype);
 int CECSendMessage(unsigned char *buffer, int size);
 int CECReceiveMessage(unsigned char *buffer, int size, long timeout);
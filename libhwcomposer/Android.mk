@@ -26,7 +26,7 @@ LOCAL_SHARED_LIBRARIES := liblog libcutils libEGL \
 LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/../include
 
-LOCAL_SRC_FILES := SecHWCLog.cpp SecHWCUtils.cpp SecHWC.cpp
+LOCAL_SRC_FILES := SecHWCLog.cpp SecHWCUtils.cpp SecHWCCapture.cpp SecHWCStats.cpp SecHWC.cpp
 
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/../libfimg
 
@@ -47,6 +47,12 @@ ifeq ($(BOARD_USES_HDMI_SUBTITLES),true)
 	LOCAL_CFLAGS += -DBOARD_USES_HDMI_SUBTITLES
 endif
 
+# HDMI as HWC_DISPLAY_EXTERNAL instead of mirroring the panel, the TV-out
+# service needs BOARD_USES_HDMI_SUBTITLES to show the UI over the video
+ifeq ($(BOARD_USES_HWC_EXTERNAL_DISPLAY),true)
+	LOCAL_CFLAGS += -DHWC_EXTERNAL_DISPLAY
+endif
+
 ifeq ($(BOARD_HDMI_STD), STD_NTSC_M)
 LOCAL_CFLAGS  += -DSTD_NTSC_M
 endif
@@ -64,10 +70,21 @@ LOCAL_CFLAGS  += -DSTD_1080P
 endif
 endif
 
+ifeq ($(BOARD_USES_FIMGAPI),true)
+LOCAL_CFLAGS += -DBOARD_USES_FIMGAPI
+LOCAL_SHARED_LIBRARIES += libfimg
+endif
+
 ifeq ($(BOARD_NO_OVERLAY),true)
 LOCAL_CFLAGS += -DBOARD_NO_OVERLAY
 endif
 
+ifeq ($(BOARD_HWC_CAPTURE),true)
+LOCAL_CFLAGS += -DHWC_CAPTURE
+endif
+
 LOCAL_MODULE := hwcomposer.$(TARGET_BOARD_PLATFORM)
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
@@ -26,12 +26,17 @@
 
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 
 #include <EGL/egl.h>
 #include <fcntl.h>
 #include <hardware_legacy/uevent.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
+#ifdef SYSFS_VSYNC_NOTIFICATION
+#include <sys/epoll.h>
+#include <time.h>
+#endif
 
 #include "SecHWCUtils.h"
 
@@ -45,11 +50,11 @@
 
 #include "SecHdmi.h"
 
-//#define CHECK_EGL_FPS
-#ifdef CHECK_EGL_FPS
-extern void check_fps();
+#ifdef HWC_EXTERNAL_DISPLAY
+#include <sync/sync.h>
 #endif
 
+
 static int lcd_width, lcd_height;
 static int prev_usage = 0;
 
@@ -150,27 +155,12 @@ static int set_src_dst_img_rect(hwc_layer_1_t *cur,
 
     src_img->mem_type = HWC_VIRT_MEM_TYPE;
 
-    switch (src_img->format) {
-    case HAL_PIXEL_FORMAT_YV12:             /* To support video editor */
-    case HAL_PIXEL_FORMAT_YCbCr_420_P:      /* To support SW codec     */
-    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
-    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_SP:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_SP:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_I:
-    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_I:
-    case HAL_PIXEL_FORMAT_CUSTOM_CbYCrY_422_I:
-    case HAL_PIXEL_FORMAT_CUSTOM_CrYCbY_422_I:
+    if (sec_hwc_get_format(src_img->format)->pad_frame) {
         src_img->f_w = (src_img->f_w + 15) & ~15;
         src_img->f_h = (src_img->f_h + 1) & ~1;
-        break;
-    default:
+    } else {
         src_img->f_w = src_img->w;
         src_img->f_h = src_img->h;
-        break;
     }
 
     /* 2. Set dst_img from window(lcd) */
@@ -320,31 +310,28 @@ static int get_hwc_compos_decision(hwc_layer_1_t* cur, int iter, int win_cnt)
 
     if (iter == 0) {
     /* check here....if we have any resolution constraints */
-        if (((cur->sourceCrop.right - cur->sourceCrop.left + 1) < 16) ||
-            ((cur->sourceCrop.bottom - cur->sourceCrop.top + 1) < 8))
+        if (((cur->sourceCrop.right - cur->sourceCrop.left + 1) < HWC_FIMC_MIN_SRC_W) ||
+            ((cur->sourceCrop.bottom - cur->sourceCrop.top + 1) < HWC_FIMC_MIN_SRC_H))
             return compositionType;
 
         if ((cur->transform == HAL_TRANSFORM_ROT_90) ||
             (cur->transform == HAL_TRANSFORM_ROT_270)) {
-            if (((cur->displayFrame.right - cur->displayFrame.left + 1) < 4) ||
-                ((cur->displayFrame.bottom - cur->displayFrame.top + 1) < 8))
+            if (((cur->displayFrame.right - cur->displayFrame.left + 1) < HWC_FIMC_MIN_DST_H) ||
+                ((cur->displayFrame.bottom - cur->displayFrame.top + 1) < HWC_FIMC_MIN_DST_W))
                 return compositionType;
-        } else if (((cur->displayFrame.right - cur->displayFrame.left + 1) < 8) ||
-                   ((cur->displayFrame.bottom - cur->displayFrame.top + 1) < 4)) {
+        } else if (((cur->displayFrame.right - cur->displayFrame.left + 1) < HWC_FIMC_MIN_DST_W) ||
+                   ((cur->displayFrame.bottom - cur->displayFrame.top + 1) < HWC_FIMC_MIN_DST_H)) {
             return compositionType;
         }
 
-        switch (prev_handle->format) {
-        case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
-        case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP:
-        case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
+        switch (sec_hwc_get_format(prev_handle->format)->overlay) {
+        case HWC_FORMAT_MFC:
             compositionType = HWC_OVERLAY;
             break;
-        case HAL_PIXEL_FORMAT_YV12:                 /* YCrCb_420_P */
-        case HAL_PIXEL_FORMAT_YCbCr_420_P:
-        case HAL_PIXEL_FORMAT_YCrCb_420_SP:
-        case HAL_PIXEL_FORMAT_YCbCr_420_SP:
-            if ((prev_handle->usage & GRALLOC_USAGE_HWC_HWOVERLAY) &&
+        case HWC_FORMAT_SW:
+            /* without a physical address FIMC reads a copy, see is_bounce_src() */
+            if (((prev_handle->usage & GRALLOC_USAGE_HWC_HWOVERLAY) ||
+                 prev_handle->paddr || prev_handle->base) &&
                  (cur->blending == HWC_BLENDING_NONE))
                 compositionType = HWC_OVERLAY;
             else
@@ -369,6 +356,16 @@ static int get_hwc_compos_decision(hwc_layer_1_t* cur, int iter, int win_cnt)
     return  compositionType;
 }
 
+/* software decoded YUV layers FIMC cannot address are copied to a bounce buffer */
+static bool is_bounce_src(private_handle_t *prev_handle)
+{
+    if (sec_hwc_get_format(prev_handle->format)->overlay != HWC_FORMAT_SW)
+        return false;
+
+    return !(prev_handle->usage & GRALLOC_USAGE_HW_FIMC1) &&
+           (prev_handle->paddr == 0) && (prev_handle->base != 0);
+}
+
 static void reset_win_rect_info(hwc_win_info_t *win)
 {
     win->rect_info.x = 0;
@@ -391,6 +388,16 @@ static int assign_overlay_window(struct hwc_context_t *ctx, hwc_layer_1_t *cur,
 
     win = &ctx->win[win_idx];
 
+    /* take the bounce buffers now, the layer stays on GLES without them */
+    if (is_bounce_src((private_handle_t *)cur->handle)) {
+        private_handle_t *prev_handle = (private_handle_t *)cur->handle;
+
+        /* f_w/f_h of set_src_dst_img_rect() */
+        if (bounce_buf_alloc(ctx, (prev_handle->width + 15) & ~15,
+                             (prev_handle->height + 1) & ~1) < 0)
+            return -1;
+    }
+
     SEC_HWC_Log(HWC_LOG_DEBUG,
             "%s:: left(%d),top(%d),right(%d),bottom(%d),transform(%d)"
             "lcd_info.xres(%d),lcd_info.yres(%d)",
@@ -428,7 +435,322 @@ static int assign_overlay_window(struct hwc_context_t *ctx, hwc_layer_1_t *cur,
     return 0;
 }
 
+#if defined(BOARD_USES_FIMGAPI)
+static int get_g2d_format(int hal_format, bool opaque,
+        enum color_format *fmt, enum pixel_order *order, int *bpp)
+{
+    switch (hal_format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+        *fmt   = opaque ? CF_XRGB_8888 : CF_ARGB_8888;
+        *order = AX_BGR;
+        *bpp   = 4;
+        break;
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+        *fmt   = CF_XRGB_8888;
+        *order = AX_BGR;
+        *bpp   = 4;
+        break;
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        *fmt   = opaque ? CF_XRGB_8888 : CF_ARGB_8888;
+        *order = AX_RGB;
+        *bpp   = 4;
+        break;
+    case HAL_PIXEL_FORMAT_RGB_565:
+        *fmt   = CF_RGB_565;
+        *order = AX_RGB;
+        *bpp   = 2;
+        break;
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+static int get_hwc_g2d_decision(struct hwc_context_t *ctx, hwc_layer_1_t *cur)
+{
+    enum color_format fmt;
+    enum pixel_order  order;
+    int bpp;
+
+    if ((cur->flags & HWC_SKIP_LAYER) || !cur->handle)
+        return 0;
+
+    private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+
+    if (get_g2d_format(prev_handle->format, false, &fmt, &order, &bpp) < 0)
+        return 0;
+
+    if (prev_handle->base == 0 &&
+        !((prev_handle->usage & GRALLOC_USAGE_HW_FIMC1) && prev_handle->paddr))
+        return 0;
+
+    if (cur->transform != 0)
+        return 0;
+
+    /* the window never starts off screen, clipped layers stay on GLES */
+    if ((cur->displayFrame.left < 0) || (cur->displayFrame.top < 0) ||
+        ((int)ctx->lcd_info.xres < cur->displayFrame.right) ||
+        ((int)ctx->lcd_info.yres < cur->displayFrame.bottom) ||
+        (cur->displayFrame.right <= cur->displayFrame.left) ||
+        (cur->displayFrame.bottom <= cur->displayFrame.top))
+        return 0;
+
+    if ((cur->sourceCrop.left < 0) || (cur->sourceCrop.top < 0) ||
+        (prev_handle->width < cur->sourceCrop.right) ||
+        (prev_handle->height < cur->sourceCrop.bottom) ||
+        (cur->sourceCrop.right <= cur->sourceCrop.left) ||
+        (cur->sourceCrop.bottom <= cur->sourceCrop.top))
+        return 0;
+
+    return 1;
+}
+
+static int is_g2d_layer(struct hwc_context_t *ctx, int layer_idx)
+{
+    for (int i = 0; i < ctx->num_2d_blit_layer; i++) {
+        if (ctx->g2d_layer_index[i] == layer_idx)
+            return 1;
+    }
+
+    return 0;
+}
+
+static int assign_g2d_window(struct hwc_context_t *ctx,
+        hwc_display_contents_1_t *list)
+{
+    struct hwc_win_info_t *win = &ctx->win[ctx->g2d_win_idx];
+    int left   = ctx->lcd_info.xres;
+    int top    = ctx->lcd_info.yres;
+    int right  = 0;
+    int bottom = 0;
+
+    for (int i = 0; i < ctx->num_2d_blit_layer; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[ctx->g2d_layer_index[i]];
+
+        left   = SEC_MIN(left,   cur->displayFrame.left);
+        top    = SEC_MIN(top,    cur->displayFrame.top);
+        right  = SEC_MAX(right,  cur->displayFrame.right);
+        bottom = SEC_MAX(bottom, cur->displayFrame.bottom);
+
+    }
+
+    if ((left != win->rect_info.x) || (top != win->rect_info.y) ||
+        ((right - left) != win->rect_info.w) || ((bottom - top) != win->rect_info.h)) {
+        win->rect_info.x = left;
+        win->rect_info.y = top;
+        win->rect_info.w = right - left;
+        win->rect_info.h = bottom - top;
+        /* the layers move inside the window, nothing drawn before is reusable */
+        ctx->g2d_prev_win_idx = -1;
+
+        if (window_set_pos(win) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::window_set_pos is failed : %s",
+                    __func__, strerror(errno));
+            return -1;
+        }
+    }
+
+    ctx->layer_prev_buf[ctx->g2d_win_idx] = 0;
+    win->layer_index = ctx->g2d_layer_index[0];
+    win->status = HWC_WIN_RESERVED;
+
+    return 0;
+}
+
+static void get_g2d_lay_info(hwc_layer_1_t *cur, struct hwc_g2d_lay_info *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->handle       = (uint32_t)cur->handle;
+    info->sourceCrop   = cur->sourceCrop;
+    info->displayFrame = cur->displayFrame;
+    info->blending     = cur->blending;
+#ifdef HWC_DEVICE_API_VERSION_1_2
+    info->plane_alpha  = cur->planeAlpha;
+#else
+    info->plane_alpha  = 0xff;
+#endif
+}
+
+/*
+ * Compose the G2D layers bottom to top into the next buffer of their window.
+ * The window is cleared first unless its bottom layer is opaque and covers it.
+ */
+static int runG2d(struct hwc_context_t *ctx, struct hwc_win_info_t *win,
+        hwc_layer_1_t **layer, int num_of_layer)
+{
+    struct fimg2d_blit   cmd[HWC_G2D_MAX_LAYER + 1];
+    struct fimg2d_blit  *cmd_list[HWC_G2D_MAX_LAYER + 1];
+    struct fimg2d_image  src_img[HWC_G2D_MAX_LAYER];
+    struct fimg2d_image  dst_img[HWC_G2D_MAX_LAYER + 1];
+    int num_of_cmd = 0;
+    int dst_bpp = win->lcd_info.bits_per_pixel >> 3;
+    hwc_layer_1_t *cur = layer[0];
+
+    memset(cmd,     0, sizeof(cmd));
+    memset(src_img, 0, sizeof(src_img));
+    memset(dst_img, 0, sizeof(dst_img));
+
+    for (int i = 0; i <= num_of_layer; i++) {
+        dst_img[i].width      = win->rect_info.w;
+        dst_img[i].height     = win->rect_info.h;
+        dst_img[i].stride     = win->var_info.xres_virtual * dst_bpp;
+        dst_img[i].order      = AX_RGB;
+        dst_img[i].fmt        = (dst_bpp == 4) ? CF_ARGB_8888 : CF_RGB_565;
+        dst_img[i].addr.type  = ADDR_PHYS;
+        dst_img[i].addr.start = win->addr[win->buf_index];
+        dst_img[i].rect.x2    = win->rect_info.w;
+        dst_img[i].rect.y2    = win->rect_info.h;
+    }
+
+    if ((cur->blending != HWC_BLENDING_NONE) ||
+#ifdef HWC_DEVICE_API_VERSION_1_2
+        (cur->planeAlpha != 0xff) ||
+#endif
+        (cur->displayFrame.left != win->rect_info.x) ||
+        (cur->displayFrame.top  != win->rect_info.y) ||
+        ((cur->displayFrame.right - cur->displayFrame.left) != win->rect_info.w) ||
+        ((cur->displayFrame.bottom - cur->displayFrame.top) != win->rect_info.h)) {
+        cmd[num_of_cmd].op            = BLIT_OP_CLR;
+        cmd[num_of_cmd].param.g_alpha = 0xff;
+        cmd[num_of_cmd].param.premult = PREMULTIPLIED;
+        cmd[num_of_cmd].dst           = &dst_img[num_of_cmd];
+        cmd[num_of_cmd].sync          = BLIT_SYNC;
+        num_of_cmd++;
+    }
+
+    for (int i = 0; i < num_of_layer; i++) {
+        struct fimg2d_blit  *blit = &cmd[num_of_cmd];
+        struct fimg2d_image *src  = &src_img[i];
+        struct fimg2d_image *dst  = &dst_img[num_of_cmd];
+        bool opaque;
+        int  bpp;
+        int  src_w, src_h, dst_w, dst_h;
+
+        cur = layer[i];
+        private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+        opaque = (cur->blending == HWC_BLENDING_NONE);
+
+        if (get_g2d_format(prev_handle->format, opaque, &src->fmt, &src->order, &bpp) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::unsupported format(0x%x)",
+                    __func__, prev_handle->format);
+            return -1;
+        }
+
+        if ((prev_handle->usage & GRALLOC_USAGE_HW_FIMC1) && prev_handle->paddr) {
+            src->addr.type     = ADDR_PHYS;
+            src->addr.start    = prev_handle->paddr;
+            src->need_cacheopr = false;
+        } else {
+            src->addr.type     = ADDR_USER;
+            src->addr.start    = prev_handle->base;
+            src->need_cacheopr = true;
+        }
+
+        src->width   = prev_handle->width;
+        src->height  = prev_handle->height;
+        src->stride  = (prev_handle->stride ? prev_handle->stride : prev_handle->width) * bpp;
+        src->rect.x1 = cur->sourceCrop.left;
+        src->rect.y1 = cur->sourceCrop.top;
+        src->rect.x2 = cur->sourceCrop.right;
+        src->rect.y2 = cur->sourceCrop.bottom;
+
+        dst->rect.x1 = cur->displayFrame.left   - win->rect_info.x;
+        dst->rect.y1 = cur->displayFrame.top    - win->rect_info.y;
+        dst->rect.x2 = cur->displayFrame.right  - win->rect_info.x;
+        dst->rect.y2 = cur->displayFrame.bottom - win->rect_info.y;
+
+        src_w = src->rect.x2 - src->rect.x1;
+        src_h = src->rect.y2 - src->rect.y1;
+        dst_w = dst->rect.x2 - dst->rect.x1;
+        dst_h = dst->rect.y2 - dst->rect.y1;
+
+        blit->op            = opaque ? BLIT_OP_SRC : BLIT_OP_SRC_OVER;
+#ifdef HWC_DEVICE_API_VERSION_1_2
+        blit->param.g_alpha = cur->planeAlpha;
+        if (cur->planeAlpha != 0xff)
+            blit->op = BLIT_OP_SRC_OVER;
+#else
+        blit->param.g_alpha = 0xff;
+#endif
+        blit->param.rotate  = ORIGIN;
+        blit->param.premult = (cur->blending == HWC_BLENDING_PREMULT) ?
+                              PREMULTIPLIED : NON_PREMULTIPLIED;
+        if ((src_w != dst_w) || (src_h != dst_h)) {
+            blit->param.scaling.mode  = SCALING_BILINEAR;
+            blit->param.scaling.src_w = src_w;
+            blit->param.scaling.src_h = src_h;
+            blit->param.scaling.dst_w = dst_w;
+            blit->param.scaling.dst_h = dst_h;
+        }
+        blit->src  = src;
+        blit->dst  = dst;
+        blit->sync = BLIT_SYNC;
+        num_of_cmd++;
+    }
+
+    for (int i = 0; i < num_of_cmd; i++)
+        cmd_list[i] = &cmd[i];
+
+    if (stretchFimgApiBatch(cmd_list, num_of_cmd) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::stretchFimgApiBatch(%d) fail",
+                __func__, num_of_cmd);
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+static inline bool is_empty_rect(const hwc_rect_t *rect)
+{
+    return (rect->right <= rect->left) || (rect->bottom <= rect->top);
+}
+
+static inline void union_rect(hwc_rect_t *dst, const hwc_rect_t *src)
+{
+    if (is_empty_rect(src))
+        return;
+
+    if (is_empty_rect(dst)) {
+        *dst = *src;
+        return;
+    }
+
+    dst->left   = SEC_MIN(dst->left,   src->left);
+    dst->top    = SEC_MIN(dst->top,    src->top);
+    dst->right  = SEC_MAX(dst->right,  src->right);
+    dst->bottom = SEC_MAX(dst->bottom, src->bottom);
+}
+
+#if defined(BOARD_USES_HDMI)
+/* post a UI frame to the TV, damage is clipped to the w x h frame and empty is all of it */
+static void hdmi_blit_ui(android::SecHdmiClient *hdmiClient,
+        int w, int h, int format, uint32_t addr, uint32_t cb_addr,
+        hwc_rect_t damage, int num_of_video_layer)
+{
+    damage.left   = SEC_MAX(damage.left, 0);
+    damage.top    = SEC_MAX(damage.top, 0);
+    damage.right  = SEC_MIN(damage.right, w);
+    damage.bottom = SEC_MIN(damage.bottom, h);
+    if (is_empty_rect(&damage))
+        memset(&damage, 0, sizeof(damage));
+
+    hdmiClient->blit2Hdmi(w, h, format, addr, cb_addr, addr, 0, 0,
+                          android::SecHdmiClient::HDMI_MODE_UI,
+                          num_of_video_layer,
+                          damage.left, damage.top,
+                          damage.right - damage.left, damage.bottom - damage.top);
+}
+#endif
+
 #ifdef SKIP_DUMMY_UI_LAY_DRAWING
+/*
+ * A framebuffer layer is damaged when its buffer or its frame changed, the
+ * damage is where it was and where it is now. When nothing is damaged the
+ * layers are not drawn and the swap is skipped, otherwise only the union of
+ * the damage is posted.
+ */
 static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
                                hwc_display_contents_1_t* list)
 {
@@ -436,6 +758,9 @@ static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
     hwc_layer_1_t* cur;
     int num_of_fb_lay_skip = 0;
     int fb_lay_tot = ctx->num_of_fb_layer + ctx->num_of_fb_lay_skip;
+    hwc_rect_t damage = {0, 0, 0, 0};
+
+    memset(&ctx->fb_damage, 0, sizeof(ctx->fb_damage));
 
     if (fb_lay_tot > NUM_OF_DUMMY_WIN)
         return;
@@ -454,22 +779,32 @@ static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
     if (ctx->fb_lay_skip_initialized) {
         for (int cnt = 0; cnt < fb_lay_tot; cnt++) {
             cur = &list->hwLayers[ctx->win_virt[cnt].layer_index];
-            if (ctx->win_virt[cnt].layer_prev_buf == (uint32_t)cur->handle)
+            if ((ctx->win_virt[cnt].layer_prev_buf == (uint32_t)cur->handle) &&
+                !memcmp(&ctx->win_virt[cnt].layer_prev_frame, &cur->displayFrame,
+                        sizeof(hwc_rect_t))) {
                 num_of_fb_lay_skip++;
+            } else {
+                union_rect(&damage, &ctx->win_virt[cnt].layer_prev_frame);
+                union_rect(&damage, &cur->displayFrame);
+            }
         }
 #ifdef GL_WA_OVLY_ALL
-        if (ctx->ui_skip_frame_cnt >= THRES_FOR_SWAP)
+        if (ctx->ui_skip_frame_cnt >= THRES_FOR_SWAP) {
             num_of_fb_lay_skip = 0;
+            memset(&damage, 0, sizeof(damage));
+        }
 #endif
         if (num_of_fb_lay_skip != fb_lay_tot) {
             ctx->num_of_fb_layer = fb_lay_tot;
             ctx->num_of_fb_lay_skip = 0;
+            ctx->fb_damage = damage;
 #ifdef GL_WA_OVLY_ALL
             ctx->ui_skip_frame_cnt = 0;
 #endif
             for (int cnt = 0; cnt < fb_lay_tot; cnt++) {
                 cur = &list->hwLayers[ctx->win_virt[cnt].layer_index];
                 ctx->win_virt[cnt].layer_prev_buf = (uint32_t)cur->handle;
+                ctx->win_virt[cnt].layer_prev_frame = cur->displayFrame;
                 cur->compositionType = HWC_FRAMEBUFFER;
                 ctx->win_virt[cnt].status = HWC_WIN_FREE;
             }
@@ -492,6 +827,14 @@ static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
                 break;
 
             cur = &list->hwLayers[i];
+#ifdef HWC_EXTERNAL_DISPLAY
+            if (cur->compositionType == HWC_FRAMEBUFFER_TARGET)
+                continue;
+#endif
+#if defined(BOARD_USES_FIMGAPI)
+            if (is_g2d_layer(ctx, i))
+                continue;
+#endif
             if (cur->handle) {
                 prev_handle = (private_handle_t *)(cur->handle);
 
@@ -503,6 +846,8 @@ static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
                     cur->compositionType = HWC_FRAMEBUFFER;
                     ctx->win_virt[num_of_fb_lay_skip].layer_prev_buf =
                         (uint32_t)cur->handle;
+                    ctx->win_virt[num_of_fb_lay_skip].layer_prev_frame =
+                        cur->displayFrame;
                     ctx->win_virt[num_of_fb_lay_skip].layer_index = i;
                     ctx->win_virt[num_of_fb_lay_skip].status = HWC_WIN_FREE;
                     num_of_fb_lay_skip++;
@@ -522,97 +867,531 @@ static void get_hwc_ui_lay_skipdraw_decision(struct hwc_context_t* ctx,
     return;
 
 }
-#endif
 
-static int hwc_prepare(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_display_contents_1_t** displays)
-{
+typedef EGLBoolean (*hwc_set_swap_rect_t)(EGLDisplay dpy, EGLSurface sur,
+        EGLint left, EGLint top, EGLint width, EGLint height);
 
-    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
-    int overlay_win_cnt = 0;
-    int compositionType = 0;
-    int ret;
+/* limit the next eglSwapBuffers() to the damage, when EGL can do that */
+static void hwc_set_swap_rect(struct hwc_context_t *ctx,
+        hwc_display_contents_1_t *list)
+{
+    hwc_rect_t rect = ctx->fb_damage;
 
-    // Compat
-    hwc_display_contents_1_t* list = NULL;
-    if (numDisplays > 0) {
-        list = displays[0];
+    if (!ctx->set_swap_rect_checked) {
+        ctx->set_swap_rect = (void *)eglGetProcAddress("eglSetSwapRectangleANDROID");
+        ctx->set_swap_rect_checked = 1;
     }
 
-#if defined(BOARD_USES_HDMI)
-    android::SecHdmiClient *mHdmiClient = android::SecHdmiClient::getInstance();
-    int hdmi_cable_status = (int)mHdmiClient->getHdmiCableStatus();
+    if (!ctx->set_swap_rect)
+        return;
 
-    ctx->hdmi_cable_status = hdmi_cable_status;
-#endif
-        
-#ifdef SKIP_DUMMY_UI_LAY_DRAWING
-    if ((list && (!(list->flags & HWC_GEOMETRY_CHANGED))) &&
-	(ctx->num_of_hwc_layer > 0)) {
-      get_hwc_ui_lay_skipdraw_decision(ctx, list);
-      return 0;
+    rect.left   = SEC_MAX(rect.left, 0);
+    rect.top    = SEC_MAX(rect.top, 0);
+    rect.right  = SEC_MIN(rect.right,  ctx->lcd_info.xres);
+    rect.bottom = SEC_MIN(rect.bottom, ctx->lcd_info.yres);
+
+    if (is_empty_rect(&rect)) {
+        rect.left   = 0;
+        rect.top    = 0;
+        rect.right  = ctx->lcd_info.xres;
+        rect.bottom = ctx->lcd_info.yres;
     }
-    ctx->fb_lay_skip_initialized = 0;
-    ctx->num_of_fb_lay_skip = 0;
-#ifdef GL_WA_OVLY_ALL
-    ctx->ui_skip_frame_cnt = 0;
+
+    ((hwc_set_swap_rect_t)ctx->set_swap_rect)((EGLDisplay)list->dpy, (EGLSurface)list->sur,
+            rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top);
+}
 #endif
-        
-    for (int i = 0; i < NUM_OF_DUMMY_WIN; i++) {
-        ctx->win_virt[i].layer_prev_buf = 0;
-        ctx->win_virt[i].layer_index = -1;
-        ctx->win_virt[i].status = HWC_WIN_FREE;
+
+#ifdef HWC_EXTERNAL_DISPLAY
+/*
+ * Wait for the buffers the hardware reads directly and drop all the acquire
+ * fences, GLES waits for the framebuffer layers by itself.
+ */
+static void hwc_wait_acquire_fences(hwc_display_contents_1_t *list, bool wait_fb_target)
+{
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+
+        if (cur->acquireFenceFd < 0)
+            continue;
+
+        if ((cur->compositionType == HWC_OVERLAY) ||
+            (wait_fb_target && (cur->compositionType == HWC_FRAMEBUFFER_TARGET))) {
+            if (sync_wait(cur->acquireFenceFd, 1000) < 0)
+                SEC_HWC_Log(HWC_LOG_ERROR, "%s::sync_wait(%d) fail : %s",
+                        __func__, cur->acquireFenceFd, strerror(errno));
+        }
+
+        close(cur->acquireFenceFd);
+        cur->acquireFenceFd = -1;
     }
-#endif
-        
-    //if geometry is not changed, there is no need to do any work here
-    if (!list || (!(list->flags & HWC_GEOMETRY_CHANGED)))
+}
+
+/* called from the uevent or vsync thread, SurfaceFlinger must not be called back from prepare */
+static void hwc_ext_hotplug(struct hwc_context_t *ctx)
+{
+    if (!ctx->procs || !ctx->procs->hotplug)
+        return;
+
+    if (android_atomic_cmpxchg(1, 0, &ctx->ext_hotplug_pending) == 0)
+        ctx->procs->hotplug(ctx->procs, HWC_DISPLAY_EXTERNAL, ctx->ext_connected);
+}
+
+static int hwc_ext_read_switch(void)
+{
+    char buf[8];
+    int fd;
+    int len;
+
+    fd = open(HDMI_SWITCH_NODE, O_RDONLY);
+    if (fd < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::open(%s) fail : %s",
+                __func__, HDMI_SWITCH_NODE, strerror(errno));
         return 0;
+    }
 
-    //all the windows are free here....
-    for (int i = 0 ; i < NUM_OF_WIN; i++) {
-        ctx->win[i].status = HWC_WIN_FREE;
-        ctx->win[i].buf_index = 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+
+    buf[len] = 0;
+    return atoi(buf) ? 1 : 0;
+}
+
+/* the HDMI switch changed, the hotplug goes out from the thread reading the uevents */
+static void hwc_ext_handle_uevent(struct hwc_context_t *ctx, const char *buff, int len)
+{
+    const char *s = buff;
+    int connected = -1;
+
+    if (strcmp(s, HDMI_SWITCH_UEVENT))
+        return;
+
+    s += strlen(s) + 1;
+
+    while (*s) {
+        if (!strncmp(s, "SWITCH_STATE=", strlen("SWITCH_STATE=")))
+            connected = atoi(s + strlen("SWITCH_STATE=")) ? 1 : 0;
+
+        s += strlen(s) + 1;
+        if (s - buff >= len)
+            break;
     }
 
-    ctx->num_of_hwc_layer = 0;
-    ctx->num_of_fb_layer = 0;
-    ctx->num_2d_blit_layer = 0;
-    ctx->num_of_ext_disp_video_layer = 0;
+    if ((connected < 0) || (connected == ctx->ext_connected))
+        return;
 
-    for (int i = 0; i < list->numHwLayers; i++) {
+    ctx->ext_connected = connected;
+    android_atomic_release_store(1, &ctx->ext_hotplug_pending);
+}
+
+/* refresh rate of a TV-out resolution value, as hdmi_resolution_2_std_id() knows them */
+static int hwc_ext_refresh_rate(unsigned int resolution)
+{
+    switch (resolution) {
+    case 1080950:
+    case 1080150:
+    case 720950:
+    case 7209501:
+    case 5769501:
+    case 5769502:
+        return 50;
+    case 1080930:
+        return 30;
+    case 1080924:
+        return 24;
+    default:
+        return 60;
+    }
+}
+
+/*
+ * The panel has no EGL surface with HWC 1.1, SurfaceFlinger renders into the
+ * framebuffer target and the HWC posts it through the framebuffer HAL.
+ */
+static int hwc_post_fb_target(struct hwc_context_t *ctx, hwc_display_contents_1_t *list)
+{
+    for (size_t i = 0; i < list->numHwLayers; i++) {
         hwc_layer_1_t *cur = &list->hwLayers[i];
-        private_handle_t *prev_handle = NULL;
-        if (cur->handle) {
-            prev_handle = (private_handle_t *)(cur->handle);
-            SEC_HWC_Log(HWC_LOG_DEBUG, "prev_handle->usage = %d", prev_handle->usage);
-            if (prev_handle->usage & GRALLOC_USAGE_EXTERNAL_DISP) {
-                ctx->num_of_ext_disp_layer++;
-                if ((prev_handle->usage & GRALLOC_USAGE_EXTERNAL_DISP) ||
-                    check_yuv_format((unsigned int)prev_handle->format) == 1) {
-                    ctx->num_of_ext_disp_video_layer++;
-                }
-            }
+
+        if (cur->compositionType != HWC_FRAMEBUFFER_TARGET)
+            continue;
+
+        if (!cur->handle || !ctx->fb_dev)
+            break;
+
+        window_show(&ctx->global_lcd_win);
+        if (ctx->fb_dev->post(ctx->fb_dev, cur->handle) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::post fail : %s", __func__, strerror(errno));
+            return -1;
         }
+        return 0;
     }
 
-    for (int i = 0; i < list->numHwLayers ; i++) {
-        hwc_layer_1_t* cur = &list->hwLayers[i];
-        private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+    SEC_HWC_Log(HWC_LOG_ERROR, "%s::no framebuffer target to post", __func__);
+    return -1;
+}
 
-        if (overlay_win_cnt < NUM_OF_WIN) {
-            compositionType = get_hwc_compos_decision(cur, 0, overlay_win_cnt);
+static int get_ext_video_addr(private_handle_t *prev_handle,
+        uint32_t *y_addr, uint32_t *cb_addr, uint32_t *cr_addr)
+{
+    ADDRS *addr;
+
+    switch (sec_hwc_get_format(prev_handle->format)->overlay) {
+    case HWC_FORMAT_MFC:
+        if (prev_handle->base == 0)
+            return -1;
+        addr = (ADDRS *)(prev_handle->base);
+        *y_addr  = addr->addr_y;
+        *cb_addr = addr->addr_cbcr;
+        *cr_addr = addr->addr_cbcr;
+        break;
+    case HWC_FORMAT_SW:
+        if (!(prev_handle->usage & GRALLOC_USAGE_HW_FIMC1) || (prev_handle->paddr == 0))
+            return -1;
+        *y_addr  = prev_handle->paddr;
+        *cb_addr = prev_handle->paddr + prev_handle->uoffset;
+        *cr_addr = prev_handle->paddr + prev_handle->uoffset + prev_handle->voffset;
+        break;
+    default:
+        return -1;
+    }
 
-            if (compositionType == HWC_FRAMEBUFFER) {
-                cur->compositionType = HWC_FRAMEBUFFER;
-                ctx->num_of_fb_layer++;
-            } else {
-                ret = assign_overlay_window(ctx, cur, overlay_win_cnt, i);
-                if (ret != 0) {
-                    SEC_HWC_Log(HWC_LOG_ERROR, "assign_overlay_window fail, change to frambuffer");
-                    cur->compositionType = HWC_FRAMEBUFFER;
-                    ctx->num_of_fb_layer++;
-                    continue;
-                }
+    return (*y_addr == 0) ? -1 : 0;
+}
+
+static int get_hwc_ext_decision(hwc_layer_1_t *cur)
+{
+    uint32_t y_addr, cb_addr, cr_addr;
+
+    if (get_hwc_compos_decision(cur, 0, 0) != HWC_OVERLAY)
+        return HWC_FRAMEBUFFER;
+
+    /* the mixer scales the video layer but does not rotate it */
+    if (cur->transform != 0)
+        return HWC_FRAMEBUFFER;
+
+    if (get_ext_video_addr((private_handle_t *)cur->handle,
+                           &y_addr, &cb_addr, &cr_addr) < 0)
+        return HWC_FRAMEBUFFER;
+
+    return HWC_OVERLAY;
+}
+
+/*
+ * The mixer has one video layer below the graphic ones. The first video
+ * layer goes there and SurfaceFlinger composes everything else, at the TV
+ * resolution, into the framebuffer target which goes to a graphic layer.
+ */
+static void hwc_prepare_external(struct hwc_context_t *ctx,
+        hwc_display_contents_1_t *list)
+{
+    if (!(list->flags & HWC_GEOMETRY_CHANGED))
+        return;
+
+    ctx->ext_video_layer = -1;
+    ctx->ext_video_prev_buf = 0;
+    ctx->ext_fb_prev_buf = 0;
+    ctx->ext_layer_num = -1;
+
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+
+        if (cur->compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+
+        if ((ctx->ext_video_layer < 0) &&
+            (get_hwc_ext_decision(cur) == HWC_OVERLAY)) {
+            cur->compositionType = HWC_OVERLAY;
+            cur->hints = HWC_HINT_CLEAR_FB;
+            ctx->ext_video_layer = i;
+        } else {
+            cur->compositionType = HWC_FRAMEBUFFER;
+            cur->hints = 0;
+        }
+    }
+}
+
+/*
+ * Region of the external framebuffer target which changed since the last one
+ * went to the TV: where a layer was and where it is now, for every layer whose
+ * buffer or frame changed. The mixer video layer only punches a hole in the
+ * target, so it only counts when it moves. Empty is the whole target.
+ */
+static void get_ext_fb_damage(struct hwc_context_t *ctx,
+        hwc_display_contents_1_t *list, hwc_rect_t *damage)
+{
+    int num = 0;
+    bool full = false;
+
+    memset(damage, 0, sizeof(*damage));
+
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+        uint32_t buf;
+
+        if (cur->compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+
+        if (num >= NUM_OF_DUMMY_WIN) {
+            full = true;
+            break;
+        }
+
+        buf = (cur->compositionType == HWC_OVERLAY) ? 0 : (uint32_t)cur->handle;
+
+        if ((ctx->ext_layer_prev_buf[num] != buf) ||
+            memcmp(&ctx->ext_layer_prev_frame[num], &cur->displayFrame, sizeof(hwc_rect_t))) {
+            union_rect(damage, &ctx->ext_layer_prev_frame[num]);
+            union_rect(damage, &cur->displayFrame);
+        }
+
+        ctx->ext_layer_prev_buf[num] = buf;
+        ctx->ext_layer_prev_frame[num] = cur->displayFrame;
+        num++;
+    }
+
+    if (full || ctx->ext_layer_num != num) {
+        memset(damage, 0, sizeof(*damage));
+        ctx->ext_layer_num = full ? -1 : num;
+    }
+}
+
+static void hwc_set_external(struct hwc_context_t *ctx,
+        hwc_display_contents_1_t *list)
+{
+    android::SecHdmiClient *mHdmiClient = android::SecHdmiClient::getInstance();
+    hwc_layer_1_t *fb_target = NULL;
+    int num_of_fb_layer = 0;
+    int num_of_video_layer = (0 <= ctx->ext_video_layer) ? 1 : 0;
+
+    hwc_wait_acquire_fences(list, true);
+
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+
+        if (cur->compositionType == HWC_FRAMEBUFFER_TARGET)
+            fb_target = cur;
+        else if (cur->compositionType == HWC_FRAMEBUFFER)
+            num_of_fb_layer++;
+    }
+
+    mHdmiClient->setHdmiEnable(1);
+    mHdmiClient->setHdmiHwcLayer(num_of_video_layer);
+#ifdef SUPPORT_AUTO_UI_ROTATE
+    /* the external display is composed in its own orientation */
+    mHdmiClient->setHdmiRotate(0, num_of_video_layer);
+#endif
+
+    if (num_of_video_layer) {
+        hwc_layer_1_t *cur = &list->hwLayers[ctx->ext_video_layer];
+        private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+        uint32_t y_addr, cb_addr, cr_addr;
+
+        if (ctx->ext_video_prev_buf != (uint32_t)cur->handle) {
+            if (get_ext_video_addr(prev_handle, &y_addr, &cb_addr, &cr_addr) < 0) {
+                SEC_HWC_Log(HWC_LOG_ERROR, "%s::no physical address for format(0x%x)",
+                        __func__, prev_handle->format);
+            } else {
+                mHdmiClient->blit2Hdmi(cur->sourceCrop.right - cur->sourceCrop.left,
+                                       cur->sourceCrop.bottom - cur->sourceCrop.top,
+                                       prev_handle->format,
+                                       y_addr, cb_addr, cr_addr,
+                                       0, 0,
+                                       android::SecHdmiClient::HDMI_MODE_VIDEO,
+                                       num_of_video_layer);
+                ctx->ext_video_prev_buf = (uint32_t)cur->handle;
+            }
+        }
+    }
+
+    if (fb_target && fb_target->handle && (num_of_fb_layer || !num_of_video_layer) &&
+        (ctx->ext_fb_prev_buf != (uint32_t)fb_target->handle)) {
+        private_handle_t *prev_handle = (private_handle_t *)(fb_target->handle);
+        hwc_rect_t damage;
+
+        get_ext_fb_damage(ctx, list, &damage);
+
+        /* without a physical address the service shows the panel framebuffer */
+        hdmi_blit_ui(mHdmiClient, prev_handle->width, prev_handle->height,
+                     prev_handle->format, prev_handle->paddr, prev_handle->paddr,
+                     damage, num_of_video_layer);
+        ctx->ext_fb_prev_buf = (uint32_t)fb_target->handle;
+    }
+}
+#endif
+
+/*
+ * hwc_set() runs the FIMC for the windows in order. Set it up for the first
+ * one while preparing, so the first frame of a new geometry only queues.
+ */
+static void preconfig_fimc(struct hwc_context_t *ctx, hwc_display_contents_1_t *list)
+{
+    struct sec_img  src_img;
+    struct sec_img  dst_img;
+    struct sec_rect src_rect;
+    struct sec_rect dst_rect;
+
+    for (int i = 0; i < NUM_OF_WIN; i++) {
+        struct hwc_win_info_t *win = &ctx->win[i];
+        hwc_layer_1_t *cur;
+
+        if (win->status != HWC_WIN_RESERVED)
+            continue;
+#if defined(BOARD_USES_FIMGAPI)
+        if (i == ctx->g2d_win_idx)
+            continue;
+#endif
+        cur = &list->hwLayers[win->layer_index];
+        if (cur->compositionType != HWC_OVERLAY)
+            continue;
+
+        memset(&src_img, 0, sizeof(src_img));
+        memset(&dst_img, 0, sizeof(dst_img));
+        set_src_dst_img_rect(cur, win, &src_img, &dst_img, &src_rect, &dst_rect, i);
+
+        /* runFimc() sets it up in hwc_set() then */
+        if (fimc_preconfig(ctx, &src_img, &src_rect, &dst_img, &dst_rect,
+                           cur->transform) < 0)
+            SEC_HWC_Log(HWC_LOG_DEBUG, "%s::fimc_preconfig fail : win %d", __func__, i);
+        return;
+    }
+}
+
+static int hwc_prepare_layers(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_display_contents_1_t** displays)
+{
+
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+    int overlay_win_cnt = 0;
+    int compositionType = 0;
+    int ret;
+#if defined(BOARD_USES_FIMGAPI)
+    bool g2d_open = true;
+#endif
+
+    // Compat
+    hwc_display_contents_1_t* list = NULL;
+    if (numDisplays > 0) {
+        list = displays[0];
+    }
+
+#if defined(BOARD_USES_HDMI)
+    android::SecHdmiClient *mHdmiClient = android::SecHdmiClient::getInstance();
+    int hdmi_cable_status = (int)mHdmiClient->getHdmiCableStatus();
+
+    ctx->hdmi_cable_status = hdmi_cable_status;
+#endif
+#ifdef HWC_EXTERNAL_DISPLAY
+    ctx->ext_active = (numDisplays > HWC_DISPLAY_EXTERNAL) &&
+                      (displays[HWC_DISPLAY_EXTERNAL] != NULL);
+    if (ctx->ext_active)
+        hwc_prepare_external(ctx, displays[HWC_DISPLAY_EXTERNAL]);
+#endif
+        
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+    if (list && (!(list->flags & HWC_GEOMETRY_CHANGED))) {
+      get_hwc_ui_lay_skipdraw_decision(ctx, list);
+      return 0;
+    }
+    ctx->fb_lay_skip_initialized = 0;
+    ctx->num_of_fb_lay_skip = 0;
+    memset(&ctx->fb_damage, 0, sizeof(ctx->fb_damage));
+#ifdef GL_WA_OVLY_ALL
+    ctx->ui_skip_frame_cnt = 0;
+#endif
+        
+    for (int i = 0; i < NUM_OF_DUMMY_WIN; i++) {
+        ctx->win_virt[i].layer_prev_buf = 0;
+        ctx->win_virt[i].layer_index = -1;
+        ctx->win_virt[i].status = HWC_WIN_FREE;
+    }
+#endif
+        
+    //if geometry is not changed, there is no need to do any work here
+    if (!list || (!(list->flags & HWC_GEOMETRY_CHANGED)))
+        return 0;
+
+    ctx->stats.cur.geometry_changed = 1;
+
+    //all the windows are free here....
+    for (int i = 0 ; i < NUM_OF_WIN; i++)
+        ctx->win[i].status = HWC_WIN_FREE;
+
+    ctx->num_of_hwc_layer = 0;
+    ctx->num_of_fb_layer = 0;
+    ctx->num_2d_blit_layer = 0;
+    ctx->num_of_ext_disp_video_layer = 0;
+#if defined(BOARD_USES_FIMGAPI)
+    ctx->g2d_win_idx = -1;
+#endif
+
+    for (int i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+        private_handle_t *prev_handle = NULL;
+        if (cur->handle) {
+            prev_handle = (private_handle_t *)(cur->handle);
+            SEC_HWC_Log(HWC_LOG_DEBUG, "prev_handle->usage = %d", prev_handle->usage);
+            if (prev_handle->usage & GRALLOC_USAGE_EXTERNAL_DISP) {
+                ctx->num_of_ext_disp_layer++;
+                if ((prev_handle->usage & GRALLOC_USAGE_EXTERNAL_DISP) ||
+                    check_yuv_format((unsigned int)prev_handle->format) == 1) {
+                    ctx->num_of_ext_disp_video_layer++;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < list->numHwLayers ; i++) {
+        hwc_layer_1_t* cur = &list->hwLayers[i];
+        private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+
+#ifdef HWC_EXTERNAL_DISPLAY
+        /* composed by SurfaceFlinger, not a layer of its own */
+        if (cur->compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+#endif
+
+#if defined(BOARD_USES_FIMGAPI)
+        /*
+         * The G2D window is below the framebuffer and above the windows
+         * before it, so it only takes RGB layers from the bottom of the
+         * list up to the first framebuffer or overlay layer above them.
+         */
+        if ((ctx->num_of_fb_layer > 0) ||
+            ((0 <= ctx->g2d_win_idx) && (ctx->g2d_win_idx + 1 < overlay_win_cnt)))
+            g2d_open = false;
+
+        if (g2d_open && get_hwc_g2d_decision(ctx, cur) &&
+            (get_hwc_compos_decision(cur, 0, overlay_win_cnt) == HWC_FRAMEBUFFER)) {
+            if ((ctx->g2d_win_idx < 0) && (overlay_win_cnt < NUM_OF_WIN))
+                ctx->g2d_win_idx = overlay_win_cnt++;
+
+            if ((0 <= ctx->g2d_win_idx) &&
+                (ctx->num_2d_blit_layer < HWC_G2D_MAX_LAYER)) {
+                ctx->g2d_layer_index[ctx->num_2d_blit_layer++] = i;
+                cur->compositionType = HWC_OVERLAY;
+                cur->hints = HWC_HINT_CLEAR_FB;
+                ctx->num_of_hwc_layer++;
+                continue;
+            }
+        }
+#endif
+
+        if (overlay_win_cnt < NUM_OF_WIN) {
+            compositionType = get_hwc_compos_decision(cur, 0, overlay_win_cnt);
+
+            if (compositionType == HWC_FRAMEBUFFER) {
+                cur->compositionType = HWC_FRAMEBUFFER;
+                ctx->num_of_fb_layer++;
+            } else {
+                ret = assign_overlay_window(ctx, cur, overlay_win_cnt, i);
+                if (ret != 0) {
+                    SEC_HWC_Log(HWC_LOG_ERROR, "assign_overlay_window fail, change to frambuffer");
+                    cur->compositionType = HWC_FRAMEBUFFER;
+                    ctx->num_of_fb_layer++;
+                    continue;
+                }
 
                 cur->compositionType = HWC_OVERLAY;
                 cur->hints = HWC_HINT_CLEAR_FB;
@@ -640,9 +1419,34 @@ static int hwc_prepare(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_dis
 #endif
     }
 
+#if defined(BOARD_USES_FIMGAPI)
+    if ((0 <= ctx->g2d_win_idx) && (assign_g2d_window(ctx, list) < 0)) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "assign_g2d_window fail, change to frambuffer");
+        for (int i = 0; i < ctx->num_2d_blit_layer; i++) {
+            hwc_layer_1_t *cur = &list->hwLayers[ctx->g2d_layer_index[i]];
+            cur->compositionType = HWC_FRAMEBUFFER;
+            cur->hints = 0;
+            ctx->num_of_fb_layer++;
+        }
+        ctx->num_of_hwc_layer -= ctx->num_2d_blit_layer;
+        ctx->num_2d_blit_layer = 0;
+        window_hide(&ctx->win[ctx->g2d_win_idx]);
+        reset_win_rect_info(&ctx->win[ctx->g2d_win_idx]);
+        ctx->g2d_win_idx = -1;
+    }
+
+    /* without its G2D window for a frame the window may show anything else */
+    if (ctx->g2d_win_idx < 0)
+        ctx->g2d_prev_win_idx = -1;
+#endif
+
 #if defined(BOARD_USES_HDMI)
     mHdmiClient = android::SecHdmiClient::getInstance();
-    mHdmiClient->setHdmiHwcLayer(ctx->num_of_hwc_layer);
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* hwc_set_external() keeps the layer count of the external display */
+    if (!ctx->ext_active)
+#endif
+    mHdmiClient->setHdmiHwcLayer(ctx->num_of_hwc_layer - ctx->num_2d_blit_layer);
     if (ctx->num_of_ext_disp_video_layer > 1) {
         mHdmiClient->setExtDispLayerNum(0);
     }
@@ -662,10 +1466,45 @@ static int hwc_prepare(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_dis
         }
     }
 
+    preconfig_fimc(ctx, list);
+
     return 0;
 }
 
-static int hwc_set(hwc_composer_device_1_t *dev,
+/* pick the buffer the window is rendered into, never waiting for a vsync */
+static int get_window_buf(struct hwc_context_t *ctx, struct hwc_win_info_t *win)
+{
+    int index = window_get_free_buf(win, android_atomic_acquire_load(&ctx->vsync_time_us));
+
+    if (index < 0) {
+        /* drop the frame and let SurfaceFlinger come back with it */
+        SEC_HWC_Log(HWC_LOG_DEBUG, "%s::no free buffer, frame dropped", __func__);
+        if (ctx->procs && ctx->procs->invalidate)
+            ctx->procs->invalidate(ctx->procs);
+        return -1;
+    }
+
+    win->buf_index = index;
+    return 0;
+}
+
+static int hwc_prepare(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_display_contents_1_t** displays)
+{
+    struct hwc_context_t *ctx = (struct hwc_context_t *)dev;
+    int64_t start_ns;
+    int ret;
+
+#ifdef HWC_CAPTURE
+    capture_poll(ctx);
+#endif
+    stats_frame_begin(ctx);
+    start_ns = hwc_get_time_ns();
+    ret = hwc_prepare_layers(dev, numDisplays, displays);
+    ctx->prepare_ns = hwc_get_time_ns() - start_ns;
+    return ret;
+}
+
+static int hwc_set_layers(hwc_composer_device_1_t *dev,
                    size_t numDisplays,
                    hwc_display_contents_1_t** displays)
 {
@@ -674,6 +1513,7 @@ static int hwc_set(hwc_composer_device_1_t *dev,
     hwc_layer_1_t* cur;
     struct hwc_win_info_t   *win;
     int ret;
+    int64_t fimc_start_ns;
     int pmem_phyaddr;
     struct sec_img src_img;
     struct sec_img dst_img;
@@ -689,6 +1529,8 @@ static int hwc_set(hwc_composer_device_1_t *dev,
 #if defined(BOARD_USES_HDMI)
     int skip_hdmi_rendering = 0;
     int rotVal = 0;
+
+    android::SecHdmiClient::getInstance()->setHwcSetTime(systemTime());
 #endif
 
     // Only support one display
@@ -702,18 +1544,36 @@ static int hwc_set(hwc_composer_device_1_t *dev,
             ctx->win[i].status = HWC_WIN_FREE;
         }
         ctx->num_of_hwc_layer = 0;
-        need_swap_buffers = true;
-
-        if (list->sur == NULL && list->dpy == NULL) {
+        ctx->num_2d_blit_layer = 0;
+#if defined(BOARD_USES_FIMGAPI)
+        ctx->g2d_win_idx = -1;
+        ctx->g2d_prev_win_idx = -1;
+#endif
 #ifdef SKIP_DUMMY_UI_LAY_DRAWING
-            ctx->fb_lay_skip_initialized = 0;
+        ctx->fb_lay_skip_initialized = 0;
 #endif
-            return HWC_EGL_ERROR;
+
+        /* the panel is off, there is nothing to swap or to mirror */
+#if defined(BOARD_USES_HDMI)
+#ifdef HWC_EXTERNAL_DISPLAY
+        if (ctx->ext_active && (numDisplays > HWC_DISPLAY_EXTERNAL) &&
+            displays[HWC_DISPLAY_EXTERNAL]) {
+            hwc_set_external(ctx, displays[HWC_DISPLAY_EXTERNAL]);
+            return 0;
         }
+#endif
+        android::SecHdmiClient::getInstance()->setHdmiEnable(0);
+#endif
+        return 0;
     }
 
-    if(ctx->num_of_hwc_layer > NUM_OF_WIN)
-        ctx->num_of_hwc_layer = NUM_OF_WIN;
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* the framebuffer target is read by the display controller too */
+    hwc_wait_acquire_fences(list, true);
+#endif
+
+    if(ctx->num_of_hwc_layer - ctx->num_2d_blit_layer > NUM_OF_WIN)
+        ctx->num_of_hwc_layer = NUM_OF_WIN + ctx->num_2d_blit_layer;
 
     /*
      * H/W composer documentation states:
@@ -731,22 +1591,76 @@ static int hwc_set(hwc_composer_device_1_t *dev,
 #ifdef SKIP_DUMMY_UI_LAY_DRAWING
         if (ctx->num_of_fb_lay_skip == 0)
 #endif
+#ifdef HWC_EXTERNAL_DISPLAY
+        /* no GL context here, the panel framebuffer window goes off instead */
+        window_hide(&ctx->global_lcd_win);
+#else
         {
             glDisable(GL_SCISSOR_TEST);
             glClearColor(0, 0, 0, 0);
             glClear(GL_COLOR_BUFFER_BIT);
             glEnable(GL_SCISSOR_TEST);
             need_swap_buffers = true;
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+            memset(&ctx->fb_damage, 0, sizeof(ctx->fb_damage));
+#endif
         }
+#endif
     }
     ctx->num_of_fb_layer_prev = ctx->num_of_fb_layer;
 
     //compose hardware layers here
-    for (int i = 0; i < ctx->num_of_hwc_layer - ctx->num_2d_blit_layer; i++) {
+    for (int i = 0; i < NUM_OF_WIN; i++) {
         win = &ctx->win[i];
+        if (win->status == HWC_WIN_FREE)
+            continue;
+
         if (win->status == HWC_WIN_RESERVED) {
             cur = &list->hwLayers[win->layer_index];
 
+#if defined(BOARD_USES_FIMGAPI)
+            if (i == ctx->g2d_win_idx) {
+                hwc_layer_1_t *g2d_layer[HWC_G2D_MAX_LAYER];
+                struct hwc_g2d_lay_info g2d_info[HWC_G2D_MAX_LAYER];
+                bool g2d_changed = (ctx->g2d_prev_win_idx != i) ||
+                                   (ctx->num_of_g2d_layer_prev != ctx->num_2d_blit_layer);
+
+                for (int j = 0; j < ctx->num_2d_blit_layer; j++) {
+                    g2d_layer[j] = &list->hwLayers[ctx->g2d_layer_index[j]];
+                    get_g2d_lay_info(g2d_layer[j], &g2d_info[j]);
+                    if (!g2d_changed &&
+                        memcmp(&ctx->g2d_layer_prev[j], &g2d_info[j], sizeof(g2d_info[j])) != 0)
+                        g2d_changed = true;
+                }
+
+                /* the window still shows the same composition */
+                if (!g2d_changed) {
+                    ctx->stats.cur.num_of_dup_buf++;
+                    continue;
+                }
+
+                if (get_window_buf(ctx, win) < 0)
+                    continue;
+
+                if (runG2d(ctx, win, g2d_layer, ctx->num_2d_blit_layer) < 0) {
+                    SEC_HWC_Log(HWC_LOG_ERROR, "%s::runG2d fail", __func__);
+                    ctx->g2d_prev_win_idx = -1;
+                    skipped_window_mask |= (1 << i);
+                    continue;
+                }
+
+                memcpy(ctx->g2d_layer_prev, g2d_info, sizeof(g2d_info[0]) * ctx->num_2d_blit_layer);
+                ctx->num_of_g2d_layer_prev = ctx->num_2d_blit_layer;
+                ctx->g2d_prev_win_idx = i;
+
+                window_pan_display(win);
+
+                if (win->power_state == 0)
+                    window_show(win);
+                continue;
+            }
+#endif
+
             if (cur->compositionType == HWC_OVERLAY) {
                 if (ctx->layer_prev_buf[i] == (uint32_t)cur->handle) {
                     /*
@@ -754,21 +1668,32 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                      * double buffered (2 or more) this buffer is already rendered.
                      * It is the redundant src buffer for FIMC rendering.
                      */
+                    ctx->stats.cur.num_of_dup_buf++;
+
+#if defined(BOARD_USES_HDMI)
+                    skip_hdmi_rendering = 1;
+#endif
+                    continue;
+                }
 
+                if (get_window_buf(ctx, win) < 0) {
 #if defined(BOARD_USES_HDMI)
                     skip_hdmi_rendering = 1;
 #endif
                     continue;
                 }
+
                 ctx->layer_prev_buf[i] = (uint32_t)cur->handle;
                 // initialize the src & dist context for fimc
                 set_src_dst_img_rect(cur, win, &src_img, &dst_img,
                                 &src_work_rect, &dst_work_rect, i);
 
+                fimc_start_ns = hwc_get_time_ns();
                 ret = runFimc(ctx,
                             &src_img, &src_work_rect,
                             &dst_img, &dst_work_rect,
                             cur->transform);
+                ctx->stats.cur.fimc_us += (int32_t)((hwc_get_time_ns() - fimc_start_ns) / 1000);
 
                 if (ret < 0) {
                     SEC_HWC_Log(HWC_LOG_ERROR, "%s::runFimc fail : ret=%d\n",
@@ -779,7 +1704,6 @@ static int hwc_set(hwc_composer_device_1_t *dev,
 
                 window_pan_display(win);
 
-                win->buf_index = (win->buf_index + 1) % NUM_OF_WIN_BUF;
                 if (win->power_state == 0)
                     window_show(win);
             } else {
@@ -808,43 +1732,59 @@ static int hwc_set(hwc_composer_device_1_t *dev,
     }
 
     if (need_swap_buffers) {
-#ifdef CHECK_EGL_FPS
-        check_fps();
-#endif
+#ifdef HWC_EXTERNAL_DISPLAY
+        if (hwc_post_fb_target(ctx, list) < 0)
+            return -EINVAL;
+#else
 #ifdef HWC_HWOVERLAY
         unsigned char pixels[4];
         glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+#endif
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+        hwc_set_swap_rect(ctx, list);
 #endif
         EGLBoolean sucess = eglSwapBuffers((EGLDisplay)list->dpy, (EGLSurface)list->sur);
         if (!sucess)
             return HWC_EGL_ERROR;
+#endif
+    }
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+    else if (ctx->num_of_fb_lay_skip) {
+        ctx->stats.cur.swap_skipped = 1;
     }
+#endif
 
 #if defined(BOARD_USES_HDMI)
     android::SecHdmiClient *mHdmiClient = android::SecHdmiClient::getInstance();
 
-    if (skip_hdmi_rendering == 1)
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* SurfaceFlinger drives the TV as a display of its own, nothing to mirror */
+    if (ctx->ext_active) {
+        if ((numDisplays > HWC_DISPLAY_EXTERNAL) && displays[HWC_DISPLAY_EXTERNAL])
+            hwc_set_external(ctx, displays[HWC_DISPLAY_EXTERNAL]);
         return 0;
+    }
+#endif
 
-    if (list == NULL) {
-        // Don't display unnecessary image
-        mHdmiClient->setHdmiEnable(0);
+    if (skip_hdmi_rendering == 1)
         return 0;
-    } else {
-        mHdmiClient->setHdmiEnable(1);
-    }
+
+    mHdmiClient->setHdmiEnable(1);
+
+    /* layers composed by G2D are UI, the HDMI path only follows the FIMC ones */
+    int num_of_video_layer = ctx->num_of_hwc_layer - ctx->num_2d_blit_layer;
 
 #ifdef SUPPORT_AUTO_UI_ROTATE
     cur = &list->hwLayers[0];
 
     if (cur->transform == HAL_TRANSFORM_ROT_90 || cur->transform == HAL_TRANSFORM_ROT_270)
-        mHdmiClient->setHdmiRotate(270, ctx->num_of_hwc_layer);
+        mHdmiClient->setHdmiRotate(270, num_of_video_layer);
     else
-        mHdmiClient->setHdmiRotate(0, ctx->num_of_hwc_layer);
+        mHdmiClient->setHdmiRotate(0, num_of_video_layer);
 #endif
 
     // To support S3D video playback (automatic TV mode change to 3D mode)
-    if (ctx->num_of_hwc_layer == 1) {
+    if (num_of_video_layer == 1) {
         if (src_img.usage != prev_usage)
             mHdmiClient->setHdmiResolution(DEFAULT_HDMI_RESOLUTION_VALUE, android::SecHdmiClient::HDMI_2D);    // V4L2_STD_1080P_60
 
@@ -866,7 +1806,7 @@ static int hwc_set(hwc_composer_device_1_t *dev,
         prev_usage = 0;
     }
 
-    if (ctx->num_of_hwc_layer == 1) {
+    if (num_of_video_layer == 1) {
         if ((src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED)||
                 (src_img.format == HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP)) {
             ADDRS * addr = (ADDRS *)(src_img.base);
@@ -875,7 +1815,7 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                                     (unsigned int)addr->addr_y, (unsigned int)addr->addr_cbcr, (unsigned int)addr->addr_cbcr,
                                     0, 0,
                                     android::SecHdmiClient::HDMI_MODE_VIDEO,
-                                    ctx->num_of_hwc_layer);
+                                    num_of_video_layer);
         } else if ((src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_SP) ||
                     (src_img.format == HAL_PIXEL_FORMAT_YCrCb_420_SP) ||
                     (src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_P) ||
@@ -887,21 +1827,79 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                                     (unsigned int)ctx->fimc.params.src.buf_addr_phy_cr,
                                     0, 0,
                                     android::SecHdmiClient::HDMI_MODE_VIDEO,
-                                    ctx->num_of_hwc_layer);
+                                    num_of_video_layer);
         } else {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s: Unsupported format = %d", __func__, src_img.format);
         }
+    } else if (need_swap_buffers) {
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+        hwc_rect_t damage = ctx->fb_damage;
+#else
+        hwc_rect_t damage = {0, 0, 0, 0};
+#endif
+        struct fb_var_screeninfo var;
+        uint32_t fb_buf = 0;
+
+        /* the damage is relative to the buffer this swap posted, tell the TV which one */
+        if (ioctl(ctx->global_lcd_win.fd, FBIOGET_VSCREENINFO, &var) == 0)
+            fb_buf = HDMI_FB_YOFFSET_VALID | var.yoffset;
+
+        /* the TV mirrors the panel framebuffer (address 0), re-scale what this post changed */
+        hdmi_blit_ui(mHdmiClient, ctx->lcd_info.xres, ctx->lcd_info.yres,
+                     HAL_PIXEL_FORMAT_BGRA_8888, 0, fb_buf, damage, 0);
     }
 #endif
 
     return 0;
 }
 
+static int hwc_set(hwc_composer_device_1_t *dev,
+                   size_t numDisplays,
+                   hwc_display_contents_1_t** displays)
+{
+    struct hwc_context_t *ctx = (struct hwc_context_t *)dev;
+    int64_t start_ns;
+    int64_t set_ns;
+    int ret;
+
+    start_ns = hwc_get_time_ns();
+    ret = hwc_set_layers(dev, numDisplays, displays);
+    set_ns = hwc_get_time_ns() - start_ns;
+
+    stats_frame_end(ctx, ctx->prepare_ns, set_ns);
+#ifdef HWC_CAPTURE
+    if (numDisplays > 0)
+        capture_frame(ctx, displays[0], set_ns);
+#endif
+    return ret;
+}
+
 static void hwc_registerProcs(struct hwc_composer_device_1* dev,
         hwc_procs_t const* procs)
 {
     struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
     ctx->procs = const_cast<hwc_procs_t *>(procs);
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* a TV plugged in before SurfaceFlinger came up, reported from the thread */
+    if (ctx->ext_connected) {
+        android_atomic_release_store(1, &ctx->ext_hotplug_pending);
+#ifdef SYSFS_VSYNC_NOTIFICATION
+        char cmd = 'h';
+        if (write(ctx->vsync.ctl_pipe[1], &cmd, 1) < 0)
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::write fail : %s", __func__, strerror(errno));
+#endif
+    }
+#endif
+}
+
+static void hwc_dump(struct hwc_composer_device_1* dev, char *buff, int buff_len)
+{
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+
+    if (buff_len <= 0)
+        return;
+
+    stats_dump(ctx, buff, buff_len);
 }
 
 static int hwc_query(struct hwc_composer_device_1* dev,
@@ -918,6 +1916,11 @@ static int hwc_query(struct hwc_composer_device_1* dev,
         // vsync period in nanosecond
         value[0] = 1000000000.0 / 57;
         break;
+#ifdef HWC_EXTERNAL_DISPLAY
+    case HWC_DISPLAY_TYPES_SUPPORTED:
+        value[0] = HWC_DISPLAY_PRIMARY_BIT | HWC_DISPLAY_EXTERNAL_BIT;
+        break;
+#endif
     default:
         // unsupported query
         return -EINVAL;
@@ -925,6 +1928,318 @@ static int hwc_query(struct hwc_composer_device_1* dev,
     return 0;
 }
 
+#ifdef SYSFS_VSYNC_NOTIFICATION
+static void vsync_deliver(hwc_context_t *ctx, int64_t timestamp)
+{
+    /* interrupt or predicted, this is the vsync the frame starts from */
+    android_atomic_release_store((int32_t)(timestamp / 1000), &ctx->vsync_delivered_us);
+
+    if (ctx->procs && ctx->procs->vsync)
+        ctx->procs->vsync(ctx->procs, 0, timestamp);
+}
+
+/*
+ * An interrupt: the phase snaps to it and the period follows the measured
+ * one slowly. The error against the prediction is the jitter.
+ */
+static void vsync_update_model(struct hwc_vsync_info *vsync, int64_t timestamp)
+{
+    int64_t num_frames;
+    int64_t err;
+
+    if ((vsync->phase_ns == 0) || (timestamp <= vsync->phase_ns)) {
+        vsync->phase_ns = timestamp;
+        vsync->num_locked = 0;
+        return;
+    }
+
+    num_frames = (timestamp - vsync->phase_ns + vsync->period_ns / 2) / vsync->period_ns;
+    if (num_frames < 1)
+        num_frames = 1;
+
+    err = timestamp - (vsync->phase_ns + num_frames * vsync->period_ns);
+    if (err < 0)
+        err = -err;
+
+    vsync->period_ns += ((timestamp - vsync->phase_ns) / num_frames - vsync->period_ns) / 8;
+    vsync->phase_ns = timestamp;
+
+    if (err < HWC_VSYNC_LOCK_ERR_NS) {
+        if (vsync->num_locked < HWC_VSYNC_LOCK_FRAMES)
+            vsync->num_locked++;
+    } else {
+        vsync->num_locked = 0;
+    }
+
+    if (vsync->resync) {
+        vsync->stat_resync_err_max_ns = SEC_MAX(vsync->stat_resync_err_max_ns, err);
+        vsync->resync = 0;
+    }
+
+    vsync->stat_err_sum_ns += err;
+    vsync->stat_err_max_ns = SEC_MAX(vsync->stat_err_max_ns, err);
+    if (++vsync->stat_cnt == HWC_VSYNC_STATS_FRAMES) {
+        ALOGD("vsync period %lld ns, jitter avg %lld max %lld ns, "
+              "resync error max %lld ns, %u predicted",
+              vsync->period_ns, vsync->stat_err_sum_ns / vsync->stat_cnt,
+              vsync->stat_err_max_ns, vsync->stat_resync_err_max_ns,
+              vsync->stat_predicted);
+        vsync->stat_cnt = 0;
+        vsync->stat_predicted = 0;
+        vsync->stat_err_sum_ns = 0;
+        vsync->stat_err_max_ns = 0;
+        vsync->stat_resync_err_max_ns = 0;
+    }
+}
+
+/* called with vsync.lock held */
+static void vsync_set_hw(hwc_context_t *ctx, int enable)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    int val = !!enable;
+
+    if (vsync->hw_enabled == val)
+        return;
+
+    if (ioctl(ctx->global_lcd_win.fd, S3CFB_SET_VSYNC_INT, &val) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::S3CFB_SET_VSYNC_INT(%d) fail : %s",
+                __func__, val, strerror(errno));
+        return;
+    }
+
+    vsync->hw_enabled = val;
+    vsync->num_predicted = 0;
+}
+
+static int64_t vsync_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* called with vsync.lock held */
+static void vsync_skip_to_next(struct hwc_vsync_info *vsync, int64_t now)
+{
+    if (vsync->next_ns <= now)
+        vsync->next_ns = vsync->phase_ns +
+            ((now - vsync->phase_ns) / vsync->period_ns + 1) * vsync->period_ns;
+}
+
+/*
+ * The interrupt is only kept on until the model locks to it, after that
+ * vsyncs are predicted and the interrupt comes back every
+ * HWC_VSYNC_PREDICT_FRAMES to check the model.
+ */
+static int vsync_set_enabled(hwc_context_t *ctx, int enabled)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    char cmd = 'v';
+
+    pthread_mutex_lock(&vsync->lock);
+
+    vsync->enabled = !!enabled;
+    if (!vsync->enabled) {
+        vsync_set_hw(ctx, 0);
+    } else if ((vsync->num_locked < HWC_VSYNC_LOCK_FRAMES) ||
+               (HWC_VSYNC_PREDICT_FRAMES * vsync->period_ns <
+                vsync_now_ns() - vsync->phase_ns)) {
+        /* not locked, or the model was not checked for too long */
+        if (vsync->num_locked == HWC_VSYNC_LOCK_FRAMES) {
+            vsync->num_locked--;
+            vsync->resync = 1;
+        }
+        vsync_set_hw(ctx, 1);
+    } else {
+        vsync_skip_to_next(vsync, vsync_now_ns());
+    }
+
+    pthread_mutex_unlock(&vsync->lock);
+
+    if (write(vsync->ctl_pipe[1], &cmd, 1) < 0)
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::write fail : %s", __func__, strerror(errno));
+
+    return 0;
+}
+
+static void vsync_handle_hw(hwc_context_t *ctx)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    char buf[32];
+    int64_t timestamp;
+    bool deliver;
+    ssize_t len;
+
+    len = pread(vsync->node_fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return;
+    buf[len] = '\0';
+    timestamp = strtoull(buf, NULL, 0);
+
+    /* predicted vsyncs are not exact enough to release overlay buffers */
+    android_atomic_release_store((int32_t)(timestamp / 1000), &ctx->vsync_time_us);
+
+    pthread_mutex_lock(&vsync->lock);
+
+    vsync_update_model(vsync, timestamp);
+    vsync->next_ns = vsync->phase_ns + vsync->period_ns;
+
+    /* the last predicted vsync may have been this one already */
+    deliver = vsync->enabled && (vsync->period_ns / 2 < timestamp - vsync->last_ns);
+    if (deliver)
+        vsync->last_ns = timestamp;
+
+    vsync_set_hw(ctx, vsync->enabled && (vsync->num_locked < HWC_VSYNC_LOCK_FRAMES));
+
+    pthread_mutex_unlock(&vsync->lock);
+
+    if (deliver)
+        vsync_deliver(ctx, timestamp);
+}
+
+static void vsync_handle_predicted(hwc_context_t *ctx)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    int64_t timestamp;
+    int64_t now;
+
+    pthread_mutex_lock(&vsync->lock);
+
+    if (!vsync->enabled || vsync->hw_enabled) {
+        pthread_mutex_unlock(&vsync->lock);
+        return;
+    }
+
+    /* epoll_wait() only waits in ms, sleep the rest */
+    now = vsync_now_ns();
+    if (now < vsync->next_ns) {
+        struct timespec ts;
+        ts.tv_sec  = 0;
+        ts.tv_nsec = vsync->next_ns - now;
+        pthread_mutex_unlock(&vsync->lock);
+        nanosleep(&ts, NULL);
+        pthread_mutex_lock(&vsync->lock);
+
+        if (!vsync->enabled || vsync->hw_enabled) {
+            pthread_mutex_unlock(&vsync->lock);
+            return;
+        }
+        now = vsync_now_ns();
+    }
+
+    timestamp = vsync->next_ns;
+    vsync_skip_to_next(vsync, now);
+    vsync->last_ns = timestamp;
+    vsync->stat_predicted++;
+
+    if (HWC_VSYNC_PREDICT_FRAMES <= ++vsync->num_predicted) {
+        vsync->num_locked--;
+        vsync->resync = 1;
+        vsync_set_hw(ctx, 1);
+    }
+
+    pthread_mutex_unlock(&vsync->lock);
+
+    vsync_deliver(ctx, timestamp);
+}
+
+/* the uevent socket belongs to libhardware_legacy, it is not closed here */
+static void vsync_close(hwc_context_t *ctx)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+
+    if (0 <= vsync->epoll_fd)
+        close(vsync->epoll_fd);
+    if (0 <= vsync->ctl_pipe[0])
+        close(vsync->ctl_pipe[0]);
+    if (0 <= vsync->ctl_pipe[1])
+        close(vsync->ctl_pipe[1]);
+    if (0 <= vsync->node_fd)
+        close(vsync->node_fd);
+
+    vsync->epoll_fd    = -1;
+    vsync->ctl_pipe[0] = -1;
+    vsync->ctl_pipe[1] = -1;
+    vsync->node_fd     = -1;
+    vsync->uevent_fd   = -1;
+
+    pthread_mutex_destroy(&vsync->lock);
+}
+
+static int vsync_open(hwc_context_t *ctx)
+{
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    struct epoll_event event;
+    char buf[32];
+
+    pthread_mutex_init(&vsync->lock, NULL);
+    vsync->period_ns = HWC_VSYNC_PERIOD_US * 1000LL;
+    vsync->epoll_fd = -1;
+    vsync->ctl_pipe[0] = -1;
+    vsync->ctl_pipe[1] = -1;
+    vsync->uevent_fd = -1;
+
+    vsync->node_fd = open(VSYNC_TIME_NODE, O_RDONLY);
+    if (vsync->node_fd < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::open(%s) fail : %s",
+                __func__, VSYNC_TIME_NODE, strerror(errno));
+        goto err;
+    }
+
+    /* sysfs only notifies a node which was read */
+    if (pread(vsync->node_fd, buf, sizeof(buf), 0) < 0)
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::pread fail : %s", __func__, strerror(errno));
+
+    if (pipe(vsync->ctl_pipe) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::pipe fail : %s", __func__, strerror(errno));
+        goto err;
+    }
+
+    vsync->epoll_fd = epoll_create(3);
+    if (vsync->epoll_fd < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::epoll_create fail : %s", __func__, strerror(errno));
+        goto err;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events  = EPOLLPRI | EPOLLERR;
+    event.data.fd = vsync->node_fd;
+    if (epoll_ctl(vsync->epoll_fd, EPOLL_CTL_ADD, vsync->node_fd, &event) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::epoll_ctl(node) fail : %s", __func__, strerror(errno));
+        goto err;
+    }
+
+    event.events  = EPOLLIN;
+    event.data.fd = vsync->ctl_pipe[0];
+    if (epoll_ctl(vsync->epoll_fd, EPOLL_CTL_ADD, vsync->ctl_pipe[0], &event) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::epoll_ctl(pipe) fail : %s", __func__, strerror(errno));
+        goto err;
+    }
+
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* the HDMI switch uevents come to this thread too */
+    if (uevent_init() && (0 <= uevent_get_fd())) {
+        vsync->uevent_fd = uevent_get_fd();
+        event.events  = EPOLLIN;
+        event.data.fd = vsync->uevent_fd;
+        if (epoll_ctl(vsync->epoll_fd, EPOLL_CTL_ADD, vsync->uevent_fd, &event) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::epoll_ctl(uevent) fail : %s", __func__, strerror(errno));
+            goto err;
+        }
+    } else {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::uevent_init fail, no HDMI hotplug", __func__);
+    }
+#endif
+
+    return 0;
+
+err:
+    vsync_close(ctx);
+    return -1;
+}
+#endif
+
 static int hwc_eventControl(struct hwc_composer_device_1* dev, int dpy,
         int event, int enabled)
 {
@@ -932,44 +2247,150 @@ static int hwc_eventControl(struct hwc_composer_device_1* dev, int dpy,
 
     switch (event) {
     case HWC_EVENT_VSYNC:
+#ifdef SYSFS_VSYNC_NOTIFICATION
+        return vsync_set_enabled(ctx, enabled);
+#else
         int val = !!enabled;
         int err = ioctl(ctx->global_lcd_win.fd, S3CFB_SET_VSYNC_INT, &val);
         if (err < 0)
             return -errno;
         
         return 0;
+#endif
     }
     return -EINVAL;
 }
 
+#ifdef HWC_EXTERNAL_DISPLAY
+static int hwc_getDisplayConfigs(struct hwc_composer_device_1 *dev, int disp,
+        uint32_t *configs, size_t *numConfigs)
+{
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+
+    if (*numConfigs == 0)
+        return 0;
+
+    switch (disp) {
+    case HWC_DISPLAY_PRIMARY:
+        break;
+    case HWC_DISPLAY_EXTERNAL:
+        if (!ctx->ext_connected)
+            return -EINVAL;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    configs[0] = 0;
+    *numConfigs = 1;
+    return 0;
+}
+
+static int hwc_getDisplayAttributes(struct hwc_composer_device_1 *dev, int disp,
+        uint32_t config, const uint32_t *attributes, int32_t *values)
+{
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+
+    if ((disp != HWC_DISPLAY_PRIMARY) && (disp != HWC_DISPLAY_EXTERNAL))
+        return -EINVAL;
+
+    for (int i = 0; attributes[i] != HWC_DISPLAY_NO_ATTRIBUTE; i++) {
+        switch (attributes[i]) {
+        case HWC_DISPLAY_VSYNC_PERIOD:
+            values[i] = (disp == HWC_DISPLAY_PRIMARY) ?
+                        1000000000.0 / 57 :
+                        1000000000.0 / hwc_ext_refresh_rate(DEFAULT_HDMI_RESOLUTION_VALUE);
+            break;
+        case HWC_DISPLAY_WIDTH:
+            values[i] = (disp == HWC_DISPLAY_PRIMARY) ?
+                        ctx->lcd_info.xres : DEFALULT_DISPLAY_WIDTH;
+            break;
+        case HWC_DISPLAY_HEIGHT:
+            values[i] = (disp == HWC_DISPLAY_PRIMARY) ?
+                        ctx->lcd_info.yres : DEFALULT_DISPLAY_HEIGHT;
+            break;
+        case HWC_DISPLAY_DPI_X:
+            /* dots per thousand inches, 0 when the panel size is unknown */
+            if ((disp == HWC_DISPLAY_PRIMARY) && ((int)ctx->lcd_info.width > 0))
+                values[i] = (ctx->lcd_info.xres * 25400) / ctx->lcd_info.width;
+            else
+                values[i] = 0;
+            break;
+        case HWC_DISPLAY_DPI_Y:
+            if ((disp == HWC_DISPLAY_PRIMARY) && ((int)ctx->lcd_info.height > 0))
+                values[i] = (ctx->lcd_info.yres * 25400) / ctx->lcd_info.height;
+            else
+                values[i] = 0;
+            break;
+        default:
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::unknown attribute %d",
+                    __func__, attributes[i]);
+            return -EINVAL;
+        }
+    }
+
+    return 0;
+}
+#endif
+
 #ifdef SYSFS_VSYNC_NOTIFICATION
 static void *hwc_vsync_sysfs_loop(void *data)
 {
-    static char buf[4096];
-    int vsync_timestamp_fd;
-    fd_set exceptfds;
-    int res;
-    int64_t timestamp = 0;
     hwc_context_t * ctx = (hwc_context_t *)(data);
-
-    vsync_timestamp_fd = open("/sys/devices/platform/samsung-pd.2/s3cfb.0/vsync_time", O_RDONLY);
+    struct hwc_vsync_info *vsync = &ctx->vsync;
+    struct epoll_event events[3];
     char thread_name[64] = "hwcVsyncThread";
+    char cmd[16];
+#ifdef HWC_EXTERNAL_DISPLAY
+    char uevent_desc[4096];
+#endif
+
     prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
     setpriority(PRIO_PROCESS, 0, -20);
-    memset(buf, 0, sizeof(buf));
-    
+
     SEC_HWC_Log(HWC_LOG_DEBUG,"Using sysfs mechanism for VSYNC notification");
 
-    FD_ZERO(&exceptfds);
-    FD_SET(vsync_timestamp_fd, &exceptfds);
-    do {
-        ssize_t len = read(vsync_timestamp_fd, buf, sizeof(buf));
-        timestamp = strtoull(buf, NULL, 0);
-        if(ctx->procs)
-            ctx->procs->vsync(ctx->procs, 0, timestamp);
-        select(vsync_timestamp_fd + 1, NULL, NULL, &exceptfds, NULL);
-        lseek(vsync_timestamp_fd, 0, SEEK_SET);
-    } while (1);
+    while (true) {
+        int timeout = -1;
+        int num;
+
+        pthread_mutex_lock(&vsync->lock);
+        if (vsync->enabled && !vsync->hw_enabled) {
+            int64_t wait_ns = vsync->next_ns - vsync_now_ns();
+            timeout = (0 < wait_ns) ? (int)(wait_ns / 1000000) : 0;
+        }
+        pthread_mutex_unlock(&vsync->lock);
+
+        num = epoll_wait(vsync->epoll_fd, events, 3, timeout);
+        if (num < 0) {
+            if (errno != EINTR)
+                SEC_HWC_Log(HWC_LOG_ERROR, "%s::epoll_wait fail : %s",
+                        __func__, strerror(errno));
+            continue;
+        }
+
+        if (num == 0) {
+            vsync_handle_predicted(ctx);
+            continue;
+        }
+
+        for (int i = 0; i < num; i++) {
+            if (events[i].data.fd == vsync->node_fd) {
+                vsync_handle_hw(ctx);
+#ifdef HWC_EXTERNAL_DISPLAY
+            } else if (events[i].data.fd == vsync->uevent_fd) {
+                memset(uevent_desc, 0, sizeof(uevent_desc));
+                int len = uevent_next_event(uevent_desc, sizeof(uevent_desc) - 2);
+                hwc_ext_handle_uevent(ctx, uevent_desc, len);
+#endif
+            } else if (read(vsync->ctl_pipe[0], cmd, sizeof(cmd)) < 0) {
+                SEC_HWC_Log(HWC_LOG_ERROR, "%s::read fail : %s", __func__, strerror(errno));
+            }
+        }
+#ifdef HWC_EXTERNAL_DISPLAY
+        hwc_ext_hotplug(ctx);
+#endif
+    }
 
     return NULL;
 }
@@ -980,9 +2401,6 @@ void handle_vsync_uevent(hwc_context_t *ctx, const char *buff, int len)
     uint64_t timestamp = 0;
     const char *s = buff;
 
-    if(!ctx->procs || !ctx->procs->vsync)
-       return;
-
     s += strlen(s) + 1;
 
     while(*s) {
@@ -994,6 +2412,12 @@ void handle_vsync_uevent(hwc_context_t *ctx, const char *buff, int len)
             break;
     }
 
+    android_atomic_release_store((int32_t)(timestamp / 1000), &ctx->vsync_time_us);
+    android_atomic_release_store((int32_t)(timestamp / 1000), &ctx->vsync_delivered_us);
+
+    if(!ctx->procs || !ctx->procs->vsync)
+       return;
+
     ctx->procs->vsync(ctx->procs, 0, timestamp);
 }
 
@@ -1013,6 +2437,11 @@ static void *hwc_vsync_thread(void *data)
         bool vsync = !strcmp(uevent_desc, "change@/devices/platform/samsung-pd.2/s3cfb.0");
         if(vsync)
             handle_vsync_uevent(ctx, uevent_desc, len);
+#ifdef HWC_EXTERNAL_DISPLAY
+        else
+            hwc_ext_handle_uevent(ctx, uevent_desc, len);
+        hwc_ext_hotplug(ctx);
+#endif
     }
 
     return NULL;
@@ -1039,6 +2468,14 @@ static int hwc_device_close(struct hw_device_t *dev)
                 SEC_HWC_Log(HWC_LOG_DEBUG, "%s::window_close() fail", __func__);
         }
 
+        bounce_buf_free(ctx);
+#ifdef HWC_CAPTURE
+        capture_close(ctx);
+#endif
+#ifdef HWC_EXTERNAL_DISPLAY
+        if (ctx->fb_dev)
+            framebuffer_close(ctx->fb_dev);
+#endif
         free(ctx);
     }
     return ret;
@@ -1065,6 +2502,8 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     int status = 0;
     int err    = 0;
     struct hwc_win_info_t   *win;
+    char value[PROPERTY_VALUE_MAX];
+    int num_of_win_buf;
 
     if (strcmp(name, HWC_HARDWARE_COMPOSER))
         return  -EINVAL;
@@ -1077,7 +2516,11 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
 
     /* initialize the procs */
     dev->device.common.tag           = HARDWARE_DEVICE_TAG;
+#ifdef HWC_EXTERNAL_DISPLAY
+    dev->device.common.version       = HWC_DEVICE_API_VERSION_1_1;
+#else
     dev->device.common.version       = HWC_DEVICE_API_VERSION_1_0;
+#endif
     dev->device.common.module        = const_cast<hw_module_t*>(module);
     dev->device.common.close         = hwc_device_close;
     dev->device.prepare              = hwc_prepare;
@@ -1086,10 +2529,27 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     dev->device.blank                = hwc_blank;
     dev->device.query                = hwc_query;
     dev->device.registerProcs        = hwc_registerProcs;
+    dev->device.dump                 = hwc_dump;
+#ifdef HWC_EXTERNAL_DISPLAY
+    dev->device.getDisplayConfigs    = hwc_getDisplayConfigs;
+    dev->device.getDisplayAttributes = hwc_getDisplayAttributes;
+#endif
     *device = &dev->device.common;
 
     //initializing
     memset(&(dev->fimc),    0, sizeof(s5p_fimc_t));
+    dev->fimc_cfg_valid = 0;
+    bounce_buf_init(dev);
+#if defined(BOARD_USES_FIMGAPI)
+    dev->g2d_win_idx = -1;
+    dev->g2d_prev_win_idx = -1;
+#endif
+#ifdef HWC_EXTERNAL_DISPLAY
+    dev->ext_video_layer = -1;
+#endif
+#ifdef HWC_CAPTURE
+    dev->capture_fd = -1;
+#endif
 
     /* open WIN0 & WIN1 here */
     for (int i = 0; i < NUM_OF_WIN; i++) {
@@ -1121,18 +2581,51 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     lcd_height  = dev->lcd_info.yres;
 #endif
 
+#ifdef HWC_EXTERNAL_DISPLAY
+    /* SurfaceFlinger leaves the framebuffer HAL to a HWC 1.1 */
+    {
+        const hw_module_t *gralloc_module;
+
+        if ((hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &gralloc_module) < 0) ||
+            (framebuffer_open(gralloc_module, &dev->fb_dev) < 0)) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::can not open the framebuffer HAL", __func__);
+            dev->fb_dev = NULL;
+            status = -EINVAL;
+            goto err;
+        }
+    }
+    /* the framebuffer HAL has it on */
+    dev->global_lcd_win.power_state = 1;
+    dev->ext_connected = hwc_ext_read_switch();
+#endif
+
+    property_get("debug.hwc.winbuf", value, "0");
+    num_of_win_buf = atoi(value);
+    if ((num_of_win_buf < 2) || (MAX_NUM_OF_WIN_BUF < num_of_win_buf))
+        num_of_win_buf = NUM_OF_WIN_BUF;
+
     /* initialize the window context */
     for (int i = 0; i < NUM_OF_WIN; i++) {
         win = &dev->win[i];
         memcpy(&win->lcd_info, &dev->lcd_info, sizeof(struct fb_var_screeninfo));
         memcpy(&win->var_info, &dev->lcd_info, sizeof(struct fb_var_screeninfo));
+        win->lcd_info.yoffset = 0;
+        win->num_of_buf = num_of_win_buf;
 
         win->rect_info.x = 0;
         win->rect_info.y = 0;
         win->rect_info.w = win->var_info.xres;
         win->rect_info.h = win->var_info.yres;
 
-       if (window_set_pos(win) < 0) {
+        err = window_set_pos(win);
+        if ((err < 0) && (NUM_OF_WIN_BUF < win->num_of_buf)) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::win-%d can not take %d buffers, using %d",
+                    __func__, i, win->num_of_buf, NUM_OF_WIN_BUF);
+            win->num_of_buf = NUM_OF_WIN_BUF;
+            err = window_set_pos(win);
+        }
+
+       if (err < 0) {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s::window_set_pos is failed : %s",
                     __func__, strerror(errno));
             status = -EINVAL;
@@ -1165,9 +2658,15 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
 #endif
 
 #ifdef SYSFS_VSYNC_NOTIFICATION
+    if (vsync_open(dev) < 0) {
+        status = -EINVAL;
+        goto err;
+    }
+
     err = pthread_create(&dev->vsync_thread, NULL, hwc_vsync_sysfs_loop, dev);
     if (err) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::pthread_create() failed : %s", __func__, strerror(err));
+        vsync_close(dev);
         status = -err;
         goto err;
     }
@@ -1178,6 +2677,10 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     return 0;
 
 err:
+#ifdef HWC_EXTERNAL_DISPLAY
+    if (dev->fb_dev)
+        framebuffer_close(dev->fb_dev);
+#endif
     if (destroyFimc(&dev->fimc) < 0)
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::destroyFimc() fail", __func__);
 
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <cutils/properties.h>
+
+#include "SecHWCUtils.h"
+#include "gralloc_priv.h"
+
+int64_t hwc_get_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#ifdef HWC_CAPTURE
+void capture_close(struct hwc_context_t *ctx)
+{
+    if (ctx->capture_fd < 0)
+        return;
+
+    close(ctx->capture_fd);
+    ctx->capture_fd = -1;
+    ALOGD("%s::capture stopped after %u frames", __func__, ctx->capture_frame);
+}
+
+void capture_poll(struct hwc_context_t *ctx)
+{
+    char path[PROPERTY_VALUE_MAX];
+    struct hwc_capture_header header;
+
+    if (ctx->capture_poll_cnt++ % HWC_CAPTURE_POLL_FRAMES)
+        return;
+
+    property_get(HWC_CAPTURE_PROP, path, "");
+    if (path[0] == '\0') {
+        capture_close(ctx);
+        ctx->capture_failed = 0;
+        return;
+    }
+
+    if (ctx->capture_fd >= 0 || ctx->capture_failed)
+        return;
+
+    ctx->capture_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (ctx->capture_fd < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::open(%s) fail (%s)",
+                __func__, path, strerror(errno));
+        ctx->capture_failed = 1;
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic      = HWC_CAPTURE_MAGIC;
+    header.version    = HWC_CAPTURE_VERSION;
+    header.lcd_width  = ctx->lcd_info.xres;
+    header.lcd_height = ctx->lcd_info.yres;
+    header.num_of_win = NUM_OF_WIN;
+
+    if (write(ctx->capture_fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::write header fail (%s)",
+                __func__, strerror(errno));
+        capture_close(ctx);
+        ctx->capture_failed = 1;
+        return;
+    }
+
+    ctx->capture_frame = 0;
+    ALOGD("%s::capturing to %s", __func__, path);
+}
+
+void capture_frame(struct hwc_context_t *ctx, hwc_display_contents_1_t *list, int64_t set_ns)
+{
+    struct hwc_capture_frame  frame;
+    struct hwc_capture_layer  layer[HWC_CAPTURE_MAX_LAYER];
+    struct iovec iov[2];
+    ssize_t size;
+    uint32_t i;
+
+    if (ctx->capture_fd < 0 || list == NULL)
+        return;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.frame             = ctx->capture_frame;
+    frame.flags             = list->flags;
+    frame.num_of_layer      = list->numHwLayers;
+    if (HWC_CAPTURE_MAX_LAYER < frame.num_of_layer)
+        frame.num_of_layer  = HWC_CAPTURE_MAX_LAYER;
+    frame.num_of_hwc_layer  = ctx->num_of_hwc_layer;
+    frame.num_of_fb_layer   = ctx->num_of_fb_layer;
+    frame.num_2d_blit_layer = ctx->num_2d_blit_layer;
+    frame.time_ns           = hwc_get_time_ns();
+    frame.prepare_ns        = ctx->prepare_ns;
+    frame.set_ns            = set_ns;
+
+    memset(layer, 0, sizeof(layer[0]) * frame.num_of_layer);
+    for (i = 0; i < frame.num_of_layer; i++) {
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+        private_handle_t *prev_handle = (private_handle_t *)(cur->handle);
+
+        layer[i].composition_type = cur->compositionType;
+        layer[i].hints            = cur->hints;
+        layer[i].flags            = cur->flags;
+        layer[i].handle           = (uint32_t)cur->handle;
+        layer[i].transform        = cur->transform;
+        layer[i].blending         = cur->blending;
+        layer[i].source_crop      = cur->sourceCrop;
+        layer[i].display_frame    = cur->displayFrame;
+        if (prev_handle) {
+            layer[i].format       = prev_handle->format;
+            layer[i].width        = prev_handle->width;
+            layer[i].height       = prev_handle->height;
+            layer[i].stride       = prev_handle->stride;
+            layer[i].usage        = prev_handle->usage;
+        }
+    }
+
+    iov[0].iov_base = &frame;
+    iov[0].iov_len  = sizeof(frame);
+    iov[1].iov_base = layer;
+    iov[1].iov_len  = sizeof(layer[0]) * frame.num_of_layer;
+
+    size = writev(ctx->capture_fd, iov, 2);
+    if (size != (ssize_t)(iov[0].iov_len + iov[1].iov_len)) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::write frame %u fail (%s)",
+                __func__, ctx->capture_frame, strerror(errno));
+        capture_close(ctx);
+        ctx->capture_failed = 1;
+        return;
+    }
+
+    ctx->capture_frame++;
+}
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * What the HWC decides from the gralloc format of a layer, the FIMC side
+ * of a format is in sec_fimc_format.h. Include it after sec_format.h.
+ */
+
+#ifndef ANDROID_SEC_HWC_FORMAT_H_
+#define ANDROID_SEC_HWC_FORMAT_H_
+
+/* how a layer of the format can reach a window */
+enum {
+    HWC_FORMAT_FB = 0,      /* composed by GLES (or G2D) only */
+    HWC_FORMAT_MFC,         /* MFC output, handle->base points to the ADDRS of the frame */
+    HWC_FORMAT_SW,          /* software codec output, FIMC reads it at handle->paddr
+                               or from a bounce copy, opaque layers only */
+};
+
+/*
+ * One line per format:
+ *   F(hal format, overlay, frame padded)
+ * A padded frame is allocated with its width rounded up to 16 and its
+ * height to 2, the codec strides. The smallest layer FIMC takes is the same
+ * for every format (HWC_FIMC_MIN_*), with a rotation of 90/270 the
+ * destination limits swap. The HDMI mixer rotates none of them.
+ */
+#define SEC_HWC_FORMAT_LIST(F)                                              \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP,         HWC_FORMAT_MFC, 1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP,         HWC_FORMAT_MFC, 1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED,   HWC_FORMAT_MFC, 1)      \
+    F(HAL_PIXEL_FORMAT_YV12,                        HWC_FORMAT_SW,  1)      \
+    F(HAL_PIXEL_FORMAT_YCbCr_420_P,                 HWC_FORMAT_SW,  1)      \
+    F(HAL_PIXEL_FORMAT_YCrCb_420_SP,                HWC_FORMAT_SW,  1)      \
+    F(HAL_PIXEL_FORMAT_YCbCr_420_SP,                HWC_FORMAT_SW,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_SP,         HWC_FORMAT_FB,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_SP,         HWC_FORMAT_FB,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_I,          HWC_FORMAT_FB,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_I,          HWC_FORMAT_FB,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_CbYCrY_422_I,         HWC_FORMAT_FB,  1)      \
+    F(HAL_PIXEL_FORMAT_CUSTOM_CrYCbY_422_I,         HWC_FORMAT_FB,  1)
+
+#define HWC_FIMC_MIN_SRC_W  (16)
+#define HWC_FIMC_MIN_SRC_H  (8)
+#define HWC_FIMC_MIN_DST_W  (8)
+#define HWC_FIMC_MIN_DST_H  (4)
+
+struct sec_hwc_format {
+    int     hal_fmt;
+    int     overlay;
+    int     pad_frame;
+};
+
+#define SEC_HWC_FORMAT_ENTRY(fmt, overlay, pad_frame) \
+    { fmt, overlay, pad_frame },
+
+static const struct sec_hwc_format sec_hwc_format_table[] = {
+    SEC_HWC_FORMAT_LIST(SEC_HWC_FORMAT_ENTRY)
+};
+
+#undef SEC_HWC_FORMAT_ENTRY
+
+/* RGB and unknown formats: framebuffer, unpadded */
+static const struct sec_hwc_format sec_hwc_format_default = { 0, HWC_FORMAT_FB, 0 };
+
+#define SEC_HWC_FORMAT_INDEX(fmt, overlay, pad_frame) \
+    SEC_HWC_FORMAT_INDEX_##fmt,
+
+enum {
+    SEC_HWC_FORMAT_LIST(SEC_HWC_FORMAT_INDEX)
+    SEC_HWC_FORMAT_NUM
+};
+
+#define SEC_HWC_FORMAT_CASE(fmt, overlay, pad_frame) \
+    case fmt: return &sec_hwc_format_table[SEC_HWC_FORMAT_INDEX_##fmt];
+
+static inline const struct sec_hwc_format *sec_hwc_get_format(int hal_fmt)
+{
+    switch (hal_fmt) {
+    SEC_HWC_FORMAT_LIST(SEC_HWC_FORMAT_CASE)
+    default:
+        return &sec_hwc_format_default;
+    }
+}
+
+#undef SEC_HWC_FORMAT_INDEX
+#undef SEC_HWC_FORMAT_CASE
+
+#endif /* ANDROID_SEC_HWC_FORMAT_H_ */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+
+#include "SecHWCUtils.h"
+
+#define HWC_STATS_MAX_FRAMES    (HWC_STATS_RING - HWC_STATS_GUARD)
+
+struct hwc_stats_pct {
+    int32_t p50;
+    int32_t p90;
+    int32_t p99;
+    int32_t max;
+    int     num;
+};
+
+static int compare_int32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* sorts val, negative values are not counted */
+static void get_percentile(int32_t *val, int num, struct hwc_stats_pct *pct)
+{
+    int first = 0;
+
+    qsort(val, num, sizeof(val[0]), compare_int32);
+    while (first < num && val[first] < 0)
+        first++;
+
+    memset(pct, 0, sizeof(*pct));
+    pct->num = num - first;
+    if (pct->num == 0)
+        return;
+
+    pct->p50 = val[first + (pct->num - 1) * 50 / 100];
+    pct->p90 = val[first + (pct->num - 1) * 90 / 100];
+    pct->p99 = val[first + (pct->num - 1) * 99 / 100];
+    pct->max = val[num - 1];
+}
+
+static int print_percentile(char *buff, int buff_len, const char *name,
+        int32_t *val, int num)
+{
+    struct hwc_stats_pct pct;
+
+    get_percentile(val, num, &pct);
+    if (pct.num == 0)
+        return snprintf(buff, buff_len, "  %-16s n/a\n", name);
+
+    return snprintf(buff, buff_len, "  %-16s p50 %6d p90 %6d p99 %6d max %6d\n",
+            name, pct.p50, pct.p90, pct.p99, pct.max);
+}
+
+void stats_frame_begin(struct hwc_context_t *ctx)
+{
+    struct hwc_stats *stats = &ctx->stats;
+    char value[PROPERTY_VALUE_MAX];
+
+    memset(&stats->cur, 0, sizeof(stats->cur));
+
+    if (stats->poll_cnt++ % HWC_STATS_POLL_FRAMES)
+        return;
+
+    property_get(HWC_STATS_PROP, value, "0");
+    stats->log_interval = (uint32_t)atoi(value);
+    if (HWC_STATS_MAX_FRAMES < stats->log_interval)
+        stats->log_interval = HWC_STATS_MAX_FRAMES;
+}
+
+void stats_frame_end(struct hwc_context_t *ctx, int64_t prepare_ns, int64_t set_ns)
+{
+    struct hwc_stats       *stats = &ctx->stats;
+    struct hwc_frame_stats *cur   = &stats->cur;
+    int32_t vsync_time_us = android_atomic_acquire_load(&ctx->vsync_delivered_us);
+    int32_t head          = stats->head;
+
+    cur->time_us           = (int32_t)(hwc_get_time_ns() / 1000);
+    cur->prepare_us        = (int32_t)(prepare_ns / 1000);
+    cur->set_us            = (int32_t)(set_ns / 1000);
+    cur->num_of_hwc_layer  = ctx->num_of_hwc_layer - ctx->num_2d_blit_layer;
+    cur->num_2d_blit_layer = ctx->num_2d_blit_layer;
+    cur->num_of_fb_layer   = ctx->num_of_fb_layer;
+#ifdef SKIP_DUMMY_UI_LAY_DRAWING
+    cur->num_of_fb_lay_skip = ctx->num_of_fb_lay_skip;
+#endif
+
+    /*
+     * From the vsync SurfaceFlinger was woken up by, predicted ones included.
+     * Vsync events are off while SurfaceFlinger is idle, the last one is stale then.
+     */
+    cur->vsync_latency_us = cur->time_us - vsync_time_us;
+    if (vsync_time_us == 0 || cur->vsync_latency_us < 0 ||
+        2 * HWC_VSYNC_PERIOD_US < cur->vsync_latency_us)
+        cur->vsync_latency_us = -1;
+
+    stats->ring[head & (HWC_STATS_RING - 1)] = *cur;
+    android_atomic_release_store(head + 1, &stats->head);
+
+    if (stats->log_interval == 0)
+        return;
+
+    if (++stats->log_cnt >= stats->log_interval) {
+        char buff[1024];
+
+        stats->log_cnt = 0;
+        stats_dump(ctx, buff, sizeof(buff));
+        ALOGD("%s", buff);
+    }
+}
+
+int stats_dump(struct hwc_context_t *ctx, char *buff, int buff_len)
+{
+    struct hwc_frame_stats frame[HWC_STATS_MAX_FRAMES];
+    int32_t val[HWC_STATS_MAX_FRAMES];
+    struct hwc_stats *stats = &ctx->stats;
+    int32_t head = android_atomic_acquire_load(&stats->head);
+    uint32_t hwc_layer = 0, g2d_layer = 0, fb_layer = 0;
+    uint32_t fb_lay_skip = 0, dup_buf = 0, swap_skipped = 0;
+    uint32_t geometry_changed = 0, fimc_config = 0;
+    int32_t span_us;
+    int num = HWC_STATS_MAX_FRAMES;
+    int len = 0;
+    int i;
+
+    if ((uint32_t)head < (uint32_t)num)
+        num = head;
+
+    if (num < 2)
+        return snprintf(buff, buff_len, "HWC stats: no frames\n");
+
+    /* the writer fills the slot at head, HWC_STATS_GUARD slots past the oldest copied */
+    for (i = 0; i < num; i++)
+        frame[i] = stats->ring[(head - num + i) & (HWC_STATS_RING - 1)];
+
+    for (i = 0; i < num; i++) {
+        hwc_layer    += frame[i].num_of_hwc_layer;
+        g2d_layer    += frame[i].num_2d_blit_layer;
+        fb_layer     += frame[i].num_of_fb_layer;
+        fb_lay_skip  += frame[i].num_of_fb_lay_skip;
+        dup_buf      += frame[i].num_of_dup_buf;
+        swap_skipped += frame[i].swap_skipped;
+        geometry_changed += frame[i].geometry_changed;
+        fimc_config  += frame[i].num_of_fimc_config;
+    }
+
+    span_us = frame[num - 1].time_us - frame[0].time_us;
+    len += snprintf(buff + len, buff_len - len,
+            "HWC stats: last %d frames, %.1f fps, times in us\n", num,
+            (0 < span_us) ? (num - 1) * 1000000.0 / span_us : 0.0);
+
+#define PRINT_PCT(name, value)                                              \
+    do {                                                                    \
+        for (i = 0; i < num; i++)                                           \
+            val[i] = (value);                                               \
+        if (len < buff_len)                                                 \
+            len += print_percentile(buff + len, buff_len - len, name, val, num); \
+    } while (0)
+
+    PRINT_PCT("prepare",        frame[i].prepare_us);
+    PRINT_PCT("set",            frame[i].set_us);
+    PRINT_PCT("fimc",           frame[i].fimc_us);
+    PRINT_PCT("vsync->present", frame[i].vsync_latency_us);
+    /* first frame of each geometry, the FIMC was set up in prepare */
+    PRINT_PCT("set (geometry)", frame[i].geometry_changed ? frame[i].set_us : -1);
+#undef PRINT_PCT
+
+    if (len < buff_len)
+        len += snprintf(buff + len, buff_len - len,
+                "  layers/frame     overlay %.2f g2d %.2f fb %.2f\n"
+                "  skipped          fb layers %u, window buffers %u, GL swaps %u\n"
+                "  geometry changes %u, FIMC set up in set %u\n",
+                (float)hwc_layer / num, (float)g2d_layer / num, (float)fb_layer / num,
+                fb_lay_skip, dup_buf, swap_skipped, geometry_changed, fimc_config);
+
+    return (len < buff_len) ? len : buff_len - 1;
+}
@@ -25,69 +25,17 @@
  */
 
 #include "SecHWCUtils.h"
+#include <time.h>
 
 #define V4L2_BUF_TYPE_OUTPUT V4L2_BUF_TYPE_VIDEO_OUTPUT
 #define V4L2_BUF_TYPE_CAPTURE V4L2_BUF_TYPE_VIDEO_CAPTURE
 
 #define EXYNOS4_ALIGN( value, base ) (((value) + ((base) - 1)) & ~((base) - 1))
 
-//#define CHECK_FPS
-#ifdef CHECK_FPS
-#include <sys/time.h>
-#include <unistd.h>
-#define CHK_FRAME_CNT 30
-
-void check_fps()
-{
-    static struct timeval tick, tick_old;
-    static int total = 0;
-    static int cnt = 0;
-    int FPS;
-    cnt++;
-    gettimeofday(&tick, NULL);
-    if (cnt > 10) {
-        if (tick.tv_sec > tick_old.tv_sec)
-            total += ((tick.tv_usec/1000) + (tick.tv_sec - tick_old.tv_sec)*1000 - (tick_old.tv_usec/1000));
-        else
-            total += ((tick.tv_usec - tick_old.tv_usec)/1000);
-
-        memcpy(&tick_old, &tick, sizeof(timeval));
-        if (cnt == (10 + CHK_FRAME_CNT)) {
-            FPS = 1000*CHK_FRAME_CNT/total;
-            LOGE("[FPS]:%d\n", FPS);
-            total = 0;
-            cnt = 10;
-        }
-    } else {
-        memcpy(&tick_old, &tick, sizeof(timeval));
-        total = 0;
-    }
-}
-#endif
-
-struct yuv_fmt_list yuv_list[] = {
-    { "V4L2_PIX_FMT_NV12",      "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12,     12, 2 },
-    { "V4L2_PIX_FMT_NV12T",     "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12T,    12, 2 },
-    { "V4L2_PIX_FMT_NV21",      "YUV420/2P/LSB_CRCB",   V4L2_PIX_FMT_NV21,     12, 2 },
-    { "V4L2_PIX_FMT_NV21X",     "YUV420/2P/MSB_CBCR",   V4L2_PIX_FMT_NV21X,    12, 2 },
-    { "V4L2_PIX_FMT_NV12X",     "YUV420/2P/MSB_CRCB",   V4L2_PIX_FMT_NV12X,    12, 2 },
-    { "V4L2_PIX_FMT_YUV420",    "YUV420/3P",            V4L2_PIX_FMT_YUV420,   12, 3 },
-    { "V4L2_PIX_FMT_YUYV",      "YUV422/1P/YCBYCR",     V4L2_PIX_FMT_YUYV,     16, 1 },
-    { "V4L2_PIX_FMT_YVYU",      "YUV422/1P/YCRYCB",     V4L2_PIX_FMT_YVYU,     16, 1 },
-    { "V4L2_PIX_FMT_UYVY",      "YUV422/1P/CBYCRY",     V4L2_PIX_FMT_UYVY,     16, 1 },
-    { "V4L2_PIX_FMT_VYUY",      "YUV422/1P/CRYCBY",     V4L2_PIX_FMT_VYUY,     16, 1 },
-    { "V4L2_PIX_FMT_UV12",      "YUV422/2P/LSB_CBCR",   V4L2_PIX_FMT_NV16,     16, 2 },
-    { "V4L2_PIX_FMT_UV21",      "YUV422/2P/LSB_CRCB",   V4L2_PIX_FMT_NV61,     16, 2 },
-    { "V4L2_PIX_FMT_UV12X",     "YUV422/2P/MSB_CBCR",   V4L2_PIX_FMT_NV16X,    16, 2 },
-    { "V4L2_PIX_FMT_UV21X",     "YUV422/2P/MSB_CRCB",   V4L2_PIX_FMT_NV61X,    16, 2 },
-    { "V4L2_PIX_FMT_YUV422P",   "YUV422/3P",            V4L2_PIX_FMT_YUV422P,  16, 3 },
-};
-
 int window_open(struct hwc_win_info_t *win, int id)
 {
     int fd = 0;
     char name[64];
-    int vsync = 1;
     int real_id = id;
 
     char const * const device_template = "/dev/graphics/fb%u";
@@ -135,13 +83,6 @@ int window_open(struct hwc_win_info_t *win, int id)
         goto error;
     }
 
-#ifdef ENABLE_FIMD_VSYNC
-    if (ioctl(win->fd, S3CFB_SET_VSYNC_INT, &vsync) < 0) {
-        SEC_HWC_Log(HWC_LOG_ERROR, "%s::S3CFB_SET_VSYNC_INT fail", __func__);
-        goto error;
-    }
-#endif
-
     return 0;
 
 error:
@@ -157,12 +98,6 @@ int window_close(struct hwc_win_info_t *win)
     int ret = 0;
 
     if (0 < win->fd) {
-
-#ifdef ENABLE_FIMD_VSYNC
-        int vsync = 0;
-        if (ioctl(win->fd, S3CFB_SET_VSYNC_INT, &vsync) < 0)
-            SEC_HWC_Log(HWC_LOG_ERROR, "%s::S3CFB_SET_VSYNC_INT fail", __func__);
-#endif
         ret = close(win->fd);
     }
     win->fd = 0;
@@ -185,9 +120,11 @@ int window_set_pos(struct hwc_win_info_t *win)
             __func__, win->rect_info.x, win->rect_info.y);
 
     win->var_info.xres_virtual = (win->lcd_info.xres + 15) & ~ 15;
-    win->var_info.yres_virtual = win->lcd_info.yres * NUM_OF_WIN_BUF;
+    win->var_info.yres_virtual = win->lcd_info.yres * win->num_of_buf;
     win->var_info.xres = win->rect_info.w;
     win->var_info.yres = win->rect_info.h;
+    /* keep scanning out the buffer the last pan showed */
+    win->var_info.yoffset = win->lcd_info.yoffset;
 
     win->var_info.activate &= ~FB_ACTIVATE_MASK;
     win->var_info.activate |= FB_ACTIVATE_FORCE;
@@ -222,7 +159,13 @@ int window_get_info(struct hwc_win_info_t *win, int win_num)
 
     win->size = win->fix_info.line_length * win->var_info.yres;
 
-    for (int j = 0; j < NUM_OF_WIN_BUF; j++) {
+    if ((0 < win->size) && (win->fix_info.smem_len < (uint32_t)(win->size * win->num_of_buf))) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::win-%d has memory for %d of %d buffers",
+                __func__, win_num, win->fix_info.smem_len / win->size, win->num_of_buf);
+        win->num_of_buf = SEC_MAX(win->fix_info.smem_len / win->size, 1);
+    }
+
+    for (int j = 0; j < win->num_of_buf; j++) {
         temp_size = win->size * j;
         win->addr[j] = win->fix_info.smem_start + temp_size;
         SEC_HWC_Log(HWC_LOG_DEBUG, "%s::win-%d add[%d]  %x ",
@@ -236,15 +179,22 @@ error:
     return -1;
 }
 
+static int32_t get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int32_t)((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/*
+ * The pan is latched at the next vsync and the kernel does not wait for it,
+ * so the buffer on screen before stays busy until a vsync after the pan.
+ */
 int window_pan_display(struct hwc_win_info_t *win)
 {
     struct fb_var_screeninfo *lcd_info = &(win->lcd_info);
-
-#ifdef ENABLE_FIMD_VSYNC
-    if (ioctl(win->fd, FBIO_WAITFORVSYNC, 0) < 0)
-        SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIO_WAITFORVSYNC fail(%s)",
-                __func__, strerror(errno));
-#endif
+    int32_t now = get_time_us();
 
     lcd_info->yoffset = lcd_info->yres * win->buf_index;
 
@@ -256,9 +206,51 @@ int window_pan_display(struct hwc_win_info_t *win)
             strerror(errno));
         return -1;
     }
+
+    for (int i = 0; i < win->num_of_buf; i++) {
+        if ((i != win->buf_index) && (win->buf_state[i] == HWC_WIN_BUF_ON_SCREEN)) {
+            win->buf_state[i] = HWC_WIN_BUF_RELEASING;
+            win->buf_release_us[i] = now;
+        }
+    }
+    win->buf_state[win->buf_index] = HWC_WIN_BUF_ON_SCREEN;
+    win->buf_pan_us[win->buf_index] = now;
+
     return 0;
 }
 
+/*
+ * Return the free buffer panned longest ago, or -1 when all of them are
+ * on screen or waiting for a vsync. Without vsync events a buffer is also
+ * free once a whole refresh period passed since it was replaced.
+ */
+int window_get_free_buf(struct hwc_win_info_t *win, int32_t vsync_time_us)
+{
+    int32_t now = get_time_us();
+    int index = -1;
+
+    if (win->num_of_buf < 2)
+        return 0;
+
+    for (int i = 0; i < win->num_of_buf; i++) {
+        if (win->power_state == 0) {
+            win->buf_state[i] = HWC_WIN_BUF_FREE;
+        } else if ((win->buf_state[i] == HWC_WIN_BUF_RELEASING) &&
+                   ((0 < (int32_t)(vsync_time_us - win->buf_release_us[i])) ||
+                    (HWC_VSYNC_PERIOD_US <= (int32_t)(now - win->buf_release_us[i])))) {
+            win->buf_state[i] = HWC_WIN_BUF_FREE;
+        }
+
+        if (win->buf_state[i] != HWC_WIN_BUF_FREE)
+            continue;
+
+        if ((index < 0) || ((int32_t)(win->buf_pan_us[i] - win->buf_pan_us[index]) < 0))
+            index = i;
+    }
+
+    return index;
+}
+
 int window_show(struct hwc_win_info_t *win)
 {
     if (win->power_state == 0) {
@@ -308,12 +300,29 @@ int window_get_global_lcd_info(struct hwc_context_t *ctx)
     return 0;
 }
 
+/* fimc_handle_oneshot() releases the input buffer after every frame */
+static int fimc_v4l2_req_src_buf(int fd)
+{
+    struct v4l2_requestbuffers req;
+
+    /* input buffer type */
+    req.count       = 1;
+    req.memory      = V4L2_MEMORY_USERPTR;
+    req.type        = V4L2_BUF_TYPE_OUTPUT;
+
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in VIDIOC_REQBUFS", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
 int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
 {
     struct v4l2_format  fmt;
     struct v4l2_cropcap cropcap;
     struct v4l2_crop    crop;
-    struct v4l2_requestbuffers req;
 
     fmt.fmt.pix.width       = src->full_width;
     fmt.fmt.pix.height      = src->full_height;
@@ -346,25 +355,32 @@ int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
         return -1;
     }
 
-    /* input buffer type */
-    req.count       = 1;
-    req.memory      = V4L2_MEMORY_USERPTR;
-    req.type        = V4L2_BUF_TYPE_OUTPUT;
+    return fimc_v4l2_req_src_buf(fd);
+}
 
-    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
-        SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in VIDIOC_REQBUFS", __func__);
+/* moves the destination to addr, the rest of the setup is left as it is */
+static int fimc_v4l2_set_dst_addr(int fd, struct v4l2_framebuffer *fbuf, unsigned int addr)
+{
+    int ret;
+
+    fbuf->base = (void *)addr;
+
+    ret = ioctl(fd, VIDIOC_S_FBUF, fbuf);
+    if (ret < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_FBUF (%d)", __func__, ret);
         return -1;
     }
 
     return 0;
 }
 
+/* fbuf gets what VIDIOC_G_FBUF returned, for fimc_v4l2_set_dst_addr() */
 int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
-        int rotation, int hflip, int vflip, unsigned int addr)
+        int rotation, int hflip, int vflip, unsigned int addr,
+        struct v4l2_framebuffer *fbuf)
 {
     struct v4l2_format      sFormat;
     struct v4l2_control     vc;
-    struct v4l2_framebuffer fbuf;
     int ret;
 
     /* set rotation configuration */
@@ -402,22 +418,18 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     }
 
     /* set size, format & address for destination image (DMA-OUTPUT) */
-    ret = ioctl(fd, VIDIOC_G_FBUF, &fbuf);
+    ret = ioctl(fd, VIDIOC_G_FBUF, fbuf);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_G_FBUF (%d)", __func__, ret);
         return -1;
     }
 
-    fbuf.base            = (void *)addr;
-    fbuf.fmt.width       = dst->full_width;
-    fbuf.fmt.height      = dst->full_height;
-    fbuf.fmt.pixelformat = dst->color_space;
+    fbuf->fmt.width       = dst->full_width;
+    fbuf->fmt.height      = dst->full_height;
+    fbuf->fmt.pixelformat = dst->color_space;
 
-    ret = ioctl(fd, VIDIOC_S_FBUF, &fbuf);
-    if (ret < 0) {
-        SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_FBUF (%d)", __func__, ret);
+    if (fimc_v4l2_set_dst_addr(fd, fbuf, addr) < 0)
         return -1;
-    }
 
     /* set destination window */
     sFormat.type             = V4L2_BUF_TYPE_VIDEO_OVERLAY;
@@ -522,10 +534,6 @@ int fimc_v4l2_S_ctrl(int fd)
 
 int fimc_handle_oneshot(int fd, struct fimc_buf *fimc_src_buf, struct fimc_buf *fimc_dst_buf)
 {
-#ifdef CHECK_FPS
-    check_fps();
-#endif
-
     if (fimc_v4l2_stream_on(fd, V4L2_BUF_TYPE_OUTPUT) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Fail : SRC v4l2_stream_on()");
         return -5;
@@ -555,105 +563,165 @@ STREAM_OFF:
     return 0;
 }
 
-static int memcpy_rect(void *dst, void *src, int fullW, int fullH, int realW, int realH, int format)
+/*
+ * Planes of a planar/semi-planar YUV gralloc buffer: the offsets gralloc
+ * keeps for FIMC1 buffers, otherwise the 16 aligned layout it allocates.
+ */
+struct yuv_layout {
+    int      planes;
+    uint32_t offset[3];
+    uint32_t stride[3];
+};
+
+static int get_yuv_layout(sec_img *img, struct yuv_layout *layout)
 {
-    unsigned char *srcCb, *srcCr;
-    unsigned char *dstCb, *dstCr;
-    unsigned char *srcY, *dstY;
-    int srcCbOffset, srcCrOffset;
-    int dstCbOffset, dstFrameOffset, dstCrOffset;
-    int cbFullW, cbRealW, cbFullH, cbRealH;
-    int ySrcFW, ySrcFH, ySrcRW, ySrcRH;
-    int planes;
-    int i;
+    uint32_t y_stride = EXYNOS4_ALIGN(img->w, 16);
+    uint32_t c_stride = EXYNOS4_ALIGN(img->w >> 1, 16);
 
-    SEC_HWC_Log(HWC_LOG_DEBUG,
-            "++memcpy_rect()::"
-            "dst(0x%x),src(0x%x),f.w(%d),f.h(%d),r.w(%d),r.h(%d),format(0x%x)",
-            (unsigned int)dst, (unsigned int)src, fullW, fullH, realW, realH, format);
-
-// Set dst Y, Cb, Cr address for FIMC
-    {
-        cbFullW = fullW >> 1;
-        cbRealW = realW >> 1;
-        cbFullH = fullH >> 1;
-        cbRealH = realH >> 1;
-        dstFrameOffset = fullW * fullH;
-        dstCrOffset = cbFullW * cbFullH;
-        dstY = (unsigned char *)dst;
-        dstCb = (unsigned char *)dst + dstFrameOffset;
-        dstCr = (unsigned char *)dstCb + dstCrOffset;
-    }
-
-// Get src Y, Cb, Cr address for source buffer.
-// Each address is aligned by 16's multiple for GPU both width and height.
-    {
-        ySrcFW = fullW;
-        ySrcFH = fullH;
-        ySrcRW = realW;
-        ySrcRH = realH;
-        srcCbOffset = EXYNOS4_ALIGN(ySrcRW,16)* EXYNOS4_ALIGN(ySrcRH,16);
-        srcCrOffset = EXYNOS4_ALIGN(cbRealW,16)* EXYNOS4_ALIGN(cbRealH,16);
-        srcY =  (unsigned char *)src;
-        srcCb = (unsigned char *)src + srcCbOffset;
-        srcCr = (unsigned char *)srcCb + srcCrOffset;
+    switch (img->format) {
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_YCbCr_420_P:
+        layout->planes    = 3;
+        layout->stride[1] = c_stride;
+        break;
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+        layout->planes    = 2;
+        layout->stride[1] = y_stride;
+        break;
+    default:
+        return -1;
     }
-    SEC_HWC_Log(HWC_LOG_DEBUG,
-            "--memcpy_rect()::\n"
-            "dstY(0x%x),dstCb(0x%x),dstCr(0x%x) \n"
-            "srcY(0x%x),srcCb(0x%x),srcCr(0x%x) \n"
-            "cbRealW(%d),cbRealH(%d)",
-            (unsigned int)dstY,(unsigned int)dstCb,(unsigned int)dstCr,
-            (unsigned int)srcY,(unsigned int)srcCb,(unsigned int)srcCr,
-            cbRealW, cbRealH);
-
-    if (format == HAL_PIXEL_FORMAT_YV12) { //YV12(Y,Cr,Cv)
-        planes = 3;
-//This is code for VE, deleted temporory by SSONG 2011.09.22
-// This will be enabled later.
+
+    layout->stride[0] = y_stride;
+    layout->stride[2] = layout->stride[1];
+    layout->offset[0] = 0;
+    layout->offset[1] = img->uoffset ? img->uoffset :
+                        y_stride * EXYNOS4_ALIGN(img->h, 16);
+    layout->offset[2] = layout->offset[1];
+    if (layout->planes == 3)
+        layout->offset[2] += img->voffset ? img->voffset :
+                             c_stride * EXYNOS4_ALIGN(img->h >> 1, 16);
+
+    return 0;
+}
+
+static inline void copy_plane(unsigned char *dst, uint32_t dst_stride,
+        const unsigned char *src, uint32_t src_stride,
+        uint32_t width, uint32_t height)
+{
+    /* memcpy is the NEON copy of bionic, give it runs as long as possible */
+    if (dst_stride == src_stride && width == src_stride) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+
+    for (uint32_t i = 0; i < height; i++)
+        memcpy(dst + dst_stride * i, src + src_stride * i, width);
+}
+
 /*
-        //as defined in hardware.h, cb & cr full_width should be aligned to 16. ALIGN(y_stride/2, 16).
-        ////Alignment is hard coded to 16.
-        ////for example...check frameworks/media/libvideoeditor/lvpp/VideoEditorTools.cpp file for UV stride cal
-        cbSrcFW = (cbSrcFW + 15) & (~15);
-        srcCbOffset = ySrcFW * fullH;
-        srcCrOffset = srcCbOffset + ((cbSrcFW * fullH) >> 1);
-        srcY =  (unsigned char *)src;
-        srcCb = (unsigned char *)src + srcCbOffset;
-        srcCr = (unsigned char *)src + srcCrOffset;
-*/
-    } else if ((format == HAL_PIXEL_FORMAT_YCbCr_420_P)) {
-        planes = 3;
-    } else if (format == HAL_PIXEL_FORMAT_YCbCr_420_SP || format == HAL_PIXEL_FORMAT_YCrCb_420_SP) {
-        planes = 2;
+ * Copies the rows of src_rect of a YUV buffer FIMC cannot address into the
+ * next bounce buffer, laid out as FIMC reads it (full_width x full_height
+ * planes), and returns the physical address of the copy.
+ */
+static unsigned int stage_src_to_bounce_buf(struct hwc_context_t *ctx,
+        sec_img *src_img, sec_rect *src_rect)
+{
+    s5p_fimc_t *fimc = &ctx->fimc;
+    struct secion_param *buf;
+    struct yuv_layout src, dst;
+    unsigned char *src_base = (unsigned char *)(src_img->base + src_img->offset);
+    unsigned char *dst_base;
+    uint32_t size, top, bottom, c_width;
+
+    if (get_yuv_layout(src_img, &src) < 0)
+        return 0;
+
+    dst.planes    = src.planes;
+    dst.stride[0] = src_img->f_w;
+    dst.offset[0] = 0;
+    dst.offset[1] = src_img->f_w * src_img->f_h;
+    if (dst.planes == 3) {
+        dst.stride[1] = dst.stride[2] = src_img->f_w >> 1;
+        dst.offset[2] = dst.offset[1] + (src_img->f_w >> 1) * (src_img->f_h >> 1);
+        c_width       = (src_img->w + 1) >> 1;
     } else {
-        SEC_HWC_Log(HWC_LOG_ERROR, "use default memcpy instead of memcpy_rect");
-        return -1;
+        dst.stride[1] = dst.stride[2] = src_img->f_w;
+        dst.offset[2] = dst.offset[1];
+        c_width       = EXYNOS4_ALIGN(src_img->w, 2);
+    }
+    size = EXYNOS4_ALIGN(src_img->f_w * src_img->f_h * 3 / 2, PAGE_SIZE);
+
+    if (bounce_buf_alloc(ctx, src_img->f_w, src_img->f_h) < 0)
+        return 0;
+
+    buf = &ctx->bounce_buf[ctx->bounce_idx];
+    ctx->bounce_idx = (ctx->bounce_idx + 1) % HWC_BOUNCE_BUF_NUM;
+
+    /* FIMC only reads the crop, chroma rows go in pairs of luma rows */
+    top    = src_rect->y & ~1;
+    bottom = SEC_MIN(EXYNOS4_ALIGN(src_rect->y + src_rect->h, 2), src_img->h);
+    dst_base = (unsigned char *)buf->memory;
+
+    copy_plane(dst_base + dst.stride[0] * top, dst.stride[0],
+               src_base + src.stride[0] * top, src.stride[0],
+               src_img->w, bottom - top);
+    for (int i = 1; i < src.planes; i++)
+        copy_plane(dst_base + dst.offset[i] + dst.stride[i] * (top >> 1), dst.stride[i],
+                   src_base + src.offset[i] + src.stride[i] * (top >> 1), src.stride[i],
+                   c_width, (bottom - top) >> 1);
+
+    ion_msync(buf->client, buf->buffer, IMSYNC_DEV_TO_READ | IMSYNC_SYNC_FOR_DEV, size, 0);
+
+    fimc->params.src.buf_addr_phy_rgb_y = buf->physaddr;
+    fimc->params.src.buf_addr_phy_cb    = buf->physaddr + dst.offset[1];
+    fimc->params.src.buf_addr_phy_cr    = buf->physaddr + dst.offset[2];
+
+    return fimc->params.src.buf_addr_phy_rgb_y;
+}
+
+void bounce_buf_init(struct hwc_context_t *ctx)
+{
+    for (int i = 0; i < HWC_BOUNCE_BUF_NUM; i++) {
+        memset(&ctx->bounce_buf[i], 0, sizeof(ctx->bounce_buf[i]));
+        ctx->bounce_buf[i].client = -1;
+        ctx->bounce_buf[i].buffer = -1;
+    }
+    ctx->bounce_idx = 0;
+}
+
+/* makes every bounce buffer hold a full_w x full_h 4:2:0 frame */
+int bounce_buf_alloc(struct hwc_context_t *ctx, uint32_t full_w, uint32_t full_h)
+{
+    uint32_t size = EXYNOS4_ALIGN(full_w * full_h * 3 / 2, PAGE_SIZE);
+
+    for (int i = 0; i < HWC_BOUNCE_BUF_NUM; i++) {
+        struct secion_param *buf = &ctx->bounce_buf[i];
+
+        if (size <= buf->size)
+            continue;
+
+        destroyIONMem(buf);
+        if (createIONMem(buf, size, ION_HEAP_EXYNOS_CONTIG_MASK) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "%s::createIONMem(%d) fail", __func__, size);
+            return -1;
+        }
     }
-//#define CHECK_PERF
-#ifdef CHECK_PERF
-    struct timeval start, end;
-    gettimeofday(&start, NULL);
-#endif
-    for (i = 0; i < realH; i++)
-        memcpy(dstY + fullW * i, srcY + ySrcFW * i, ySrcRW);
-    if (planes == 2) {
-        for (i = 0; i < cbRealH; i++)
-            memcpy(dstCb + ySrcFW * i, srcCb + ySrcFW * i, ySrcRW);
-    } else if (planes == 3) {
-        for (i = 0; i < cbRealH; i++)
-            memcpy(dstCb + cbFullW * i, srcCb + cbFullW * i, cbRealW);
-        for (i = 0; i < cbRealH; i++)
-            memcpy(dstCr + cbFullW * i, srcCr + cbFullW * i, cbRealW);
-    }
-#ifdef CHECK_PERF
-    gettimeofday(&end, NULL);
-    SEC_HWC_Log(HWC_LOG_ERROR, "[COPY]=%d,",(end.tv_sec - start.tv_sec)*1000+(end.tv_usec - start.tv_usec)/1000);
-#endif
 
     return 0;
 }
 
+void bounce_buf_free(struct hwc_context_t *ctx)
+{
+    for (int i = 0; i < HWC_BOUNCE_BUF_NUM; i++) {
+        destroyIONMem(&ctx->bounce_buf[i]);
+        if (0 <= ctx->bounce_buf[i].client)
+            ion_client_destroy(ctx->bounce_buf[i].client);
+    }
+    bounce_buf_init(ctx);
+}
+
 /*****************************************************************************/
 static int get_src_phys_addr(struct hwc_context_t *ctx,
         sec_img *src_img, sec_rect *src_rect)
@@ -667,7 +735,7 @@ static int get_src_phys_addr(struct hwc_context_t *ctx,
     ADDRS * addr;
 
     // error check routine
-    if (0 == src_img->base && !(src_img->usage & GRALLOC_USAGE_HW_FIMC1)) {
+    if (0 == src_img->base && 0 == src_img->paddr) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s invalid src image base\n", __func__);
         return 0;
     }
@@ -719,10 +787,24 @@ static int get_src_phys_addr(struct hwc_context_t *ctx,
                 fimc->params.src.buf_addr_phy_cb = src_img->paddr + src_img->uoffset;
                 fimc->params.src.buf_addr_phy_cr = src_img->paddr + src_img->uoffset + src_img->voffset;
                 src_phys_addr = fimc->params.src.buf_addr_phy_rgb_y;
+            } else if (src_img->paddr) {
+                /* contiguous (ION) buffer allocated without FIMC1 */
+                struct yuv_layout layout;
+
+                if (get_yuv_layout(src_img, &layout) < 0) {
+                    SEC_HWC_Log(HWC_LOG_ERROR, "%s::format = 0x%x : not supported "
+                            "without GRALLOC_USAGE_HW_FIMC1", __func__, src_img->format);
+                    break;
+                }
+                fimc->params.src.buf_addr_phy_rgb_y = src_img->paddr;
+                fimc->params.src.buf_addr_phy_cb = src_img->paddr + layout.offset[1];
+                fimc->params.src.buf_addr_phy_cr = src_img->paddr + layout.offset[2];
+                src_phys_addr = fimc->params.src.buf_addr_phy_rgb_y;
             } else {
-                SEC_HWC_Log(HWC_LOG_ERROR, "%s::\nformat = 0x%x : Not "
-                        "GRALLOC_USAGE_HW_FIMC1 can not supported\n",
-                        __func__, src_img->format);
+                src_phys_addr = stage_src_to_bounce_buf(ctx, src_img, src_rect);
+                if (0 == src_phys_addr)
+                    SEC_HWC_Log(HWC_LOG_ERROR, "%s::format = 0x%x : no physical "
+                            "address and no bounce buffer", __func__, src_img->format);
             }
             break;
         }
@@ -781,276 +863,137 @@ static inline int vflipValueHAL2PP(unsigned char transform)
     return 0;
 }
 
-static inline int multipleOf2(int number)
-{
-    if (number % 2 == 1)
-        return (number - 1);
-    else
-        return number;
-}
-
-static inline int multipleOf4(int number)
-{
-    int remain_number = number % 4;
-
-    if (remain_number != 0)
-        return (number - remain_number);
-    else
-        return number;
-}
-
-static inline int multipleOf8(int number)
-{
-    int remain_number = number % 8;
-
-    if (remain_number != 0)
-        return (number - remain_number);
-    else
-        return number;
-}
-
-static inline int multipleOf16(int number)
-{
-    int remain_number = number % 16;
-
-    if (remain_number != 0)
-        return (number - remain_number);
-    else
-        return number;
-}
-
 static inline int widthOfPP(unsigned int ver, int pp_color_format, int number)
 {
-    if (0x50 <= ver) {
-        switch (pp_color_format) {
-        /* 422 1/2/3 plane */
-        case V4L2_PIX_FMT_YUYV:
-        case V4L2_PIX_FMT_UYVY:
-        case V4L2_PIX_FMT_NV61:
-        case V4L2_PIX_FMT_NV16:
-        case V4L2_PIX_FMT_YUV422P:
-
-        /* 420 2/3 plane */
-        case V4L2_PIX_FMT_NV21:
-        case V4L2_PIX_FMT_NV12:
-        case V4L2_PIX_FMT_NV12T:
-        case V4L2_PIX_FMT_YUV420:
-            return multipleOf2(number);
-
-        default :
-            return number;
-        }
-    } else {
-        switch (pp_color_format) {
-        case V4L2_PIX_FMT_RGB565:
-            return multipleOf8(number);
-
-        case V4L2_PIX_FMT_RGB32:
-            return multipleOf4(number);
-
-        case V4L2_PIX_FMT_YUYV:
-        case V4L2_PIX_FMT_UYVY:
-            return multipleOf4(number);
-
-        case V4L2_PIX_FMT_NV61:
-        case V4L2_PIX_FMT_NV16:
-            return multipleOf8(number);
-
-        case V4L2_PIX_FMT_YUV422P:
-            return multipleOf16(number);
-
-        case V4L2_PIX_FMT_NV21:
-        case V4L2_PIX_FMT_NV12:
-        case V4L2_PIX_FMT_NV12T:
-            return multipleOf8(number);
-
-        case V4L2_PIX_FMT_YUV420:
-            return multipleOf16(number);
-
-        default :
-            return number;
-        }
-    }
-    return number;
+    return sec_fimc_align_width(pp_color_format, 0x50 <= ver, number);
 }
 
 static inline int heightOfPP(int pp_color_format, int number)
 {
-    switch (pp_color_format) {
-    case V4L2_PIX_FMT_NV21:
-    case V4L2_PIX_FMT_NV12:
-    case V4L2_PIX_FMT_NV12T:
-    case V4L2_PIX_FMT_YUV420:
-        return multipleOf2(number);
-
-    default :
-        return number;
-        break;
-    }
-    return number;
-}
-
-static unsigned int get_yuv_bpp(unsigned int fmt)
-{
-    int i, sel = -1;
-
-    for (i = 0; i < (int)(sizeof(yuv_list) / sizeof(struct yuv_fmt_list)); i++) {
-        if (yuv_list[i].fmt == fmt) {
-            sel = i;
-            break;
-        }
-    }
-
-    if (sel == -1)
-        return sel;
-    else
-        return yuv_list[sel].bpp;
-}
-
-static unsigned int get_yuv_planes(unsigned int fmt)
-{
-    int i, sel = -1;
-
-    for (i = 0; i < (int)(sizeof(yuv_list) / sizeof(struct yuv_fmt_list)); i++) {
-        if (yuv_list[i].fmt == fmt) {
-            sel = i;
-            break;
-        }
-    }
-
-    if (sel == -1)
-        return sel;
-    else
-        return yuv_list[sel].planes;
+    return sec_fimc_align_height(pp_color_format, number);
 }
 
-static int runFimcCore(struct hwc_context_t *ctx,
-        unsigned int src_phys_addr, sec_img *src_img, sec_rect *src_rect,
-        uint32_t src_color_space,
-        unsigned int dst_phys_addr, sec_img *dst_img, sec_rect *dst_rect,
-        uint32_t dst_color_space, int transform)
+/*
+ * FIMC setup for src_rect of src_img => dst_rect of dst_img, which only
+ * depends on the geometry of the layer and its window.
+ */
+static int fimc_get_config(s5p_fimc_t *fimc,
+        sec_img *src_img, sec_rect *src_rect, uint32_t src_color_space,
+        sec_img *dst_img, sec_rect *dst_rect, uint32_t dst_color_space,
+        int transform, struct hwc_fimc_config *cfg)
 {
-    s5p_fimc_t        * fimc = &ctx->fimc;
-    s5p_fimc_params_t * params = &(fimc->params);
-
-    struct fimc_buf fimc_src_buf;
-    int src_bpp, src_planes;
-
-    unsigned int    frame_size = 0;
-
-    bool src_cbcr_order = true;
     int rotate_value = rotateValueHAL2PP(transform);
-    int hflip = 0;
-    int vflip = 0;
 
-    /* 1. param(fimc config)->src information
+    memset(cfg, 0, sizeof(*cfg));
+
+    /* 1. src information
      *    - src_img,src_rect => s_fw,s_fh,s_w,s_h,s_x,s_y
      */
-    params->src.full_width  = src_img->f_w;
-    params->src.full_height = src_img->f_h;
-    params->src.width       = src_rect->w;
-    params->src.height      = src_rect->h;
-    params->src.start_x     = src_rect->x;
-    params->src.start_y     = src_rect->y;
-    params->src.color_space = src_color_space;
-    params->src.buf_addr_phy_rgb_y = src_phys_addr;
+    cfg->src.full_width  = src_img->f_w;
+    cfg->src.full_height = src_img->f_h;
+    cfg->src.width       = src_rect->w;
+    cfg->src.height      = src_rect->h;
+    cfg->src.start_x     = src_rect->x;
+    cfg->src.start_y     = src_rect->y;
+    cfg->src.color_space = src_color_space;
 
     /* check src minimum */
     if (src_rect->w < 16 || src_rect->h < 8) {
         SEC_HWC_Log(HWC_LOG_ERROR,
                 "%s src size is not supported by fimc : f_w=%d f_h=%d "
                 "x=%d y=%d w=%d h=%d (ow=%d oh=%d) format=0x%x", __func__,
-                params->src.full_width, params->src.full_height,
-                params->src.start_x, params->src.start_y,
-                params->src.width, params->src.height,
+                cfg->src.full_width, cfg->src.full_height,
+                cfg->src.start_x, cfg->src.start_y,
+                cfg->src.width, cfg->src.height,
                 src_rect->w, src_rect->h,
-                params->src.color_space);
+                cfg->src.color_space);
         return -1;
     }
 
-    /* 2. param(fimc config)->dst information
+    /* 2. dst information
      *    - dst_img,dst_rect,rot => d_fw,d_fh,d_w,d_h,d_x,d_y
      */
+    cfg->rotation = rotate_value;
     switch (rotate_value) {
     case 0:
-        hflip = hflipValueHAL2PP(transform);
-        vflip = vflipValueHAL2PP(transform);
-        params->dst.full_width  = dst_img->f_w;
-        params->dst.full_height = dst_img->f_h;
+        cfg->hflip = hflipValueHAL2PP(transform);
+        cfg->vflip = vflipValueHAL2PP(transform);
+        cfg->dst.full_width  = dst_img->f_w;
+        cfg->dst.full_height = dst_img->f_h;
 
-        params->dst.start_x     = dst_rect->x;
-        params->dst.start_y     = dst_rect->y;
+        cfg->dst.start_x     = dst_rect->x;
+        cfg->dst.start_y     = dst_rect->y;
 
-        params->dst.width       =
+        cfg->dst.width       =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->w);
-        params->dst.height      = heightOfPP(dst_color_space, dst_rect->h);
+        cfg->dst.height      = heightOfPP(dst_color_space, dst_rect->h);
         break;
     case 90:
-        hflip = vflipValueHAL2PP(transform);
-        vflip = hflipValueHAL2PP(transform);
-        params->dst.full_width  = dst_img->f_h;
-        params->dst.full_height = dst_img->f_w;
+        cfg->hflip = vflipValueHAL2PP(transform);
+        cfg->vflip = hflipValueHAL2PP(transform);
+        cfg->dst.full_width  = dst_img->f_h;
+        cfg->dst.full_height = dst_img->f_w;
 
-        params->dst.start_x     = dst_rect->y;
-        params->dst.start_y     = dst_img->f_w - (dst_rect->x + dst_rect->w);
+        cfg->dst.start_x     = dst_rect->y;
+        cfg->dst.start_y     = dst_img->f_w - (dst_rect->x + dst_rect->w);
 
-        params->dst.width       =
+        cfg->dst.width       =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->h);
-        params->dst.height      =
+        cfg->dst.height      =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->w);
 
         if (0x50 > fimc->hw_ver)
-            params->dst.start_y     += (dst_rect->w - params->dst.height);
+            cfg->dst.start_y     += (dst_rect->w - cfg->dst.height);
         break;
     case 180:
-        params->dst.full_width  = dst_img->f_w;
-        params->dst.full_height = dst_img->f_h;
+        cfg->dst.full_width  = dst_img->f_w;
+        cfg->dst.full_height = dst_img->f_h;
 
-        params->dst.start_x     = dst_img->f_w - (dst_rect->x + dst_rect->w);
-        params->dst.start_y     = dst_img->f_h - (dst_rect->y + dst_rect->h);
+        cfg->dst.start_x     = dst_img->f_w - (dst_rect->x + dst_rect->w);
+        cfg->dst.start_y     = dst_img->f_h - (dst_rect->y + dst_rect->h);
 
-        params->dst.width       =
+        cfg->dst.width       =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->w);
-        params->dst.height      = heightOfPP(dst_color_space, dst_rect->h);
+        cfg->dst.height      = heightOfPP(dst_color_space, dst_rect->h);
         break;
     case 270:
-        params->dst.full_width  = dst_img->f_h;
-        params->dst.full_height = dst_img->f_w;
+        cfg->dst.full_width  = dst_img->f_h;
+        cfg->dst.full_height = dst_img->f_w;
 
-        params->dst.start_x     = dst_img->f_h - (dst_rect->y + dst_rect->h);
-        params->dst.start_y     = dst_rect->x;
+        cfg->dst.start_x     = dst_img->f_h - (dst_rect->y + dst_rect->h);
+        cfg->dst.start_y     = dst_rect->x;
 
-        params->dst.width       =
+        cfg->dst.width       =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->h);
-        params->dst.height      =
+        cfg->dst.height      =
             widthOfPP(fimc->hw_ver, dst_color_space, dst_rect->w);
 
         if (0x50 > fimc->hw_ver)
-            params->dst.start_y += (dst_rect->w - params->dst.height);
+            cfg->dst.start_y += (dst_rect->w - cfg->dst.height);
         break;
     }
-    params->dst.color_space = dst_color_space;
+    cfg->dst.color_space = dst_color_space;
 
     SEC_HWC_Log(HWC_LOG_DEBUG,
-            "runFimcCore()::"
+            "fimc_get_config()::"
             "SRC f.w(%d),f.h(%d),x(%d),y(%d),w(%d),h(%d)=>"
             "DST f.w(%d),f.h(%d),x(%d),y(%d),w(%d),h(%d)",
-            params->src.full_width, params->src.full_height,
-            params->src.start_x, params->src.start_y,
-            params->src.width, params->src.height,
-            params->dst.full_width, params->dst.full_height,
-            params->dst.start_x, params->dst.start_y,
-            params->dst.width, params->dst.height);
+            cfg->src.full_width, cfg->src.full_height,
+            cfg->src.start_x, cfg->src.start_y,
+            cfg->src.width, cfg->src.height,
+            cfg->dst.full_width, cfg->dst.full_height,
+            cfg->dst.start_x, cfg->dst.start_y,
+            cfg->dst.width, cfg->dst.height);
 
     /* check dst minimum */
     if (dst_rect->w  < 8 || dst_rect->h < 4) {
         SEC_HWC_Log(HWC_LOG_ERROR,
                 "%s dst size is not supported by fimc : f_w=%d f_h=%d "
                 "x=%d y=%d w=%d h=%d (ow=%d oh=%d) format=0x%x", __func__,
-                params->dst.full_width, params->dst.full_height,
-                params->dst.start_x, params->dst.start_y,
-                params->dst.width, params->dst.height,
-                dst_rect->w, dst_rect->h, params->dst.color_space);
+                cfg->dst.full_width, cfg->dst.full_height,
+                cfg->dst.start_x, cfg->dst.start_y,
+                cfg->dst.width, cfg->dst.height,
+                dst_rect->w, dst_rect->h, cfg->dst.color_space);
         return -1;
     }
     /* check scaling limit
@@ -1066,31 +1009,114 @@ static int runFimcCore(struct hwc_context_t *ctx,
         return -1;
     }
 
-   /* 3. Set configuration related to destination (DMA-OUT)
+    return 0;
+}
+
+/* the buffer addresses are not part of the setup */
+static bool fimc_img_info_equal(s5p_fimc_img_info *a, s5p_fimc_img_info *b)
+{
+    return (a->full_width  == b->full_width)  &&
+           (a->full_height == b->full_height) &&
+           (a->start_x     == b->start_x)     &&
+           (a->start_y     == b->start_y)     &&
+           (a->width       == b->width)       &&
+           (a->height      == b->height)      &&
+           (a->color_space == b->color_space);
+}
+
+/*
+ * Sets the FIMC up for cfg, writing to dst_phys_addr. When it already is,
+ * only the destination address and the input buffer are set.
+ * Returns 1 if the FIMC was set up again, 0 if not, -1 on error.
+ */
+static int fimc_set_config(struct hwc_context_t *ctx, struct hwc_fimc_config *cfg,
+        unsigned int dst_phys_addr)
+{
+    s5p_fimc_t             *fimc = &ctx->fimc;
+    struct hwc_fimc_config *cur  = &ctx->fimc_cfg;
+    bool same = ctx->fimc_cfg_valid &&
+                (cur->rotation == cfg->rotation) &&
+                (cur->hflip    == cfg->hflip)    &&
+                (cur->vflip    == cfg->vflip)    &&
+                fimc_img_info_equal(&cur->src, &cfg->src) &&
+                fimc_img_info_equal(&cur->dst, &cfg->dst);
+
+    if (same) {
+        if ((fimc_v4l2_set_dst_addr(fimc->dev_fd, &ctx->fimc_fbuf, dst_phys_addr) < 0) ||
+            (fimc_v4l2_req_src_buf(fimc->dev_fd) < 0)) {
+            ctx->fimc_cfg_valid = 0;
+            return -1;
+        }
+        return 0;
+    }
+
+    /* nothing is known about the FIMC until all of it is set */
+    ctx->fimc_cfg_valid = 0;
+
+   /* Set configuration related to destination (DMA-OUT)
      *   - set input format & size
      *   - crop input size
      *   - set input buffer
      *   - set buffer type (V4L2_MEMORY_USERPTR)
      */
-
-    if (fimc_v4l2_set_dst(fimc->dev_fd, &params->dst, rotate_value, hflip, vflip, dst_phys_addr) < 0) {
+    if (fimc_v4l2_set_dst(fimc->dev_fd, &cfg->dst, cfg->rotation, cfg->hflip, cfg->vflip,
+                dst_phys_addr, &ctx->fimc_fbuf) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_dst is failed\n");
         return -1;
     }
 
-   /* 4. Set configuration related to source (DMA-INPUT)
+   /* Set configuration related to source (DMA-INPUT)
      *   - set input format & size
      *   - crop input size
      *   - set input buffer
      *   - set buffer type (V4L2_MEMORY_USERPTR)
      */
-
-    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &params->src) < 0) {
+    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &cfg->src) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_src is failed\n");
         return -1;
     }
 
-    /* 5. Set input dma address (Y/RGB, Cb, Cr)
+    *cur = *cfg;
+    ctx->fimc_cfg_valid = 1;
+
+    return 1;
+}
+
+static int runFimcCore(struct hwc_context_t *ctx,
+        unsigned int src_phys_addr, sec_img *src_img, sec_rect *src_rect,
+        uint32_t src_color_space,
+        unsigned int dst_phys_addr, sec_img *dst_img, sec_rect *dst_rect,
+        uint32_t dst_color_space, int transform)
+{
+    s5p_fimc_t        * fimc = &ctx->fimc;
+    s5p_fimc_params_t * params = &(fimc->params);
+
+    struct hwc_fimc_config cfg;
+    struct fimc_buf fimc_src_buf;
+
+    bool src_cbcr_order = true;
+    int ret;
+
+    /* 1. param(fimc config) : src and dst information */
+    if (fimc_get_config(fimc, src_img, src_rect, src_color_space,
+                dst_img, dst_rect, dst_color_space, transform, &cfg) < 0)
+        return -1;
+
+    /* get_src_phys_addr() set the cb/cr addresses */
+    cfg.src.buf_addr_phy_rgb_y = src_phys_addr;
+    cfg.src.buf_addr_phy_cb    = params->src.buf_addr_phy_cb;
+    cfg.src.buf_addr_phy_cr    = params->src.buf_addr_phy_cr;
+    params->src = cfg.src;
+    params->dst = cfg.dst;
+
+    /* 2. Set configuration, fimc_preconfig() did it on geometry changes */
+    ret = fimc_set_config(ctx, &cfg, dst_phys_addr);
+    if (ret < 0)
+        return -1;
+    if (ret > 0)
+        ctx->stats.cur.num_of_fimc_config++;
+
+    /* 3. Set input dma address (Y/RGB, Cb, Cr)
      *    - zero copy : mfc, camera
      */
     switch (src_img->format) {
@@ -1114,28 +1140,28 @@ static int runFimcCore(struct hwc_context_t *ctx,
         if (src_img->format == HAL_PIXEL_FORMAT_YV12)
             src_cbcr_order = false;
 
-        if (src_img->usage & GRALLOC_USAGE_HW_FIMC1) {
-            fimc_src_buf.base[0] = params->src.buf_addr_phy_rgb_y;
-            if (src_cbcr_order == true) {
-                fimc_src_buf.base[1] = params->src.buf_addr_phy_cb;
-                fimc_src_buf.base[2] = params->src.buf_addr_phy_cr;
-            }
-            else {
-                fimc_src_buf.base[2] = params->src.buf_addr_phy_cb;
-                fimc_src_buf.base[1] = params->src.buf_addr_phy_cr;
-            }
-            SEC_HWC_Log(HWC_LOG_DEBUG,
-                    "runFimcCore - Y=0x%X, U=0x%X, V=0x%X\n",
-                    fimc_src_buf.base[0], fimc_src_buf.base[1],fimc_src_buf.base[2]);
-            break;
+        /* get_src_phys_addr() set the planes: FIMC1 buffer, contiguous buffer or copy */
+        fimc_src_buf.base[0] = params->src.buf_addr_phy_rgb_y;
+        if (src_cbcr_order == true) {
+            fimc_src_buf.base[1] = params->src.buf_addr_phy_cb;
+            fimc_src_buf.base[2] = params->src.buf_addr_phy_cr;
         }
+        else {
+            fimc_src_buf.base[2] = params->src.buf_addr_phy_cb;
+            fimc_src_buf.base[1] = params->src.buf_addr_phy_cr;
+        }
+        SEC_HWC_Log(HWC_LOG_DEBUG,
+                "runFimcCore - Y=0x%X, U=0x%X, V=0x%X\n",
+                fimc_src_buf.base[0], fimc_src_buf.base[1],fimc_src_buf.base[2]);
+        break;
     }
 
-    /* 6. Run FIMC
+    /* 4. Run FIMC
      *    - stream on => queue => dequeue => stream off => clear buf
      */
     if (fimc_handle_oneshot(fimc->dev_fd, &fimc_src_buf, NULL) < 0) {
         fimc_v4l2_clr_buf(fimc->dev_fd, V4L2_BUF_TYPE_OUTPUT);
+        ctx->fimc_cfg_valid = 0;
         return -1;
     }
 
@@ -1257,6 +1283,41 @@ int runFimc(struct hwc_context_t *ctx,
         return 0;
     }
 
+/*
+ * Sets the FIMC up for a layer when the geometry changes, so the first
+ * runFimc() of the new geometry finds it ready and only sets the buffers.
+ */
+int fimc_preconfig(struct hwc_context_t *ctx,
+            struct sec_img *src_img, struct sec_rect *src_rect,
+            struct sec_img *dst_img, struct sec_rect *dst_rect,
+            uint32_t transform)
+{
+    s5p_fimc_t *fimc = &ctx->fimc;
+    struct hwc_fimc_config cfg;
+    int32_t src_color_space;
+    int32_t dst_color_space;
+
+    if (0 == dst_img->base)
+        return -1;
+
+    src_color_space = HAL_PIXEL_FORMAT_2_V4L2_PIX(src_img->format);
+    dst_color_space = HAL_PIXEL_FORMAT_2_V4L2_PIX(dst_img->format);
+    if ((0 > src_color_space) || (0 > dst_color_space))
+        return -1;
+
+    if (fimc_get_config(fimc, src_img, src_rect, (uint32_t)src_color_space,
+                dst_img, dst_rect, (uint32_t)dst_color_space, transform, &cfg) < 0)
+        return -1;
+
+    if (fimc_set_config(ctx, &cfg, dst_img->base) < 0)
+        return -1;
+
+    /* leave the input buffer released, as fimc_handle_oneshot() does */
+    fimc_v4l2_clr_buf(fimc->dev_fd, V4L2_BUF_TYPE_OUTPUT);
+
+    return 0;
+}
+
 int check_yuv_format(unsigned int color_format) {
     switch (color_format) {
     case HAL_PIXEL_FORMAT_YV12:
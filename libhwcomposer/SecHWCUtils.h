@@ -38,6 +38,7 @@
 #include "videodev2.h"
 #include "s5p_fimc.h"
 #include "sec_utils.h"
+#include "sec_fimc_format.h"
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
@@ -47,10 +48,15 @@
 
 #include "s3c_lcd.h"
 #include "sec_format.h"
+#include "SecHWCFormat.h"
+#include "secion.h"
 
 //#define HWC_DEBUG 1
 #if defined(BOARD_USES_FIMGAPI)
-#include "sec_g2d.h"
+#include "FimgApi.h"
+
+/* RGB layers composed by G2D into one window, bottom to top */
+#define HWC_G2D_MAX_LAYER   (8)
 #endif
 
 #define SKIP_DUMMY_UI_LAY_DRAWING
@@ -60,15 +66,62 @@
 #define THRES_FOR_SWAP  (3427)    /* 60sec in Frames. 57fps * 60 = 3427 */
 #endif
 
-#define NUM_OF_DUMMY_WIN    (4)
+/*
+ * With BOARD_HWC_CAPTURE, "setprop debug.hwc.capture <file>" records every
+ * composed frame (layer list, composition decision and prepare/set time) to
+ * <file> until the property is cleared, test/hwc_capture_stat reads it and
+ * test/hwc_replay runs it through this HWC on the build host.
+ */
+#ifdef HWC_CAPTURE
+#define HWC_CAPTURE_PROP        "debug.hwc.capture"
+#define HWC_CAPTURE_POLL_FRAMES (60)            /* property is checked once per this many frames */
+#define HWC_CAPTURE_MAGIC       (0x43574853)    /* "SHWC" */
+#define HWC_CAPTURE_VERSION     (1)
+#define HWC_CAPTURE_MAX_LAYER   (32)
+#endif
+
+#define NUM_OF_DUMMY_WIN    (32)   /* framebuffer layers tracked for damage */
 #define NUM_OF_WIN          (2)
-#define NUM_OF_WIN_BUF      (2)
+#define NUM_OF_WIN_BUF      (2)     /* default, debug.hwc.winbuf sets 2..4 */
+#define MAX_NUM_OF_WIN_BUF  (4)
 #define NUM_OF_MEM_OBJ      (1)
 
-#if (NUM_OF_WIN_BUF < 2)
-    #define ENABLE_FIMD_VSYNC
+/* copies of YUV layers FIMC cannot address, the HDMI path reads the previous one */
+#define HWC_BOUNCE_BUF_NUM  (2)
+
+#define HWC_VSYNC_PERIOD_US (1000000 / 57)
+
+#ifdef HWC_EXTERNAL_DISPLAY
+#ifndef BOARD_USES_HDMI
+#error "HWC_EXTERNAL_DISPLAY drives the TV-out of libhdmi and needs BOARD_USES_HDMI"
+#endif
+/* HDMI hotplug, reported by the switch class of the HPD driver */
+#define HDMI_SWITCH_UEVENT  "change@/devices/virtual/switch/hdmi"
+#define HDMI_SWITCH_NODE    "/sys/class/switch/hdmi/state"
+#endif
+
+#ifdef SYSFS_VSYNC_NOTIFICATION
+#define VSYNC_TIME_NODE     "/sys/devices/platform/samsung-pd.2/s3cfb.0/vsync_time"
+
+/* interrupts the model must follow within HWC_VSYNC_LOCK_ERR_NS to predict */
+#define HWC_VSYNC_LOCK_FRAMES       (8)
+#define HWC_VSYNC_LOCK_ERR_NS       (500000)
+/* predicted vsyncs before the interrupt is turned on again to resync */
+#define HWC_VSYNC_PREDICT_FRAMES    (120)
+/* interrupts per jitter report */
+#define HWC_VSYNC_STATS_FRAMES      (1000)
 #endif
 
+/*
+ * Per frame composition statistics, kept for the last HWC_STATS_RING frames
+ * and summarized by dumpsys SurfaceFlinger. "setprop debug.hwc.stats <n>"
+ * also logs the summary every n frames.
+ */
+#define HWC_STATS_PROP          "debug.hwc.stats"
+#define HWC_STATS_POLL_FRAMES   (60)
+#define HWC_STATS_RING          (256)   /* power of two */
+#define HWC_STATS_GUARD         (8)     /* slots a reader keeps away from the writer */
+
 #define MAX_RESIZING_RATIO_LIMIT  (63)
 
 #ifdef SAMSUNG_EXYNOS4x12
@@ -119,8 +172,14 @@ struct hwc_win_info_t {
     int        fd;
     int        size;
     sec_rect   rect_info;
-    uint32_t   addr[NUM_OF_WIN_BUF];
+    uint32_t   addr[MAX_NUM_OF_WIN_BUF];
     int        buf_index;
+    int        num_of_buf;
+
+    /* scan out state, a replaced buffer is free after the next vsync */
+    int        buf_state[MAX_NUM_OF_WIN_BUF];
+    int32_t    buf_pan_us[MAX_NUM_OF_WIN_BUF];
+    int32_t    buf_release_us[MAX_NUM_OF_WIN_BUF];
 
     int        power_state;
     int        blending;
@@ -138,6 +197,39 @@ enum {
     HWC_WIN_RESERVED,
 };
 
+#ifdef SYSFS_VSYNC_NOTIFICATION
+struct hwc_vsync_info {
+    pthread_mutex_t lock;
+    int        node_fd;
+    int        epoll_fd;
+    int        ctl_pipe[2];        /* wakes the thread up on eventControl */
+    int        uevent_fd;          /* HDMI hotplug, -1 without HWC_EXTERNAL_DISPLAY */
+
+    int        enabled;            /* SurfaceFlinger wants vsync events */
+    int        hw_enabled;         /* FIMD vsync interrupt */
+    int        num_locked;         /* interrupts in a row close to the model */
+    int        num_predicted;      /* vsyncs delivered since the interrupt was off */
+    int        resync;             /* next interrupt ends a prediction */
+
+    int64_t    period_ns;
+    int64_t    phase_ns;           /* last interrupt */
+    int64_t    next_ns;            /* next predicted vsync */
+    int64_t    last_ns;            /* last vsync delivered */
+
+    uint32_t   stat_cnt;
+    uint32_t   stat_predicted;
+    int64_t    stat_err_sum_ns;
+    int64_t    stat_err_max_ns;
+    int64_t    stat_resync_err_max_ns;
+};
+#endif
+
+enum {
+    HWC_WIN_BUF_FREE = 0,
+    HWC_WIN_BUF_ON_SCREEN,
+    HWC_WIN_BUF_RELEASING,
+};
+
 enum {
     HWC_UNKNOWN_MEM_TYPE = 0,
     HWC_PHYS_MEM_TYPE,
@@ -147,11 +239,98 @@ enum {
 #ifdef SKIP_DUMMY_UI_LAY_DRAWING
 struct hwc_ui_lay_info{
     uint32_t   layer_prev_buf;
+    hwc_rect_t layer_prev_frame;
     int        layer_index;
     int        status;
 };
 #endif
 
+#if defined(BOARD_USES_FIMGAPI)
+/* what a G2D layer looked like when the window was last composed */
+struct hwc_g2d_lay_info {
+    uint32_t   handle;
+    hwc_rect_t sourceCrop;
+    hwc_rect_t displayFrame;
+    int32_t    blending;
+    uint32_t   plane_alpha;
+};
+#endif
+
+#ifdef HWC_CAPTURE
+/* file starts with one header, then per frame one record and its layers */
+struct hwc_capture_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lcd_width;
+    uint32_t lcd_height;
+    uint32_t num_of_win;
+    uint32_t reserved[3];
+};
+
+struct hwc_capture_frame {
+    uint32_t frame;
+    uint32_t flags;                 /* hwc_display_contents_1_t flags */
+    uint32_t num_of_layer;          /* layer records following */
+    int32_t  num_of_hwc_layer;
+    int32_t  num_of_fb_layer;
+    int32_t  num_2d_blit_layer;
+    int64_t  time_ns;               /* CLOCK_MONOTONIC at the end of set */
+    int64_t  prepare_ns;
+    int64_t  set_ns;
+};
+
+struct hwc_capture_layer {
+    int32_t    composition_type;
+    uint32_t   hints;
+    uint32_t   flags;
+    uint32_t   handle;              /* identifies the buffer across frames */
+    int32_t    format;
+    int32_t    width;
+    int32_t    height;
+    int32_t    stride;
+    int32_t    usage;
+    uint32_t   transform;
+    int32_t    blending;
+    hwc_rect_t source_crop;
+    hwc_rect_t display_frame;
+};
+#endif
+
+/* FIMC setup of one overlay window, everything but the buffer addresses */
+struct hwc_fimc_config {
+    s5p_fimc_img_info   src;
+    s5p_fimc_img_info   dst;
+    int                 rotation;
+    int                 hflip;
+    int                 vflip;
+};
+
+struct hwc_frame_stats {
+    int32_t  time_us;               /* end of set, wraps */
+    int32_t  prepare_us;
+    int32_t  set_us;
+    int32_t  fimc_us;
+    int32_t  vsync_latency_us;      /* last vsync to end of set, -1 if unknown */
+    uint8_t  num_of_hwc_layer;
+    uint8_t  num_2d_blit_layer;
+    uint8_t  num_of_fb_layer;
+    uint8_t  num_of_fb_lay_skip;    /* FB layers left out, unchanged */
+    uint8_t  num_of_dup_buf;        /* window buffers already on screen */
+    uint8_t  swap_skipped;          /* FB unchanged, no eglSwapBuffers */
+    uint8_t  geometry_changed;
+    uint8_t  num_of_fimc_config;    /* FIMC set up again in set, not prepare */
+};
+
+/* written by the composition thread only, read lock-free by dump */
+struct hwc_stats {
+    struct hwc_frame_stats    cur;
+    struct hwc_frame_stats    ring[HWC_STATS_RING];
+    volatile int32_t          head;             /* frames stored, wraps */
+    uint32_t                  poll_cnt;
+    uint32_t                  log_interval;     /* from HWC_STATS_PROP, 0 is off */
+    uint32_t                  log_cnt;
+};
+
 struct hwc_context_t {
     hwc_composer_device_1_t device;
 
@@ -162,6 +341,9 @@ struct hwc_context_t {
     struct hwc_ui_lay_info    win_virt[NUM_OF_DUMMY_WIN];
     int                       fb_lay_skip_initialized;
     int                       num_of_fb_lay_skip;
+    hwc_rect_t                fb_damage;          /* framebuffer region to post, empty is all */
+    void                      *set_swap_rect;     /* eglSetSwapRectangleANDROID or NULL */
+    int                       set_swap_rect_checked;
 #ifdef GL_WA_OVLY_ALL
     int                       ui_skip_frame_cnt;
 #endif
@@ -169,22 +351,60 @@ struct hwc_context_t {
 
     struct fb_var_screeninfo  lcd_info;
     s5p_fimc_t                fimc;
+    struct hwc_fimc_config    fimc_cfg;           /* what the FIMC is set up with */
+    int                       fimc_cfg_valid;
+    struct v4l2_framebuffer   fimc_fbuf;          /* VIDIOC_G_FBUF of fimc_cfg.dst */
+    struct secion_param       bounce_buf[HWC_BOUNCE_BUF_NUM];
+    int                       bounce_idx;
     hwc_procs_t               *procs;
     pthread_t                 uevent_thread;
     pthread_t                 vsync_thread;
+    volatile int32_t          vsync_time_us;      /* last vsync interrupt, wraps */
+    volatile int32_t          vsync_delivered_us; /* last vsync given to SurfaceFlinger, wraps */
+#ifdef SYSFS_VSYNC_NOTIFICATION
+    struct hwc_vsync_info     vsync;
+#endif
 
     int                       num_of_fb_layer;
     int                       num_of_hwc_layer;
     int                       num_of_fb_layer_prev;
     int                       num_2d_blit_layer;
     uint32_t                  layer_prev_buf[NUM_OF_WIN];
+#if defined(BOARD_USES_FIMGAPI)
+    int                       g2d_win_idx;
+    int                       g2d_layer_index[HWC_G2D_MAX_LAYER];
+    int                       g2d_prev_win_idx;   /* window of g2d_layer_prev, -1 when stale */
+    int                       num_of_g2d_layer_prev;
+    struct hwc_g2d_lay_info   g2d_layer_prev[HWC_G2D_MAX_LAYER];
+#endif
 
     int                       num_of_ext_disp_layer;
     int                       num_of_ext_disp_video_layer;
 
+    struct hwc_stats          stats;
+    int64_t                   prepare_ns;         /* last hwc_prepare() */
+
 #ifdef BOARD_USES_HDMI
     int                       hdmi_cable_status;
 #endif
+#ifdef HWC_EXTERNAL_DISPLAY
+    framebuffer_device_t     *fb_dev;               /* posts the framebuffer target of the panel */
+    int                       ext_connected;        /* HDMI switch state, set by the uevent thread */
+    volatile int32_t          ext_hotplug_pending;
+    int                       ext_active;           /* SurfaceFlinger composes displays[1] */
+    int                       ext_video_layer;      /* layer on the mixer video layer or -1 */
+    uint32_t                  ext_video_prev_buf;
+    uint32_t                  ext_fb_prev_buf;
+    int                       ext_layer_num;        /* layers tracked for the damage, -1 is unknown */
+    uint32_t                  ext_layer_prev_buf[NUM_OF_DUMMY_WIN];
+    hwc_rect_t                ext_layer_prev_frame[NUM_OF_DUMMY_WIN];
+#endif
+#ifdef HWC_CAPTURE
+    int                       capture_fd;         /* -1 while not capturing */
+    int                       capture_failed;     /* open failed, wait for the property to clear */
+    uint32_t                  capture_poll_cnt;
+    uint32_t                  capture_frame;
+#endif
 };
 
 typedef enum _LOG_LEVEL {
@@ -278,6 +498,7 @@ int window_close      (struct hwc_win_info_t *win);
 int window_set_pos    (struct hwc_win_info_t *win);
 int window_get_info   (struct hwc_win_info_t *win, int win_num);
 int window_pan_display(struct hwc_win_info_t *win);
+int window_get_free_buf(struct hwc_win_info_t *win, int32_t vsync_time_us);
 int window_show       (struct hwc_win_info_t *win);
 int window_hide       (struct hwc_win_info_t *win);
 int window_get_global_lcd_info(struct hwc_context_t *ctx);
@@ -288,6 +509,24 @@ int runFimc(struct hwc_context_t *ctx,
 	    struct sec_img *src_img, struct sec_rect *src_rect,
 	    struct sec_img *dst_img, struct sec_rect *dst_rect,
 	    uint32_t transform);
+int fimc_preconfig(struct hwc_context_t *ctx,
+	    struct sec_img *src_img, struct sec_rect *src_rect,
+	    struct sec_img *dst_img, struct sec_rect *dst_rect,
+	    uint32_t transform);
 int check_yuv_format(unsigned int color_format);
+void bounce_buf_init(struct hwc_context_t *ctx);
+int  bounce_buf_alloc(struct hwc_context_t *ctx, uint32_t full_w, uint32_t full_h);
+void bounce_buf_free(struct hwc_context_t *ctx);
+
+int64_t hwc_get_time_ns(void);
+
+void stats_frame_begin(struct hwc_context_t *ctx);
+void stats_frame_end  (struct hwc_context_t *ctx, int64_t prepare_ns, int64_t set_ns);
+int  stats_dump       (struct hwc_context_t *ctx, char *buff, int buff_len);
+#ifdef HWC_CAPTURE
+void capture_poll (struct hwc_context_t *ctx);
+void capture_frame(struct hwc_context_t *ctx, hwc_display_contents_1_t *list, int64_t set_ns);
+void capture_close(struct hwc_context_t *ctx);
+#endif
 
 #endif /* ANDROID_SEC_HWC_UTILS_H_*/
@@ -0,0 +1,89 @@
+# Copyright (C) 2008 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	hwc_capture_stat.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include \
+	$(LOCAL_PATH)/../../libfimg
+
+LOCAL_CFLAGS += -DHWC_CAPTURE
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+LOCAL_MODULE := hwc_capture_stat
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	hwc_format_bench.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include
+
+LOCAL_SHARED_LIBRARIES := libutils
+
+LOCAL_MODULE := hwc_format_bench
+include $(BUILD_EXECUTABLE)
+
+# Replays a capture through the HWC on a Linux build host, the windows and
+# FIMC are faked in hwc_replay_shim.cpp by wrapping open/close/ioctl/pread
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	hwc_replay.cpp \
+	hwc_replay_shim.cpp \
+	../SecHWCLog.cpp \
+	../SecHWCUtils.cpp \
+	../SecHWCCapture.cpp \
+	../SecHWCStats.cpp \
+	../SecHWC.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include \
+	$(LOCAL_PATH)/../../libfimg
+
+LOCAL_CFLAGS += -DSAMSUNG_EXYNOS4x12 -DSYSFS_VSYNC_NOTIFICATION -DHWC_CAPTURE -DPAGE_SIZE=4096
+
+ifeq ($(BOARD_USES_FIMGAPI),true)
+LOCAL_CFLAGS += -DBOARD_USES_FIMGAPI
+endif
+
+ifeq ($(BOARD_NO_OVERLAY),true)
+LOCAL_CFLAGS += -DBOARD_NO_OVERLAY
+endif
+
+LOCAL_LDFLAGS += -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=ioctl -Wl,--wrap=pread
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS += -lpthread -lrt
+
+LOCAL_MODULE := hwc_replay
+include $(BUILD_HOST_EXECUTABLE)
+endif
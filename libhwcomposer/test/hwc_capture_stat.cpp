@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Reads a capture written with "setprop debug.hwc.capture <file>".
+ *
+ *   hwc_capture_stat <capture> [reference]
+ *
+ * Prints how the frames were composed (GLES, FIMC overlay, G2D) and the
+ * prepare/set time percentiles. With a reference capture of the same
+ * scenario the composition type of every layer is compared frame by frame
+ * and the time percentiles are put side by side; any frame composed
+ * differently makes the exit status 1, so a build can be checked against a
+ * known good one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SecHWCUtils.h"
+
+#define STAT_MAX_DIFF_PRINT     (10)
+
+struct capture_file {
+    FILE                        *fp;
+    const char                  *path;
+    struct hwc_capture_header   header;
+    struct hwc_capture_frame    frame;
+    struct hwc_capture_layer    layer[HWC_CAPTURE_MAX_LAYER];
+};
+
+struct capture_stat {
+    uint32_t    num_of_frame;
+    uint32_t    num_of_geometry;    /* frames with HWC_GEOMETRY_CHANGED */
+    uint32_t    num_of_gles;        /* frames with a framebuffer layer */
+    uint32_t    num_of_overlay;     /* frames with a FIMC overlay */
+    uint32_t    num_of_g2d;         /* frames with G2D layers */
+    uint32_t    num_of_layer;
+    uint32_t    size;
+    int64_t     *prepare_ns;
+    int64_t     *set_ns;
+};
+
+static int capture_open(struct capture_file *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+    file->path = path;
+
+    file->fp = fopen(path, "rb");
+    if (file->fp == NULL) {
+        printf("%s: can't open\n", path);
+        return -1;
+    }
+
+    if (fread(&file->header, sizeof(file->header), 1, file->fp) != 1 ||
+        file->header.magic != HWC_CAPTURE_MAGIC) {
+        printf("%s: not a HWC capture\n", path);
+        fclose(file->fp);
+        return -1;
+    }
+
+    if (file->header.version != HWC_CAPTURE_VERSION) {
+        printf("%s: version %u, %u is supported\n", path,
+               file->header.version, HWC_CAPTURE_VERSION);
+        fclose(file->fp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 1 when a frame was read, 0 at the end, -1 on a truncated file */
+static int capture_next(struct capture_file *file)
+{
+    if (fread(&file->frame, sizeof(file->frame), 1, file->fp) != 1)
+        return 0;
+
+    if (HWC_CAPTURE_MAX_LAYER < file->frame.num_of_layer ||
+        fread(file->layer, sizeof(file->layer[0]), file->frame.num_of_layer, file->fp) !=
+        file->frame.num_of_layer) {
+        printf("%s: frame %u is truncated\n", file->path, file->frame.frame);
+        return -1;
+    }
+
+    return 1;
+}
+
+static int stat_add(struct capture_stat *stat, struct capture_file *file)
+{
+    struct hwc_capture_frame *frame = &file->frame;
+    int num_of_overlay = frame->num_of_hwc_layer - frame->num_2d_blit_layer;
+
+    if (stat->num_of_frame == stat->size) {
+        uint32_t size = stat->size ? stat->size * 2 : 1024;
+        int64_t *prepare_ns = (int64_t *)realloc(stat->prepare_ns, size * sizeof(int64_t));
+        int64_t *set_ns;
+
+        if (prepare_ns == NULL)
+            return -1;
+        stat->prepare_ns = prepare_ns;
+
+        set_ns = (int64_t *)realloc(stat->set_ns, size * sizeof(int64_t));
+        if (set_ns == NULL)
+            return -1;
+        stat->set_ns = set_ns;
+        stat->size = size;
+    }
+
+    stat->prepare_ns[stat->num_of_frame] = frame->prepare_ns;
+    stat->set_ns[stat->num_of_frame]     = frame->set_ns;
+    stat->num_of_frame++;
+    stat->num_of_layer += frame->num_of_layer;
+
+    if (frame->flags & HWC_GEOMETRY_CHANGED)
+        stat->num_of_geometry++;
+    if (0 < frame->num_of_fb_layer)
+        stat->num_of_gles++;
+    if (0 < num_of_overlay)
+        stat->num_of_overlay++;
+    if (0 < frame->num_2d_blit_layer)
+        stat->num_of_g2d++;
+
+    return 0;
+}
+
+static int compare_ns(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static int64_t percentile_us(int64_t *sorted, uint32_t num, int pct)
+{
+    if (num == 0)
+        return 0;
+
+    return sorted[((uint64_t)(num - 1) * pct) / 100] / 1000;
+}
+
+static void stat_print(const char *name, struct capture_stat *stat)
+{
+    uint32_t num = stat->num_of_frame;
+
+    if (num == 0) {
+        printf("%-9s: no frames\n", name);
+        return;
+    }
+
+    qsort(stat->prepare_ns, num, sizeof(int64_t), compare_ns);
+    qsort(stat->set_ns, num, sizeof(int64_t), compare_ns);
+
+    printf("%-9s: %u frames, %.1f layers/frame, geometry changed %u\n", name,
+           num, (float)stat->num_of_layer / num, stat->num_of_geometry);
+    printf("%-9s: GLES %u%%, overlay %u%%, G2D %u%% of the frames\n", name,
+           stat->num_of_gles * 100 / num, stat->num_of_overlay * 100 / num,
+           stat->num_of_g2d * 100 / num);
+    printf("%-9s: prepare p50 %lld p90 %lld p99 %lld max %lld us\n", name,
+           percentile_us(stat->prepare_ns, num, 50), percentile_us(stat->prepare_ns, num, 90),
+           percentile_us(stat->prepare_ns, num, 99), stat->prepare_ns[num - 1] / 1000);
+    printf("%-9s: set     p50 %lld p90 %lld p99 %lld max %lld us\n", name,
+           percentile_us(stat->set_ns, num, 50), percentile_us(stat->set_ns, num, 90),
+           percentile_us(stat->set_ns, num, 99), stat->set_ns[num - 1] / 1000);
+}
+
+static const char *composition_name(int32_t type)
+{
+    switch (type) {
+    case HWC_FRAMEBUFFER:
+        return "FB";
+    case HWC_OVERLAY:
+        return "OVERLAY";
+    case HWC_BACKGROUND:
+        return "BACKGROUND";
+    default:
+        return "TARGET";
+    }
+}
+
+/* 1 when the two frames were composed differently */
+static int frame_differs(struct capture_file *cur, struct capture_file *ref, int print)
+{
+    uint32_t i;
+
+    if (cur->frame.num_of_layer != ref->frame.num_of_layer) {
+        if (print)
+            printf("frame %u: %u layers, reference %u\n", cur->frame.frame,
+                   cur->frame.num_of_layer, ref->frame.num_of_layer);
+        return 1;
+    }
+
+    for (i = 0; i < cur->frame.num_of_layer; i++) {
+        if (cur->layer[i].composition_type != ref->layer[i].composition_type)
+            break;
+    }
+
+    if ((i == cur->frame.num_of_layer) &&
+        (cur->frame.num_2d_blit_layer == ref->frame.num_2d_blit_layer))
+        return 0;
+
+    if (print) {
+        if (i < cur->frame.num_of_layer)
+            printf("frame %u: layer %u (format 0x%x %dx%d) %s, reference %s\n",
+                   cur->frame.frame, i, cur->layer[i].format,
+                   cur->layer[i].width, cur->layer[i].height,
+                   composition_name(cur->layer[i].composition_type),
+                   composition_name(ref->layer[i].composition_type));
+        else
+            printf("frame %u: %d G2D layers, reference %d\n", cur->frame.frame,
+                   cur->frame.num_2d_blit_layer, ref->frame.num_2d_blit_layer);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    struct capture_file *cur;
+    struct capture_file *ref = NULL;
+    struct capture_stat cur_stat, ref_stat;
+    uint32_t num_of_diff = 0;
+    int ret = 0;
+
+    if (argc < 2) {
+        printf("usage: %s <capture> [reference]\n", argv[0]);
+        return 2;
+    }
+
+    memset(&cur_stat, 0, sizeof(cur_stat));
+    memset(&ref_stat, 0, sizeof(ref_stat));
+
+    cur = (struct capture_file *)malloc(sizeof(*cur));
+    if (cur == NULL || capture_open(cur, argv[1]) < 0)
+        return 2;
+
+    if (argc > 2) {
+        ref = (struct capture_file *)malloc(sizeof(*ref));
+        if (ref == NULL || capture_open(ref, argv[2]) < 0)
+            return 2;
+
+        if (cur->header.lcd_width != ref->header.lcd_width ||
+            cur->header.lcd_height != ref->header.lcd_height)
+            printf("warning: panel %ux%u, reference %ux%u\n",
+                   cur->header.lcd_width, cur->header.lcd_height,
+                   ref->header.lcd_width, ref->header.lcd_height);
+    }
+
+    for (;;) {
+        int cur_ret = capture_next(cur);
+        int ref_ret = ref ? capture_next(ref) : 0;
+
+        if (cur_ret < 0 || ref_ret < 0)
+            return 2;
+
+        if (cur_ret && stat_add(&cur_stat, cur) < 0)
+            return 2;
+        if (ref_ret && stat_add(&ref_stat, ref) < 0)
+            return 2;
+
+        if (cur_ret && ref_ret &&
+            frame_differs(cur, ref, num_of_diff < STAT_MAX_DIFF_PRINT))
+            num_of_diff++;
+
+        if (!cur_ret && !ref_ret)
+            break;
+    }
+
+    stat_print("capture", &cur_stat);
+
+    if (ref) {
+        stat_print("reference", &ref_stat);
+
+        if (cur_stat.num_of_frame != ref_stat.num_of_frame)
+            printf("warning: %u frames, reference %u, only the common ones are compared\n",
+                   cur_stat.num_of_frame, ref_stat.num_of_frame);
+
+        printf("composition: %u frames differ, %s\n", num_of_diff, num_of_diff ? "FAIL" : "ok");
+        if (num_of_diff)
+            ret = 1;
+    }
+
+    return ret;
+}
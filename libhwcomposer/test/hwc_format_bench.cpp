@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the format tables of sec_fimc_format.h and SecHWCFormat.h against
+ * the switches and the yuv_list scan they replaced, then times both.
+ *
+ *   hwc_format_bench [frames] [layers]
+ *
+ * Every format is compared for each FIMC version and a range of sizes, any
+ * difference is printed and the exit status is 1. The timed loop makes the
+ * per layer format decisions of prepare and of the FIMC setup (overlay
+ * class, frame padding, aligned destination size, bpp and planes) for a
+ * frame of the given number of layers, cycling through the formats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hardware/hardware.h>
+#include <utils/Timers.h>
+
+#include "s5p_fimc.h"
+#include "sec_format.h"
+#include "sec_fimc_format.h"
+#include "SecHWCFormat.h"
+
+#define ARRAY_SIZE(a)   ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* ---- before: the per-format switches of SecHWC.cpp and SecHWCUtils.cpp ---- */
+
+static struct yuv_fmt_list yuv_list[] = {
+    { "V4L2_PIX_FMT_NV12",      "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12,     12, 2 },
+    { "V4L2_PIX_FMT_NV12T",     "YUV420/2P/LSB_CBCR",   V4L2_PIX_FMT_NV12T,    12, 2 },
+    { "V4L2_PIX_FMT_NV21",      "YUV420/2P/LSB_CRCB",   V4L2_PIX_FMT_NV21,     12, 2 },
+    { "V4L2_PIX_FMT_NV21X",     "YUV420/2P/MSB_CBCR",   V4L2_PIX_FMT_NV21X,    12, 2 },
+    { "V4L2_PIX_FMT_NV12X",     "YUV420/2P/MSB_CRCB",   V4L2_PIX_FMT_NV12X,    12, 2 },
+    { "V4L2_PIX_FMT_YUV420",    "YUV420/3P",            V4L2_PIX_FMT_YUV420,   12, 3 },
+    { "V4L2_PIX_FMT_YUYV",      "YUV422/1P/YCBYCR",     V4L2_PIX_FMT_YUYV,     16, 1 },
+    { "V4L2_PIX_FMT_YVYU",      "YUV422/1P/YCRYCB",     V4L2_PIX_FMT_YVYU,     16, 1 },
+    { "V4L2_PIX_FMT_UYVY",      "YUV422/1P/CBYCRY",     V4L2_PIX_FMT_UYVY,     16, 1 },
+    { "V4L2_PIX_FMT_VYUY",      "YUV422/1P/CRYCBY",     V4L2_PIX_FMT_VYUY,     16, 1 },
+    { "V4L2_PIX_FMT_UV12",      "YUV422/2P/LSB_CBCR",   V4L2_PIX_FMT_NV16,     16, 2 },
+    { "V4L2_PIX_FMT_UV21",      "YUV422/2P/LSB_CRCB",   V4L2_PIX_FMT_NV61,     16, 2 },
+    { "V4L2_PIX_FMT_UV12X",     "YUV422/2P/MSB_CBCR",   V4L2_PIX_FMT_NV16X,    16, 2 },
+    { "V4L2_PIX_FMT_UV21X",     "YUV422/2P/MSB_CRCB",   V4L2_PIX_FMT_NV61X,    16, 2 },
+    { "V4L2_PIX_FMT_YUV422P",   "YUV422/3P",            V4L2_PIX_FMT_YUV422P,  16, 3 },
+};
+
+static int old_multipleOf(int number, int align)
+{
+    return number - (number % align);
+}
+
+static int old_widthOfPP(unsigned int ver, int pp_color_format, int number)
+{
+    if (0x50 <= ver) {
+        switch (pp_color_format) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_NV61:
+        case V4L2_PIX_FMT_NV16:
+        case V4L2_PIX_FMT_YUV422P:
+        case V4L2_PIX_FMT_NV21:
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV12T:
+        case V4L2_PIX_FMT_YUV420:
+            return old_multipleOf(number, 2);
+        default:
+            return number;
+        }
+    }
+
+    switch (pp_color_format) {
+    case V4L2_PIX_FMT_RGB565:
+        return old_multipleOf(number, 8);
+    case V4L2_PIX_FMT_RGB32:
+        return old_multipleOf(number, 4);
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:
+        return old_multipleOf(number, 4);
+    case V4L2_PIX_FMT_NV61:
+    case V4L2_PIX_FMT_NV16:
+        return old_multipleOf(number, 8);
+    case V4L2_PIX_FMT_YUV422P:
+        return old_multipleOf(number, 16);
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12T:
+        return old_multipleOf(number, 8);
+    case V4L2_PIX_FMT_YUV420:
+        return old_multipleOf(number, 16);
+    default:
+        return number;
+    }
+}
+
+static int old_heightOfPP(int pp_color_format, int number)
+{
+    switch (pp_color_format) {
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12T:
+    case V4L2_PIX_FMT_YUV420:
+        return old_multipleOf(number, 2);
+    default:
+        return number;
+    }
+}
+
+static int old_get_yuv_bpp(unsigned int fmt)
+{
+    for (int i = 0; i < ARRAY_SIZE(yuv_list); i++) {
+        if (yuv_list[i].fmt == fmt)
+            return yuv_list[i].bpp;
+    }
+    return -1;
+}
+
+static int old_get_yuv_planes(unsigned int fmt)
+{
+    for (int i = 0; i < ARRAY_SIZE(yuv_list); i++) {
+        if (yuv_list[i].fmt == fmt)
+            return yuv_list[i].planes;
+    }
+    return -1;
+}
+
+static int old_overlay(int format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
+        return HWC_FORMAT_MFC;
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_YCbCr_420_P:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+        return HWC_FORMAT_SW;
+    default:
+        return HWC_FORMAT_FB;
+    }
+}
+
+static int old_pad_frame(int format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_YCbCr_420_P:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_I:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_I:
+    case HAL_PIXEL_FORMAT_CUSTOM_CbYCrY_422_I:
+    case HAL_PIXEL_FORMAT_CUSTOM_CrYCbY_422_I:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* ---- formats compared and timed ---- */
+
+static const unsigned int v4l2_formats[] = {
+    V4L2_PIX_FMT_RGB565,  V4L2_PIX_FMT_RGB32,   V4L2_PIX_FMT_RGB24,
+    V4L2_PIX_FMT_NV12,    V4L2_PIX_FMT_NV12T,   V4L2_PIX_FMT_NV21,
+    V4L2_PIX_FMT_NV21X,   V4L2_PIX_FMT_NV12X,   V4L2_PIX_FMT_YUV420,
+    V4L2_PIX_FMT_YUYV,    V4L2_PIX_FMT_YVYU,    V4L2_PIX_FMT_UYVY,
+    V4L2_PIX_FMT_VYUY,    V4L2_PIX_FMT_NV16,    V4L2_PIX_FMT_NV61,
+    V4L2_PIX_FMT_NV16X,   V4L2_PIX_FMT_NV61X,   V4L2_PIX_FMT_YUV422P,
+};
+
+static const int hal_formats[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_YCbCr_420_P,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+    HAL_PIXEL_FORMAT_YCbCr_420_SP,
+    HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP,
+    HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP,
+    HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED,
+    HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_SP,
+    HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_SP,
+    HAL_PIXEL_FORMAT_CUSTOM_YCbCr_422_I,
+    HAL_PIXEL_FORMAT_CUSTOM_YCrCb_422_I,
+    HAL_PIXEL_FORMAT_CUSTOM_CbYCrY_422_I,
+    HAL_PIXEL_FORMAT_CUSTOM_CrYCbY_422_I,
+};
+
+static int check_formats(void)
+{
+    int fail = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(v4l2_formats); i++) {
+        unsigned int fmt = v4l2_formats[i];
+
+        if (old_get_yuv_bpp(fmt) != sec_fimc_yuv_bpp(fmt) ||
+            old_get_yuv_planes(fmt) != sec_fimc_yuv_planes(fmt)) {
+            printf("v4l2 0x%08x: bpp/planes %d/%d, table %d/%d\n", fmt,
+                   old_get_yuv_bpp(fmt), old_get_yuv_planes(fmt),
+                   sec_fimc_yuv_bpp(fmt), sec_fimc_yuv_planes(fmt));
+            fail++;
+        }
+
+        for (int size = 1; size <= 64; size++) {
+            for (int v50 = 0; v50 <= 1; v50++) {
+                int w = old_widthOfPP(v50 ? 0x50 : 0x43, fmt, size);
+                if (w != sec_fimc_align_width(fmt, v50, size)) {
+                    printf("v4l2 0x%08x: width %d (v50 %d) -> %d, table %d\n", fmt, size,
+                           v50, w, sec_fimc_align_width(fmt, v50, size));
+                    fail++;
+                }
+            }
+            if (old_heightOfPP(fmt, size) != sec_fimc_align_height(fmt, size)) {
+                printf("v4l2 0x%08x: height %d -> %d, table %d\n", fmt, size,
+                       old_heightOfPP(fmt, size), sec_fimc_align_height(fmt, size));
+                fail++;
+            }
+        }
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(hal_formats); i++) {
+        const struct sec_hwc_format *format = sec_hwc_get_format(hal_formats[i]);
+
+        if (old_overlay(hal_formats[i]) != format->overlay ||
+            old_pad_frame(hal_formats[i]) != format->pad_frame) {
+            printf("hal 0x%x: overlay/pad %d/%d, table %d/%d\n", hal_formats[i],
+                   old_overlay(hal_formats[i]), old_pad_frame(hal_formats[i]),
+                   format->overlay, format->pad_frame);
+            fail++;
+        }
+    }
+
+    return fail;
+}
+
+/* ---- timing ---- */
+
+struct bench_layer {
+    int             hal_fmt;
+    unsigned int    v4l2_fmt;
+    int             w;
+    int             h;
+};
+
+static volatile int sink;
+
+static int layer_old(struct bench_layer *l)
+{
+    int sum = old_overlay(l->hal_fmt) + old_pad_frame(l->hal_fmt);
+
+    sum += old_widthOfPP(0x50, l->v4l2_fmt, l->w) + old_heightOfPP(l->v4l2_fmt, l->h);
+    sum += old_get_yuv_bpp(l->v4l2_fmt) + old_get_yuv_planes(l->v4l2_fmt);
+    return sum;
+}
+
+static int layer_new(struct bench_layer *l)
+{
+    const struct sec_hwc_format *format = sec_hwc_get_format(l->hal_fmt);
+    int sum = format->overlay + format->pad_frame;
+
+    sum += sec_fimc_align_width(l->v4l2_fmt, true, l->w) + sec_fimc_align_height(l->v4l2_fmt, l->h);
+    sum += sec_fimc_yuv_bpp(l->v4l2_fmt) + sec_fimc_yuv_planes(l->v4l2_fmt);
+    return sum;
+}
+
+#define BENCH_POOL  (ARRAY_SIZE(v4l2_formats))
+
+static struct bench_layer layers[BENCH_POOL];
+
+static nsecs_t bench(const char *name, int (*layer)(struct bench_layer *),
+                     int numOfLayer, int frames)
+{
+    nsecs_t start = systemTime();
+    int next = 0;
+    int sum = 0;
+
+    /* a frame takes the next numOfLayer layers of the pool */
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < numOfLayer; i++) {
+            sum += layer(&layers[next]);
+            if (++next == BENCH_POOL)
+                next = 0;
+        }
+    }
+    sink = sum;
+
+    nsecs_t time = systemTime() - start;
+    printf("%-6s : %6lld ns/frame, %4lld ns/layer\n", name,
+           (long long)(time / frames), (long long)(time / ((nsecs_t)frames * numOfLayer)));
+    return time;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 1000000;
+    int numOfLayer = 4;
+    int fail;
+
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (argc > 2)
+        numOfLayer = atoi(argv[2]);
+
+    if (frames < 1 || numOfLayer < 1) {
+        printf("usage: %s [frames] [layers]\n", argv[0]);
+        return 1;
+    }
+
+    fail = check_formats();
+    printf("formats: %d v4l2, %d hal, %s\n", ARRAY_SIZE(v4l2_formats),
+           ARRAY_SIZE(hal_formats), fail ? "FAIL" : "ok");
+
+    for (int i = 0; i < BENCH_POOL; i++) {
+        layers[i].hal_fmt  = hal_formats[i % ARRAY_SIZE(hal_formats)];
+        layers[i].v4l2_fmt = v4l2_formats[i];
+        layers[i].w        = 1280 - i;
+        layers[i].h        = 720 - i;
+    }
+
+    bench("switch", layer_old, numOfLayer, frames);
+    bench("table", layer_new, numOfLayer, frames);
+
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,527 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds a capture written with "setprop debug.hwc.capture <file>" through
+ * hwc_prepare()/hwc_set() of this HWC on the build host, against the fake
+ * windows and FIMC of hwc_replay_shim.cpp.
+ *
+ *   hwc_replay [-v] [-s] [-n loops] <capture>
+ *
+ * Every frame is prepared and set as SurfaceFlinger would: the layers keep
+ * their composition type until the geometry changes, and one vsync passes
+ * between two frames. Prints the prepare/set time percentiles, the fb and
+ * FIMC ioctls, FBIOPAN_DISPLAY, FIMC frames and pixels, G2D blits and the
+ * overlay hit rate, and counts the layers composed differently than in the
+ * capture. -v prints one CSV line per frame, -s makes any such layer exit
+ * with 1, so a composition change can be checked in CI. The buffers hold no
+ * pixels: a capture only has the layer geometry and format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+
+#include "SecHWCUtils.h"
+#include "gralloc_priv.h"
+#include "hwc_replay_shim.h"
+
+#define REPLAY_ALIGN(x, a)      (((x) + (a) - 1) & ~((a) - 1))
+
+extern hwc_module_t HAL_MODULE_INFO_SYM;
+
+struct capture_file {
+    FILE                        *fp;
+    const char                  *path;
+    struct hwc_capture_header   header;
+    struct hwc_capture_frame    frame;
+    struct hwc_capture_layer    layer[HWC_CAPTURE_MAX_LAYER];
+};
+
+/* a buffer of the capture, looked up by its handle there */
+struct replay_buffer {
+    uint32_t            id;
+    int                 format;
+    int                 width;
+    int                 height;
+    int                 stride;
+    int                 usage;
+    private_handle_t    *handle;
+    void                *mem;
+    size_t              size;
+};
+
+struct replay_frame {
+    int64_t             prepare_ns;
+    int64_t             set_ns;
+    uint32_t            overlay;    /* layers on a FIMC overlay */
+    uint32_t            mismatch;   /* layers composed differently than captured */
+};
+
+struct replay_stat {
+    uint32_t            num_of_frame;
+    uint32_t            size;
+    struct replay_frame *frame;
+    uint32_t            num_of_layer;
+    uint32_t            num_of_overlay_frame;
+    uint32_t            num_of_overlay_layer;
+    uint32_t            num_of_mismatch_frame;
+    uint32_t            num_of_mismatch_layer;
+    uint32_t            max_ioctl_fb;
+    uint32_t            max_ioctl_fimc;
+};
+
+static struct replay_buffer *g_buffer;
+static uint32_t             g_num_of_buffer;
+static uint32_t             g_size_of_buffer;
+
+static int capture_open(struct capture_file *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+    file->path = path;
+
+    file->fp = fopen(path, "rb");
+    if (file->fp == NULL) {
+        printf("%s: can't open\n", path);
+        return -1;
+    }
+
+    if (fread(&file->header, sizeof(file->header), 1, file->fp) != 1 ||
+        file->header.magic != HWC_CAPTURE_MAGIC) {
+        printf("%s: not a HWC capture\n", path);
+        fclose(file->fp);
+        return -1;
+    }
+
+    if (file->header.version != HWC_CAPTURE_VERSION) {
+        printf("%s: version %u, %u is supported\n", path,
+               file->header.version, HWC_CAPTURE_VERSION);
+        fclose(file->fp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 1 when a frame was read, 0 at the end, -1 on a truncated file */
+static int capture_next(struct capture_file *file)
+{
+    if (fread(&file->frame, sizeof(file->frame), 1, file->fp) != 1)
+        return 0;
+
+    if (HWC_CAPTURE_MAX_LAYER < file->frame.num_of_layer ||
+        fread(file->layer, sizeof(file->layer[0]), file->frame.num_of_layer, file->fp) !=
+        file->frame.num_of_layer) {
+        printf("%s: frame %u is truncated\n", file->path, file->frame.frame);
+        return -1;
+    }
+
+    return 1;
+}
+
+static void capture_rewind(struct capture_file *file)
+{
+    fseek(file->fp, sizeof(file->header), SEEK_SET);
+}
+
+static int64_t get_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*****************************************************************************/
+/*
+ * What gralloc would have handed out for the layer: MFC output with its
+ * ADDRS at base, FIMC1 buffers with a physical address, anything else only
+ * mapped, so FIMC gets a bounce copy and G2D the virtual address.
+ */
+static int buffer_alloc(struct replay_buffer *buf, struct hwc_capture_layer *layer)
+{
+    int stride = layer->stride ? layer->stride : layer->width;
+    uint32_t frame_size = REPLAY_ALIGN(stride, 16) * REPLAY_ALIGN(layer->height, 2) * 4;
+    private_handle_t *handle;
+
+    memset(buf, 0, sizeof(*buf));
+    buf->id     = layer->handle;
+    buf->format = layer->format;
+    buf->width  = layer->width;
+    buf->height = layer->height;
+    buf->stride = layer->stride;
+    buf->usage  = layer->usage;
+    buf->size   = REPLAY_ALIGN(frame_size + PAGE_SIZE, PAGE_SIZE);
+
+    buf->mem = replay_shim_alloc(buf->size);
+    if (buf->mem == NULL) {
+        printf("can't map %zu bytes for buffer 0x%x\n", buf->size, layer->handle);
+        return -1;
+    }
+
+    handle = new private_handle_t(0, frame_size, (int)(uintptr_t)buf->mem, 0, 0, 0);
+    handle->format = layer->format;
+    handle->usage  = layer->usage;
+    handle->width  = layer->width;
+    handle->height = layer->height;
+    handle->stride = stride;
+    handle->bpp    = 4;
+
+    if (sec_hwc_get_format(layer->format)->overlay == HWC_FORMAT_MFC) {
+        ADDRS *addrs = (ADDRS *)buf->mem;
+        uint32_t y_size = REPLAY_ALIGN(layer->width, 16) * REPLAY_ALIGN(layer->height, 16);
+
+        addrs->addr_y    = replay_shim_phys(buf->mem) + PAGE_SIZE;
+        addrs->addr_cbcr = addrs->addr_y + y_size;
+        addrs->buf_idx   = 0;
+    } else if (layer->usage & GRALLOC_USAGE_HW_FIMC1) {
+        handle->paddr   = replay_shim_phys(buf->mem);
+        handle->uoffset = REPLAY_ALIGN(stride, 16) * REPLAY_ALIGN(layer->height, 16);
+        handle->voffset = handle->uoffset / 4;
+    }
+
+    buf->handle = handle;
+    return 0;
+}
+
+static void buffer_free(struct replay_buffer *buf)
+{
+    delete buf->handle;
+    replay_shim_free(buf->mem, buf->size);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* the handle for the layer, a new one when gralloc reused the handle */
+static buffer_handle_t buffer_get(struct hwc_capture_layer *layer)
+{
+    struct replay_buffer *buf = NULL;
+
+    if (layer->handle == 0)
+        return NULL;
+
+    for (uint32_t i = 0; i < g_num_of_buffer; i++) {
+        if (g_buffer[i].id == layer->handle) {
+            buf = &g_buffer[i];
+            break;
+        }
+    }
+
+    if (buf) {
+        if (buf->format == layer->format && buf->width == layer->width &&
+            buf->height == layer->height && buf->stride == layer->stride &&
+            buf->usage == layer->usage)
+            return buf->handle;
+        buffer_free(buf);
+    } else {
+        if (g_num_of_buffer == g_size_of_buffer) {
+            uint32_t size = g_size_of_buffer ? g_size_of_buffer * 2 : 64;
+            struct replay_buffer *buffer =
+                (struct replay_buffer *)realloc(g_buffer, size * sizeof(g_buffer[0]));
+
+            if (buffer == NULL)
+                return NULL;
+            g_buffer = buffer;
+            g_size_of_buffer = size;
+        }
+        buf = &g_buffer[g_num_of_buffer++];
+    }
+
+    if (buffer_alloc(buf, layer) < 0)
+        return NULL;
+
+    return buf->handle;
+}
+
+/*****************************************************************************/
+/* the list SurfaceFlinger keeps, the composition types survive the frame */
+static void list_fill(hwc_display_contents_1_t *list, hwc_rect_t *visible,
+                      struct capture_file *file, int reset)
+{
+    static int dummy_dpy, dummy_sur;
+
+    list->retireFenceFd = -1;
+    list->dpy           = &dummy_dpy;
+    list->sur           = &dummy_sur;
+    list->numHwLayers   = file->frame.num_of_layer;
+    list->flags         = file->frame.flags;
+    if (reset)
+        list->flags |= HWC_GEOMETRY_CHANGED;
+
+    for (uint32_t i = 0; i < file->frame.num_of_layer; i++) {
+        struct hwc_capture_layer *layer = &file->layer[i];
+        hwc_layer_1_t *cur = &list->hwLayers[i];
+
+        if (layer->composition_type == HWC_FRAMEBUFFER_TARGET) {
+            cur->compositionType = HWC_FRAMEBUFFER_TARGET;
+            cur->hints = 0;
+        } else if (list->flags & HWC_GEOMETRY_CHANGED) {
+            cur->compositionType = HWC_FRAMEBUFFER;
+            cur->hints = 0;
+        }
+
+        cur->flags          = layer->flags;
+        cur->handle         = buffer_get(layer);
+        cur->transform      = layer->transform;
+        cur->blending       = layer->blending;
+        cur->sourceCrop     = layer->source_crop;
+        cur->displayFrame   = layer->display_frame;
+        cur->acquireFenceFd = -1;
+        cur->releaseFenceFd = -1;
+
+        visible[i] = layer->display_frame;
+        cur->visibleRegionScreen.numRects = 1;
+        cur->visibleRegionScreen.rects    = &visible[i];
+    }
+}
+
+static void list_close_fences(hwc_display_contents_1_t *list)
+{
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        if (0 <= list->hwLayers[i].releaseFenceFd)
+            close(list->hwLayers[i].releaseFenceFd);
+        list->hwLayers[i].releaseFenceFd = -1;
+    }
+    if (0 <= list->retireFenceFd)
+        close(list->retireFenceFd);
+    list->retireFenceFd = -1;
+}
+
+/*****************************************************************************/
+static struct replay_frame *stat_add(struct replay_stat *stat)
+{
+    if (stat->num_of_frame == stat->size) {
+        uint32_t size = stat->size ? stat->size * 2 : 1024;
+        struct replay_frame *frame =
+            (struct replay_frame *)realloc(stat->frame, size * sizeof(stat->frame[0]));
+
+        if (frame == NULL)
+            return NULL;
+        stat->frame = frame;
+        stat->size  = size;
+    }
+
+    return &stat->frame[stat->num_of_frame++];
+}
+
+static int compare_prepare(const void *a, const void *b)
+{
+    int64_t x = ((const struct replay_frame *)a)->prepare_ns;
+    int64_t y = ((const struct replay_frame *)b)->prepare_ns;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static int compare_set(const void *a, const void *b)
+{
+    int64_t x = ((const struct replay_frame *)a)->set_ns;
+    int64_t y = ((const struct replay_frame *)b)->set_ns;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static void print_percentile(const char *name, struct replay_stat *stat, int prepare)
+{
+    uint32_t num = stat->num_of_frame;
+    int64_t us[4];
+    int pct[3] = { 50, 90, 99 };
+
+    qsort(stat->frame, num, sizeof(stat->frame[0]), prepare ? compare_prepare : compare_set);
+
+    for (int i = 0; i < 4; i++) {
+        struct replay_frame *frame =
+            &stat->frame[(i < 3) ? ((uint64_t)(num - 1) * pct[i]) / 100 : num - 1];
+
+        us[i] = (prepare ? frame->prepare_ns : frame->set_ns) / 1000;
+    }
+
+    printf("%-7s: p50 %lld p90 %lld p99 %lld max %lld us\n", name,
+           us[0], us[1], us[2], us[3]);
+}
+
+static void stat_print(struct replay_stat *stat, struct replay_counters *total)
+{
+    uint32_t num = stat->num_of_frame;
+
+    if (num == 0) {
+        printf("replay : no frames\n");
+        return;
+    }
+
+    printf("replay : %u frames, %.1f layers/frame\n", num, (float)stat->num_of_layer / num);
+    print_percentile("prepare", stat, 1);
+    print_percentile("set", stat, 0);
+    printf("ioctl  : fb %.1f (max %u), FIMC %.1f (max %u) per frame, %.2f pans per frame\n",
+           (float)total->ioctl_fb / num, stat->max_ioctl_fb,
+           (float)total->ioctl_fimc / num, stat->max_ioctl_fimc,
+           (float)total->pan / num);
+    printf("overlay: %u%% of the frames, %u%% of the layers\n",
+           stat->num_of_overlay_frame * 100 / num,
+           stat->num_of_layer ? stat->num_of_overlay_layer * 100 / stat->num_of_layer : 0);
+    printf("FIMC   : %u frames, %llu source and %llu destination pixels per frame\n",
+           total->fimc_frame,
+           (unsigned long long)(total->fimc_src_pixel / num),
+           (unsigned long long)(total->fimc_dst_pixel / num));
+    printf("G2D    : %u blits, %llu pixels per frame\n", total->g2d_blit,
+           (unsigned long long)(total->g2d_pixel / num));
+    printf("GLES   : %u swaps\n", total->egl_swap);
+    printf("capture: %u frames (%u layers) composed differently\n",
+           stat->num_of_mismatch_frame, stat->num_of_mismatch_layer);
+}
+
+int main(int argc, char **argv)
+{
+    struct capture_file *file;
+    struct replay_stat stat;
+    struct replay_counters total;
+    hwc_composer_device_1_t *dev;
+    struct hwc_context_t *ctx;
+    hwc_display_contents_1_t *list;
+    hwc_rect_t visible[HWC_CAPTURE_MAX_LAYER];
+    uint32_t prev_num_of_layer = 0;
+    int verbose = 0;
+    int strict = 0;
+    int loops = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vsn:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        case 's':
+            strict = 1;
+            break;
+        case 'n':
+            loops = atoi(optarg);
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+
+    if (argc <= optind || loops < 1) {
+        printf("usage: %s [-v] [-s] [-n loops] <capture>\n", argv[0]);
+        return 2;
+    }
+
+    memset(&stat, 0, sizeof(stat));
+
+    file = (struct capture_file *)malloc(sizeof(*file));
+    if (file == NULL || capture_open(file, argv[optind]) < 0)
+        return 2;
+
+    list = (hwc_display_contents_1_t *)calloc(1, sizeof(*list) +
+                HWC_CAPTURE_MAX_LAYER * sizeof(hwc_layer_1_t));
+    if (list == NULL)
+        return 2;
+
+    replay_shim_init(file->header.lcd_width, file->header.lcd_height);
+
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+            HWC_HARDWARE_COMPOSER, (struct hw_device_t **)&dev) < 0) {
+        printf("can't open the HWC\n");
+        return 2;
+    }
+    ctx = (struct hwc_context_t *)dev;
+
+    if (verbose)
+        printf("frame,prepare_us,set_us,ioctl_fb,ioctl_fimc,pan,fimc_frame,"
+               "fimc_src_pixel,fimc_dst_pixel,g2d_blit,g2d_pixel,overlay,g2d,fb,mismatch\n");
+
+    for (int loop = 0; loop < loops; loop++) {
+        int reset = 1;
+        int ret;
+
+        if (loop)
+            capture_rewind(file);
+
+        while ((ret = capture_next(file)) > 0) {
+            struct replay_counters before, after;
+            struct replay_frame *frame = stat_add(&stat);
+            uint32_t ioctl_fb, ioctl_fimc;
+            int64_t start_ns, prepare_ns;
+
+            if (frame == NULL)
+                return 2;
+
+            list_fill(list, visible, file,
+                      reset || (file->frame.num_of_layer != prev_num_of_layer));
+            reset = 0;
+            prev_num_of_layer = file->frame.num_of_layer;
+
+            replay_shim_get(&before);
+            start_ns = get_time_ns();
+            dev->prepare(dev, 1, &list);
+            prepare_ns = get_time_ns();
+            dev->set(dev, 1, &list);
+            frame->set_ns = get_time_ns() - prepare_ns;
+            frame->prepare_ns = prepare_ns - start_ns;
+            replay_shim_get(&after);
+
+            list_close_fences(list);
+
+            /* the panel scanned the frame out before the next one comes */
+            android_atomic_release_store((int32_t)(get_time_ns() / 1000) + 1,
+                                         &ctx->vsync_time_us);
+
+            ioctl_fb   = after.ioctl_fb - before.ioctl_fb;
+            ioctl_fimc = after.ioctl_fimc - before.ioctl_fimc;
+            frame->overlay  = ctx->num_of_hwc_layer - ctx->num_2d_blit_layer;
+            frame->mismatch = 0;
+            for (uint32_t i = 0; i < file->frame.num_of_layer; i++) {
+                if (list->hwLayers[i].compositionType != file->layer[i].composition_type)
+                    frame->mismatch++;
+            }
+
+            stat.num_of_layer += file->frame.num_of_layer;
+            stat.num_of_overlay_layer += frame->overlay;
+            if (frame->overlay)
+                stat.num_of_overlay_frame++;
+            if (frame->mismatch)
+                stat.num_of_mismatch_frame++;
+            stat.num_of_mismatch_layer += frame->mismatch;
+            stat.max_ioctl_fb   = SEC_MAX(stat.max_ioctl_fb, ioctl_fb);
+            stat.max_ioctl_fimc = SEC_MAX(stat.max_ioctl_fimc, ioctl_fimc);
+
+            if (verbose)
+                printf("%u,%lld,%lld,%u,%u,%u,%u,%llu,%llu,%u,%llu,%u,%d,%d,%u\n",
+                       stat.num_of_frame - 1, frame->prepare_ns / 1000, frame->set_ns / 1000,
+                       ioctl_fb, ioctl_fimc, after.pan - before.pan,
+                       after.fimc_frame - before.fimc_frame,
+                       (unsigned long long)(after.fimc_src_pixel - before.fimc_src_pixel),
+                       (unsigned long long)(after.fimc_dst_pixel - before.fimc_dst_pixel),
+                       after.g2d_blit - before.g2d_blit,
+                       (unsigned long long)(after.g2d_pixel - before.g2d_pixel),
+                       frame->overlay, ctx->num_2d_blit_layer, ctx->num_of_fb_layer,
+                       frame->mismatch);
+        }
+
+        if (ret < 0)
+            return 2;
+    }
+
+    replay_shim_get(&total);
+    dev->common.close(&dev->common);
+
+    stat_print(&stat, &total);
+
+    return (strict && stat.num_of_mismatch_layer) ? 1 : 0;
+}
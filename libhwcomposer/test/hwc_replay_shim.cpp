@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <EGL/egl.h>
+#include <GLES/gl.h>
+#include <hardware_legacy/uevent.h>
+#include <sync/sync.h>
+
+#include "SecHWCUtils.h"
+#include "hwc_replay_shim.h"
+
+#define SHIM_MAX_FD         (1024)
+#define SHIM_NUM_OF_FB      (5)
+#define SHIM_FB_PHYS_BASE   (0x80000000)    /* above replay_shim_alloc() memory */
+#define SHIM_FB_PHYS_SIZE   (0x04000000)
+#define SHIM_FIMC_VERSION   (0x51)          /* FIMC of the 4x12 */
+
+enum {
+    SHIM_DEV_NONE = 0,
+    SHIM_DEV_FB,
+    SHIM_DEV_FIMC,
+    SHIM_DEV_VSYNC,
+};
+
+struct shim_fb {
+    struct fb_var_screeninfo var;
+};
+
+struct shim_fimc {
+    struct v4l2_rect            crop;   /* VIDIOC_S_CROP of the source */
+    struct v4l2_rect            win;    /* VIDIOC_S_FMT of the overlay */
+    struct v4l2_framebuffer     fbuf;
+};
+
+static pthread_mutex_t          g_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char            g_fd_dev[SHIM_MAX_FD];
+static unsigned char            g_fd_fb[SHIM_MAX_FD];
+static uint32_t                 g_lcd_height;
+static struct shim_fb           g_fb[SHIM_NUM_OF_FB];
+static struct shim_fimc         g_fimc;
+static struct replay_counters   g_counters;
+
+extern "C" {
+int     __real_open(const char *path, int flags, ...);
+int     __real_close(int fd);
+int     __real_ioctl(int fd, unsigned long request, ...);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+}
+
+void replay_shim_init(uint32_t lcd_width, uint32_t lcd_height)
+{
+    pthread_mutex_lock(&g_lock);
+
+    g_lcd_height = lcd_height;
+    memset(g_fb, 0, sizeof(g_fb));
+    for (int i = 0; i < SHIM_NUM_OF_FB; i++) {
+        struct fb_var_screeninfo *var = &g_fb[i].var;
+
+        var->xres           = lcd_width;
+        var->yres           = lcd_height;
+        var->xres_virtual   = (lcd_width + 15) & ~15;
+        var->yres_virtual   = lcd_height * NUM_OF_WIN_BUF;
+        var->bits_per_pixel = 32;
+        var->red.offset     = 16;
+        var->red.length     = 8;
+        var->green.offset   = 8;
+        var->green.length   = 8;
+        var->blue.offset    = 0;
+        var->blue.length    = 8;
+        var->transp.offset  = 24;
+        var->transp.length  = 8;
+    }
+    memset(&g_fimc, 0, sizeof(g_fimc));
+    memset(&g_counters, 0, sizeof(g_counters));
+
+    pthread_mutex_unlock(&g_lock);
+}
+
+void replay_shim_get(struct replay_counters *counters)
+{
+    pthread_mutex_lock(&g_lock);
+    *counters = g_counters;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void *replay_shim_alloc(size_t size)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+
+    return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+void replay_shim_free(void *addr, size_t size)
+{
+    if (addr)
+        munmap(addr, size);
+}
+
+uint32_t replay_shim_phys(void *addr)
+{
+    return (uint32_t)(uintptr_t)addr;
+}
+
+/*****************************************************************************/
+/* the device a path is served by, fb index in *fb */
+static int shim_device(const char *path, int *fb)
+{
+    unsigned int id;
+    char tail;
+
+    if (sscanf(path, "/dev/graphics/fb%u%c", &id, &tail) == 1 && id < SHIM_NUM_OF_FB) {
+        *fb = id;
+        return SHIM_DEV_FB;
+    }
+    if (!strcmp(path, PP_DEVICE_DEV_NAME))
+        return SHIM_DEV_FIMC;
+    if (!strcmp(path, VSYNC_TIME_NODE))
+        return SHIM_DEV_VSYNC;
+
+    return SHIM_DEV_NONE;
+}
+
+static int shim_dev_of(int fd)
+{
+    if (fd < 0 || SHIM_MAX_FD <= fd)
+        return SHIM_DEV_NONE;
+    return g_fd_dev[fd];
+}
+
+static int shim_open(const char *path)
+{
+    int fb = 0;
+    int dev = shim_device(path, &fb);
+    int fd;
+
+    if (dev == SHIM_DEV_NONE)
+        return -2;
+
+    /* an eventfd, so epoll and close take it; it is never signalled */
+    fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (SHIM_MAX_FD <= fd) {
+        __real_close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    g_fd_dev[fd] = dev;
+    g_fd_fb[fd]  = fb;
+    pthread_mutex_unlock(&g_lock);
+
+    return fd;
+}
+
+extern "C" int __wrap_open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    int fd;
+
+    if (flags & O_CREAT) {
+        va_list ap;
+
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+
+    fd = shim_open(path);
+    if (fd == -2)
+        fd = __real_open(path, flags, mode);
+
+    return fd;
+}
+
+extern "C" int __wrap_close(int fd)
+{
+    if (shim_dev_of(fd) != SHIM_DEV_NONE) {
+        pthread_mutex_lock(&g_lock);
+        g_fd_dev[fd] = SHIM_DEV_NONE;
+        pthread_mutex_unlock(&g_lock);
+    }
+
+    return __real_close(fd);
+}
+
+/* the kernel's vsync_time node, the time of the last vsync in ns */
+extern "C" ssize_t __wrap_pread(int fd, void *buf, size_t count, off_t offset)
+{
+    struct timespec ts;
+    char value[32];
+    int len;
+
+    if (shim_dev_of(fd) != SHIM_DEV_VSYNC)
+        return __real_pread(fd, buf, count, offset);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    len = snprintf(value, sizeof(value), "%llu\n",
+                   (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    if ((size_t)len > count)
+        len = count;
+    memcpy(buf, value, len);
+
+    return len;
+}
+
+static int shim_fb_ioctl(int fb, unsigned long request, void *arg)
+{
+    struct fb_var_screeninfo *var = &g_fb[fb].var;
+
+    g_counters.ioctl_fb++;
+
+    switch (request) {
+    case FBIOGET_VSCREENINFO:
+        memcpy(arg, var, sizeof(*var));
+        return 0;
+
+    case FBIOPUT_VSCREENINFO:
+        memcpy(var, arg, sizeof(*var));
+        return 0;
+
+    case FBIOGET_FSCREENINFO: {
+        struct fb_fix_screeninfo *fix = (struct fb_fix_screeninfo *)arg;
+
+        memset(fix, 0, sizeof(*fix));
+        snprintf(fix->id, sizeof(fix->id), "s3cfb.%d", fb);
+        fix->line_length = var->xres_virtual * var->bits_per_pixel / 8;
+        fix->smem_start  = SHIM_FB_PHYS_BASE + fb * SHIM_FB_PHYS_SIZE;
+        fix->smem_len    = fix->line_length * g_lcd_height * MAX_NUM_OF_WIN_BUF;
+        return 0;
+    }
+
+    case FBIOPAN_DISPLAY:
+        var->yoffset = ((struct fb_var_screeninfo *)arg)->yoffset;
+        g_counters.pan++;
+        return 0;
+
+    case FBIOBLANK:
+    case S3CFB_WIN_POSITION:
+    case S3CFB_SET_VSYNC_INT:
+        return 0;
+
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+static int shim_fimc_ioctl(unsigned long request, void *arg)
+{
+    g_counters.ioctl_fimc++;
+
+    switch (request) {
+    case VIDIOC_QUERYCAP: {
+        struct v4l2_capability *cap = (struct v4l2_capability *)arg;
+
+        memset(cap, 0, sizeof(*cap));
+        strcpy((char *)cap->driver, "s3c-fimc");
+        cap->capabilities = V4L2_CAP_STREAMING | V4L2_CAP_VIDEO_OUTPUT |
+                            V4L2_CAP_VIDEO_OVERLAY;
+        return 0;
+    }
+
+    case VIDIOC_G_CTRL: {
+        struct v4l2_control *vc = (struct v4l2_control *)arg;
+
+        vc->value = (vc->id == V4L2_CID_FIMC_VERSION) ? SHIM_FIMC_VERSION : 0;
+        return 0;
+    }
+
+    case VIDIOC_S_FMT: {
+        struct v4l2_format *fmt = (struct v4l2_format *)arg;
+
+        if (fmt->type == V4L2_BUF_TYPE_VIDEO_OVERLAY)
+            g_fimc.win = fmt->fmt.win.w;
+        return 0;
+    }
+
+    case VIDIOC_S_CROP:
+        g_fimc.crop = ((struct v4l2_crop *)arg)->c;
+        return 0;
+
+    case VIDIOC_G_FBUF:
+        memcpy(arg, &g_fimc.fbuf, sizeof(g_fimc.fbuf));
+        return 0;
+
+    case VIDIOC_S_FBUF:
+        memcpy(&g_fimc.fbuf, arg, sizeof(g_fimc.fbuf));
+        return 0;
+
+    case VIDIOC_QBUF:
+        if (((struct v4l2_buffer *)arg)->type == V4L2_BUF_TYPE_VIDEO_OUTPUT) {
+            g_counters.fimc_frame++;
+            g_counters.fimc_src_pixel += (uint64_t)g_fimc.crop.width * g_fimc.crop.height;
+            g_counters.fimc_dst_pixel += (uint64_t)g_fimc.win.width * g_fimc.win.height;
+        }
+        return 0;
+
+    case VIDIOC_DQBUF:
+        ((struct v4l2_buffer *)arg)->index = 0;
+        return 0;
+
+    case VIDIOC_G_FMT:
+    case VIDIOC_S_CTRL:
+    case VIDIOC_REQBUFS:
+    case VIDIOC_STREAMON:
+    case VIDIOC_STREAMOFF:
+        return 0;
+
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+extern "C" int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+    int ret;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    pthread_mutex_lock(&g_lock);
+    switch (shim_dev_of(fd)) {
+    case SHIM_DEV_FB:
+        ret = shim_fb_ioctl(g_fd_fb[fd], request, arg);
+        break;
+    case SHIM_DEV_FIMC:
+        ret = shim_fimc_ioctl(request, arg);
+        break;
+    case SHIM_DEV_VSYNC:
+        errno = ENOTTY;
+        ret = -1;
+        break;
+    default:
+        pthread_mutex_unlock(&g_lock);
+        return __real_ioctl(fd, request, arg);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    return ret;
+}
+
+/*****************************************************************************/
+#if defined(BOARD_USES_FIMGAPI)
+/* G2D: counted, the destination is never touched */
+extern "C" int stretchFimgApiBatch(struct fimg2d_blit **cmd, int numOfCmd)
+{
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < numOfCmd; i++) {
+        struct fimg2d_rect *rect = &cmd[i]->dst->rect;
+
+        g_counters.g2d_blit++;
+        g_counters.g2d_pixel += (uint64_t)(rect->x2 - rect->x1) * (rect->y2 - rect->y1);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    return 0;
+}
+#endif
+
+/* ION: the bounce buffers, plain memory with a made up physical address */
+extern "C" int createIONMem(struct secion_param *param, size_t size, unsigned int flags)
+{
+    param->memory = replay_shim_alloc(size);
+    if (param->memory == NULL) {
+        param->buffer   = -1;
+        param->size     = 0;
+        param->physaddr = 0;
+        return -1;
+    }
+
+    param->client   = 0;
+    param->buffer   = 0;
+    param->size     = size;
+    param->physaddr = replay_shim_phys(param->memory);
+    return 0;
+}
+
+extern "C" int destroyIONMem(struct secion_param *param)
+{
+    replay_shim_free(param->memory, param->size);
+    param->buffer   = -1;
+    param->size     = 0;
+    param->memory   = 0;
+    param->physaddr = 0;
+    return 0;
+}
+
+extern "C" int ion_msync(ion_client client, ion_buffer buffer, long flags,
+                         size_t size, off_t offset)
+{
+    return 0;
+}
+
+extern "C" void ion_client_destroy(ion_client client)
+{
+}
+
+/* EGL and GLES: SurfaceFlinger's side of the framebuffer layers */
+extern "C" EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    pthread_mutex_lock(&g_lock);
+    g_counters.egl_swap++;
+    pthread_mutex_unlock(&g_lock);
+
+    return EGL_TRUE;
+}
+
+extern "C" __eglMustCastToProperFunctionPointerType eglGetProcAddress(const char *procname)
+{
+    return NULL;
+}
+
+extern "C" void glDisable(GLenum cap) {}
+extern "C" void glEnable(GLenum cap) {}
+extern "C" void glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) {}
+extern "C" void glClear(GLbitfield mask) {}
+
+extern "C" void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                             GLenum format, GLenum type, GLvoid *pixels)
+{
+    memset(pixels, 0, width * height * 4);
+}
+
+/* no HDMI switch and no fences on this side */
+extern "C" int uevent_init()
+{
+    return 0;
+}
+
+extern "C" int uevent_get_fd()
+{
+    return -1;
+}
+
+extern "C" int uevent_next_event(char *buffer, int buffer_length)
+{
+    return 0;
+}
+
+extern "C" int sync_wait(int fd, int timeout)
+{
+    return 0;
+}
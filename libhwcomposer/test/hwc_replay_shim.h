@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The devices hwc_replay runs the HWC against. The HWC objects are linked
+ * with open, close, ioctl and pread wrapped (-Wl,--wrap), so the s3cfb
+ * windows, the FIMC node and the vsync node are served from here and every
+ * other path goes to the real call. G2D, ION and EGL are replaced at the
+ * API the HWC calls. Nothing is drawn, only counted.
+ */
+
+#ifndef ANDROID_HWC_REPLAY_SHIM_H_
+#define ANDROID_HWC_REPLAY_SHIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct replay_counters {
+    uint32_t ioctl_fb;              /* every ioctl on a window */
+    uint32_t ioctl_fimc;            /* every ioctl on the FIMC node */
+    uint32_t pan;                   /* FBIOPAN_DISPLAY */
+    uint32_t fimc_frame;            /* VIDIOC_QBUF of a source frame */
+    uint64_t fimc_src_pixel;        /* source crop read by those frames */
+    uint64_t fimc_dst_pixel;        /* destination window written */
+    uint32_t g2d_blit;
+    uint64_t g2d_pixel;             /* destination rect of the blits */
+    uint32_t egl_swap;
+};
+
+/* the panel every window reports, call before the HWC is opened */
+void replay_shim_init(uint32_t lcd_width, uint32_t lcd_height);
+
+/* what the devices did since replay_shim_init() */
+void replay_shim_get(struct replay_counters *counters);
+
+/* zero filled, below 4GB: gralloc and ION hand addresses out as int */
+void *replay_shim_alloc(size_t size);
+void  replay_shim_free(void *addr, size_t size);
+
+/* the physical address FIMC and G2D see for a buffer of replay_shim_alloc() */
+uint32_t replay_shim_phys(void *addr);
+
+#endif /* ANDROID_HWC_REPLAY_SHIM_H_ */
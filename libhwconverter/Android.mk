@@ -19,6 +19,7 @@ include $(CLEAR_VARS)
 
 LOCAL_PRELINK_MODULE := false
 LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libfimc
+LOCAL_STATIC_LIBRARIES := libswconverter
 
 LOCAL_SRC_FILES := HardwareConverter.cpp
 
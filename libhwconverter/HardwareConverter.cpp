@@ -16,15 +16,193 @@
 
 #include <utils/Log.h>
 #include "SEC_OMX_Def.h"
+#include <utils/Timers.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include "SecFimc.h"
+#include "SecFimcScheduler.h"
 #include "HardwareConverter.h"
 
+extern "C" {
+#include "swconverter.h"
+}
+
+#define HW_CONVERTER_STAT_PERIOD    (1000000000LL)   // ns
+
+// FIMC cost model : overhead + per 1K pixels, both are refined from the draws
+#define HW_CONVERTER_FIMC_OVERHEAD_NS   (1500000LL)
+#define HW_CONVERTER_FIMC_NS_PER_KPIXEL (4000LL)
+// while the CPU takes every frame, one frame per period goes to FIMC to keep the model fresh
+#define HW_CONVERTER_FIMC_PROBE_PERIOD  (1000000000LL)   // ns
+
+// frame of the startup CPU benchmark, a multiple of the 64x32 NV12T tile
+#define HW_CONVERTER_BENCH_WIDTH        (256)
+#define HW_CONVERTER_BENCH_HEIGHT       (128)
+#define HW_CONVERTER_BENCH_LOOP         (3)
+
+enum {
+    SW_KERNEL_NONE = -1,
+    SW_KERNEL_TILED_TO_SP = 0,  // csc_tiled_to_linear_y/uv
+    SW_KERNEL_TILED_TO_P,       // csc_tiled_to_linear_y/uv_deinterleave
+    SW_KERNEL_P_TO_SP,          // memcpy + csc_interleave_memcpy
+    SW_KERNEL_SP_TO_P,          // memcpy + csc_deinterleave_memcpy
+    SW_KERNEL_COPY,             // memcpy
+    SW_KERNEL_MAX,
+};
+
+// CPU cost of each kernel in ns per 1K pixels, measured once per process
+static int64_t        sw_kernel_ns_per_kpixel[SW_KERNEL_MAX];
+static pthread_once_t sw_kernel_bench_once = PTHREAD_ONCE_INIT;
+
+static int sw_kernel_of(OMX_COLOR_FORMATTYPE src_format, OMX_COLOR_FORMATTYPE dst_format)
+{
+    if (src_format == OMX_SEC_COLOR_FormatNV12TPhysicalAddress) {
+        if (dst_format == OMX_COLOR_FormatYUV420SemiPlanar)
+            return SW_KERNEL_TILED_TO_SP;
+        if (dst_format == OMX_COLOR_FormatYUV420Planar)
+            return SW_KERNEL_TILED_TO_P;
+        return SW_KERNEL_NONE;
+    }
+
+    if (src_format == OMX_COLOR_FormatYUV420Planar) {
+        if (dst_format == OMX_COLOR_FormatYUV420SemiPlanar)
+            return SW_KERNEL_P_TO_SP;
+        if (dst_format == OMX_COLOR_FormatYUV420Planar)
+            return SW_KERNEL_COPY;
+        return SW_KERNEL_NONE;
+    }
+
+    if (src_format == OMX_COLOR_FormatYUV420SemiPlanar) {
+        if (dst_format == OMX_COLOR_FormatYUV420Planar)
+            return SW_KERNEL_SP_TO_P;
+        if (dst_format == OMX_COLOR_FormatYUV420SemiPlanar)
+            return SW_KERNEL_COPY;
+    }
+
+    return SW_KERNEL_NONE;
+}
+
+/*
+ * dst/src are the plane addresses : Y, Cb(CbCr), Cr.
+ * For SW_KERNEL_COPY of YUV420SP the CbCr plane is the second half of src[1].
+ */
+static void sw_kernel_run(int kernel, unsigned char **dst, unsigned char **src,
+                          unsigned int width, unsigned int height)
+{
+    unsigned int y_size = width * height;
+
+    switch (kernel) {
+    case SW_KERNEL_TILED_TO_SP:
+        csc_tiled_to_linear_y_neon(dst[0], src[0], width, height);
+        csc_tiled_to_linear_uv_neon(dst[1], src[1], width, height >> 1);
+        break;
+    case SW_KERNEL_TILED_TO_P:
+        csc_tiled_to_linear_y_neon(dst[0], src[0], width, height);
+        csc_tiled_to_linear_uv_deinterleave_neon(dst[1], dst[2], src[1], width, height >> 1);
+        break;
+    case SW_KERNEL_P_TO_SP:
+        memcpy(dst[0], src[0], y_size);
+        csc_interleave_memcpy(dst[1], src[1], src[2], y_size >> 2);
+        break;
+    case SW_KERNEL_SP_TO_P:
+        memcpy(dst[0], src[0], y_size);
+        csc_deinterleave_memcpy(dst[1], dst[2], src[1], y_size >> 1);
+        break;
+    case SW_KERNEL_COPY:
+        memcpy(dst[0], src[0], y_size);
+        if (dst[2] != NULL && src[2] != NULL) {
+            memcpy(dst[1], src[1], y_size >> 2);
+            memcpy(dst[2], src[2], y_size >> 2);
+        } else {
+            memcpy(dst[1], src[1], y_size >> 1);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void sw_kernel_bench(void)
+{
+    unsigned int width  = HW_CONVERTER_BENCH_WIDTH;
+    unsigned int height = HW_CONVERTER_BENCH_HEIGHT;
+    unsigned int y_size = width * height;
+    unsigned char *src_buf = (unsigned char *)malloc(y_size * 3 / 2);
+    unsigned char *dst_buf = (unsigned char *)malloc(y_size * 3 / 2);
+
+    for (int k = 0; k < SW_KERNEL_MAX; k++)
+        sw_kernel_ns_per_kpixel[k] = 0;
+
+    if (src_buf == NULL || dst_buf == NULL) {
+        ALOGE("%s:: malloc failed, CPU conversion is not used", __func__);
+        free(src_buf);
+        free(dst_buf);
+        return;
+    }
+
+    memset(src_buf, 0x80, y_size * 3 / 2);
+
+    unsigned char *src[3] = { src_buf, src_buf + y_size, src_buf + y_size + (y_size >> 2) };
+    unsigned char *dst[3] = { dst_buf, dst_buf + y_size, dst_buf + y_size + (y_size >> 2) };
+
+    for (int k = 0; k < SW_KERNEL_MAX; k++) {
+        nsecs_t best = 0;
+
+        // the best of a few runs, the first one also warms the caches
+        for (int i = 0; i < HW_CONVERTER_BENCH_LOOP; i++) {
+            nsecs_t start = systemTime();
+            sw_kernel_run(k, dst, src, width, height);
+            nsecs_t time = systemTime() - start;
+
+            if (i == 0 || time < best)
+                best = time;
+        }
+
+        sw_kernel_ns_per_kpixel[k] = (best * 1024) / y_size;
+        if (sw_kernel_ns_per_kpixel[k] <= 0)
+            sw_kernel_ns_per_kpixel[k] = 1;
+
+        ALOGD("%s:: kernel %d : %lld ns per 1K pixels", __func__, k,
+              (long long)sw_kernel_ns_per_kpixel[k]);
+    }
+
+    free(src_buf);
+    free(dst_buf);
+}
+
 HardwareConverter::HardwareConverter()
+    : mPolicy(HW_CONVERTER_POLICY_AUTO),
+      mFimcOverheadNs(HW_CONVERTER_FIMC_OVERHEAD_NS),
+      mFimcNsPerKpixel(HW_CONVERTER_FIMC_NS_PER_KPIXEL),
+      mFimcAvgX(0),
+      mFimcAvgY(0),
+      mFimcAvgXX(0),
+      mFimcAvgXY(0),
+      mFimcNumOfSample(0),
+      mFimcSampleTime(0),
+      mScheduler(NULL),
+      mFlagSession(false),
+      mSessionSrcFormat(OMX_COLOR_FormatUnused),
+      mSessionDstFormat(OMX_COLOR_FormatUnused),
+      mSessionWidth(0),
+      mSessionHeight(0),
+      mMaxInFlight(0),
+      mInFlightHead(0),
+      mNumOfInFlight(0),
+      mStatStart(0),
+      mStatFrames(0),
+      mStatLatencySum(0),
+      mStatLatencyMax(0),
+      mFps(0),
+      mAvgLatencyUs(0),
+      mMaxLatencyUs(0)
 {
-    SecFimc* handle_fimc = new SecFimc();
-    mSecFimc = (void *)handle_fimc;
+    // every FIMC frame goes through the scheduler, which opens nodes on demand
+    SecFimcScheduler *scheduler = SecFimcScheduler::getInstance();
+
+    mScheduler = (void *)scheduler;
 
-    if (handle_fimc->create(SecFimc::DEV_0, SecFimc::MODE_MULTI_BUF, 1) == false)
+    if (scheduler == NULL || scheduler->getNumOfNode() == 0)
         bHWconvert_flag = 0;
     else
         bHWconvert_flag = 1;
@@ -32,9 +210,7 @@ HardwareConverter::HardwareConverter()
 
 HardwareConverter::~HardwareConverter()
 {
-    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
-    handle_fimc->destroy();
-    delete mSecFimc;
+    closeSession();
 }
 
 bool HardwareConverter::convert(
@@ -45,81 +221,369 @@ bool HardwareConverter::convert(
     int32_t height,
     OMX_COLOR_FORMATTYPE dst_format)
 {
-    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
+    return convert(src_addr, dst_addr, NULL, NULL, src_format, width, height, dst_format);
+}
+
+bool HardwareConverter::convert(
+    void * src_addr,
+    void * dst_addr,
+    void * src_virt,
+    void * dst_virt,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    bool cpuAvail = (   src_virt != NULL
+                     && dst_virt != NULL
+                     && sw_kernel_of(src_format, dst_format) != SW_KERNEL_NONE);
+
+    if (cpuAvail == true && m_useCpu(src_format, width, height, dst_format) == true)
+        return m_convertCpu(src_virt, dst_virt, src_format, width, height, dst_format);
+
+    if (bHWconvert_flag == true && mPolicy != HW_CONVERTER_POLICY_CPU) {
+        // with frames queued ahead the time is not the cost of this frame
+        bool    sample = (m_numOfQueued() == 0);
+        nsecs_t start  = systemTime();
+
+        mFimcSampleTime = start;
+
+        if (m_convertFimc(src_addr, dst_addr, src_format, width, height, dst_format) == true) {
+            if (sample == true)
+                m_updateFimcModel(((int64_t)width * height) >> 10, systemTime() - start);
+            return true;
+        }
+    }
+
+    // FIMC is missing or busy
+    if (cpuAvail == true && mPolicy != HW_CONVERTER_POLICY_FIMC)
+        return m_convertCpu(src_virt, dst_virt, src_format, width, height, dst_format);
+
+    return false;
+}
+
+void HardwareConverter::setPolicy(int policy)
+{
+    mPolicy = policy;
+}
+
+bool HardwareConverter::m_useCpu(
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    if (mPolicy == HW_CONVERTER_POLICY_CPU)
+        return true;
+    if (mPolicy == HW_CONVERTER_POLICY_FIMC)
+        return false;
+    if (bHWconvert_flag == false)
+        return true;
+
+    pthread_once(&sw_kernel_bench_once, sw_kernel_bench);
+
+    int64_t kpixel = ((int64_t)width * height) >> 10;
+    int64_t cpuNs  = kpixel * sw_kernel_ns_per_kpixel[sw_kernel_of(src_format, dst_format)];
+    int64_t fimcNs = mFimcOverheadNs + kpixel * mFimcNsPerKpixel;
+
+    // the benchmark could not run
+    if (cpuNs <= 0)
+        return false;
+
+    // the model is only refined by FIMC frames, let one through now and then
+    if (bHWconvert_flag == true && HW_CONVERTER_FIMC_PROBE_PERIOD <= systemTime() - mFimcSampleTime)
+        return false;
+
+    // frames of any user waiting for a FIMC node delay this one as well
+    SecFimcScheduler *scheduler = (SecFimcScheduler *)mScheduler;
+    int numOfQueued = m_numOfQueued();
+    int numOfNode   = (scheduler != NULL) ? scheduler->getNumOfNode() : 0;
+
+    if (0 < numOfQueued && 0 < numOfNode)
+        fimcNs += (fimcNs * numOfQueued) / numOfNode;
+
+    return (cpuNs < fimcNs);
+}
+
+int HardwareConverter::m_numOfQueued(void)
+{
+    SecFimcScheduler *scheduler = (SecFimcScheduler *)mScheduler;
+    SecFimcScheduler::NodeStats stats;
+    int numOfQueued = 0;
+
+    if (scheduler == NULL)
+        return 0;
+
+    for (int i = 0; i < SecFimc::DEV_MAX; i++) {
+        if (scheduler->getNodeStats(i, &stats) == true && stats.enable == true)
+            numOfQueued += stats.numOfQueued;
+    }
+
+    return numOfQueued;
+}
+
+/*
+ * Least squares line through the recent (kpixel, time) samples, 1/8 weight
+ * for the newest one. While every frame has about the same size the slope
+ * can not be told apart from the overhead, then only the overhead follows.
+ */
+void HardwareConverter::m_updateFimcModel(int64_t kpixel, int64_t time)
+{
+    if (mFimcNumOfSample == 0) {
+        mFimcAvgX  = kpixel;
+        mFimcAvgY  = time;
+        mFimcAvgXX = kpixel * kpixel;
+        mFimcAvgXY = kpixel * time;
+    } else {
+        mFimcAvgX  += (kpixel - mFimcAvgX) / 8;
+        mFimcAvgY  += (time - mFimcAvgY) / 8;
+        mFimcAvgXX += (kpixel * kpixel - mFimcAvgXX) / 8;
+        mFimcAvgXY += (kpixel * time - mFimcAvgXY) / 8;
+    }
+    mFimcNumOfSample++;
+
+    int64_t var = mFimcAvgXX - mFimcAvgX * mFimcAvgX;
+    int64_t cov = mFimcAvgXY - mFimcAvgX * mFimcAvgY;
+
+    // sizes spread by more than 1/4 of the mean
+    if (8 <= mFimcNumOfSample && 16 * var > mFimcAvgX * mFimcAvgX && 0 < cov)
+        mFimcNsPerKpixel = cov / var;
+
+    mFimcOverheadNs = mFimcAvgY - mFimcNsPerKpixel * mFimcAvgX;
+    if (mFimcOverheadNs < 0)
+        mFimcOverheadNs = 0;
+}
+
+bool HardwareConverter::m_convertCpu(
+    void * src_virt,
+    void * dst_virt,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    int kernel = sw_kernel_of(src_format, dst_format);
+
+    if (kernel == SW_KERNEL_NONE) {
+        ALOGE("%s:: not supported (%d -> %d)", __func__, src_format, dst_format);
+        return false;
+    }
+
+    sw_kernel_run(kernel, (unsigned char **)dst_virt, (unsigned char **)src_virt,
+                  (unsigned int)width, (unsigned int)height);
+
+    return true;
+}
+
+bool HardwareConverter::m_convertFimc(
+    void * src_addr,
+    void *dst_addr,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    SecFimcScheduler *scheduler = (SecFimcScheduler *)mScheduler;
+    SecFimcScheduler::Job job;
 
-    int rotate_value = 0;
-    unsigned int src_crop_x = 0;
-    unsigned int src_crop_y = 0;
-    unsigned int src_crop_width = width;
-    unsigned int src_crop_height = height;
+    m_setJob(&job, src_addr, dst_addr, src_format, width, height, dst_format);
+
+    if (scheduler->run(&job) == false) {
+        ALOGE("%s:: SecFimcScheduler::run() failed", __func__);
+        return false;
+    }
 
-    unsigned int dst_crop_x = 0;
-    unsigned int dst_crop_y = 0;
-    unsigned int dst_crop_width = width;
-    unsigned int dst_crop_height = height;
+    return true;
+}
 
+void HardwareConverter::m_setJob(
+    void * job,
+    void * src_addr,
+    void * dst_addr,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    SecFimcScheduler::Job *fimcJob = (SecFimcScheduler::Job *)job;
     void **src_addr_array = (void **)src_addr;
     void **dst_addr_array = (void **)dst_addr;
 
     unsigned int src_har_format = OMXtoHarPixelFomrat(src_format);
     unsigned int dst_har_format = OMXtoHarPixelFomrat(dst_format);
 
-    // set post processor configuration
-    if (!handle_fimc->setSrcParams(width, height, src_crop_x, src_crop_y,
-                                   &src_crop_width, &src_crop_height,
-                                   src_har_format)) {
-        ALOGE("%s:: setSrcParms() failed", __func__);
+    fimcJob->srcRect = SecRect(0, 0, width, height, width, height, src_har_format);
+    fimcJob->srcBuf.phys.extP[0] = (unsigned int)src_addr_array[0];
+    fimcJob->srcBuf.phys.extP[1] = (unsigned int)src_addr_array[1];
+    fimcJob->srcBuf.phys.extP[2] = (unsigned int)src_addr_array[1];
+
+    fimcJob->dstRect = SecRect(0, 0, width, height, width, height, dst_har_format);
+    fimcJob->dstBuf.phys.extP[0] = (unsigned int)dst_addr_array[0];
+    fimcJob->dstBuf.phys.extP[1] = (unsigned int)dst_addr_array[1];
+    if (dst_format == OMX_COLOR_FormatYUV420SemiPlanar)
+        fimcJob->dstBuf.phys.extP[2] = (unsigned int)dst_addr_array[1];
+    else
+        fimcJob->dstBuf.phys.extP[2] = (unsigned int)dst_addr_array[2];
+
+    fimcJob->rotVal   = 0;
+    fimcJob->priority = SecFimcScheduler::PRIORITY_ENCODER;
+}
+
+bool HardwareConverter::openSession(
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format,
+    int numOfInFlight)
+{
+    if (numOfInFlight < 1 || HW_CONVERTER_MAX_IN_FLIGHT < numOfInFlight) {
+        ALOGE("%s:: invalid numOfInFlight(%d)", __func__, numOfInFlight);
         return false;
     }
 
-    if (!handle_fimc->setSrcAddr((unsigned int)src_addr_array[0],
-                                 (unsigned int)src_addr_array[1],
-                                 (unsigned int)src_addr_array[1],
-                                 src_har_format)) {
-        ALOGE("%s:: setSrcPhyAddr() failed", __func__);
-        return false;
+    if (   mFlagSession == true
+        && mSessionSrcFormat == src_format
+        && mSessionDstFormat == dst_format
+        && mSessionWidth == width
+        && mSessionHeight == height) {
+        mMaxInFlight = numOfInFlight;
+        return true;
     }
 
-    if (!handle_fimc->setRotVal(rotate_value)) {
-        ALOGE("%s:: setRotVal() failed", __func__);
+    closeSession();
+
+    if (mScheduler == NULL) {
+        ALOGE("%s:: SecFimcScheduler::getInstance() failed", __func__);
         return false;
     }
 
-    if (!handle_fimc->setDstParams(width, height, dst_crop_x, dst_crop_y,
-                                   &dst_crop_width, &dst_crop_height,
-                                   dst_har_format)) {
-        ALOGE("%s:: setDstParams() failed", __func__);
+    mSessionSrcFormat = src_format;
+    mSessionDstFormat = dst_format;
+    mSessionWidth     = width;
+    mSessionHeight    = height;
+    mMaxInFlight      = numOfInFlight;
+    mInFlightHead     = 0;
+    mNumOfInFlight    = 0;
+
+    mStatStart      = systemTime();
+    mStatFrames     = 0;
+    mStatLatencySum = 0;
+    mStatLatencyMax = 0;
+    mFps            = 0;
+    mAvgLatencyUs   = 0;
+    mMaxLatencyUs   = 0;
+
+    mFlagSession = true;
+
+    return true;
+}
+
+void HardwareConverter::closeSession(void)
+{
+    if (mFlagSession == false)
+        return;
+
+    // the dst buffers belong to the caller, they must not be written after this
+    while (0 < mNumOfInFlight) {
+        if (reap() == false)
+            ALOGE("%s:: reap() failed", __func__);
+    }
+
+    mFlagSession = false;
+}
+
+bool HardwareConverter::submit(void * src_addr, void * dst_addr)
+{
+    SecFimcScheduler *scheduler = (SecFimcScheduler *)mScheduler;
+    SecFimcScheduler::Job job;
+    if (mFlagSession == false) {
+        ALOGE("%s:: session is not open", __func__);
         return false;
     }
 
-    switch (dst_format) {
-    case OMX_COLOR_FormatYUV420SemiPlanar:
-        if (!handle_fimc->setDstAddr((unsigned int)(dst_addr_array[0]),
-                                     (unsigned int)(dst_addr_array[1]),
-                                     (unsigned int)(dst_addr_array[1]))) {
-            ALOGE("%s:: setDstPhyAddr() failed", __func__);
-            return false;
-        }
-        break;
-    case OMX_COLOR_FormatYUV420Planar:
-    default:
-        if (!handle_fimc->setDstAddr((unsigned int)(dst_addr_array[0]),
-                                     (unsigned int)(dst_addr_array[1]),
-                                     (unsigned int)(dst_addr_array[2]))) {
-            ALOGE("%s:: setDstPhyAddr() failed", __func__);
+    if (mMaxInFlight <= mNumOfInFlight) {
+        if (reap() == false)
             return false;
-        }
-        break;
     }
 
-    if (!handle_fimc->draw(0, 0)) {
-        ALOGE("%s:: handleOneShot() failed", __func__);
+    // same addresses and geometry as convert()
+    m_setJob(&job, src_addr, dst_addr, mSessionSrcFormat,
+             mSessionWidth, mSessionHeight, mSessionDstFormat);
+
+    int jobId = scheduler->submit(&job);
+    if (jobId < 0) {
+        ALOGE("%s:: SecFimcScheduler::submit() failed", __func__);
+        return false;
+    }
+
+    InFlight *frame = &mInFlight[(mInFlightHead + mNumOfInFlight) % HW_CONVERTER_MAX_IN_FLIGHT];
+    frame->jobId      = jobId;
+    frame->dst_addr   = dst_addr;
+    frame->submitTime = systemTime();
+    mNumOfInFlight++;
+
+    return true;
+}
+
+bool HardwareConverter::reap(void ** dst_addr)
+{
+    SecFimcScheduler *scheduler = (SecFimcScheduler *)mScheduler;
+
+    if (mNumOfInFlight <= 0) {
+        ALOGE("%s:: nothing in flight", __func__);
+        return false;
+    }
+
+    InFlight *frame = &mInFlight[mInFlightHead];
+    bool ret = scheduler->wait(frame->jobId);
+    nsecs_t now = systemTime();
+
+    mInFlightHead = (mInFlightHead + 1) % HW_CONVERTER_MAX_IN_FLIGHT;
+    mNumOfInFlight--;
+
+    if (dst_addr != NULL)
+        *dst_addr = frame->dst_addr;
+
+    if (ret == false) {
+        ALOGE("%s:: conversion failed", __func__);
         return false;
     }
 
+    nsecs_t latency = now - frame->submitTime;
+    mStatFrames++;
+    mStatLatencySum += latency;
+    if (mStatLatencyMax < latency)
+        mStatLatencyMax = latency;
+
+    if (HW_CONVERTER_STAT_PERIOD <= now - mStatStart) {
+        mFps          = (float)mStatFrames * 1000000000.0f / (float)(now - mStatStart);
+        mAvgLatencyUs = ns2us(mStatLatencySum / mStatFrames);
+        mMaxLatencyUs = ns2us(mStatLatencyMax);
+
+        mStatStart      = now;
+        mStatFrames     = 0;
+        mStatLatencySum = 0;
+        mStatLatencyMax = 0;
+    }
+
     return true;
 }
 
+int HardwareConverter::getNumOfInFlight(void)
+{
+    return mNumOfInFlight;
+}
+
+void HardwareConverter::getStats(float *fps, int64_t *avgLatencyUs, int64_t *maxLatencyUs)
+{
+    if (fps != NULL)
+        *fps = mFps;
+    if (avgLatencyUs != NULL)
+        *avgLatencyUs = mAvgLatencyUs;
+    if (maxLatencyUs != NULL)
+        *maxLatencyUs = mMaxLatencyUs;
+}
+
 unsigned int HardwareConverter::OMXtoHarPixelFomrat(OMX_COLOR_FORMATTYPE omx_format)
 {
     unsigned int hal_format = 0;
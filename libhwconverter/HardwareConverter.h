@@ -18,8 +18,17 @@
 
 #define HARDWARE_CONVERTER_H_
 
+#include <stdint.h>
 #include <OMX_Video.h>
 
+#define HW_CONVERTER_MAX_IN_FLIGHT  (4)
+
+enum HW_CONVERTER_POLICY {
+    HW_CONVERTER_POLICY_AUTO = 0,   // the engine expected to finish first
+    HW_CONVERTER_POLICY_FIMC,
+    HW_CONVERTER_POLICY_CPU,
+};
+
 class HardwareConverter {
 public:
     HardwareConverter();
@@ -31,10 +40,114 @@ public:
         int32_t width,
         int32_t height,
         OMX_COLOR_FORMATTYPE dst_format);
+
+    /*
+     * src_virt / dst_virt are the virtual addresses of the same planes, with
+     * them the frame may be converted by the CPU (libswconverter) when FIMC
+     * is missing, fails, is backed up or costs more for this frame size.
+     */
+    bool convert(
+        void * src_addr,
+        void * dst_addr,
+        void * src_virt,
+        void * dst_virt,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
+    void setPolicy(int policy);
+
+    /*
+     * Session : the geometry is set once by openSession(), then every frame
+     * is only a submit() of its addresses. Frames are converted by the FIMC
+     * scheduler while the caller goes on, reap() returns the oldest one.
+     * Calling openSession() again with the same geometry keeps the session.
+     */
+    bool openSession(
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format,
+        int numOfInFlight = 2);
+    void closeSession(void);
+    bool submit(void * src_addr, void * dst_addr);
+    bool reap(void ** dst_addr = NULL);
+    int  getNumOfInFlight(void);
+    //! frames/s and per-frame latency (submit to reap) of the last second
+    void getStats(float *fps, int64_t *avgLatencyUs, int64_t *maxLatencyUs);
+
     bool bHWconvert_flag;
 private:
-    void *mSecFimc;
     unsigned int OMXtoHarPixelFomrat(OMX_COLOR_FORMATTYPE omx_format);
+
+    void m_setJob(
+        void * job,
+        void * src_addr,
+        void * dst_addr,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
+
+    bool m_convertFimc(
+        void * src_addr,
+        void * dst_addr,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
+    bool m_convertCpu(
+        void * src_virt,
+        void * dst_virt,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
+    bool m_useCpu(
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
+    int  m_numOfQueued(void);
+    void m_updateFimcModel(int64_t kpixel, int64_t time);
+
+    int          mPolicy;
+
+    // FIMC cost : mFimcOverheadNs + mFimcNsPerKpixel per 1K pixels, a line
+    // fitted to the recent draws (moving averages of x, y, x*x and x*y)
+    int64_t      mFimcOverheadNs;
+    int64_t      mFimcNsPerKpixel;
+    int64_t      mFimcAvgX;
+    int64_t      mFimcAvgY;
+    int64_t      mFimcAvgXX;
+    int64_t      mFimcAvgXY;
+    int          mFimcNumOfSample;
+    int64_t      mFimcSampleTime;   // last frame sent to FIMC
+
+    struct InFlight {
+        int     jobId;
+        void   *dst_addr;
+        int64_t submitTime;
+    };
+
+    void        *mScheduler;
+    bool         mFlagSession;
+    OMX_COLOR_FORMATTYPE mSessionSrcFormat;
+    OMX_COLOR_FORMATTYPE mSessionDstFormat;
+    int32_t      mSessionWidth;
+    int32_t      mSessionHeight;
+    int          mMaxInFlight;
+    InFlight     mInFlight[HW_CONVERTER_MAX_IN_FLIGHT];
+    int          mInFlightHead;
+    int          mNumOfInFlight;
+
+    int64_t      mStatStart;
+    int          mStatFrames;
+    int64_t      mStatLatencySum;
+    int64_t      mStatLatencyMax;
+    float        mFps;
+    int64_t      mAvgLatencyUs;
+    int64_t      mMaxLatencyUs;
 };
 
 void test_function();
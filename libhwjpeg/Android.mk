@@ -31,3 +31,5 @@ LOCAL_MODULE:= libhwjpeg
 LOCAL_MODULE_TAGS := eng
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
@@ -30,6 +30,7 @@
 #include <signal.h>
 #include <math.h>
 #include <sys/poll.h>
+#include <time.h>
 
 #include <cutils/log.h>
 
@@ -202,7 +203,7 @@ static int jpeg_v4l2_reqbufs(int fd, int buf_cnt, struct jpeg_buf *buf)
     return ret;
 }
 
-static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
+static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf, int index)
 {
     struct v4l2_buffer v4l2_buf;
     struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
@@ -211,7 +212,7 @@ static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
 
     memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
-    v4l2_buf.index = 0;
+    v4l2_buf.index = index;
     v4l2_buf.type = buf->buf_type;
     v4l2_buf.memory = buf->memory;
     v4l2_buf.length = buf->num_planes;
@@ -230,7 +231,7 @@ static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
                     v4l2_buf.m.planes[i].m.mem_offset);
 
         //ALOGI("[%s]: buf.start[%d] = %p, length = %d", __func__, 0, buf->start[0], buf->length[0]);
-        if (buf->start[0] == MAP_FAILED) {
+        if (buf->start[i] == MAP_FAILED) {
             ALOGE("[%s]: mmap failed", __func__);
             return -1;
         }
@@ -239,7 +240,7 @@ static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
     return ret;
 }
 
-static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
+static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf, int index)
 {
     struct v4l2_buffer v4l2_buf;
     struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
@@ -249,7 +250,7 @@ static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
     memset(&v4l2_buf, 0, sizeof(struct v4l2_buffer));
     memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
-    v4l2_buf.index = 0;
+    v4l2_buf.index = index;
     v4l2_buf.type = buf->buf_type;
     v4l2_buf.memory = buf->memory;
     v4l2_buf.length = buf->num_planes;
@@ -271,15 +272,20 @@ static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
     return ret;
 }
 
-static int jpeg_v4l2_dqbuf(int fd, enum v4l2_buf_type type, enum v4l2_memory memory)
+static int jpeg_v4l2_dqbuf(int fd, enum v4l2_buf_type type, enum v4l2_memory memory,
+                           int *index, int *bytesused)
 {
     struct v4l2_buffer buf;
+    struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
     int ret = 0;
 
     memset(&buf, 0, sizeof(struct v4l2_buffer));
+    memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
     buf.type = type;
     buf.memory = memory;
+    buf.length = JPEG_MAX_PLANE_CNT;
+    buf.m.planes = plane;
 
     ret = ioctl(fd, VIDIOC_DQBUF, &buf);
     if (ret < 0) {
@@ -287,6 +293,11 @@ static int jpeg_v4l2_dqbuf(int fd, enum v4l2_buf_type type, enum v4l2_memory mem
         return -1;
     }
 
+    if (index)
+        *index = buf.index;
+    if (bytesused)
+        *bytesused = plane[0].bytesused;
+
     return ret;
 }
 
@@ -436,7 +447,7 @@ int jpeghal_set_inbuf(int fd, struct jpeg_buf *buf)
     }
 
     if (buf->memory == V4L2_MEMORY_MMAP) {
-        ret = jpeg_v4l2_querybuf(fd, buf);
+        ret = jpeg_v4l2_querybuf(fd, buf, 0);
         if (ret < 0) {
             ALOGE("[%s:%d]: Input QUERYBUF failed", __func__, ret);
             return -1;
@@ -459,7 +470,7 @@ int jpeghal_set_outbuf(int fd, struct jpeg_buf *buf)
     }
 
     if (buf->memory == V4L2_MEMORY_MMAP) {
-        ret = jpeg_v4l2_querybuf(fd, buf);
+        ret = jpeg_v4l2_querybuf(fd, buf, 0);
         if (ret < 0) {
             ALOGE("[%s:%d]: Output QUERYBUF failed", __func__, ret);
             return -1;
@@ -473,13 +484,13 @@ static int jpeg_exe(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf)
 {
     int ret = 0;
 
-    ret = jpeg_v4l2_qbuf(fd, in_buf);
+    ret = jpeg_v4l2_qbuf(fd, in_buf, 0);
     if (ret < 0) {
         ALOGE("[%s:%d]: Input QBUF failed", __func__, ret);
         return -1;
     }
 
-    ret = jpeg_v4l2_qbuf(fd, out_buf);
+    ret = jpeg_v4l2_qbuf(fd, out_buf, 0);
     if (ret < 0) {
         ALOGE("[%s:%d]: Output QBUF failed", __func__, ret);
         return -1;
@@ -488,8 +499,8 @@ static int jpeg_exe(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf)
     ret = jpeg_v4l2_streamon(fd, in_buf->buf_type);
     ret = jpeg_v4l2_streamon(fd, out_buf->buf_type);
 
-    ret = jpeg_v4l2_dqbuf(fd, in_buf->buf_type, in_buf->memory);
-    ret = jpeg_v4l2_dqbuf(fd, out_buf->buf_type, out_buf->memory);
+    ret = jpeg_v4l2_dqbuf(fd, in_buf->buf_type, in_buf->memory, NULL, NULL);
+    ret = jpeg_v4l2_dqbuf(fd, out_buf->buf_type, out_buf->memory, NULL, NULL);
 
     return ret;
 }
@@ -538,6 +549,619 @@ int jpeghal_deinit(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf)
     return ret;
 }
 
+/* unmaps the planes jpeg_v4l2_querybuf() could map, the others are NULL or MAP_FAILED */
+static void jpeg_session_unmap(struct jpeg_buf *buf)
+{
+    int i;
+
+    if (buf->memory != V4L2_MEMORY_MMAP)
+        return;
+
+    for (i = 0; i < buf->num_planes; i++) {
+        if (buf->start[i] != NULL && buf->start[i] != MAP_FAILED)
+            munmap((char *)(buf->start[i]), buf->length[i]);
+        buf->start[i] = NULL;
+    }
+}
+
+static void jpeg_session_release(struct jpeg_session *session)
+{
+    if (session->flag_stream_on) {
+        jpeg_v4l2_streamoff(session->fd, session->in_buf.buf_type);
+        jpeg_v4l2_streamoff(session->fd, session->out_buf.buf_type);
+        session->flag_stream_on = 0;
+    }
+
+    if (!session->flag_config)
+        return;
+
+    jpeg_session_unmap(&session->in_buf);
+    jpeg_session_unmap(&session->out_buf);
+
+    jpeg_v4l2_reqbufs(session->fd, 0, &session->in_buf);
+    jpeg_v4l2_reqbufs(session->fd, 0, &session->out_buf);
+
+    session->flag_config = 0;
+}
+
+static int jpeg_session_compatible(struct jpeg_session *session, struct jpeg_config *config,
+                                   struct jpeg_buf_info *in_info, struct jpeg_buf_info *out_info)
+{
+    struct jpeg_config *cur = &session->config;
+
+    if (!session->flag_config)
+        return 0;
+
+    if (session->in_buf.memory != in_info->memory
+        || session->in_buf.num_planes != in_info->num_planes
+        || session->out_buf.memory != out_info->memory
+        || session->out_buf.num_planes != out_info->num_planes)
+        return 0;
+
+    if (cur->width != config->width
+        || cur->height != config->height
+        || cur->num_planes != config->num_planes
+        || cur->pix.enc_fmt.in_fmt != config->pix.enc_fmt.in_fmt
+        || cur->pix.enc_fmt.out_fmt != config->pix.enc_fmt.out_fmt)
+        return 0;
+
+    if (session->mode == JPEG_DECODE) {
+        if (cur->scaled_width != config->scaled_width
+            || cur->scaled_height != config->scaled_height)
+            return 0;
+
+        if (session->in_size_jpeg < config->sizeJpeg)
+            return 0;
+    }
+
+    return 1;
+}
+
+int jpeghal_session_open(struct jpeg_session *session, enum jpeg_mode mode)
+{
+    memset(session, 0, sizeof(struct jpeg_session));
+
+    if (mode == JPEG_ENCODE)
+        session->fd = jpeghal_enc_init();
+    else
+        session->fd = jpeghal_dec_init();
+
+    if (session->fd < 0) {
+        ALOGE("[%s]: open failed", __func__);
+        return -1;
+    }
+
+    session->mode = mode;
+
+    return 0;
+}
+
+int jpeghal_session_setconfig(struct jpeg_session *session, struct jpeg_config *config,
+                              struct jpeg_buf_info *in_info, struct jpeg_buf_info *out_info)
+{
+    struct jpeg_config new_config;
+    int ret = 0;
+
+    if (session->fd < 0) {
+        ALOGE("[%s]: session is not open", __func__);
+        return -1;
+    }
+
+    if (jpeg_session_compatible(session, config, in_info, out_info)) {
+        /* the quality is a control, it does not touch the queues */
+        if (session->mode == JPEG_ENCODE && session->config.enc_qual != config->enc_qual) {
+            ret = jpeg_v4l2_s_jpegcomp(session->fd, config->enc_qual);
+            if (ret < 0) {
+                ALOGE("[%s]: S_JPEGCOMP failed", __func__);
+                return -1;
+            }
+            session->config.enc_qual = config->enc_qual;
+        }
+
+        session->config.sizeJpeg = config->sizeJpeg;
+        return 0;
+    }
+
+    jpeg_session_release(session);
+
+    new_config = *config;
+
+    if (session->mode == JPEG_DECODE) {
+        /* room for the next images of the burst, which are rarely the same size */
+        new_config.sizeJpeg = (config->sizeJpeg + JPEG_SESSION_SIZE_ALIGN - 1)
+                              & ~(JPEG_SESSION_SIZE_ALIGN - 1);
+        ret = jpeghal_dec_setconfig(session->fd, &new_config);
+    } else {
+        ret = jpeghal_enc_setconfig(session->fd, &new_config);
+    }
+
+    if (ret < 0) {
+        ALOGE("[%s]: setconfig failed", __func__);
+        return -1;
+    }
+
+    memset(&session->in_buf, 0, sizeof(struct jpeg_buf));
+    session->in_buf.num_planes = in_info->num_planes;
+    session->in_buf.memory     = in_info->memory;
+
+    memset(&session->out_buf, 0, sizeof(struct jpeg_buf));
+    session->out_buf.num_planes = out_info->num_planes;
+    session->out_buf.memory     = out_info->memory;
+
+    if (jpeghal_set_inbuf(session->fd, &session->in_buf) < 0) {
+        ALOGE("[%s]: input buffer setup failed", __func__);
+        goto err_inbuf;
+    }
+
+    if (jpeghal_set_outbuf(session->fd, &session->out_buf) < 0) {
+        ALOGE("[%s]: output buffer setup failed", __func__);
+        goto err_outbuf;
+    }
+
+    session->config       = *config;
+    session->in_size_jpeg = new_config.sizeJpeg;
+    session->flag_config  = 1;
+
+    return 0;
+
+    /* the buffers can only be freed by REQBUFS(0) once nothing maps them */
+err_outbuf:
+    jpeg_session_unmap(&session->out_buf);
+    jpeg_v4l2_reqbufs(session->fd, 0, &session->out_buf);
+err_inbuf:
+    jpeg_session_unmap(&session->in_buf);
+    jpeg_v4l2_reqbufs(session->fd, 0, &session->in_buf);
+
+    return -1;
+}
+
+int jpeghal_session_exe(struct jpeg_session *session)
+{
+    int fd = session->fd;
+    int ret = 0;
+
+    if (!session->flag_config) {
+        ALOGE("[%s]: session is not configured", __func__);
+        return -1;
+    }
+
+    ret = jpeg_v4l2_qbuf(fd, &session->in_buf, 0);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Input QBUF failed", __func__, ret);
+        goto err;
+    }
+
+    ret = jpeg_v4l2_qbuf(fd, &session->out_buf, 0);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Output QBUF failed", __func__, ret);
+        goto err;
+    }
+
+    if (!session->flag_stream_on) {
+        if (jpeg_v4l2_streamon(fd, session->in_buf.buf_type) < 0
+            || jpeg_v4l2_streamon(fd, session->out_buf.buf_type) < 0)
+            goto err;
+        session->flag_stream_on = 1;
+    }
+
+    ret = jpeg_v4l2_dqbuf(fd, session->in_buf.buf_type, session->in_buf.memory, NULL, NULL);
+    if (ret < 0)
+        goto err;
+
+    ret = jpeg_v4l2_dqbuf(fd, session->out_buf.buf_type, session->out_buf.memory, NULL, NULL);
+    if (ret < 0)
+        goto err;
+
+    return 0;
+
+err:
+    /* STREAMOFF gives back whatever is still queued, the next image starts clean */
+    jpeg_v4l2_streamoff(fd, session->in_buf.buf_type);
+    jpeg_v4l2_streamoff(fd, session->out_buf.buf_type);
+    session->flag_stream_on = 0;
+
+    if (session->mode == JPEG_ENCODE)
+        ALOGE("[%s]: JPEG Encoding is failed", __func__);
+    else
+        ALOGE("[%s]: JPEG decoding is failed", __func__);
+
+    return -1;
+}
+
+int jpeghal_session_close(struct jpeg_session *session)
+{
+    int ret = 0;
+
+    if (session->fd < 0)
+        return 0;
+
+    jpeg_session_release(session);
+
+    ret = close(session->fd);
+    session->fd = -1;
+
+    return ret;
+}
+
+static long long jpeg_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void jpeg_queue_release(struct jpeg_queue *queue)
+{
+    int i, j;
+
+    if (queue->flag_stream_on) {
+        jpeg_v4l2_streamoff(queue->fd, queue->in_buf[0].buf_type);
+        jpeg_v4l2_streamoff(queue->fd, queue->out_buf[0].buf_type);
+        queue->flag_stream_on = 0;
+    }
+
+    if (!queue->flag_config)
+        return;
+
+    for (i = 0; i < queue->depth; i++) {
+        if (queue->in_buf[i].memory == V4L2_MEMORY_MMAP) {
+            for (j = 0; j < queue->in_buf[i].num_planes; j++)
+                munmap((char *)(queue->in_buf[i].start[j]), queue->in_buf[i].length[j]);
+        }
+
+        if (queue->out_buf[i].memory == V4L2_MEMORY_MMAP) {
+            for (j = 0; j < queue->out_buf[i].num_planes; j++)
+                munmap((char *)(queue->out_buf[i].start[j]), queue->out_buf[i].length[j]);
+        }
+
+        queue->busy[i] = 0;
+    }
+
+    jpeg_v4l2_reqbufs(queue->fd, 0, &queue->in_buf[0]);
+    jpeg_v4l2_reqbufs(queue->fd, 0, &queue->out_buf[0]);
+
+    queue->num_queued = 0;
+    queue->flag_config = 0;
+}
+
+/* STREAMOFF gives back every queued pair, they are reported as failed */
+static void jpeg_queue_abort(struct jpeg_queue *queue)
+{
+    int i;
+
+    jpeg_v4l2_streamoff(queue->fd, queue->in_buf[0].buf_type);
+    jpeg_v4l2_streamoff(queue->fd, queue->out_buf[0].buf_type);
+    queue->flag_stream_on = 0;
+
+    for (i = 0; i < queue->num_queued; i++) {
+        queue->busy[queue->order[i]] = 0;
+        if (queue->done_cb)
+            queue->done_cb(queue->order[i], -1, 0, queue->done_priv);
+    }
+
+    queue->num_queued = 0;
+}
+
+int jpeghal_queue_open(struct jpeg_queue *queue, enum jpeg_mode mode, int depth)
+{
+    memset(queue, 0, sizeof(struct jpeg_queue));
+
+    if (depth < 1 || JPEG_QUEUE_MAX_DEPTH < depth) {
+        ALOGE("[%s]: invalid depth(%d)", __func__, depth);
+        queue->fd = -1;
+        return -1;
+    }
+
+    if (mode == JPEG_ENCODE)
+        queue->fd = jpeghal_enc_init();
+    else
+        queue->fd = jpeghal_dec_init();
+
+    if (queue->fd < 0) {
+        ALOGE("[%s]: open failed", __func__);
+        return -1;
+    }
+
+    queue->mode  = mode;
+    queue->depth = depth;
+
+    return 0;
+}
+
+int jpeghal_queue_setconfig(struct jpeg_queue *queue, struct jpeg_config *config,
+                            struct jpeg_buf_info *in_info, struct jpeg_buf_info *out_info)
+{
+    struct jpeg_config new_config;
+    struct jpeg_config same_qual;
+    int same_buf = 0;
+    int i;
+    int ret = 0;
+
+    if (queue->fd < 0) {
+        ALOGE("[%s]: queue is not open", __func__);
+        return -1;
+    }
+
+    if (queue->flag_config
+        && queue->in_info.num_planes == in_info->num_planes
+        && queue->in_info.memory == in_info->memory
+        && queue->out_info.num_planes == out_info->num_planes
+        && queue->out_info.memory == out_info->memory) {
+        /* a decoding JPEG only has to fit the input buffers */
+        same_qual = *config;
+        same_qual.enc_qual = queue->config.enc_qual;
+        same_qual.sizeJpeg = queue->config.sizeJpeg;
+        same_buf = (memcmp(&queue->config, &same_qual, sizeof(struct jpeg_config)) == 0);
+
+        if (queue->mode == JPEG_DECODE && queue->in_size_jpeg < config->sizeJpeg)
+            same_buf = 0;
+    }
+
+    /* the quality means nothing to the decoder */
+    if (same_buf && (queue->mode == JPEG_DECODE || queue->config.enc_qual == config->enc_qual)) {
+        queue->config.sizeJpeg = config->sizeJpeg;
+        return 0;
+    }
+
+    if (queue->num_queued > 0) {
+        ALOGE("[%s]: %d images are still in flight", __func__, queue->num_queued);
+        return -1;
+    }
+
+    /* the quality is a control, the queues and buffers stay as they are */
+    if (same_buf) {
+        if (jpeg_v4l2_s_jpegcomp(queue->fd, config->enc_qual) < 0) {
+            ALOGE("[%s]: S_JPEGCOMP failed", __func__);
+            return -1;
+        }
+        queue->config.enc_qual = config->enc_qual;
+        queue->config.sizeJpeg = config->sizeJpeg;
+        return 0;
+    }
+
+    jpeg_queue_release(queue);
+
+    new_config = *config;
+
+    if (queue->mode == JPEG_ENCODE) {
+        ret = jpeghal_enc_setconfig(queue->fd, &new_config);
+    } else {
+        /* room for the next images of the batch, as for a session */
+        new_config.sizeJpeg = (config->sizeJpeg + JPEG_SESSION_SIZE_ALIGN - 1)
+                              & ~(JPEG_SESSION_SIZE_ALIGN - 1);
+        ret = jpeghal_dec_setconfig(queue->fd, &new_config);
+    }
+
+    if (ret < 0) {
+        ALOGE("[%s]: setconfig failed", __func__);
+        return -1;
+    }
+
+    for (i = 0; i < queue->depth; i++) {
+        memset(&queue->in_buf[i], 0, sizeof(struct jpeg_buf));
+        queue->in_buf[i].num_planes = in_info->num_planes;
+        queue->in_buf[i].memory     = in_info->memory;
+        queue->in_buf[i].buf_type   = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+
+        memset(&queue->out_buf[i], 0, sizeof(struct jpeg_buf));
+        queue->out_buf[i].num_planes = out_info->num_planes;
+        queue->out_buf[i].memory     = out_info->memory;
+        queue->out_buf[i].buf_type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    }
+
+    if (jpeg_v4l2_reqbufs(queue->fd, queue->depth, &queue->in_buf[0]) < 0
+        || jpeg_v4l2_reqbufs(queue->fd, queue->depth, &queue->out_buf[0]) < 0) {
+        ALOGE("[%s]: REQBUFS(%d) failed", __func__, queue->depth);
+        goto err;
+    }
+
+    for (i = 0; i < queue->depth; i++) {
+        if (in_info->memory == V4L2_MEMORY_MMAP
+            && jpeg_v4l2_querybuf(queue->fd, &queue->in_buf[i], i) < 0) {
+            ALOGE("[%s]: Input QUERYBUF(%d) failed", __func__, i);
+            goto err;
+        }
+
+        if (out_info->memory == V4L2_MEMORY_MMAP
+            && jpeg_v4l2_querybuf(queue->fd, &queue->out_buf[i], i) < 0) {
+            ALOGE("[%s]: Output QUERYBUF(%d) failed", __func__, i);
+            goto err;
+        }
+    }
+
+    queue->config       = *config;
+    queue->in_info      = *in_info;
+    queue->out_info     = *out_info;
+    queue->in_size_jpeg = new_config.sizeJpeg;
+    queue->flag_config  = 1;
+
+    return 0;
+
+err:
+    /* unmap whatever was mapped before the failure */
+    queue->flag_config = 1;
+    jpeg_queue_release(queue);
+
+    return -1;
+}
+
+void jpeghal_queue_set_callback(struct jpeg_queue *queue, jpeg_queue_done_cb cb, void *priv)
+{
+    queue->done_cb   = cb;
+    queue->done_priv = priv;
+}
+
+int jpeghal_queue_get_fd(struct jpeg_queue *queue)
+{
+    return queue->fd;
+}
+
+int jpeghal_queue_get_buf(struct jpeg_queue *queue)
+{
+    int i;
+
+    if (!queue->flag_config)
+        return -1;
+
+    for (i = 0; i < queue->depth; i++) {
+        if (!queue->busy[i])
+            return i;
+    }
+
+    return -1;
+}
+
+int jpeghal_queue_submit(struct jpeg_queue *queue, int index)
+{
+    int fd = queue->fd;
+
+    if (!queue->flag_config || index < 0 || queue->depth <= index || queue->busy[index]) {
+        ALOGE("[%s]: invalid index(%d)", __func__, index);
+        return -1;
+    }
+
+    if (jpeg_v4l2_qbuf(fd, &queue->in_buf[index], index) < 0) {
+        ALOGE("[%s]: Input QBUF(%d) failed", __func__, index);
+        return -1;
+    }
+
+    if (jpeg_v4l2_qbuf(fd, &queue->out_buf[index], index) < 0) {
+        ALOGE("[%s]: Output QBUF(%d) failed", __func__, index);
+        /* the input is queued alone now, drop everything */
+        queue->busy[index] = 1;
+        queue->order[queue->num_queued++] = index;
+        jpeg_queue_abort(queue);
+        return -1;
+    }
+
+    queue->busy[index] = 1;
+    queue->order[queue->num_queued++] = index;
+
+    if (!queue->flag_stream_on) {
+        if (jpeg_v4l2_streamon(fd, queue->in_buf[0].buf_type) < 0
+            || jpeg_v4l2_streamon(fd, queue->out_buf[0].buf_type) < 0) {
+            jpeg_queue_abort(queue);
+            return -1;
+        }
+        queue->flag_stream_on = 1;
+    }
+
+    if (queue->num_done == 0 && queue->time_first_us == 0)
+        queue->time_first_us = jpeg_time_us();
+
+    return 0;
+}
+
+int jpeghal_queue_reap(struct jpeg_queue *queue, int timeout_ms, int *size)
+{
+    struct pollfd events;
+    int index = -1;
+    int out_index = -1;
+    int bytesused = 0;
+    int i;
+    int ret = 0;
+
+    if (queue->num_queued == 0)
+        return JPEG_QUEUE_EMPTY;
+
+    events.fd      = queue->fd;
+    events.events  = POLLIN | POLLERR;
+    events.revents = 0;
+
+    ret = poll(&events, 1, timeout_ms);
+    if (ret == 0 || (ret < 0 && errno == EINTR))
+        return JPEG_QUEUE_TIMEOUT;  /* still in flight */
+
+    if (ret < 0 || (events.revents & POLLERR)) {
+        ALOGE("[%s]: poll failed(%d, 0x%x)", __func__, ret, events.revents);
+        goto err;
+    }
+
+    if (jpeg_v4l2_dqbuf(queue->fd, queue->in_buf[0].buf_type, queue->in_buf[0].memory,
+                        &index, NULL) < 0)
+        goto err;
+
+    if (jpeg_v4l2_dqbuf(queue->fd, queue->out_buf[0].buf_type, queue->out_buf[0].memory,
+                        &out_index, &bytesused) < 0)
+        goto err;
+
+    if (index != out_index || index != queue->order[0])
+        ALOGE("[%s]: out of order completion(%d, %d, %d)", __func__, index, out_index, queue->order[0]);
+
+    index = out_index;
+    queue->busy[index] = 0;
+    for (i = 0; i < queue->num_queued - 1; i++)
+        queue->order[i] = queue->order[i + 1];
+    queue->num_queued--;
+
+    queue->num_done++;
+    queue->time_last_us = jpeg_time_us();
+
+#ifdef JPEG_PERF_MEAS
+    if ((queue->num_done % 30) == 0)
+        ALOGD("[%s]: %u images, %.1f images/s", __func__, queue->num_done, jpeghal_queue_get_rate(queue));
+#endif
+
+    if (size)
+        *size = bytesused;
+
+    if (queue->done_cb)
+        queue->done_cb(index, 0, bytesused, queue->done_priv);
+
+    return index;
+
+err:
+    if (queue->mode == JPEG_ENCODE)
+        ALOGE("[%s]: JPEG Encoding is failed", __func__);
+    else
+        ALOGE("[%s]: JPEG decoding is failed", __func__);
+
+    jpeg_queue_abort(queue);
+
+    return JPEG_QUEUE_ERROR;
+}
+
+int jpeghal_queue_flush(struct jpeg_queue *queue)
+{
+    int ret;
+
+    while (queue->num_queued > 0) {
+        ret = jpeghal_queue_reap(queue, -1, NULL);
+        if (ret == JPEG_QUEUE_ERROR)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* images per second from the first submit to the last completion */
+float jpeghal_queue_get_rate(struct jpeg_queue *queue)
+{
+    long long elapsed = queue->time_last_us - queue->time_first_us;
+
+    if (queue->num_done == 0 || elapsed <= 0)
+        return 0.0f;
+
+    return (float)queue->num_done * 1000000.0f / (float)elapsed;
+}
+
+int jpeghal_queue_close(struct jpeg_queue *queue)
+{
+    int ret = 0;
+
+    if (queue->fd < 0)
+        return 0;
+
+    jpeg_queue_release(queue);
+
+    ret = close(queue->fd);
+    queue->fd = -1;
+
+    return ret;
+}
+
 int jpeghal_s_ctrl(int fd, int cid, int value)
 {
     struct v4l2_control vc;
@@ -0,0 +1,231 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the JPEG encoder throughput of a session against a queue.
+ *
+ *   jpeg_queue_bench [width] [height] [images]
+ *
+ * "session" encodes one image at a time with jpeghal_session_exe(), "queue N"
+ * keeps N images in flight and fills the next input while the codec works.
+ * "queue 1 qual" changes the quality before every image, which has to drain
+ * the queue, and must come close to "queue 1" since only the control is
+ * written instead of setting the buffers up again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jpeg_hal.h"
+
+#define BENCH_TIMEOUT_MS    (1000)
+
+static long long bench_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* YUYV color bars, moved by one line per image so no two inputs are equal */
+static void fill_yuyv(struct jpeg_buf *buf, int width, int height, int seq)
+{
+    static const unsigned char bar[8][3] = {
+        { 235, 128, 128 }, { 210,  16, 146 }, { 170, 166,  16 }, { 145,  54,  34 },
+        { 106, 202, 222 }, {  81,  90, 240 }, {  41, 240, 110 }, {  16, 128, 128 },
+    };
+    unsigned char *p = (unsigned char *)buf->start[0];
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 2) {
+            const unsigned char *c = bar[((x * 8 / width) + ((y + seq) >> 4)) & 7];
+            p[0] = c[0];
+            p[1] = c[1];
+            p[2] = c[0];
+            p[3] = c[2];
+            p += 4;
+        }
+    }
+}
+
+static void init_config(struct jpeg_config *config, struct jpeg_buf_info *in_info,
+                        struct jpeg_buf_info *out_info, int width, int height)
+{
+    memset(config, 0, sizeof(struct jpeg_config));
+    config->mode       = JPEG_ENCODE;
+    config->enc_qual   = QUALITY_LEVEL_2;
+    config->width      = width;
+    config->height     = height;
+    config->num_planes = 1;
+    config->pix.enc_fmt.in_fmt  = V4L2_PIX_FMT_YUYV;
+    config->pix.enc_fmt.out_fmt = V4L2_PIX_FMT_JPEG_422;
+
+    memset(in_info, 0, sizeof(struct jpeg_buf_info));
+    in_info->num_planes = 1;
+    in_info->memory     = V4L2_MEMORY_MMAP;
+
+    memset(out_info, 0, sizeof(struct jpeg_buf_info));
+    out_info->num_planes = 1;
+    out_info->memory     = V4L2_MEMORY_MMAP;
+}
+
+static int bench_session(int width, int height, int images)
+{
+    struct jpeg_session session;
+    struct jpeg_config config;
+    struct jpeg_buf_info in_info, out_info;
+    long long start, elapsed;
+    int i;
+    int ret = 0;
+
+    if (jpeghal_session_open(&session, JPEG_ENCODE) < 0) {
+        printf("session      : open fail\n");
+        return -1;
+    }
+
+    init_config(&config, &in_info, &out_info, width, height);
+    if (jpeghal_session_setconfig(&session, &config, &in_info, &out_info) < 0) {
+        printf("session      : setconfig fail\n");
+        jpeghal_session_close(&session);
+        return -1;
+    }
+
+    start = bench_time_us();
+    for (i = 0; i < images; i++) {
+        fill_yuyv(&session.in_buf, width, height, i);
+        if (jpeghal_session_exe(&session) < 0) {
+            printf("session      : exe fail at image %d\n", i);
+            ret = -1;
+            break;
+        }
+    }
+    elapsed = bench_time_us() - start;
+
+    if (ret == 0 && elapsed > 0)
+        printf("session      : %6.1f images/s\n", (float)images * 1000000.0f / (float)elapsed);
+
+    jpeghal_session_close(&session);
+    return ret;
+}
+
+static int bench_queue(int depth, int width, int height, int images, int vary_quality)
+{
+    struct jpeg_queue queue;
+    struct jpeg_config config;
+    struct jpeg_buf_info in_info, out_info;
+    int submitted = 0;
+    int reaped = 0;
+    int index;
+    int ret = 0;
+
+    if (jpeghal_queue_open(&queue, JPEG_ENCODE, depth) < 0) {
+        printf("queue %d      : open fail\n", depth);
+        return -1;
+    }
+
+    init_config(&config, &in_info, &out_info, width, height);
+    if (jpeghal_queue_setconfig(&queue, &config, &in_info, &out_info) < 0) {
+        printf("queue %d      : setconfig fail\n", depth);
+        jpeghal_queue_close(&queue);
+        return -1;
+    }
+
+    while (reaped < images) {
+        /* keep the queue full, then take the oldest image back */
+        while (submitted < images && (index = jpeghal_queue_get_buf(&queue)) >= 0) {
+            if (vary_quality && queue.num_queued == 0) {
+                config.enc_qual = (enum jpeg_quality_level)(submitted & 3);
+                if (jpeghal_queue_setconfig(&queue, &config, &in_info, &out_info) < 0) {
+                    printf("queue %d      : quality change fail\n", depth);
+                    ret = -1;
+                    goto out;
+                }
+            }
+
+            fill_yuyv(&queue.in_buf[index], width, height, submitted);
+            if (jpeghal_queue_submit(&queue, index) < 0) {
+                printf("queue %d      : submit fail at image %d\n", depth, submitted);
+                ret = -1;
+                goto out;
+            }
+            submitted++;
+
+            /* a quality change waits for the queue to drain, as a caller would */
+            if (vary_quality)
+                break;
+        }
+
+        index = jpeghal_queue_reap(&queue, BENCH_TIMEOUT_MS, NULL);
+        if (index == JPEG_QUEUE_TIMEOUT) {
+            printf("queue %d      : no image done in %d ms\n", depth, BENCH_TIMEOUT_MS);
+            ret = -1;
+            goto out;
+        }
+        if (index < 0) {
+            printf("queue %d      : reap fail(%d) at image %d\n", depth, index, reaped);
+            ret = -1;
+            goto out;
+        }
+        reaped++;
+    }
+
+    printf("queue %d%s : %6.1f images/s\n", depth, vary_quality ? " qual" : "     ",
+           jpeghal_queue_get_rate(&queue));
+
+out:
+    jpeghal_queue_flush(&queue);
+    jpeghal_queue_close(&queue);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int width  = 1280;
+    int height = 720;
+    int images = 100;
+    int depth;
+    int ret = 0;
+
+    if (argc > 1)
+        width = atoi(argv[1]);
+    if (argc > 2)
+        height = atoi(argv[2]);
+    if (argc > 3)
+        images = atoi(argv[3]);
+
+    if (width < 16 || (width & 15) || height < 8 || (height & 7) || images < 1) {
+        printf("usage: %s [width(x16)] [height(x8)] [images]\n", argv[0]);
+        return 1;
+    }
+
+    if (bench_session(width, height, images) < 0)
+        ret = 1;
+
+    for (depth = 1; depth <= JPEG_QUEUE_MAX_DEPTH; depth++) {
+        if (bench_queue(depth, width, height, images, 0) < 0)
+            ret = 1;
+    }
+
+    if (bench_queue(1, width, height, images, 1) < 0)
+        ret = 1;
+
+    return ret;
+}
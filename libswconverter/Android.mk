@@ -15,8 +15,7 @@ LOCAL_SRC_FILES := \
 LOCAL_C_INCLUDES := \
 	$(TOP)/$(TARGET_OMX_PATH)/include/khronos \
 	$(TOP)/$(TARGET_OMX_PATH)/include/sec \
-	$(TOP)/$(TARGET_HAL_PATH)/include \
-	$(TOP)/$(TARGET_HAL_PATH)/libhwconverter
+	$(TOP)/$(TARGET_HAL_PATH)/include
 
 ifeq ($(BOARD_USE_SAMSUNG_COLORFORMAT), true)
 LOCAL_CFLAGS += -DUSE_SAMSUNG_COLORFORMAT
@@ -29,6 +28,8 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_ARM_MODE := arm
 
 LOCAL_STATIC_LIBRARIES :=
-LOCAL_SHARED_LIBRARIES := liblog libfimc libhwconverter
+LOCAL_SHARED_LIBRARIES := liblog libfimc
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
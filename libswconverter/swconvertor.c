@@ -30,8 +30,16 @@
 
 #include "stdio.h"
 #include "stdlib.h"
+#include <pthread.h>
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
 #include "swconverter.h"
 
+/* RGB to NV12T runs in bands of at least CSC_NV12T_BAND_MIN_HEIGHT rows */
+#define CSC_NV12T_BAND_NUM          2
+#define CSC_NV12T_BAND_MIN_HEIGHT   128
+
 /*
  * Get tiled address of position(x,y)
  *
@@ -1825,4 +1833,434 @@ void csc_ARGB8888_to_YUV420SP(
             }
         }
     }
-}
\ No newline at end of file
+}
+/*
+ * Get offset of the 64x32 block(x,y) in a NV12T plane
+ * Same as the fomulas of csc_linear_to_tiled_crop()
+ *
+ * @param x_index
+ *   x index of the block[in]
+ *
+ * @param y_index
+ *   y index of the block[in]
+ *
+ * @param width
+ *   width of the plane[in]
+ *
+ * @param height
+ *   height of the plane[in]
+ *
+ * @return
+ *   offset of the block
+ */
+static unsigned int tile_64x32_offset(
+    unsigned int x_index,
+    unsigned int y_index,
+    unsigned int width,
+    unsigned int height)
+{
+    unsigned int x_block_num = ((width + 127) >> 7) << 1;
+    unsigned int y_block_num = (height + 31) >> 5;
+    unsigned int tiled_offset;
+
+    if (y_index & 0x1) {
+        /* odd fomula: 2+x+(x>>2)<<2+x_block_num*(y-1) */
+        tiled_offset = x_block_num * (y_index - 1) + x_index + 2 + ((x_index >> 2) << 2);
+    } else if ((y_index + 1) < y_block_num) {
+        /* even1 fomula: x+((x+2)>>2)<<2+x_block_num*y */
+        tiled_offset = x_index + (((x_index + 2) >> 2) << 2) + x_block_num * y_index;
+    } else {
+        /* even2 fomula: x+x_block_num*y */
+        tiled_offset = x_block_num * y_index + x_index;
+    }
+
+    return tiled_offset << 11;
+}
+
+#ifdef __ARM_NEON__
+/*
+ * Converts 16 pixels to Y, and to 8 interleaved CbCr of the even pixels
+ * Same integer math as csc_ARGB8888_to_YUV420SP(), bit exact
+ */
+static inline void csc_RGB_to_NV12_neon(
+    uint8x16_t r,
+    uint8x16_t g,
+    uint8x16_t b,
+    unsigned char *y_dst,
+    unsigned char *uv_dst)
+{
+    uint16x8_t round = vdupq_n_u16(128);
+    uint16x8_t y_lo, y_hi, u, v;
+    uint8x8_t  r_even, g_even, b_even;
+    uint8x8x2_t uv;
+
+    y_lo = vmull_u8(vget_low_u8(r), vdup_n_u8(66));
+    y_lo = vmlal_u8(y_lo, vget_low_u8(g), vdup_n_u8(129));
+    y_lo = vmlal_u8(y_lo, vget_low_u8(b), vdup_n_u8(25));
+    y_hi = vmull_u8(vget_high_u8(r), vdup_n_u8(66));
+    y_hi = vmlal_u8(y_hi, vget_high_u8(g), vdup_n_u8(129));
+    y_hi = vmlal_u8(y_hi, vget_high_u8(b), vdup_n_u8(25));
+
+    /* (Y + 128) >> 8 + 16 */
+    vst1q_u8(y_dst, vaddq_u8(vcombine_u8(vaddhn_u16(y_lo, round), vaddhn_u16(y_hi, round)),
+                             vdupq_n_u8(16)));
+
+    if (uv_dst == NULL)
+        return;
+
+    r_even = vuzp_u8(vget_low_u8(r), vget_high_u8(r)).val[0];
+    g_even = vuzp_u8(vget_low_u8(g), vget_high_u8(g)).val[0];
+    b_even = vuzp_u8(vget_low_u8(b), vget_high_u8(b)).val[0];
+
+    /* modulo 2^16 keeps bits 8..15, which are all the C code stores */
+    u = vmull_u8(b_even, vdup_n_u8(112));
+    u = vmlsl_u8(u, r_even, vdup_n_u8(38));
+    u = vmlsl_u8(u, g_even, vdup_n_u8(74));
+    v = vmull_u8(r_even, vdup_n_u8(112));
+    v = vmlsl_u8(v, g_even, vdup_n_u8(94));
+    v = vmlsl_u8(v, b_even, vdup_n_u8(18));
+
+    uv.val[0] = vadd_u8(vaddhn_u16(u, round), vdup_n_u8(128));
+    uv.val[1] = vadd_u8(vaddhn_u16(v, round), vdup_n_u8(128));
+    vst2_u8(uv_dst, uv);
+}
+#endif
+
+/*
+ * Converts a span of ARGB8888 row to Y of NV12, and to interleaved CbCr
+ * of its even pixels if uv_dst is not NULL
+ */
+static void csc_ARGB8888_span_to_NV12(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width)
+{
+    unsigned int *pSrc = (unsigned int *)rgb_src;
+    unsigned int R, G, B;
+    unsigned int i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x4_t argb = vld4q_u8(rgb_src + i * 4);
+
+        csc_RGB_to_NV12_neon(argb.val[2], argb.val[1], argb.val[0],
+                             y_dst + i, uv_dst ? uv_dst + i : NULL);
+    }
+#endif
+
+    for (; i < width; i++) {
+        R = (pSrc[i] & 0x00FF0000) >> 16;
+        G = (pSrc[i] & 0x0000FF00) >> 8;
+        B = (pSrc[i] & 0x000000FF);
+
+        y_dst[i] = (unsigned char)((((66 * R) + (129 * G) + (25 * B) + 128) >> 8) + 16);
+
+        if (uv_dst != NULL && (i % 2) == 0) {
+            uv_dst[i]     = (unsigned char)((((-38 * R) - (74 * G) + (112 * B) + 128) >> 8) + 128);
+            uv_dst[i + 1] = (unsigned char)((((112 * R) - (94 * G) - (18 * B) + 128) >> 8) + 128);
+        }
+    }
+}
+
+/*
+ * Converts a span of RGB565 row to Y of NV12, and to interleaved CbCr
+ * of its even pixels if uv_dst is not NULL
+ */
+static void csc_RGB565_span_to_NV12(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width)
+{
+    unsigned short int *pSrc = (unsigned short int *)rgb_src;
+    unsigned int R, G, B;
+    unsigned int i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 16 <= width; i += 16) {
+        uint16x8_t lo = vld1q_u16(pSrc + i);
+        uint16x8_t hi = vld1q_u16(pSrc + i + 8);
+        uint8x16_t r, g, b;
+
+        /* R * 8, G * 4, B * 8 as csc_RGB565_to_YUV420SP() */
+        r = vandq_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)), vdupq_n_u8(0xF8));
+        g = vandq_u8(vcombine_u8(vshrn_n_u16(lo, 3), vshrn_n_u16(hi, 3)), vdupq_n_u8(0xFC));
+        b = vshlq_n_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)), 3);
+
+        csc_RGB_to_NV12_neon(r, g, b, y_dst + i, uv_dst ? uv_dst + i : NULL);
+    }
+#endif
+
+    for (; i < width; i++) {
+        R = ((pSrc[i] & 0x0000F800) >> 11) * 8;
+        G = ((pSrc[i] & 0x000007E0) >> 5) * 4;
+        B = (pSrc[i] & 0x0000001F) * 8;
+
+        y_dst[i] = (unsigned char)((((66 * R) + (129 * G) + (25 * B) + 128) >> 8) + 16);
+
+        if (uv_dst != NULL && (i % 2) == 0) {
+            uv_dst[i]     = (unsigned char)((((-38 * R) - (74 * G) + (112 * B) + 128) >> 8) + 128);
+            uv_dst[i + 1] = (unsigned char)((((112 * R) - (94 * G) - (18 * B) + 128) >> 8) + 128);
+        }
+    }
+}
+
+typedef void (*csc_span_to_NV12_func)(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width);
+
+/* rows [top, bottom) of a RGB to NV12T conversion */
+struct csc_NV12T_band {
+    unsigned char         *y_dst;
+    unsigned char         *uv_dst;
+    unsigned char         *rgb_src;
+    unsigned int           width;
+    unsigned int           height;
+    unsigned int           bytes_per_pixel;
+    unsigned int           top;
+    unsigned int           bottom;
+    csc_span_to_NV12_func  span;
+};
+
+/*
+ * Converts the rows of a band, each 64 pixel span straight into its block
+ * of the Y plane and, on even rows, of the UV plane
+ */
+static void *csc_RGB_to_NV12T_band(void *arg)
+{
+    struct csc_NV12T_band *band = (struct csc_NV12T_band *)arg;
+    unsigned int uv_height = band->height >> 1;
+    unsigned int i, j, w;
+    unsigned char *src;
+    unsigned char *uv;
+
+    for (i = band->top; i < band->bottom; i++) {
+        src = band->rgb_src + band->width * band->bytes_per_pixel * i;
+
+        for (j = 0; j < band->width; j += 64) {
+            w = band->width - j;
+            if (w > 64)
+                w = 64;
+
+            uv = NULL;
+            if ((i % 2) == 0)
+                uv = band->uv_dst + tile_64x32_offset(j >> 6, i >> 6, band->width, uv_height)
+                     + 64 * ((i >> 1) & 0x1F);
+
+            band->span(band->y_dst + tile_64x32_offset(j >> 6, i >> 5, band->width, band->height)
+                       + 64 * (i & 0x1F),
+                       uv, src + j * band->bytes_per_pixel, w);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Threads converting the bands after the first one. They are started by
+ * the first conversion and live as long as the process, sleeping on their
+ * condition between frames: a frame costs a wakeup instead of a
+ * pthread_create() and pthread_join() per band.
+ */
+struct csc_NV12T_worker {
+    pthread_t              thread;
+    pthread_mutex_t        lock;
+    pthread_cond_t         cond;
+    struct csc_NV12T_band *band;    /* band to convert, NULL when done */
+};
+
+static struct csc_NV12T_worker csc_NV12T_workers[CSC_NV12T_BAND_NUM - 1];
+static int                     csc_NV12T_worker_num;
+static pthread_once_t          csc_NV12T_worker_once = PTHREAD_ONCE_INIT;
+/* one conversion at a time owns the workers, the others run on their caller */
+static pthread_mutex_t         csc_NV12T_worker_busy = PTHREAD_MUTEX_INITIALIZER;
+
+static void *csc_NV12T_worker_loop(void *arg)
+{
+    struct csc_NV12T_worker *worker = (struct csc_NV12T_worker *)arg;
+    struct csc_NV12T_band *band;
+
+    for (;;) {
+        pthread_mutex_lock(&worker->lock);
+        while (worker->band == NULL)
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        band = worker->band;
+        pthread_mutex_unlock(&worker->lock);
+
+        csc_RGB_to_NV12T_band(band);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->band = NULL;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    return NULL;
+}
+
+static void csc_NV12T_worker_init(void)
+{
+    pthread_attr_t attr;
+    int i;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (i = 0; i < CSC_NV12T_BAND_NUM - 1; i++) {
+        struct csc_NV12T_worker *worker = &csc_NV12T_workers[i];
+
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        worker->band = NULL;
+        if (pthread_create(&worker->thread, &attr, csc_NV12T_worker_loop, worker) != 0)
+            break;
+        csc_NV12T_worker_num++;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * Splits the conversion into bands of whole UV blocks (64 rows), so the
+ * bands never write the same cache line, and runs them in parallel
+ */
+static void csc_RGB_to_NV12T(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width,
+    unsigned int height,
+    unsigned int bytes_per_pixel,
+    csc_span_to_NV12_func span)
+{
+    struct csc_NV12T_band band[CSC_NV12T_BAND_NUM];
+    unsigned int worker_num = 0;
+    unsigned int band_num = CSC_NV12T_BAND_NUM;
+    unsigned int band_height;
+    unsigned int i;
+
+    if (height < CSC_NV12T_BAND_MIN_HEIGHT * band_num)
+        band_num = 1;
+
+    band_height = (((height + band_num - 1) / band_num + 63) >> 6) << 6;
+
+    for (i = 0; i < band_num; i++) {
+        band[i].y_dst           = y_dst;
+        band[i].uv_dst          = uv_dst;
+        band[i].rgb_src         = rgb_src;
+        band[i].width           = width;
+        band[i].height          = height;
+        band[i].bytes_per_pixel = bytes_per_pixel;
+        band[i].top             = band_height * i;
+        band[i].bottom          = band_height * (i + 1);
+        if (band[i].top > height)
+            band[i].top = height;
+        if (band[i].bottom > height)
+            band[i].bottom = height;
+        band[i].span            = span;
+    }
+
+    /*
+     * The first band runs here, and so do the others when the workers
+     * could not start or are busy with a concurrent conversion.
+     */
+    if (1 < band_num) {
+        pthread_once(&csc_NV12T_worker_once, csc_NV12T_worker_init);
+        if (0 < csc_NV12T_worker_num && pthread_mutex_trylock(&csc_NV12T_worker_busy) == 0)
+            worker_num = csc_NV12T_worker_num;
+    }
+    if (worker_num > band_num - 1)
+        worker_num = band_num - 1;
+
+    for (i = 0; i < worker_num; i++) {
+        struct csc_NV12T_worker *worker = &csc_NV12T_workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+        worker->band = &band[i + 1];
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    csc_RGB_to_NV12T_band(&band[0]);
+    for (i = worker_num + 1; i < band_num; i++)
+        csc_RGB_to_NV12T_band(&band[i]);
+
+    for (i = 0; i < worker_num; i++) {
+        struct csc_NV12T_worker *worker = &csc_NV12T_workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+        while (worker->band != NULL)
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    if (0 < worker_num)
+        pthread_mutex_unlock(&csc_NV12T_worker_busy);
+}
+
+/*
+ * Converts ARGB8888 to NV12T in one pass
+ * Same result as csc_ARGB8888_to_YUV420SP() followed by
+ * csc_linear_to_tiled_y() of Y and UV, without the linear buffer
+ *
+ * @param y_dst
+ *   Y plane address of NV12T[out]
+ *
+ * @param uv_dst
+ *   UV plane address of NV12T[out]
+ *
+ * @param rgb_src
+ *   Address of ARGB8888[in]
+ *
+ * @param width
+ *   Width of ARGB8888[in]
+ *   it should be even
+ *
+ * @param height
+ *   Height of ARGB8888[in]
+ *   it should be even
+ */
+void csc_ARGB8888_to_NV12T(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width,
+    unsigned int height)
+{
+    csc_RGB_to_NV12T(y_dst, uv_dst, rgb_src, width, height, 4, csc_ARGB8888_span_to_NV12);
+}
+
+/*
+ * Converts RGB565 to NV12T in one pass
+ * Same result as csc_RGB565_to_YUV420SP() followed by
+ * csc_linear_to_tiled_y() of Y and UV, without the linear buffer
+ *
+ * @param y_dst
+ *   Y plane address of NV12T[out]
+ *
+ * @param uv_dst
+ *   UV plane address of NV12T[out]
+ *
+ * @param rgb_src
+ *   Address of RGB565[in]
+ *
+ * @param width
+ *   Width of RGB565[in]
+ *   it should be even
+ *
+ * @param height
+ *   Height of RGB565[in]
+ *   it should be even
+ */
+void csc_RGB565_to_NV12T(
+    unsigned char *y_dst,
+    unsigned char *uv_dst,
+    unsigned char *rgb_src,
+    unsigned int width,
+    unsigned int height)
+{
+    csc_RGB_to_NV12T(y_dst, uv_dst, rgb_src, width, height, 2, csc_RGB565_span_to_NV12);
+}
@@ -0,0 +1,268 @@
+/*
+ *
+ * Copyright 2012 Samsung Electronics S.LSI Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Golden test of the one pass RGB to NV12T converters.
+ *
+ *   csc_nv12t_test [iterations]
+ *
+ * csc_ARGB8888_to_NV12T() and csc_RGB565_to_NV12T() must write the same
+ * bytes as csc_*_to_YUV420SP() followed by csc_linear_to_tiled_y() of Y and
+ * UV, for every size below, also with CSC_TEST_THREADS conversions running
+ * at once. Then the time per 1280x720 frame of both paths is printed.
+ *
+ * The sizes keep height / 2 even: for an odd UV height
+ * csc_linear_to_tiled_y() tiles a row from past the linear plane, so the
+ * two step path is not a reference there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "swconverter.h"
+
+#define CSC_TEST_THREADS    (3)
+#define ALIGN(x, a)         (((x) + (a) - 1) & ~((a) - 1))
+
+static const unsigned int test_size[][2] = {
+    {   2,    4 }, {   6,    4 }, {  64,   32 }, { 130,   68 },
+    { 176,  144 }, { 320,  240 }, { 720,  480 }, { 800, 1280 },
+    { 1280, 720 }, { 1282, 724 }, { 1366, 768 }, { 1920, 1080 },
+};
+
+#define TEST_SIZE_NUM   (sizeof(test_size) / sizeof(test_size[0]))
+
+struct csc_test_frame {
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    bpp;
+    unsigned char  *rgb;
+    unsigned char  *y_linear;
+    unsigned char  *uv_linear;
+    unsigned char  *y_golden;
+    unsigned char  *uv_golden;
+    unsigned char  *y_out;
+    unsigned char  *uv_out;
+    unsigned int    y_size;
+    unsigned int    uv_size;
+};
+
+static long long now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int frame_alloc(struct csc_test_frame *f, unsigned int width,
+                       unsigned int height, unsigned int bpp)
+{
+    unsigned int tiled_width = ALIGN(width, 128);
+    unsigned int i;
+
+    memset(f, 0, sizeof(*f));
+    f->width   = width;
+    f->height  = height;
+    f->bpp     = bpp;
+    f->y_size  = tiled_width * ALIGN(height, 32);
+    f->uv_size = tiled_width * ALIGN(height / 2, 32);
+
+    /* the linear planes are read up to the next whole tile */
+    f->rgb       = malloc(width * height * bpp);
+    f->y_linear  = calloc(1, f->y_size);
+    f->uv_linear = calloc(1, f->uv_size);
+    f->y_golden  = malloc(f->y_size);
+    f->uv_golden = malloc(f->uv_size);
+    f->y_out     = malloc(f->y_size);
+    f->uv_out    = malloc(f->uv_size);
+    if (!f->rgb || !f->y_linear || !f->uv_linear || !f->y_golden ||
+        !f->uv_golden || !f->y_out || !f->uv_out)
+        return -1;
+
+    for (i = 0; i < width * height * bpp; i++)
+        f->rgb[i] = rand();
+
+    memset(f->y_golden, 0xAA, f->y_size);
+    memset(f->uv_golden, 0x55, f->uv_size);
+
+    if (bpp == 4)
+        csc_ARGB8888_to_YUV420SP(f->y_linear, f->uv_linear, f->rgb, width, height);
+    else
+        csc_RGB565_to_YUV420SP(f->y_linear, f->uv_linear, f->rgb, width, height);
+    csc_linear_to_tiled_y(f->y_golden, f->y_linear, width, height);
+    csc_linear_to_tiled_y(f->uv_golden, f->uv_linear, width, height / 2);
+    return 0;
+}
+
+static void frame_free(struct csc_test_frame *f)
+{
+    free(f->rgb);
+    free(f->y_linear);
+    free(f->uv_linear);
+    free(f->y_golden);
+    free(f->uv_golden);
+    free(f->y_out);
+    free(f->uv_out);
+}
+
+static void frame_convert(struct csc_test_frame *f)
+{
+    if (f->bpp == 4)
+        csc_ARGB8888_to_NV12T(f->y_out, f->uv_out, f->rgb, f->width, f->height);
+    else
+        csc_RGB565_to_NV12T(f->y_out, f->uv_out, f->rgb, f->width, f->height);
+}
+
+static int frame_check(struct csc_test_frame *f, const char *name)
+{
+    int y_ok, uv_ok;
+
+    memset(f->y_out, 0xAA, f->y_size);
+    memset(f->uv_out, 0x55, f->uv_size);
+    frame_convert(f);
+
+    y_ok  = (memcmp(f->y_out, f->y_golden, f->y_size) == 0);
+    uv_ok = (memcmp(f->uv_out, f->uv_golden, f->uv_size) == 0);
+    if (!y_ok || !uv_ok) {
+        printf("%-10s %4ux%-4u %s: %s%s mismatch\n", name, f->width, f->height,
+               f->bpp == 4 ? "ARGB8888" : "RGB565", y_ok ? "" : "Y ", uv_ok ? "" : "UV");
+        return -1;
+    }
+    return 0;
+}
+
+struct csc_test_thread {
+    pthread_t               thread;
+    struct csc_test_frame  *frame;
+    int                     iterations;
+    int                     fail;
+};
+
+static void *concurrent_thread(void *arg)
+{
+    struct csc_test_thread *t = (struct csc_test_thread *)arg;
+    int i;
+
+    for (i = 0; i < t->iterations; i++) {
+        if (frame_check(t->frame, "concurrent") < 0)
+            t->fail++;
+    }
+    return NULL;
+}
+
+static int test_concurrent(int iterations)
+{
+    struct csc_test_frame frame[CSC_TEST_THREADS];
+    struct csc_test_thread t[CSC_TEST_THREADS];
+    int fail = 0;
+    int i;
+
+    for (i = 0; i < CSC_TEST_THREADS; i++) {
+        if (frame_alloc(&frame[i], 1280, 720, (i % 2) ? 2 : 4) < 0) {
+            printf("out of memory\n");
+            return -1;
+        }
+        t[i].frame = &frame[i];
+        t[i].iterations = iterations;
+        t[i].fail = 0;
+    }
+
+    for (i = 0; i < CSC_TEST_THREADS; i++)
+        pthread_create(&t[i].thread, NULL, concurrent_thread, &t[i]);
+
+    for (i = 0; i < CSC_TEST_THREADS; i++) {
+        pthread_join(t[i].thread, NULL);
+        fail += t[i].fail;
+        frame_free(&frame[i]);
+    }
+
+    printf("concurrent %d x %d frames: %s\n", CSC_TEST_THREADS, iterations,
+           fail ? "FAIL" : "ok");
+    return fail ? -1 : 0;
+}
+
+static void bench(unsigned int bpp, int iterations)
+{
+    struct csc_test_frame f;
+    long long start, two_pass, one_pass;
+    int i;
+
+    if (frame_alloc(&f, 1280, 720, bpp) < 0)
+        return;
+
+    start = now_us();
+    for (i = 0; i < iterations; i++) {
+        if (bpp == 4)
+            csc_ARGB8888_to_YUV420SP(f.y_linear, f.uv_linear, f.rgb, f.width, f.height);
+        else
+            csc_RGB565_to_YUV420SP(f.y_linear, f.uv_linear, f.rgb, f.width, f.height);
+        csc_linear_to_tiled_y(f.y_out, f.y_linear, f.width, f.height);
+        csc_linear_to_tiled_y(f.uv_out, f.uv_linear, f.width, f.height / 2);
+    }
+    two_pass = now_us() - start;
+
+    start = now_us();
+    for (i = 0; i < iterations; i++)
+        frame_convert(&f);
+    one_pass = now_us() - start;
+
+    printf("1280x720 %-8s: two pass %6lld us, one pass %6lld us\n",
+           bpp == 4 ? "ARGB8888" : "RGB565", two_pass / iterations, one_pass / iterations);
+    frame_free(&f);
+}
+
+int main(int argc, char **argv)
+{
+    struct csc_test_frame f;
+    int iterations = 20;
+    int fail = 0;
+    unsigned int i, bpp;
+
+    if (argc > 1)
+        iterations = atoi(argv[1]);
+    if (iterations < 1) {
+        printf("usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+
+    for (i = 0; i < TEST_SIZE_NUM; i++) {
+        for (bpp = 2; bpp <= 4; bpp += 2) {
+            if (frame_alloc(&f, test_size[i][0], test_size[i][1], bpp) < 0) {
+                printf("out of memory\n");
+                return 1;
+            }
+            if (frame_check(&f, "golden") < 0)
+                fail++;
+            frame_free(&f);
+        }
+    }
+    printf("golden %u sizes: %s\n", (unsigned int)TEST_SIZE_NUM, fail ? "FAIL" : "ok");
+
+    if (test_concurrent(iterations) < 0)
+        fail++;
+
+    bench(4, iterations);
+    bench(2, iterations);
+
+    return fail ? 1 : 0;
+}